@@ -0,0 +1,80 @@
+#include "Corpus.hpp"
+
+#include <dirent.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "CompilationEngine.hpp"
+
+namespace jcc::bench {
+
+namespace {
+
+std::vector<std::string> listDir(const std::string &path) {
+  std::vector<std::string> entries;
+  if (DIR *dir = opendir(path.c_str())) {
+    while (struct dirent *ent = readdir(dir)) {
+      if (ent->d_name[0] != '.') entries.emplace_back(ent->d_name);
+    }
+    closedir(dir);
+  }
+  std::sort(entries.begin(), entries.end());
+  return entries;
+}
+
+std::string readFile(const std::string &path) {
+  std::ifstream in(path);
+  std::ostringstream contents;
+  contents << in.rdbuf();
+  return contents.str();
+}
+
+Program loadProgram(const std::string &dir, const std::string &name) {
+  Program program{name, {}};
+  for (const auto &file : listDir(dir)) {
+    if (file.size() < 5 || file.compare(file.size() - 5, 5, ".jack") != 0) {
+      continue;
+    }
+    program.files.emplace_back(file, readFile(dir + "/" + file));
+  }
+
+  std::stable_partition(
+      program.files.begin(), program.files.end(),
+      [](const auto &file) { return file.first != "Main.jack"; });
+  return program;
+}
+
+}  // namespace
+
+size_t Program::bytes() const {
+  size_t total = 0;
+  for (const auto &file : files) { total += file.second.size(); }
+  return total;
+}
+
+const std::vector<Program> &corpus() {
+  static const std::vector<Program> programs = [] {
+    std::vector<Program> loaded;
+    for (const auto &name : listDir(JCC_BENCH_CORPUS_DIR)) {
+      auto program =
+          loadProgram(std::string(JCC_BENCH_CORPUS_DIR) + "/" + name, name);
+      if (!program.files.empty()) loaded.push_back(std::move(program));
+    }
+    return loaded;
+  }();
+  return programs;
+}
+
+std::vector<std::unique_ptr<ast::ClassDecl>> parse(const Program &program) {
+  std::vector<std::unique_ptr<ast::ClassDecl>> classes;
+  for (const auto &[file, source] : program.files) {
+    CompilationEngine engine{std::make_unique<std::istringstream>(source),
+                             file};
+    classes.push_back(engine.compileClass());
+  }
+  return classes;
+}
+
+}  // namespace jcc::bench
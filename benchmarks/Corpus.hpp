@@ -0,0 +1,33 @@
+#ifndef jcc_bench_Corpus_hpp
+#define jcc_bench_Corpus_hpp
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "JackAST.hpp"
+
+namespace jcc::bench {
+
+// A Jack program of the benchmark corpus. Each program lives in its own
+// directory under benchmarks/corpus with one file per class
+struct Program {
+  std::string name;
+
+  // (file name, source) of each class, ordered so that Main comes last and
+  // the classes it uses are generated before it
+  std::vector<std::pair<std::string, std::string>> files;
+
+  size_t bytes() const;
+};
+
+// Programs found in the corpus directory, loaded once
+const std::vector<Program> &corpus();
+
+// Parse every class of a program
+std::vector<std::unique_ptr<ast::ClassDecl>> parse(const Program &program);
+
+}  // namespace jcc::bench
+
+#endif  // jcc_bench_Corpus_hpp
@@ -0,0 +1,135 @@
+// Benchmarks of each phase of the compiler over the programs of the corpus
+#include <benchmark/benchmark.h>
+
+#include <sstream>
+
+#include "CompilationEngine.hpp"
+#include "Corpus.hpp"
+#include "JackLexer.hpp"
+#include "Runtime.hpp"
+
+using namespace jcc;
+using namespace jcc::bench;
+
+namespace {
+
+size_t countInstructions(const llvm::Module &module) {
+  size_t count = 0;
+  for (const auto &F : module) { count += F.getInstructionCount(); }
+  return count;
+}
+
+// Create a runtime with the parsed and generated program, ready to be handed
+// to the JIT
+void prepare(Runtime &rt, const Program &program) {
+  for (auto &cls : parse(program)) { rt.addAST(std::move(cls)); }
+  rt.codegen();
+}
+
+void BM_Lex(benchmark::State &state, const Program *program) {
+  size_t tokens = 0;
+  for (auto _ : state) {
+    for (const auto &file : program->files) {
+      JackLexer lexer{std::make_unique<std::istringstream>(file.second)};
+      while (lexer.hasMoreTokens()) { lexer.advance(); }
+      tokens += lexer.getNumTokens();
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * program->bytes());
+  state.counters["tokens/s"] =
+      benchmark::Counter(tokens, benchmark::Counter::kIsRate);
+}
+
+void BM_Parse(benchmark::State &state, const Program *program) {
+  size_t nodes = 0;
+  for (auto _ : state) {
+    const auto before = ast::Node::numCreated();
+    auto classes = parse(*program);
+    nodes += ast::Node::numCreated() - before;
+
+    // Freeing the AST is not part of parsing
+    state.PauseTiming();
+    classes.clear();
+    state.ResumeTiming();
+  }
+  state.SetBytesProcessed(state.iterations() * program->bytes());
+  state.counters["nodes/s"] =
+      benchmark::Counter(nodes, benchmark::Counter::kIsRate);
+}
+
+void BM_Codegen(benchmark::State &state, const Program *program) {
+  std::istringstream in;
+  std::ostringstream out;
+  size_t instructions = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    Runtime rt{in, out};
+    for (auto &cls : parse(*program)) { rt.addAST(std::move(cls)); }
+    state.ResumeTiming();
+
+    rt.codegen();
+
+    state.PauseTiming();
+    instructions += countInstructions(rt.module());
+    state.ResumeTiming();
+  }
+  state.counters["instructions/s"] =
+      benchmark::Counter(instructions, benchmark::Counter::kIsRate);
+}
+
+void BM_Materialize(benchmark::State &state, const Program *program) {
+  std::istringstream in;
+  std::ostringstream out;
+  for (auto _ : state) {
+    state.PauseTiming();
+    Runtime rt{in, out};
+    prepare(rt, *program);
+    state.ResumeTiming();
+
+    benchmark::DoNotOptimize(rt.materialize());
+  }
+}
+
+void BM_Run(benchmark::State &state, const Program *program) {
+  int status = 0;
+  for (auto _ : state) {
+    std::istringstream in;
+    std::ostringstream out;
+    Runtime rt{in, out};
+    prepare(rt, *program);
+    status = rt.run();
+    benchmark::DoNotOptimize(out.str());
+  }
+  state.SetLabel("exit " + std::to_string(status));
+}
+
+// The fixed cost paid by every Runtime, mostly creating the JIT
+void BM_CreateRuntime(benchmark::State &state) {
+  std::istringstream in;
+  std::ostringstream out;
+  for (auto _ : state) {
+    Runtime rt{in, out};
+    benchmark::DoNotOptimize(&rt);
+  }
+}
+BENCHMARK(BM_CreateRuntime)->Unit(benchmark::kMillisecond);
+
+// Register every phase once per program of the corpus
+const bool registered = [] {
+  for (const auto &program : corpus()) {
+    const auto &name = program.name;
+    benchmark::RegisterBenchmark(("BM_Lex/" + name).c_str(), BM_Lex, &program);
+    benchmark::RegisterBenchmark(("BM_Parse/" + name).c_str(), BM_Parse,
+                                 &program);
+    benchmark::RegisterBenchmark(("BM_Codegen/" + name).c_str(), BM_Codegen,
+                                 &program);
+    benchmark::RegisterBenchmark(("BM_Materialize/" + name).c_str(),
+                                 BM_Materialize, &program)
+        ->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(("BM_Run/" + name).c_str(), BM_Run, &program)
+        ->Unit(benchmark::kMillisecond);
+  }
+  return true;
+}();
+
+}  // namespace
@@ -0,0 +1,121 @@
+// Compile time and memory of generated programs as their size grows. Each
+// benchmark varies one dimension of the ProgramOptions and reports the size of
+// the input so the results can be plotted against it
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include "CompilationEngine.hpp"
+#include "ProgramGenerator.hpp"
+#include "Runtime.hpp"
+#include "Statistics.hpp"
+
+using namespace jcc;
+
+namespace {
+
+using Sources = std::vector<std::pair<std::string, std::string>>;
+
+void BM_Compile(benchmark::State &state, const gen::ProgramOptions &options) {
+  const Sources sources = gen::ProgramGenerator(options).generateSources();
+
+  size_t bytes = 0;
+  size_t lines = 0;
+  for (const auto &file : sources) {
+    bytes += file.second.size();
+    lines += std::count(file.second.begin(), file.second.end(), '\n');
+  }
+
+  std::istringstream in;
+  std::ostringstream out;
+  size_t nodes = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    Runtime rt{in, out};
+    const auto before = ast::Node::numCreated();
+    state.ResumeTiming();
+
+    for (const auto &[file, source] : sources) {
+      CompilationEngine engine{std::make_unique<std::istringstream>(source),
+                               file};
+      rt.addAST(engine.compileClass());
+    }
+    rt.codegen();
+
+    state.PauseTiming();
+    nodes = ast::Node::numCreated() - before;
+    state.ResumeTiming();
+  }
+
+  state.SetBytesProcessed(state.iterations() * bytes);
+  state.counters["lines"] = lines;
+  state.counters["nodes"] = nodes;
+  state.counters["lines/s"] = benchmark::Counter(
+      state.iterations() * lines, benchmark::Counter::kIsRate);
+  // The peak only grows, so this is meaningful when the sizes are ascending
+  state.counters["peak_rss_kb"] = stats::peakRSS();
+}
+
+gen::ProgramOptions smallProgram() {
+  gen::ProgramOptions options;
+  options.numClasses = 1;
+  options.functionsPerClass = 1;
+  options.statementsPerFunction = 10;
+  return options;
+}
+
+void BM_Classes(benchmark::State &state) {
+  auto options = smallProgram();
+  options.numClasses = state.range(0);
+  options.functionsPerClass = 10;
+  BM_Compile(state, options);
+}
+BENCHMARK(BM_Classes)
+    ->RangeMultiplier(4)
+    ->Range(1, 4096)
+    ->Unit(benchmark::kMillisecond);
+
+void BM_FunctionLength(benchmark::State &state) {
+  auto options = smallProgram();
+  options.statementsPerFunction = state.range(0);
+  BM_Compile(state, options);
+}
+BENCHMARK(BM_FunctionLength)
+    ->RangeMultiplier(4)
+    ->Range(16, 1 << 16)
+    ->Unit(benchmark::kMillisecond);
+
+void BM_ExpressionDepth(benchmark::State &state) {
+  auto options = smallProgram();
+  options.expressionDepth = state.range(0);
+  BM_Compile(state, options);
+}
+BENCHMARK(BM_ExpressionDepth)
+    ->RangeMultiplier(2)
+    ->Range(1, 256)
+    ->Unit(benchmark::kMillisecond);
+
+void BM_CallDensity(benchmark::State &state) {
+  auto options = smallProgram();
+  options.numClasses = 16;
+  options.functionsPerClass = 16;
+  options.callDensity = state.range(0) / 100.0;
+  BM_Compile(state, options);
+}
+BENCHMARK(BM_CallDensity)
+    ->DenseRange(0, 40, 10)
+    ->Unit(benchmark::kMillisecond);
+
+void BM_StringLiterals(benchmark::State &state) {
+  auto options = smallProgram();
+  options.functionsPerClass = 16;
+  options.stringsPerFunction = state.range(0);
+  BM_Compile(state, options);
+}
+BENCHMARK(BM_StringLiterals)
+    ->RangeMultiplier(4)
+    ->Range(1, 1024)
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
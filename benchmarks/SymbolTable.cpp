@@ -0,0 +1,78 @@
+// Lookups in the symbol tables against the node based map they replace, for
+// tables of a growing number of variables. Every name is looked up once per
+// iteration, as the front end and the passes do for each identifier
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "JackAST.hpp"
+#include "SymbolTable.hpp"
+
+using namespace jcc;
+
+namespace {
+
+std::vector<std::unique_ptr<ast::VarDecl>> makeVars(size_t count) {
+  std::vector<std::unique_ptr<ast::VarDecl>> vars;
+  for (size_t i = 0; i < count; ++i) {
+    vars.push_back(
+        std::make_unique<ast::VarDecl>("local" + std::to_string(i), "int"));
+  }
+  return vars;
+}
+
+void BM_TableLookup(benchmark::State &state) {
+  const auto vars = makeVars(state.range(0));
+  sym::Table table{"Main"};
+  for (const auto &var : vars) table.addValue(var.get());
+
+  for (auto _ : state) {
+    for (const auto &var : vars) {
+      benchmark::DoNotOptimize(table.lookup(var->getName()));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * vars.size());
+  state.counters["bytes"] = table.memoryUsage();
+}
+BENCHMARK(BM_TableLookup)->RangeMultiplier(2)->Range(2, 256);
+
+void BM_MapLookup(benchmark::State &state) {
+  const auto vars = makeVars(state.range(0));
+  std::unordered_map<std::string, ast::VarDecl *> map;
+  for (const auto &var : vars) map.emplace(var->getName(), var.get());
+
+  for (auto _ : state) {
+    for (const auto &var : vars) {
+      benchmark::DoNotOptimize(map.find(var->getName()));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * vars.size());
+}
+BENCHMARK(BM_MapLookup)->RangeMultiplier(2)->Range(2, 256);
+
+// Building the table of a function, paid once per function parsed
+void BM_TableBuild(benchmark::State &state) {
+  const auto vars = makeVars(state.range(0));
+  for (auto _ : state) {
+    sym::Table table{"Main"};
+    for (const auto &var : vars) table.addValue(var.get());
+    benchmark::DoNotOptimize(table.size());
+  }
+  state.SetItemsProcessed(state.iterations() * vars.size());
+}
+BENCHMARK(BM_TableBuild)->RangeMultiplier(2)->Range(2, 256);
+
+void BM_MapBuild(benchmark::State &state) {
+  const auto vars = makeVars(state.range(0));
+  for (auto _ : state) {
+    std::unordered_map<std::string, ast::VarDecl *> map;
+    for (const auto &var : vars) map.emplace(var->getName(), var.get());
+    benchmark::DoNotOptimize(map.size());
+  }
+  state.SetItemsProcessed(state.iterations() * vars.size());
+}
+BENCHMARK(BM_MapBuild)->RangeMultiplier(2)->Range(2, 256);
+
+}  // namespace
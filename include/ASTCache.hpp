@@ -0,0 +1,50 @@
+#ifndef io_ASTCache_hpp
+#define io_ASTCache_hpp
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "JackAST_fwd.hpp"
+
+namespace jcc::io {
+
+// On disk cache of the parsed classes, so that the files that did not change
+// since the last compilation skip the front end. The entries are keyed by a
+// hash of the source, a file that is edited and reverted hits the cache again.
+//
+// A class is serialized as it comes out of the CompilationEngine, before any
+// pass annotated it, into a flat buffer that is read in place from a mapping of
+// the file:
+//  - a header with the version of the format and the size of each array
+//  - the nodes in preorder, records of a fixed size with their kind, location,
+//    operator or value, names and the range of their children
+//  - the children of every node, indices of nodes that follow their parent
+//  - the names, NUL terminated and referenced by their offset
+// Deserializing rebuilds the symbol tables and the parents the parser sets.
+// Entries of another version or that do not validate are misses
+class ASTCache {
+public:
+  explicit ASTCache(std::string dir) : m_dir{std::move(dir)} {}
+
+  // The class parsed from the source when it was stored, null on a miss
+  std::unique_ptr<ast::ClassDecl> load(const std::string &source) const;
+  // Returns false when the entry could not be written
+  bool store(const std::string &source, const ast::ClassDecl &cls) const;
+
+  static std::string serialize(const ast::ClassDecl &cls);
+  static std::unique_ptr<ast::ClassDecl> deserialize(const char *data,
+                                                     size_t size);
+
+  // FNV-1a, the key of the entry of a source
+  static uint64_t hash(const std::string &source);
+
+private:
+  std::string m_dir;
+
+  std::string path(const std::string &source) const;
+};
+
+}  // namespace jcc::io
+
+#endif /* io_ASTCache_hpp */
@@ -0,0 +1,76 @@
+#ifndef jcc_BatchServer_hpp
+#define jcc_BatchServer_hpp
+
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "JackJIT.hpp"
+
+namespace jcc {
+
+// Long-lived server that compiles and runs Jack programs read from a stream,
+// keeping warm JIT instances around so that a job does not pay for the JIT
+// construction and each job runs in its own JITDylib. Every payload is
+// preceded by its length in bytes:
+//
+//   JOB <id>
+//   FILE <name> <length>\n<source>   (one per class)
+//   INPUT <length>\n<data>           (optional, read by Keyboard)
+//   RUN
+//
+// The server answers each job with
+//
+//   OUTPUT <id> <length>\n<data>
+//   EXIT <id> <status>
+//
+// or with `ERROR <id> <length>\n<message>` if the job could not be compiled
+// or its entry point is missing; the server goes on with the next job.
+// Jobs run concurrently, so answers may come back out of order. `QUIT` or the
+// end of the input stops the server once the pending jobs are done
+class BatchServer {
+public:
+  struct Job {
+    std::string id;
+    std::vector<std::pair<std::string, std::string>> files;
+    std::string input;
+  };
+
+  BatchServer(std::istream &is, std::ostream &os, size_t workers,
+              exec::JITOptions jitOptions = {})
+      : m_pool{workers, 64, jitOptions},
+        m_workers{workers},
+        m_is{is},
+        m_os{os} {}
+
+  // Serve jobs until the input is exhausted. Returns non-zero if the input
+  // was malformed
+  int serve();
+
+private:
+  struct Response {
+    int status = 0;
+    std::string output;
+    std::string error;
+  };
+
+  exec::JITPool m_pool;
+  size_t m_workers;
+  std::istream &m_is;
+  std::ostream &m_os;
+  std::mutex m_osMutex;
+  std::vector<std::future<void>> m_pending;
+
+  bool readJob(const std::string &id, Job &job);
+  bool readPayload(size_t length, std::string &payload);
+  Response runJob(const Job &job);
+  void respond(const std::string &id, const Response &response);
+  void submit(Job job);
+};
+
+}  // namespace jcc
+
+#endif  // jcc_BatchServer_hpp
@@ -59,6 +59,23 @@ public:
   CompilationEngine(InputStream input)
       : CompilationEngine(std::move(input), "") {}
 
+  // Parse tokens recorded from the source file, see setDeferBodies
+  CompilationEngine(std::shared_ptr<const TokenList> tokens,
+                    std::string filename)
+      : m_tokenizer{std::move(tokens)}, m_filename{std::move(filename)} {}
+
+  // Record the tokens of the subroutine bodies instead of parsing them, only
+  // their signatures are parsed by compileClass. The bodies are parsed when
+  // FunctionDecl::parseDefinition is called, see LazyBodies
+  void setDeferBodies(bool defer) { m_deferBodies = defer; }
+
+  // Parse the subroutine bodies of the large classes on up to `threads`
+  // threads. The tokens of each body are recorded while the class is read,
+  // then contiguous runs of bodies of about the same size are parsed
+  // concurrently. The first syntax error in the file is thrown, as it is
+  // when the class is parsed on one thread
+  void setParseThreads(unsigned threads) { m_parseThreads = threads; }
+
   template <typename... Ts>
   void match(const Token &actual, const Token &expected, Ts &&... tail) {
     if (!detail::match(actual, expected, std::forward<Ts>(tail)...))
@@ -75,11 +92,31 @@ public:
 
   std::unique_ptr<ast::ClassDecl> compileClass();
 
+  // Entry points to compile a program incrementally, one declaration or
+  // statement at a time, in the scope of a class that has already been
+  // compiled. The whole input must be consumed by the declaration
+
+  // `var type name (, name)*;` at the top level. The variables are returned
+  // as statics so that they outlive the statement declaring them
+  ast::ParamList compileStaticVarDec(ast::ClassDecl &cls);
+  std::unique_ptr<ast::Block> compileStatements(ast::ClassDecl &cls,
+                                                ast::FunctionDecl &fcn);
+  std::unique_ptr<ast::Node> compileExpression(ast::ClassDecl &cls,
+                                               ast::FunctionDecl &fcn);
+  // `{ varDec* statements }`, the body of a subroutine of the class
+  std::unique_ptr<ast::Block> compileBody(ast::ClassDecl &cls,
+                                          ast::FunctionDecl &fcn);
+
 private:
   ast::VarDecList compileClassVarDec();
   std::unique_ptr<ast::FunctionDecl> compileSubroutineDec();
   ast::ParamList compileParameterList();
   std::unique_ptr<ast::Block> compileBody();
+  // The tokens of a body, from its opening brace to the matching closing one
+  std::shared_ptr<const TokenList> recordBody();
+  // Parse the bodies recorded for the parse threads
+  void compileRecordedBodies(ast::ClassDecl &cls);
+  void compileStatementList(ast::Block &block);
   ast::NodeList compileVarDec();
   std::unique_ptr<ast::Node> compileLet();
   std::unique_ptr<ast::Node> compileIf();
@@ -92,18 +129,35 @@ private:
 
   template <typename NamedValueType, typename... Ts>
   std::unique_ptr<ast::NamedValue> CreateNamedValue(Ts &&... args);
-  std::unique_ptr<ast::VarDecl> CreateVarDecl(std::string, std::string);
+  std::unique_ptr<ast::VarDecl> CreateVarDecl(std::string, std::string,
+                                              ast::SourceLocation);
+  std::unique_ptr<ast::VarDecl> CreateParam(std::string, std::string,
+                                            ast::SourceLocation);
   bool isNamedValue(const std::string &) const;
 
   const Token &getTok() const { return m_tokenizer.peek(); }
 
+  // Location of the current token, recorded on the nodes built from it
+  ast::SourceLocation getLoc() const {
+    return {m_tokenizer.getTokenLine(), m_tokenizer.getTokenColumn()};
+  }
+
   std::string getTypeFromTok();
+  void enterScope(ast::ClassDecl &cls, ast::FunctionDecl *fcn);
+  void expectEnd();
 
   JackLexer m_tokenizer;
   std::string m_filename;
   sym::Table *m_currentTable = nullptr;
   ast::FunctionDecl *m_currentFcn = nullptr;
   ast::ClassDecl *m_cls = nullptr;
+  bool m_deferBodies = false;
+  unsigned m_parseThreads = 1;
+  // The bodies left for the parse threads, in the order of the file
+  std::vector<std::pair<ast::FunctionDecl *, std::shared_ptr<const TokenList>>>
+      m_recorded;
+  // Nodes created by the parse threads, for the statistics
+  size_t m_numRecordedNodes = 0;
 };
 }  // namespace jcc
 
@@ -0,0 +1,89 @@
+#ifndef ast_ConstantFolder_hpp
+#define ast_ConstantFolder_hpp
+
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "JackAST_fwd.hpp"
+#include "Visitor.hpp"
+
+namespace jcc::ast {
+
+class Node;
+
+// Simplifies the AST in place before code generation:
+//  - operators over constants are folded, with the 32 bit wrap around of the
+//    generated code, e.g. `2 * 3` becomes `6` and `1 < 2` becomes `true`
+//  - algebraic identities are removed, e.g. `x * 1`, `x + 0`, `b & true`,
+//    `--x` and `~~b` become `x` or `b`
+//  - if and while statements with a constant condition are replaced by the
+//    branch that runs, and statements after a return are dropped
+// Operands are only dropped (as in `x * 0`) when they have no side effects
+// The AST is expected to be type checked, the constants created are typed
+class ConstantFolder : public MutableVisitor {
+public:
+  // Returns the number of nodes that were folded or removed
+  static size_t run(Node &root);
+
+  void visit(EmptyNode &) override {}
+  void visit(IntConst &) override;
+  void visit(CharConst &) override {}
+  void visit(Identifier &) override {}
+  void visit(StrConst &) override { m_pure = false; }
+  void visit(IndexExpr &) override;
+  void visit(True &) override;
+  void visit(False &) override;
+  void visit(This &) override {}
+
+  void visit(BinaryOp &) override;
+  void visit(UnaryOp &) override;
+
+  void visit(MethodCall &) override;
+  void visit(FunctionCall &) override;
+
+  void visit(LetStmt &) override;
+  void visit(IfStmt &) override;
+  void visit(WhileStmt &) override;
+  void visit(ReturnStmt &) override;
+
+  void visit(VarDecl &) override {}
+  void visit(StaticDecl &) override;
+  void visit(MethodDecl &) override;
+  void visit(ConstructorDecl &) override;
+  void visit(ClassDecl &) override;
+  void visit(Block &) override;
+
+  void visit(RValueT &) override;
+
+private:
+  struct Value {
+    enum class Kind { Int, Bool } kind;
+    int value;
+  };
+
+  // Visit a child and replace it with the simplified node, if any
+  void fold(std::unique_ptr<Node> &node);
+  void replaceWith(std::unique_ptr<Node> node) { m_result = std::move(node); }
+  void replaceWith(Value value);
+
+  // State of the node that was just folded: the replacement computed by its
+  // visit, its value if it is a constant, whether it can be removed without
+  // changing the program, and the unary operator it is, if any
+  std::unique_ptr<Node> m_result;
+  std::optional<Value> m_value;
+  bool m_pure = true;
+  UnaryOp *m_unary = nullptr;
+
+  // Statements that replace the if or while statement that was just folded,
+  // and whether the statement that was just folded returns
+  std::optional<std::vector<std::unique_ptr<Node>>> m_pruned;
+  bool m_returned = false;
+
+  size_t m_numFolded = 0;
+  size_t m_numRemoved = 0;
+};
+
+}  // namespace jcc::ast
+
+#endif /* ast_ConstantFolder_hpp */
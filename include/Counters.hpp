@@ -0,0 +1,88 @@
+#ifndef jcc_Counters_hpp
+#define jcc_Counters_hpp
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ErrorHandling.hpp"
+
+namespace jcc::instr {
+
+// Execution counters inserted by `jcc --instrument`. The generated code
+// increments the counters in place, so a counter never moves once it has been
+// added to the table. Counters are named after their function, and those of
+// statements after the line and column of the statement as well:
+//   Class.fn              function entries
+//   Class.fn:12:5         iterations of the loop at 12:5
+//   Class.fn:12:5:entry   executions of the if or while at 12:5
+//   Class.fn:12:5:then    executions of the then branch of the if at 12:5
+struct Counter {
+  enum class Kind { Function, Loop, Branch };
+
+  std::string name;
+  Kind kind;
+  unsigned line;
+  uint64_t count = 0;
+};
+
+class CounterTable {
+public:
+  // Add a counter that the generated code will increment, see Counter for
+  // the names. A name that is in the table already returns its counter, so
+  // that a function generated again keeps counting in the same place
+  Counter &add(std::string name, Counter::Kind kind, unsigned line);
+
+  size_t size() const { return m_counters.size(); }
+  const Counter *find(const std::string &name) const;
+
+  // Counters ordered from the hottest, ties are kept in declaration order
+  std::vector<const Counter *> sorted() const;
+
+  // Print the counters that were hit, hottest first
+  void print(std::ostream &os) const;
+
+  // Write every counter as a profile, see Profile
+  void write(std::ostream &os) const;
+  bool write(const std::string &path) const;
+
+  void clear() {
+    m_counters.clear();
+    m_index.clear();
+  }
+
+private:
+  std::deque<Counter> m_counters;
+  std::unordered_map<std::string, Counter *> m_index;
+};
+
+// Counts of a previous instrumented run, read back with `jcc --profile-use` to
+// guide code generation. The file has a header line followed by one
+// `<kind> <count> <name>` line per counter. A name appears once, the counts of
+// distinct statements are never merged
+class Profile {
+public:
+  static Result<Profile> read(std::istream &is);
+  static Result<Profile> read(const std::string &path);
+
+  std::optional<uint64_t> count(const std::string &name) const;
+
+  // Entry count of the most called function
+  uint64_t maxFunctionCount() const { return m_maxFunctionCount; }
+
+  size_t size() const { return m_counts.size(); }
+
+private:
+  std::unordered_map<std::string, uint64_t> m_counts;
+  uint64_t m_maxFunctionCount = 0;
+};
+
+}  // namespace jcc::instr
+
+#endif  // jcc_Counters_hpp
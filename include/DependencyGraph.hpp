@@ -0,0 +1,63 @@
+#ifndef ast_DependencyGraph_hpp
+#define ast_DependencyGraph_hpp
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "JackAST_fwd.hpp"
+
+namespace jcc::ast {
+
+// The classes of a program with what each was compiled from, for incremental
+// builds. A class depends on the classes it names: the types of its variables
+// and functions, the classes of the functions it calls and of the objects it
+// calls methods on.
+//
+// The interface of a class is what the classes depending on it see: its fields
+// and the signatures of its subroutines. A class is rebuilt when its source
+// changed, or when the interface of one of its dependencies did. The graph is
+// persisted next to the output it describes
+class DependencyGraph {
+public:
+  struct ClassInfo {
+    std::string file;
+    uint64_t sourceHash = 0;
+    uint64_t interfaceHash = 0;
+    std::set<std::string> dependencies;
+  };
+
+  // Record a class compiled from a source of the given hash
+  void add(const ClassDecl &cls, uint64_t sourceHash);
+  void remove(const std::string &cls) { m_classes.erase(cls); }
+  // Remove the classes whose file cannot be read anymore, returns their names
+  std::vector<std::string> removeMissingFiles();
+
+  const ClassInfo *find(const std::string &cls) const;
+  // The class last compiled from the file, null if there is none
+  const std::string *findFile(const std::string &file) const;
+  size_t size() const { return m_classes.size(); }
+
+  // The classes of this graph that are not rebuilt but depend on a class
+  // whose interface differs from the previous graph
+  std::vector<std::string> invalidated(const DependencyGraph &previous) const;
+
+  static std::set<std::string> dependencies(const ClassDecl &cls);
+  static uint64_t interfaceHash(const ClassDecl &cls);
+
+  // Returns false when the file could not be read or written. A graph of
+  // another version reads as empty, everything is rebuilt
+  bool read(const std::string &path);
+  bool write(const std::string &path) const;
+
+private:
+  std::map<std::string, ClassInfo> m_classes;
+  // The classes added since the graph was read
+  std::set<std::string> m_rebuilt;
+};
+
+}  // namespace jcc::ast
+
+#endif /* ast_DependencyGraph_hpp */
@@ -29,6 +29,12 @@ private:
   const std::string m_msg;
 };
 
+// Semantic error found after parsing, reported like a syntax error
+class TypeError : public SyntaxError {
+public:
+  using SyntaxError::SyntaxError;
+};
+
 struct Error {
   explicit Error(std::string msg) : m_msg{std::move(msg)} {}
   const char *message() const { return m_msg.c_str(); }
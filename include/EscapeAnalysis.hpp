@@ -0,0 +1,100 @@
+#ifndef ast_EscapeAnalysis_hpp
+#define ast_EscapeAnalysis_hpp
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "JackAST_fwd.hpp"
+#include "Visitor.hpp"
+
+namespace jcc::ast {
+
+class Node;
+
+// Finds the string literals that never escape the call they are passed to.
+// Each evaluation of a literal creates a new String, which code generation
+// can instead create once and reuse when no function keeps nor modifies it,
+// e.g. the literals printed by Output.printString.
+//
+// A parameter is borrowed when the function only passes it on to borrowed
+// parameters, `this` included for methods. Anything else, returning it,
+// assigning it, or calling a method that is not borrowing on it, makes it
+// escape. The parameters of the functions that call each other are resolved
+// together, the ones that are not declared escape.
+//
+// The AST must have been resolved and type checked
+class EscapeAnalysis : public MutableVisitor {
+public:
+  // Declare that a function without a Jack declaration, like the builtins,
+  // only reads its param-th parameter
+  void borrow(const std::string &cls, const std::string &fcn, size_t param);
+
+  // Make the functions of a class known to the code analyzed after. All the
+  // classes of a program are declared before any is analyzed
+  void declare(ClassDecl &cls);
+  // Declare the node if it is a class
+  void declare(Node &root);
+
+  // Mark the string literals of a class or function that are only passed to
+  // borrowed parameters, returns their number
+  size_t run(Node &root);
+
+  void visit(EmptyNode &) override {}
+  void visit(IntConst &) override {}
+  void visit(CharConst &) override {}
+  void visit(Identifier &) override;
+  void visit(StrConst &) override;
+  void visit(IndexExpr &) override;
+  void visit(True &) override {}
+  void visit(False &) override {}
+  void visit(This &) override {}
+
+  void visit(BinaryOp &) override;
+  void visit(UnaryOp &) override;
+
+  void visit(MethodCall &) override;
+  void visit(FunctionCall &) override;
+
+  void visit(LetStmt &) override;
+  void visit(IfStmt &) override;
+  void visit(WhileStmt &) override;
+  void visit(ReturnStmt &) override;
+
+  void visit(VarDecl &) override {}
+  void visit(StaticDecl &) override;
+  void visit(MethodDecl &) override;
+  void visit(ConstructorDecl &) override;
+  void visit(ClassDecl &) override;
+  void visit(Block &) override;
+
+  void visit(RValueT &) override;
+
+private:
+  // Whether each parameter is borrowed, by "Class.function"
+  std::unordered_map<std::string, std::vector<bool>> m_borrowed;
+  // The functions declared since the parameters were last resolved
+  std::vector<FunctionDecl *> m_functions;
+  bool m_resolved = true;
+  bool m_declaring = false;
+
+  const ClassDecl *m_class = nullptr;
+  // State of the walk: the parameters of the function that escape, whether
+  // the node visited is passed to a borrowed parameter, and the literals
+  // found in such a position
+  std::vector<bool> *m_params = nullptr;
+  bool m_borrowing = false;
+  size_t m_numBorrowed = 0;
+
+  // Compute the borrowed parameters of the declared functions
+  void resolve();
+  bool isBorrowed(const std::string &cls, const std::string &fcn,
+                  size_t param) const;
+  void visitArgument(Node &arg, bool borrowed);
+  void visitCall(Call &call, const std::string &cls, size_t first);
+  void visitFunction(FunctionDecl &decl);
+};
+
+}  // namespace jcc::ast
+
+#endif /* ast_EscapeAnalysis_hpp */
@@ -0,0 +1,37 @@
+#ifndef io_FileWatcher_hpp
+#define io_FileWatcher_hpp
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace jcc::io {
+
+// Reports the files written in a set of directories, with inotify. A file
+// counts as written once it is closed or moved into the directory, editors
+// that save through a temporary file are seen once. On the systems without
+// inotify nothing is ever reported
+class FileWatcher {
+public:
+  FileWatcher();
+  ~FileWatcher();
+
+  FileWatcher(const FileWatcher &) = delete;
+  FileWatcher &operator=(const FileWatcher &) = delete;
+
+  // Returns false when the directory cannot be watched
+  bool add(const std::string &dir);
+
+  // Wait up to timeoutMs for writes and return the paths written since the
+  // last call, each once
+  std::vector<std::string> wait(int timeoutMs);
+
+private:
+  int m_fd = -1;
+  // Watched directories by watch descriptor
+  std::unordered_map<int, std::string> m_dirs;
+};
+
+}  // namespace jcc::io
+
+#endif /* io_FileWatcher_hpp */
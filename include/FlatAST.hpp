@@ -0,0 +1,175 @@
+#ifndef ast_FlatAST_hpp
+#define ast_FlatAST_hpp
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "JackAST.hpp"
+
+namespace jcc::ast {
+
+// A tree of nodes encoded as a struct of arrays: one array per attribute,
+// indexed by the number of the node in preorder, instead of a node object per
+// allocation. The children of a node are a contiguous range of the children
+// array, and the names, types and ExprTypes are interned, so a pass over the
+// tree reads a few dense arrays front to back.
+//
+// The encoding keeps what the passes annotated: the ExprType of every node,
+// the Slot of the variables and whether a string literal is borrowed. It is a
+// snapshot, the tree it was built from can change after. Nodes are visited
+// with a FlatVisitor, which is how the PrettyPrinter and the LLVMGenerator
+// walk the tree
+class FlatAST {
+public:
+  using Index = uint32_t;
+
+  enum class Kind : uint8_t {
+    Empty,
+    Int,
+    Char,
+    Str,
+    Identifier,
+    Index,
+    This,
+    True,
+    False,
+    Binary,
+    Unary,
+    MethodCall,
+    FunctionCall,
+    Let,
+    If,
+    While,
+    Return,
+    Var,
+    Block,
+    Static,
+    Method,
+    Constructor,
+    Class,
+    RValue,
+  };
+
+  // The root is the node 0
+  static FlatAST build(const Node &root);
+
+  size_t size() const { return m_kinds.size(); }
+  // Bytes held by the arrays, for comparison with the tree
+  size_t memoryUsage() const;
+
+  Kind kind(Index node) const { return m_kinds[node]; }
+  SourceLocation location(Index node) const {
+    return SourceLocation::unpack(m_locations[node]);
+  }
+  const ExprType &exprType(Index node) const {
+    return m_exprTypes[m_exprTypeIds[node]];
+  }
+
+  // The constant of an Int or Char, the operator of a Binary or Unary, the
+  // sym::Kind of a Var of a class
+  int32_t value(Index node) const { return m_values[node]; }
+  char op(Index node) const { return static_cast<char>(m_values[node]); }
+  // The name of a variable, call or declaration, the content of a Str
+  const std::string &name(Index node) const { return m_strings[m_names[node]]; }
+  // The type of a Var, the return type of a function, the class of a
+  // FunctionCall and the file of a Class
+  const std::string &type(Index node) const { return m_strings[m_types[node]]; }
+  Slot slot(Index node) const { return m_slots[node]; }
+  bool isBorrowed(Index node) const { return m_flags[node] & kBorrowed; }
+
+  // The children are those of the tree in the order of its getters. A child
+  // that can be absent is last, when it is present: the callee of a
+  // MethodCall (first instead), the else of an If, the body of a function
+  // and the object of a variable
+  bool hasOptional(Index node) const { return m_flags[node] & kOptional; }
+  size_t numChildren(Index node) const { return m_numChildren[node]; }
+  Index child(Index node, size_t i) const {
+    return m_children[m_firstChild[node] + i];
+  }
+  const Index *children_begin(Index node) const {
+    return m_children.data() + m_firstChild[node];
+  }
+  const Index *children_end(Index node) const {
+    return children_begin(node) + m_numChildren[node];
+  }
+
+private:
+  friend class FlatBuilder;
+
+  static constexpr uint8_t kOptional = 1;
+  static constexpr uint8_t kBorrowed = 2;
+
+  std::vector<Kind> m_kinds;
+  std::vector<uint8_t> m_flags;
+  std::vector<uint32_t> m_locations;
+  std::vector<int32_t> m_values;
+  std::vector<uint32_t> m_names;
+  std::vector<uint32_t> m_types;
+  std::vector<uint32_t> m_exprTypeIds;
+  std::vector<Slot> m_slots;
+  std::vector<Index> m_firstChild;
+  std::vector<uint32_t> m_numChildren;
+  std::vector<Index> m_children;
+
+  // Interned, the empty string and the unknown type first
+  std::vector<std::string> m_strings;
+  std::vector<ExprType> m_exprTypes;
+};
+
+// Visits the nodes of a FlatAST, dispatched on their kind with a switch
+// rather than a virtual call per node. The derived class implements a
+// visit<Kind>(Index) for every kind, and calls visit() on the children it
+// wants to visit. A visitor that outlives the encoding it walks sets m_ast
+// for each traversal
+template <typename Derived>
+class FlatVisitor {
+public:
+  FlatVisitor() = default;
+  explicit FlatVisitor(const FlatAST &ast) : m_ast{&ast} {}
+
+  void visit(FlatAST::Index node) {
+    auto &self = static_cast<Derived &>(*this);
+    switch (m_ast->kind(node)) {
+      case FlatAST::Kind::Empty: return self.visitEmpty(node);
+      case FlatAST::Kind::Int: return self.visitInt(node);
+      case FlatAST::Kind::Char: return self.visitChar(node);
+      case FlatAST::Kind::Str: return self.visitStr(node);
+      case FlatAST::Kind::Identifier: return self.visitIdentifier(node);
+      case FlatAST::Kind::Index: return self.visitIndex(node);
+      case FlatAST::Kind::This: return self.visitThis(node);
+      case FlatAST::Kind::True: return self.visitTrue(node);
+      case FlatAST::Kind::False: return self.visitFalse(node);
+      case FlatAST::Kind::Binary: return self.visitBinary(node);
+      case FlatAST::Kind::Unary: return self.visitUnary(node);
+      case FlatAST::Kind::MethodCall: return self.visitMethodCall(node);
+      case FlatAST::Kind::FunctionCall: return self.visitFunctionCall(node);
+      case FlatAST::Kind::Let: return self.visitLet(node);
+      case FlatAST::Kind::If: return self.visitIf(node);
+      case FlatAST::Kind::While: return self.visitWhile(node);
+      case FlatAST::Kind::Return: return self.visitReturn(node);
+      case FlatAST::Kind::Var: return self.visitVar(node);
+      case FlatAST::Kind::Block: return self.visitBlock(node);
+      case FlatAST::Kind::Static: return self.visitStatic(node);
+      case FlatAST::Kind::Method: return self.visitMethod(node);
+      case FlatAST::Kind::Constructor: return self.visitConstructor(node);
+      case FlatAST::Kind::Class: return self.visitClass(node);
+      case FlatAST::Kind::RValue: return self.visitRValue(node);
+    }
+  }
+
+  // Visit the children [first, numChildren)
+  void visitChildren(FlatAST::Index node, size_t first = 0) {
+    for (size_t i = first; i < m_ast->numChildren(node); ++i) {
+      visit(m_ast->child(node, i));
+    }
+  }
+
+protected:
+  const FlatAST *m_ast = nullptr;
+};
+
+}  // namespace jcc::ast
+
+#endif /* ast_FlatAST_hpp */
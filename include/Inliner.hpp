@@ -0,0 +1,121 @@
+#ifndef ast_Inliner_hpp
+#define ast_Inliner_hpp
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "JackAST_fwd.hpp"
+#include "Visitor.hpp"
+
+namespace jcc::ast {
+
+class Node;
+
+// Replaces calls to small functions of any class by the expression they
+// return, before code generation, so that the getters Jack classes are full
+// of cost nothing even when the JIT does not run the LLVM inliner. A function
+// or method can be inlined when its body is a single `return <expression>;`
+// and the expression:
+//  - has at most maxSize nodes
+//  - only reads the parameters, the fields of the object and, from its own
+//    class, the statics
+//  - does not call methods, nor the function itself
+// The arguments of an inlined call must be constants or variables other than
+// statics, so that substituting them for the parameters evaluates the same
+// values in the same order. Statements with side effects, like setters, are
+// never inlined.
+//
+// The AST must have been resolved and type checked, the nodes created are
+// annotated like the ones they are copied from
+class Inliner : public MutableVisitor {
+public:
+  // Entry count of a function by "Class.function", if it was profiled
+  using CallCounts =
+      std::function<std::optional<uint64_t>(const std::string &)>;
+
+  explicit Inliner(size_t maxSize = 8) : m_maxSize{maxSize} {}
+
+  // With the counts of an instrumented run, the functions that never ran are
+  // not inlined and those entered at least a hundredth as often as the
+  // hottest one may be four times larger
+  void setCallCounts(CallCounts counts, uint64_t maxCount);
+
+  // Make the functions of a class available to the calls inlined after. All
+  // the classes of a program are declared before any is inlined into
+  void declare(ClassDecl &cls);
+  // Declare the node if it is a class
+  void declare(Node &root);
+
+  // Inline the calls of a class or function, returns the number inlined
+  size_t run(Node &root);
+
+  void visit(EmptyNode &) override {}
+  void visit(IntConst &) override {}
+  void visit(CharConst &) override {}
+  void visit(Identifier &) override {}
+  void visit(StrConst &) override {}
+  void visit(IndexExpr &) override;
+  void visit(True &) override {}
+  void visit(False &) override {}
+  void visit(This &) override {}
+
+  void visit(BinaryOp &) override;
+  void visit(UnaryOp &) override;
+
+  void visit(MethodCall &) override;
+  void visit(FunctionCall &) override;
+
+  void visit(LetStmt &) override;
+  void visit(IfStmt &) override;
+  void visit(WhileStmt &) override;
+  void visit(ReturnStmt &) override;
+
+  void visit(VarDecl &) override {}
+  void visit(StaticDecl &) override;
+  void visit(MethodDecl &) override;
+  void visit(ConstructorDecl &) override;
+  void visit(ClassDecl &) override;
+  void visit(Block &) override;
+
+  void visit(RValueT &) override;
+
+private:
+  struct Candidate {
+    const ClassDecl *cls;
+    FunctionDecl *fcn;
+    // The statement is kept rather than its expression, which may itself be
+    // replaced by inlining
+    const ReturnStmt *ret;
+    bool method;
+  };
+
+  // Functions that may be inlined by "Class.function"
+  std::unordered_map<std::string, Candidate> m_candidates;
+
+  size_t m_maxSize;
+  CallCounts m_counts;
+  uint64_t m_maxCount = 0;
+
+  // Scope of the calls being inlined
+  const ClassDecl *m_class = nullptr;
+  FunctionDecl *m_function = nullptr;
+  bool m_method = false;
+
+  // The expression that replaces the call that was just visited, if any
+  std::unique_ptr<Node> m_result;
+  size_t m_numInlined = 0;
+
+  // Visit a child and replace it by the inlined expression, if any
+  void inlineChild(std::unique_ptr<Node> &node);
+  void inlineCall(Call &call, const std::string &cls,
+                  const NamedValue *object, bool method);
+  void visitFunction(FunctionDecl &decl, bool method);
+};
+
+}  // namespace jcc::ast
+
+#endif /* ast_Inliner_hpp */
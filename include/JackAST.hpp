@@ -1,7 +1,10 @@
 #ifndef JACK_AST_HPP
 #define JACK_AST_HPP
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <numeric>
 #include <string>
@@ -71,11 +74,89 @@ struct VarDecList {
   ParamList statics;
 };
 
+// Position of the first token of a node in its source file. Lines and columns
+// start at 1, a line of 0 means the node was not parsed from source
+struct SourceLocation {
+  unsigned line = 0;
+  unsigned column = 0;
+
+  bool isValid() const { return line != 0; }
+
+  // Nodes keep their location packed in 32 bits, 20 for the line and 12 for
+  // the column. Larger lines and columns are clamped to the largest that fit
+  static constexpr unsigned kColumnBits = 12;
+  static constexpr unsigned kMaxLine = (1u << (32 - kColumnBits)) - 1;
+  static constexpr unsigned kMaxColumn = (1u << kColumnBits) - 1;
+
+  uint32_t pack() const {
+    return std::min(line, kMaxLine) << kColumnBits |
+           std::min(column, kMaxColumn);
+  }
+  static SourceLocation unpack(uint32_t packed) {
+    return {packed >> kColumnBits, packed & kMaxColumn};
+  }
+};
+
+// Type of the value of an expression, resolved by the TypeChecker before code
+// generation. Class types, Array and String included, carry the class name
+struct ExprType {
+  enum class Kind { Unknown = 0, Void, Int, Char, Boolean, Class };
+
+  Kind kind = Kind::Unknown;
+  std::string name;
+
+  ExprType() = default;
+  ExprType(Kind k, std::string n = {}) : kind{k}, name{std::move(n)} {}
+
+  // The type of a declaration: int, char, boolean, void or a class name
+  static ExprType fromName(const std::string& name);
+
+  bool isKnown() const { return kind != Kind::Unknown; }
+  // char and int convert implicitly to each other
+  bool isInteger() const { return kind == Kind::Int || kind == Kind::Char; }
+  std::string toString() const;
+
+  friend bool operator==(const ExprType& lhs, const ExprType& rhs) {
+    return lhs.kind == rhs.kind && lhs.name == rhs.name;
+  }
+  friend bool operator!=(const ExprType& lhs, const ExprType& rhs) {
+    return !(lhs == rhs);
+  }
+};
+
+// Where a variable is stored: its index among the statics or fields of its
+// class, or among the parameters or local variables of its function. Assigned
+// by the Resolver, so that code generation indexes instead of looking up names
+struct Slot {
+  sym::Kind kind = sym::Kind::NONE;
+  unsigned index = 0;
+
+  bool isResolved() const { return kind != sym::Kind::NONE; }
+};
+
 class Node {
 public:
+  Node() { ++s_numCreated; }
   virtual ~Node() = default;
   virtual void accept(MutableVisitor&) = 0;
   virtual void accept(ImmutableVisitor&) const = 0;
+
+  SourceLocation getLocation() const { return SourceLocation::unpack(m_loc); }
+  void setLocation(SourceLocation loc) { m_loc = loc.pack(); }
+
+  // Unknown until the TypeChecker has run, void for statements
+  const ExprType& getExprType() const { return m_type; }
+  void setExprType(ExprType type) { m_type = std::move(type); }
+
+  // Number of nodes created on the calling thread, used for statistics
+  static size_t numCreated() { return s_numCreated; }
+
+private:
+  ExprType m_type;
+  // Last, the members of the derived nodes that fit in the padding after it
+  // are laid out there
+  uint32_t m_loc = 0;
+  inline static thread_local size_t s_numCreated = 0;
 };
 
 // Terminals
@@ -113,9 +194,24 @@ public:
   const FunctionDecl* getParent() const { return m_parent; }
   const std::string& getType() const;
 
+  // The declaration the name refers to, null until the Resolver has run
+  const VarDecl* getDecl() const { return m_decl; }
+  void setDecl(const VarDecl* decl) { m_decl = decl; }
+  Slot getSlot() const;
+
+  // The object of a field that is not a field of `this`. Jack cannot express
+  // it, only the Inliner creates them when it inlines a method of an object
+  NamedValue* getObject() { return m_object.get(); }
+  const NamedValue* getObject() const { return m_object.get(); }
+  void setObject(std::unique_ptr<NamedValue> object) {
+    m_object = std::move(object);
+  }
+
 private:
   std::string m_name;
   FunctionDecl* m_parent;
+  const VarDecl* m_decl = nullptr;
+  std::unique_ptr<NamedValue> m_object;
 };
 
 class Identifier : public NamedValue {
@@ -133,6 +229,7 @@ public:
 
   Node* getIndex() { return m_idxExpr.get(); }
   const Node* getIndex() const { return m_idxExpr.get(); }
+  std::unique_ptr<Node>& getIndexRef() { return m_idxExpr; }
 
 private:
   std::unique_ptr<Node> m_idxExpr;
@@ -160,8 +257,14 @@ public:
   StrConst(std::string str) : m_str{std::move(str)} {}
   const std::string& getString() const { return m_str; }
 
+  // The String is only read by the function it is passed to, so a single
+  // String can be reused for every evaluation. Set by the EscapeAnalysis
+  bool isBorrowed() const { return m_borrowed; }
+  void setBorrowed(bool borrowed) { m_borrowed = borrowed; }
+
 private:
   std::string m_str;
+  bool m_borrowed = false;
 };
 
 class VarDecl : public Node {
@@ -174,9 +277,13 @@ public:
   const std::string& getType() const { return m_type; }
   void setType(const std::string& type) { m_type = type; }
 
+  Slot getSlot() const { return m_slot; }
+  void setSlot(Slot slot) { m_slot = slot; }
+
 private:
   std::string m_name;
   std::string m_type;
+  Slot m_slot;
 };
 
 class Block : public Node {
@@ -190,6 +297,14 @@ public:
   NodeList::iterator stmts_end() { return m_exprs.end(); }
   NodeList::const_iterator stmts_begin() const { return m_exprs.begin(); }
   NodeList::const_iterator stmts_end() const { return m_exprs.end(); }
+  size_t numStmts() const { return m_exprs.size(); }
+
+  // Move the statements out of the block, leaving it empty
+  NodeList takeStmts() {
+    NodeList stmts;
+    stmts.swap(m_exprs);
+    return stmts;
+  }
 
 private:
   NodeList m_exprs;
@@ -210,11 +325,17 @@ public:
   void addStatic(std::unique_ptr<VarDecl> var);
   void addFunction(std::unique_ptr<FunctionDecl> fun);
   void addMethod(std::unique_ptr<FunctionDecl> mth);
+  // Remove the functions and methods the predicate holds for
+  void removeFunctions(const std::function<bool(const FunctionDecl&)>& pred);
 
   unsigned getFieldIdx(const std::string& name) const;
 
   const std::string& getName() const { return m_name; }
   std::string getStaticName(const std::string& varName) const;
+
+  // Path of the source file the class was parsed from, if any
+  const std::string& getFile() const { return m_file; }
+  void setFile(std::string file) { m_file = std::move(file); }
   const sym::Table& getTable() const { return m_table; }
   sym::Table& getTable() { return m_table; }
 
@@ -247,6 +368,7 @@ public:
 
 private:
   std::string m_name;
+  std::string m_file;
   ParamList m_fields;
   ParamList m_statics;
   FunctionList m_functions;
@@ -276,6 +398,15 @@ public:
   const Block* getDefinition() const { return m_body.get(); }
   void addDefinition(std::unique_ptr<Block> body) { m_body = std::move(body); }
 
+  // The parser can defer the body of a function until it is needed, see
+  // CompilationEngine::setDeferBodies. A deferred function has no definition
+  // until parseDefinition() is called, which throws the syntax errors of the
+  // body
+  using BodyParser = std::function<std::unique_ptr<Block>(FunctionDecl&)>;
+  void deferDefinition(BodyParser parser) { m_parser = std::move(parser); }
+  bool isDeferred() const { return static_cast<bool>(m_parser); }
+  void parseDefinition();
+
   size_t numParams() const { return m_params.size(); }
   ParamList::iterator prms_begin() { return m_params.begin(); }
   ParamList::iterator prms_end() { return m_params.end(); }
@@ -287,7 +418,8 @@ protected:
   std::string m_return;
   ParamList m_params;
   std::unique_ptr<Block> m_body;
-  const ClassDecl* m_parent;
+  BodyParser m_parser;
+  const ClassDecl* m_parent = nullptr;
   sym::Table m_table;
 };
 
@@ -342,6 +474,8 @@ public:
   Node* getLHS() { return m_lhs.get(); }
   const Node* getRHS() const { return m_rhs.get(); }
   Node* getRHS() { return m_rhs.get(); }
+  std::unique_ptr<Node>& getLHSRef() { return m_lhs; }
+  std::unique_ptr<Node>& getRHSRef() { return m_rhs; }
 
 private:
   std::unique_ptr<Node> m_lhs;
@@ -373,6 +507,7 @@ public:
 
   const Node* getOperand() const { return m_operand.get(); }
   Node* getOperand() { return m_operand.get(); }
+  std::unique_ptr<Node>& getOperandRef() { return m_operand; }
   char getOp() const { return m_op; }
 
 private:
@@ -431,6 +566,7 @@ public:
   const NamedValue* getAssignee() const { return m_assignee.get(); }
   Node* getExpression() { return m_expr.get(); }
   const Node* getExpression() const { return m_expr.get(); }
+  std::unique_ptr<Node>& getExpressionRef() { return m_expr; }
 
 private:
   std::unique_ptr<NamedValue> m_assignee;
@@ -452,6 +588,7 @@ public:
   const Block* getIfBlock() const { return m_ifBranch.get(); }
   Block* getElseBlock() { return m_elseBranch.get(); }
   const Block* getElseBlock() const { return m_elseBranch.get(); }
+  std::unique_ptr<Node>& getCondRef() { return m_condition; }
 
 private:
   std::unique_ptr<Node> m_condition;
@@ -469,6 +606,7 @@ public:
   const Node* getCond() const { return m_condition.get(); }
   Block* getBlock() { return m_body.get(); }
   const Block* getBlock() const { return m_body.get(); }
+  std::unique_ptr<Node>& getCondRef() { return m_condition; }
 
 private:
   std::unique_ptr<Node> m_condition;
@@ -485,6 +623,7 @@ public:
 
   Node* getExpr() { return m_expr.get(); }
   const Node* getExpr() const { return m_expr.get(); }
+  std::unique_ptr<Node>& getExprRef() { return m_expr; }
 
 private:
   std::unique_ptr<Node> m_expr;
@@ -2,6 +2,8 @@
 #define _exec_JIT_hpp_
 
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 #include "llvm/ExecutionEngine/JITSymbol.h"
@@ -12,6 +14,7 @@
 #include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
 #include "llvm/ExecutionEngine/Orc/LambdaResolver.h"
 #include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
 
 namespace jcc {
 class Runtime;
@@ -21,14 +24,40 @@ namespace exec {
 using namespace llvm;
 using namespace orc;
 
+struct JITOptions {
+  // Register the compiled functions with perf, see PerfListener
+  bool Perf = false;
+  // Keep the frame pointer in every function so that stacks can be walked
+  // without unwind tables, see Profiler
+  bool FramePointers = false;
+  // Register the compiled objects with GDB so that it sees their debug info
+  bool GDB = false;
+  // Additional listeners notified of every object the JIT loads. They are not
+  // owned by the JIT and must outlive it
+  std::vector<JITEventListener *> Listeners;
+};
+
 class JIT {
 public:
+  // Throws std::runtime_error if the symbol is not defined, so that a server
+  // can fail the program and keep running
   llvm::JITSymbol findSymbol(StringRef symbol);
+  llvm::JITSymbol findSymbol(JITDylib &JD, StringRef symbol);
   // void removeModule(VModuleKey K) { cantFail(CODLayer.removeModule(K)); }
 
   void addModule(std::unique_ptr<Module> M);
 
-  static std::unique_ptr<JIT> Create();
+  // Add a module to the given dylib. The context is shared with the module so
+  // that it outlives the caller when the JIT is kept warm in a pool
+  void addModule(JITDylib &JD, std::unique_ptr<Module> M,
+                 ThreadSafeContext TSCtx);
+
+  // Create a fresh dylib so that the symbols of one job never collide with
+  // those of a previous job run on the same JIT
+  JITDylib &createJobDylib();
+  unsigned numJobs() const { return NumJobs; }
+
+  static std::unique_ptr<JIT> Create(const JITOptions &Options = {});
   int run(llvm::JITSymbol &symbol);
 
   void dumpEngine() const;
@@ -37,7 +66,7 @@ public:
 private:
   friend class jcc::Runtime;
 
-  JIT(JITTargetMachineBuilder JTMB, DataLayout DL);
+  JIT(JITTargetMachineBuilder JTMB, DataLayout DL, const JITOptions &Options);
 
   ExecutionSession ES;
   RTDyldObjectLinkingLayer ObjectLayer;
@@ -51,6 +80,32 @@ private:
   MangleAndInterner Mangle;
   ThreadSafeContext Ctx;
   JITDylib &MainJD;
+  unsigned NumJobs = 0;
+};
+
+// Compile a module ahead of time with optimizations to an object file for the
+// host. The builtins are bound to the addresses of the running compiler, so
+// the object is meant to be inspected (objdump, debug info) rather than linked
+// into a program
+bool emitObjectFile(Module &M, StringRef Path);
+
+// Pool of JIT instances that are created up front and reused across programs
+// so that each program does not pay for the JIT construction. Every program
+// run on a pooled JIT gets its own JITDylib, and a JIT is recycled after it
+// has run MaxJobs programs to bound the memory held by old dylibs
+class JITPool {
+public:
+  explicit JITPool(size_t size, unsigned maxJobs = 64,
+                   JITOptions options = {});
+
+  std::unique_ptr<JIT> acquire();
+  void release(std::unique_ptr<JIT> jit);
+
+private:
+  std::mutex Mutex;
+  std::vector<std::unique_ptr<JIT>> Free;
+  unsigned MaxJobs;
+  JITOptions Options;
 };
 
 // TODO(matt): create mock class
@@ -10,6 +10,9 @@
 #include <memory>
 #include <unordered_map>
 #include <variant>
+#include <vector>
+
+#include "Statistics.hpp"
 
 // undef symbols defined in boolean.h on mac
 #if __APPLE__
@@ -208,6 +211,17 @@ inline bool operator!=(const Token &lhs, const Token &rhs) {
   return !(lhs == rhs);
 }
 
+// A token, the position it starts at and the position of the lexer after it,
+// where errors are reported. See JackLexer(TokenList)
+struct LexedToken {
+  Token tok;
+  unsigned line;
+  unsigned column;
+  unsigned endLine;
+  unsigned endColumn;
+};
+using TokenList = std::vector<LexedToken>;
+
 class JackLexer {
 public:
   constexpr static size_t buffer_size = 512;
@@ -216,19 +230,34 @@ public:
       : m_istream{std::move(input)},
         m_colNum{1},
         m_lineNum{1},
-        m_tok{parse()} {}
+        m_timed{stats::Statistics::get().enabled()},
+        m_tok{timedParse()} {}
+  // Read tokens recorded from another lexer again, at their position in the
+  // source they were read from
+  explicit JackLexer(std::shared_ptr<const TokenList> tokens)
+      : m_colNum{1},
+        m_lineNum{1},
+        m_timed{false},
+        m_replay{std::move(tokens)} {
+    advance();
+  }
 
   void operator()(InputStream input) {
     m_istream = std::move(input);
     advance();
   }
 
-  bool hasMoreTokens() const { return !m_istream->eof() || !m_tok.isNull(); }
+  bool hasMoreTokens() const {
+    if (m_replay) return m_next < m_replay->size() || !m_tok.isNull();
+    return !m_istream->eof() || !m_tok.isNull();
+  }
 
   // Advance the current token
   void advance() {
-    if (hasMoreTokens()) {
-      m_tok = parse();
+    if (m_replay) {
+      replay();
+    } else if (hasMoreTokens()) {
+      m_tok = timedParse();
     } else {
       m_tok = Token();
     }
@@ -275,13 +304,55 @@ public:
   // Return the current column number of the source file
   unsigned getColNumber() const { return m_colNum; }
 
+  // Return the line and column where the current token starts
+  unsigned getTokenLine() const { return m_tokLine; }
+  unsigned getTokenColumn() const { return m_tokCol; }
+
+  // Return the number of tokens read so far
+  size_t getNumTokens() const { return m_numTokens; }
+
+  // Return the wall time in seconds spent reading tokens. Only measured when
+  // statistics are enabled
+  double getLexTime() const { return m_lexTime; }
+
 private:
   InputStream m_istream;
   unsigned m_colNum;
   unsigned m_lineNum;
+  unsigned m_tokLine = 1;
+  unsigned m_tokCol = 1;
+  bool m_timed;
+  size_t m_numTokens = 0;
+  double m_lexTime = 0;
   Token m_tok;
+  std::shared_ptr<const TokenList> m_replay;
+  size_t m_next = 0;
 
   Token parse();
+
+  void replay() {
+    if (m_next == m_replay->size()) {
+      m_tok = Token();
+      return;
+    }
+    const LexedToken &next = (*m_replay)[m_next++];
+    m_tok = next.tok;
+    m_tokLine = next.line;
+    m_tokCol = next.column;
+    m_lineNum = next.endLine;
+    m_colNum = next.endColumn;
+    ++m_numTokens;
+  }
+
+  // Lexing is interleaved with parsing, so it is timed one token at a time
+  // with the wall clock only
+  Token timedParse() {
+    const auto start = m_timed ? stats::wallTime() : 0;
+    auto tok = parse();
+    if (m_timed) m_lexTime += stats::wallTime() - start;
+    if (!tok.isNull()) ++m_numTokens;
+    return tok;
+  }
 };
 
 namespace operations {
@@ -1,14 +1,19 @@
 #ifndef _jcc_LLVMGenerator_hpp_
 #define _jcc_LLVMGenerator_hpp_
 
+#include "Counters.hpp"
+#include "FlatAST.hpp"
 #include "JackAST.hpp"
-#include "Visitor.hpp"
 
 #define LLVM_DISABLE_ABI_BREAKING_CHECKS_ENFORCING 1
 #include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 
 #include "llvm/ADT/APInt.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/DIBuilder.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
@@ -37,32 +42,69 @@ struct UnresolvedSymbol {
 
 class Node;
 
-class LLVMGenerator : public MutableVisitor {
+// Walks the flat encoding of the tree it generates code for, see FlatAST
+class LLVMGenerator : public FlatVisitor<LLVMGenerator> {
 public:
   llvm::Module *newModule(const std::string &name = "themodule") {
     m_module = std::make_unique<llvm::Module>(name, m_context);
+    m_strings.clear();
     return m_module.get();
   }
 
-  static std::unique_ptr<LLVMGenerator> Create(llvm::LLVMContext &context) {
+  // With debugInfo, the classes are described in DWARF: a compile unit per
+  // source file with the functions, variables and line of each statement
+  static std::unique_ptr<LLVMGenerator> Create(llvm::LLVMContext &context,
+                                               bool debugInfo = false) {
     auto g = std::unique_ptr<LLVMGenerator>(new LLVMGenerator(context));
+    g->m_debugInfo = debugInfo;
     g->newModule();
     return g;
   }
 
+  // The AST must have been resolved by the Resolver and annotated by the
+  // TypeChecker
   llvm::Value *codegen(Node &node);
 
+  // Instrument the code generated from now on with execution counters: one
+  // per function entry and one per loop iteration, added to the table
+  void setCounters(instr::CounterTable *counters) { m_counters = counters; }
+
+  // Use the counts of an instrumented run for the code generated from now on:
+  // branch weights, function entry counts and inlining hints
+  void setProfile(const instr::Profile *profile) { m_profile = profile; }
+
+  // Make the functions of the program redefinable while it runs: the calls
+  // between them load the callee from a global "<function>.slot" instead of
+  // calling it directly. A function generated again is named
+  // "<function>.r<n>" and its slot is left for the caller to patch, see
+  // takeRedefinitions
+  void setPatchable(bool patchable) { m_patchable = patchable; }
+
+  // The functions generated again since the last call, by the name of their
+  // slot's function, and the name of their new definition
+  std::vector<std::pair<std::string, std::string>> takeRedefinitions() {
+    return std::exchange(m_redefinitions, {});
+  }
+
+  // Incremental code generation for the declarations of a class whose other
+  // declarations were generated into a module that has since been moved out
+  llvm::Value *codegen(ClassDecl &cls, FunctionDecl &fcn);
+  llvm::GlobalVariable *codegenStatic(ClassDecl &cls, VarDecl &var);
+
   // Utility to print out the current module
   void dumpModule() const;
 
-  // Move the ownership of the module from the generator
-  std::unique_ptr<llvm::Module> moveModule() { return std::move(m_module); }
+  // Move the ownership of the module from the generator. The functions and
+  // globals it defines can still be referenced from the modules created after
+  std::unique_ptr<llvm::Module> moveModule();
 
   // Return a reference to the LLVM IR Builder
   llvm::IRBuilder<> &builder() { return m_builder; }
 
   // Lookup the llvm::Type given the type name
   llvm::Type *getTypeByName(const std::string &name);
+  // Lookup the llvm::Type of a type resolved by the TypeChecker
+  llvm::Type *getType(const ExprType &type);
 
   // TODO(matt): These should be in a test API
   llvm::Module *module() { return m_module.get(); }
@@ -71,73 +113,156 @@ public:
   llvm::LLVMContext &context() const { return m_builder.getContext(); }
 
   llvm::Function *getLLVMFunction(const std::string &cls,
-                                  const std::string &fname) const;
+                                  const std::string &fname);
 
-  ClassDecl *getAST() { return m_class; }
-
-  std::string mangleFunction(const FunctionDecl &f) const;
+  std::string mangleFunction(const std::string &fname) const;
   std::string mangleStatic(const std::string &varName) const;
 
-  void visit(IntConst &) override;
-  void visit(CharConst &) override;
-  void visit(Identifier &) override;
-  void visit(StrConst &) override;
-  void visit(IndexExpr &) override;
-  void visit(True &) override;
-  void visit(False &) override;
-  void visit(This &) override;
-  void visit(EmptyNode &) override;
-
-  void visit(BinaryOp &) override;
-  void visit(UnaryOp &) override;
-
-  void visit(MethodCall &) override;
-  void visit(FunctionCall &) override;
-
-  void visit(VarDecl &) override;
-  void visit(StaticDecl &) override;
-  void visit(MethodDecl &) override;
-  void visit(ConstructorDecl &) override;
-  void visit(ClassDecl &) override;
-
-  void visit(LetStmt &) override;
-  void visit(IfStmt &) override;
-  void visit(WhileStmt &) override;
-  void visit(ReturnStmt &) override;
-  void visit(Block &) override;
-
-  void visit(RValueT &) override;
-
 private:
+  friend class FlatVisitor<LLVMGenerator>;
+  using Index = FlatAST::Index;
+
+  void visitInt(Index);
+  void visitChar(Index);
+  void visitIdentifier(Index);
+  void visitStr(Index);
+  void visitIndex(Index);
+  void visitTrue(Index);
+  void visitFalse(Index);
+  void visitThis(Index);
+  void visitEmpty(Index);
+
+  void visitBinary(Index);
+  void visitUnary(Index);
+
+  void visitMethodCall(Index);
+  void visitFunctionCall(Index);
+
+  void visitVar(Index);
+  void visitStatic(Index);
+  void visitMethod(Index);
+  void visitConstructor(Index);
+  void visitClass(Index);
+
+  void visitLet(Index);
+  void visitIf(Index);
+  void visitWhile(Index);
+  void visitReturn(Index);
+  void visitBlock(Index);
+
+  void visitRValue(Index);
+
   llvm::LLVMContext &m_context;
   llvm::IRBuilder<> m_builder;
   std::vector<UnresolvedSymbol> m_unresolved;
   std::unique_ptr<llvm::Module> m_module;
   llvm::Value *m_last;
-  llvm::Type *m_ExpType;  // The expected type based on the previous
-                          // expression. This is used to cast the result of
-                          // expressions to the expected type
-  ClassDecl *m_class;     // The current class we are generating code for
-
-  using ValueTable = std::unordered_map<std::string, llvm::Value *>;
-  ValueTable m_ScopedValueTable;
+  std::string m_className;  // The current class we are generating code for
+  size_t m_numStatics = 0;  // and the number of its statics
+  ExprType m_returnType;    // Return type of the current function
+  // Class.function of the current function, which names its counters. The
+  // LLVM name of a redefined function differs, see setPatchable
+  std::string m_jackName;
+
+  // Storage of the variables of the current function, indexed by their Slot.
+  // Statics are declared in the module the first time they are used
+  std::vector<llvm::Value *> m_args;
+  std::vector<llvm::Value *> m_locals;
+  std::vector<llvm::GlobalVariable *> m_statics;
+  llvm::Value *m_this = nullptr;
+
+  // The Strings of the borrowed literals of the module, by content
+  std::unordered_map<std::string, llvm::GlobalVariable *> m_strings;
+
+  // Debug info of the class being generated. Each class is parsed from its
+  // own file so it gets its own compile unit, and hence its own DIBuilder
+  bool m_debugInfo = false;
+  std::unique_ptr<llvm::DIBuilder> m_di;
+  llvm::DIFile *m_diFile = nullptr;
+  llvm::DIScope *m_diClass = nullptr;
+  llvm::DISubprogram *m_diFunction = nullptr;
+
+  instr::CounterTable *m_counters = nullptr;
+  const instr::Profile *m_profile = nullptr;
+
+  // Hot reload, see setPatchable. The functions generated from Jack are the
+  // callees that go through a slot
+  bool m_patchable = false;
+  std::unordered_set<std::string> m_jackFunctions;
+  std::vector<std::pair<std::string, std::string>> m_redefinitions;
+  unsigned m_numRedefinitions = 0;
+
+  // Symbols defined by the modules that were moved out of the generator
+  std::unordered_map<std::string, llvm::FunctionType *> m_ExternalFunctions;
+  std::unordered_map<std::string, llvm::Type *> m_ExternalGlobals;
 
   [[noreturn]] void InternalError(llvm::Function *f);
-  llvm::Value *findIdentifier(const std::string &);
+
+  // Verify a generated function and record its size
+  void verifyFunction(llvm::Function *funcI);
+  llvm::Value *findVariable(Index value);
+  llvm::GlobalVariable *findStatic(const std::string &);
+  llvm::GlobalVariable *defineStatic(const std::string &name,
+                                     const std::string &type, unsigned line);
+  // Call the functions of the program through their slot, and define the
+  // slots of the functions the module defines
+  void patchCalls();
+  llvm::GlobalVariable *callSlot(llvm::Function &callee);
+  // The String of a literal that is only read, created once per module
+  llvm::Value *borrowedString(const std::string &str);
+
+  // Convert a value between char and int, the only implicit conversions of
+  // the language. Other values are returned as they are
+  llvm::Value *convert(llvm::Value *value, const ExprType &from,
+                       const ExprType &to);
+  // Convert the arguments of a call to a function that was already generated
+  // to the width of its parameters. The first arguments are not written in
+  // the call, like the object of a method call
+  void convertArguments(llvm::Function *funcI, const Index *arg,
+                        std::vector<llvm::Value *> &argIs, size_t first);
 
   // Utility to codegen subexpressions and retrieve the value
-  llvm::Value *codegenChild(Node &n) {
-    n.accept(*this);
+  llvm::Value *codegenChild(Index n) {
+    if (m_di) return codegenWithLocation(n);
+    visit(n);
     return m_last;
   }
 
+  // The parameters of a function are its children before the body
+  size_t numParams(Index fcn) const {
+    return m_ast->numChildren(fcn) - (m_ast->hasOptional(fcn) ? 1 : 0);
+  }
+  Index body(Index fcn) const {
+    return m_ast->child(fcn, m_ast->numChildren(fcn) - 1);
+  }
+
+  // Debug info helpers, only called when it is being emitted
+  void beginDebugInfo(Index cls);
+  void endDebugInfo();
+  llvm::DIType *getDIType(const std::string &name);
+  llvm::DISubprogram *createSubprogram(Index decl, llvm::Function *funcI);
+  void declareVariable(Index var, llvm::Value *storage, unsigned argNo);
+  llvm::Value *codegenWithLocation(Index n);
+
+  // Name of the counter of a statement of the current function, the function
+  // itself is counted under m_jackName. See Counter for the names
+  std::string counterName(Index stmt, const char *suffix) const;
+
+  // Add a counter for a function or statement and increment it at the
+  // insertion point
+  void incrementCounter(Index node, const char *suffix,
+                        instr::Counter::Kind kind);
+
+  std::optional<uint64_t> profileCount(const std::string &name) const;
+  void setBranchWeights(llvm::BranchInst *branch, uint64_t taken,
+                        uint64_t notTaken);
+
   auto UnresolvedFunction(llvm::Type *RetTy,
                           const std::vector<llvm::Value *> &args)
       -> llvm::Function *;
-  void allocateArguments(llvm::Function *funcI, FunctionDecl &decl);
+  void allocateArguments(llvm::Function *funcI, Index decl);
 
-  template <typename FunctionType>
-  llvm::Function *visitFunction(FunctionType &);
+  llvm::Function *visitFunction(Index decl);
 
   LLVMGenerator(llvm::LLVMContext &ctx)
       : m_context{ctx},
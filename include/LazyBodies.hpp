@@ -0,0 +1,41 @@
+#ifndef ast_LazyBodies_hpp
+#define ast_LazyBodies_hpp
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "JackAST_fwd.hpp"
+
+namespace jcc::ast {
+
+class Node;
+
+// Parses the deferred bodies of the functions a program can call, see
+// CompilationEngine::setDeferBodies, and removes the deferred functions it
+// cannot. Jack has no function pointers nor virtual calls, so a function that
+// no reachable body calls never runs, and the startup of a program is
+// proportional to the code it can run rather than to the code it is given.
+//
+// The functions that were not deferred are reachable, like the entry point.
+// The class of a method call is the declared type of its object, or the class
+// of the caller. Calls to the classes that are not part of the program, like
+// the OS, are left for the TypeChecker to report
+class LazyBodies {
+public:
+  struct Result {
+    size_t numParsed = 0;
+    size_t numRemoved = 0;
+  };
+
+  // Syntax errors of the reachable bodies are thrown as a SyntaxError. Only
+  // the classes among the roots are looked at. Without the entry point every
+  // body is parsed
+  static Result run(const std::vector<std::unique_ptr<Node>> &roots,
+                    const std::string &cls = "Main",
+                    const std::string &fcn = "main");
+};
+
+}  // namespace jcc::ast
+
+#endif /* ast_LazyBodies_hpp */
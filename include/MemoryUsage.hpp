@@ -0,0 +1,33 @@
+#ifndef ast_MemoryUsage_hpp
+#define ast_MemoryUsage_hpp
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace jcc::ast {
+
+class Node;
+
+// Bytes held by a tree, reported by `jcc --mem-report`: the node objects with
+// the strings and child lists they own, by kind of node, and the symbol tables
+// of its classes and functions. The lists are counted by their size, the
+// report estimates what the tree needs rather than what the allocator gave it
+struct MemoryUsage {
+  std::map<std::string, uint64_t> nodes;
+  uint64_t symbols = 0;
+  // The name of the root when it is a class
+  std::string cls;
+
+  static MemoryUsage of(const Node &root);
+
+  uint64_t numNodeBytes() const;
+
+  // Add the bytes to the memory report of the statistics, under `ast.<kind>`
+  // and `symbols` for the class
+  void record() const;
+};
+
+}  // namespace jcc::ast
+
+#endif /* ast_MemoryUsage_hpp */
@@ -10,6 +10,15 @@ inline std::string generateName(const std::string &classStr,
   return "__" + classStr + "__" + funcStr;
 }
 
+// Inverse of generateName, returns "Class.function" for a mangled name and
+// the name unchanged if it is not one
+inline std::string demangle(const std::string &name) {
+  if (name.rfind("__", 0) != 0) return name;
+  const auto sep = name.find("__", 2);
+  if (sep == std::string::npos || sep == 2) return name;
+  return name.substr(2, sep - 2) + '.' + name.substr(sep + 2);
+}
+
 }  // namespace jcc::builtin
 
 #endif  // jcc_NameMangling_hpp
@@ -0,0 +1,55 @@
+#ifndef io_Peephole_hpp
+#define io_Peephole_hpp
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace jcc::io {
+
+// Optimizes nand2tetris VM code, as written by the JackWriter, by rewriting
+// the last instructions every time one is added:
+//  - operators over constants are folded with the 16 bit arithmetic of the
+//    VM, e.g. `push constant 2, push constant 3, add` becomes `push constant 5`
+//  - `x + 0`, `x - 0`, `x | 0`, `x * 1`, `x / 1`, `--x` and `~~x` become `x`
+//  - a push followed by a pop of the same location is removed
+//  - the VM has no compare and branch, so the comparisons that a branch tests
+//    are reduced: `eq, not, if-goto` becomes `sub, if-goto` and a branch on a
+//    constant becomes a goto or nothing
+//  - the code between a goto or return and the next label is removed, as are
+//    the gotos to the next instruction
+class Peephole {
+public:
+  // Returns the optimized code, and the number of instructions it saved
+  static std::string optimize(const std::string &code,
+                              size_t *numRemoved = nullptr);
+
+private:
+  struct Instr {
+    std::string op;
+    std::string arg;
+    std::string num;
+  };
+
+  std::vector<Instr> m_code;
+  // Set after a jump, until a label makes the code reachable again
+  bool m_dead = false;
+
+  void add(Instr instr);
+  void pushConstant(int16_t value);
+
+  bool tailIs(size_t back, const std::string &op) const;
+  // The constant computed by the last instructions, and their number
+  std::optional<std::pair<int16_t, size_t>> constantAt(size_t back) const;
+  void drop(size_t count) { m_code.resize(m_code.size() - count); }
+
+  // Rules by the instruction added, true when it was rewritten
+  bool foldUnary(const Instr &instr);
+  bool foldBinary(const Instr &instr);
+  bool foldBranch(const Instr &instr);
+};
+
+}  // namespace jcc::io
+
+#endif /* io_Peephole_hpp */
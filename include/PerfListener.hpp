@@ -0,0 +1,52 @@
+#ifndef _exec_PerfListener_hpp_
+#define _exec_PerfListener_hpp_
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+
+#include "llvm/ExecutionEngine/JITEventListener.h"
+
+namespace exec {
+using namespace llvm;
+
+// Makes the functions compiled by the JIT visible to perf. Every function is
+// written to the perf map /tmp/perf-<pid>.map, which `perf report` reads on
+// its own, and to a jitdump file that `perf inject --jit` merges into the
+// profile along with the code of the function so it can be annotated. The
+// jitdump is written to $JITDUMPDIR, or /tmp, and needs `perf record -k 1`.
+// Symbols keep the mangled `__Class__function` names.
+//
+// There is one listener per process because perf expects a single map and
+// dump per pid, and it is shared by every JIT
+class PerfListener : public JITEventListener {
+public:
+  static PerfListener &get();
+
+  void notifyObjectLoaded(ObjectKey K, const object::ObjectFile &Obj,
+                          const RuntimeDyld::LoadedObjectInfo &L) override;
+
+  PerfListener(const PerfListener &) = delete;
+  PerfListener &operator=(const PerfListener &) = delete;
+
+private:
+  PerfListener();
+  ~PerfListener() override;
+
+  void writeCodeLoad(const std::string &name, uint64_t addr, uint64_t size);
+
+  std::mutex Mutex;
+  FILE *PerfMap = nullptr;
+  int DumpFd = -1;
+
+  // perf finds the jitdump through an executable mapping of the file
+  void *DumpMarker = nullptr;
+  size_t DumpMarkerSize = 0;
+
+  uint64_t CodeIndex = 0;
+};
+
+}  // namespace exec
+
+#endif /* _exec_PerfListener_hpp_ */
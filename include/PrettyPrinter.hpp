@@ -3,59 +3,62 @@
 
 #include <string>
 
-#include "JackAST_fwd.hpp"
-#include "Visitor.hpp"
+#include "FlatAST.hpp"
 
 namespace jcc::ast {
 
 class Node;
 
-class PrettyPrinter : public ImmutableVisitor {
+// Dumps the structure of a tree, a node per line indented by its depth. The
+// tree is printed from its flat encoding
+class PrettyPrinter : public FlatVisitor<PrettyPrinter> {
 public:
-  PrettyPrinter() : m_offset{0}, m_ast{} {}
   static std::string print(const Node &);
-
-  void visit(const EmptyNode &) override {}
-  void visit(const IntConst &) override;
-  void visit(const CharConst &) override;
-  void visit(const Identifier &) override;
-  void visit(const StrConst &) override;
-  void visit(const IndexExpr &) override;
-  void visit(const True &) override { m_ast += "true"; }
-  void visit(const False &) override { m_ast += "false"; }
-  void visit(const This &) override { m_ast += "this"; }
-
-  void visit(const BinaryOp &) override;
-  void visit(const UnaryOp &) override;
-
-  void visit(const MethodCall &) override;
-  void visit(const FunctionCall &) override;
-
-  void visit(const LetStmt &) override;
-  void visit(const IfStmt &) override;
-  void visit(const WhileStmt &) override;
-  void visit(const ReturnStmt &) override;
-
-  void visit(const VarDecl &) override;
-  void visit(const MethodDecl &) override;
-  void visit(const StaticDecl &) override;
-  void visit(const ConstructorDecl &) override;
-  void visit(const ClassDecl &) override;
-  void visit(const Block &) override;
-
-  void visit(const RValueT &) override;
+  static std::string print(const FlatAST &);
 
 private:
-  unsigned m_offset;
-  std::string m_ast;
+  friend class FlatVisitor<PrettyPrinter>;
+  using Index = FlatAST::Index;
+
+  explicit PrettyPrinter(const FlatAST &ast) : FlatVisitor{ast} {}
+
+  void visitEmpty(Index) {}
+  void visitInt(Index);
+  void visitChar(Index);
+  void visitStr(Index);
+  void visitIdentifier(Index);
+  void visitIndex(Index);
+  void visitThis(Index) { m_out += "this"; }
+  void visitTrue(Index) { m_out += "true"; }
+  void visitFalse(Index) { m_out += "false"; }
+
+  void visitBinary(Index);
+  void visitUnary(Index);
+
+  void visitMethodCall(Index);
+  void visitFunctionCall(Index);
+
+  void visitLet(Index);
+  void visitIf(Index);
+  void visitWhile(Index);
+  void visitReturn(Index);
+
+  void visitVar(Index);
+  void visitBlock(Index);
+  void visitStatic(Index node) { visitFunction(node, "StaticDecl: "); }
+  void visitMethod(Index node) { visitFunction(node, "MethodDecl: "); }
+  void visitConstructor(Index node) {
+    visitFunction(node, "ConstructorDecl: ");
+  }
+  void visitClass(Index);
+
+  void visitRValue(Index);
+
+  unsigned m_offset = 0;
+  std::string m_out;
 
   std::string pad() const;
-
-  template <typename ForwardIt>
-  void printExprList(ForwardIt, ForwardIt);
-
-  template <typename FunctionType>
-  void visitFunctionDecl(FunctionType &f);
+  void visitFunction(Index node, const char *title);
 
   struct Pad {
     explicit Pad(PrettyPrinter *p) : m_p{p} { ++m_p->m_offset; }
@@ -0,0 +1,94 @@
+#ifndef _exec_Profiler_hpp_
+#define _exec_Profiler_hpp_
+
+#include <signal.h>
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "llvm/DebugInfo/DIContext.h"
+#include "llvm/ExecutionEngine/JITEventListener.h"
+#include "llvm/Object/Binary.h"
+
+namespace exec {
+using namespace llvm;
+
+// Sampling profiler for JIT'd code that needs no external tool. While it is
+// running, the CPU time of the thread that started it is sampled with SIGPROF
+// and the stack of each sample is walked through the frame pointers, so the
+// JIT must keep them (JITOptions::FramePointers). The profiler is also the
+// listener that learns where the JIT put each function, which is how the
+// samples are mapped back to Jack functions, and to their lines when the
+// code was generated with debug info. Only one profiler can run at a time
+class Profiler : public JITEventListener {
+public:
+  explicit Profiler(unsigned periodUs = 1000);
+  ~Profiler() override;
+
+  void notifyObjectLoaded(ObjectKey K, const object::ObjectFile &Obj,
+                          const RuntimeDyld::LoadedObjectInfo &L) override;
+
+  // Start and stop sampling the calling thread
+  bool start();
+  void stop();
+
+  size_t numSamples() const;
+  size_t numDropped() const { return Dropped.load(); }
+
+  // Write the samples as folded stacks, one line per distinct stack with the
+  // frames from the root separated by ';' followed by the number of samples.
+  // This is the input of flamegraph.pl and most flame graph viewers
+  void writeFolded(std::ostream &os) const;
+  bool writeFolded(const std::string &path) const;
+
+  Profiler(const Profiler &) = delete;
+  Profiler &operator=(const Profiler &) = delete;
+
+private:
+  struct Symbol {
+    uint64_t Start;
+    uint64_t Size;
+    std::string Name;
+    // Line table of the object defining the symbol
+    DIContext *Lines;
+  };
+
+  // Samples are appended by the signal handler to a preallocated buffer as
+  // the number of frames followed by the program counters, innermost first
+  static constexpr size_t MaxDepth = 128;
+  static constexpr size_t BufferSize = 1 << 22;
+
+  unsigned PeriodUs;
+  std::unique_ptr<uintptr_t[]> Buffer;
+  std::atomic<size_t> Used{0};
+  std::atomic<size_t> Dropped{0};
+
+  // Bounds of the stack of the sampled thread, frame pointers outside of it
+  // end the walk
+  uintptr_t StackLow = 0;
+  uintptr_t StackHigh = 0;
+
+  void *Timer = nullptr;
+  bool Running = false;
+
+  // Sorted by address when the samples are written
+  mutable std::mutex SymbolsMutex;
+  mutable std::vector<Symbol> Symbols;
+  std::vector<object::OwningBinary<object::ObjectFile>> DebugObjects;
+  std::vector<std::unique_ptr<DIContext>> LineTables;
+
+  static std::atomic<Profiler *> Active;
+  static void handleSignal(int, siginfo_t *, void *);
+  void recordSample(uintptr_t pc, uintptr_t sp, uintptr_t fp);
+
+  std::string symbolize(uintptr_t pc) const;
+};
+
+}  // namespace exec
+
+#endif /* _exec_Profiler_hpp_ */
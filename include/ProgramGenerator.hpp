@@ -0,0 +1,89 @@
+#ifndef jcc_ProgramGenerator_hpp
+#define jcc_ProgramGenerator_hpp
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "JackAST.hpp"
+
+namespace jcc::ast {
+class Builder;
+}
+
+namespace jcc::gen {
+
+// Shape of a generated program
+struct ProgramOptions {
+  unsigned numClasses = 10;
+  unsigned functionsPerClass = 10;
+
+  // Number of statements in the body of each function, and how deeply they
+  // nest in if and while statements
+  unsigned statementsPerFunction = 20;
+  unsigned maxNesting = 2;
+
+  // Probability that an expression term is a call to a function generated
+  // before it. Calls only go to earlier functions so the call graph is acyclic
+  // and the program terminates
+  double callDensity = 0.1;
+
+  // Depth of the expression trees on the right hand side of let statements
+  unsigned expressionDepth = 3;
+
+  // Number of string literals in each function and their length
+  unsigned stringsPerFunction = 1;
+  unsigned stringLength = 16;
+
+  uint64_t seed = 1;
+};
+
+// Generates random Jack programs of a given shape to measure how the compiler
+// scales with the size of its input. Every class `C<i>` has static functions
+// `f<j>(int a, int b)` returning an int, and `Main.main` calls the last
+// function of every class. Generation is deterministic for a given seed. The
+// programs are meant to be compiled: with enough calls and loops, running them
+// takes time exponential in the number of functions
+class ProgramGenerator {
+public:
+  explicit ProgramGenerator(ProgramOptions options);
+
+  // Generate the classes of the program, Main last
+  std::vector<std::unique_ptr<ast::ClassDecl>> generate();
+
+  // Generate the program and print each class as Jack source. Returns pairs of
+  // (file name, source)
+  std::vector<std::pair<std::string, std::string>> generateSources();
+
+private:
+  struct Function {
+    std::string cls;
+    std::string name;
+  };
+
+  ProgramOptions m_options;
+  uint64_t m_state;
+
+  // Functions generated so far, which later functions may call
+  std::vector<Function> m_callees;
+
+  uint64_t next();
+  unsigned uniform(unsigned bound) { return next() % bound; }
+  bool chance(double p);
+
+  std::unique_ptr<ast::ClassDecl> generateClass(unsigned idx);
+  std::unique_ptr<ast::ClassDecl> generateMain();
+  void generateBody(ast::Builder &builder, ast::FunctionDecl &fcn);
+  void generateStatements(ast::Builder &builder, ast::Block &block,
+                          unsigned count, unsigned nesting);
+  std::unique_ptr<ast::Node> generateExpression(ast::Builder &builder,
+                                                unsigned depth);
+  std::unique_ptr<ast::Node> generateTerm(ast::Builder &builder,
+                                          unsigned depth);
+  std::string generateString();
+};
+
+}  // namespace jcc::gen
+
+#endif  // jcc_ProgramGenerator_hpp
@@ -0,0 +1,53 @@
+#ifndef jcc_Repl_hpp
+#define jcc_Repl_hpp
+
+#include <iostream>
+#include <set>
+#include <string>
+
+#include "JackAST.hpp"
+#include "Runtime.hpp"
+
+namespace jcc {
+
+// Interactive session that compiles and runs one input at a time. An input is
+// either a class declaration, a `var` declaration, a list of statements or an
+// expression whose value is printed. Each input is JIT'd into its own module
+// in the same session so that earlier classes and variables stay live
+class Repl {
+public:
+  Repl(std::istream &is, std::ostream &os);
+
+  // Read and evaluate inputs until the end of the input stream or `:quit`
+  int run();
+
+  // Evaluate a single complete input. Returns false if the session is over
+  bool eval(const std::string &input);
+
+  // Nesting depth of the braces at the end of the input, outside of string
+  // literals, so that a declaration can span multiple lines
+  static int braceDepth(const std::string &input);
+
+  // Name of the class holding the variables and statements of the session
+  static constexpr auto class_name = "Repl";
+
+private:
+  Runtime m_rt;
+  ast::ClassDecl *m_cls;
+  std::set<std::string> m_classes;
+  unsigned m_numInputs = 0;
+  std::istream &m_is;
+  std::ostream &m_os;
+
+  void defineClass(const std::string &input);
+  void defineVars(const std::string &input);
+  void evalStatements(const std::string &input);
+  void evalExpression(const std::string &input);
+
+  std::unique_ptr<ast::StaticDecl> newInputFunction();
+  int callInputFunction(std::unique_ptr<ast::StaticDecl> fcn);
+};
+
+}  // namespace jcc
+
+#endif  // jcc_Repl_hpp
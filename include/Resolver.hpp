@@ -0,0 +1,64 @@
+#ifndef ast_Resolver_hpp
+#define ast_Resolver_hpp
+
+#include "JackAST_fwd.hpp"
+#include "Visitor.hpp"
+
+namespace jcc::ast {
+
+class Node;
+
+// Binds every variable to its declaration and gives each declaration a Slot:
+//  - statics and fields by their position in the class
+//  - parameters by their position in the function, `this` first for methods
+//  - local variables in the order they are declared in the function
+// Code generation then finds the storage of a variable by indexing instead of
+// hashing its name. Undefined variables are thrown as a TypeError
+class Resolver : public MutableVisitor {
+public:
+  // Resolve a class, or a function or expression of a class. The members of
+  // the class are numbered again for a function since the REPL adds statics
+  static void run(Node &root);
+
+  void visit(EmptyNode &) override {}
+  void visit(IntConst &) override {}
+  void visit(CharConst &) override {}
+  void visit(Identifier &) override;
+  void visit(StrConst &) override {}
+  void visit(IndexExpr &) override;
+  void visit(True &) override {}
+  void visit(False &) override {}
+  void visit(This &) override {}
+
+  void visit(BinaryOp &) override;
+  void visit(UnaryOp &) override;
+
+  void visit(MethodCall &) override;
+  void visit(FunctionCall &) override;
+
+  void visit(LetStmt &) override;
+  void visit(IfStmt &) override;
+  void visit(WhileStmt &) override;
+  void visit(ReturnStmt &) override;
+
+  void visit(VarDecl &) override;
+  void visit(StaticDecl &) override;
+  void visit(MethodDecl &) override;
+  void visit(ConstructorDecl &) override;
+  void visit(ClassDecl &) override;
+  void visit(Block &) override;
+
+  void visit(RValueT &) override;
+
+private:
+  const ClassDecl *m_class = nullptr;
+  unsigned m_numLocals = 0;
+
+  void resolve(NamedValue &value);
+  void visitFunction(FunctionDecl &decl);
+  static void numberMembers(const ClassDecl &cls);
+};
+
+}  // namespace jcc::ast
+
+#endif /* ast_Resolver_hpp */
@@ -2,29 +2,78 @@
 #define Runtime_hpp
 
 #include <memory>
+#include <unordered_map>
 
+#include "Counters.hpp"
+#include "EscapeAnalysis.hpp"
+#include "Inliner.hpp"
 #include "JackAST.hpp"
 #include "JackJIT.hpp"
 #include "LLVMGenerator.hpp"
 #include "PrettyPrinter.hpp"
+#include "Profiler.hpp"
+#include "TypeChecker.hpp"
 #include "Visitor.hpp"
 
 namespace jcc {
 using NodePtr = std::unique_ptr<jcc::ast::Node>;
 using ASTList = std::vector<NodePtr>;
 
+// Options that change how a Runtime compiles and runs a program
+struct RuntimeOptions {
+  exec::JITOptions jit;
+  // When set, run() samples the program and writes the folded stacks here
+  std::string profile;
+  // Emit DWARF for the generated code, see LLVMGenerator::Create
+  bool debugInfo = false;
+  // Count function entries and loop iterations, see counters()
+  bool instrument = false;
+  // Counts of an instrumented run that guide code generation
+  std::shared_ptr<const instr::Profile> pgo;
+  // Simplify the AST before code generation, see ConstantFolder
+  bool foldConstants = true;
+  // Replace the calls of small functions by their body, see Inliner
+  bool inlineCalls = true;
+  // Create the string literals that never escape once per module instead of
+  // at every evaluation, see EscapeAnalysis
+  bool borrowStrings = true;
+  // Let reload() redefine the classes while the program runs. The calls are
+  // not inlined then, an inlined copy could not be replaced
+  bool hotReload = false;
+  // The classes were parsed with their bodies deferred. codegen() parses the
+  // bodies the program can call and drops the others, see LazyBodies
+  bool lazyBodies = false;
+};
+
 // Facade for the code generation and JIT of a Jack program. TODO This should
 // not be a singleton, but should own compilers and interpreters
 class Runtime {
 public:
-  Runtime(std::istream &is, std::ostream &os)
-      : m_context{std::make_unique<llvm::LLVMContext>()}, m_is{is}, m_os{os} {
+  // When a pool is provided, the JIT is leased from it and the program runs in
+  // its own JITDylib instead of paying for a new JIT
+  Runtime(std::istream &is, std::ostream &os, exec::JITPool *pool = nullptr,
+          RuntimeOptions options = {})
+      : m_context{std::make_unique<llvm::LLVMContext>()},
+        m_pool{pool},
+        m_options{options},
+        m_is{is},
+        m_os{os} {
+    if (m_options.hotReload) m_options.inlineCalls = false;
+    if (!m_options.profile.empty()) {
+      m_profiler = std::make_unique<exec::Profiler>();
+    }
     reset();
   }
   Runtime() : Runtime(std::cin, std::cout) {}
+  ~Runtime() { releaseJIT(); }
 
   std::istream &istream() { return m_is; }
   std::ostream &ostream() { return m_os; }
+  const RuntimeOptions &options() const { return m_options; }
+
+  // Execution counts of the program run since the last reset, only filled
+  // when the runtime instruments the code
+  const instr::CounterTable &counters() const { return m_counters; }
 
   llvm::Module &module();
   llvm::orc::JITDylib &engine();
@@ -34,7 +83,9 @@ public:
   Runtime(Runtime &&) = delete;
   Runtime &operator=(Runtime &&other) = delete;
 
-  const llvm::LLVMContext &getContext() const { return *m_context; }
+  const llvm::LLVMContext &getContext() const {
+    return *m_context.getContext();
+  }
 
   const ast::Node *getAST(size_t idx = 0) const { return m_ast[idx].get(); }
   ast::Node *getAST(size_t idx = 0) { return m_ast[idx].get(); }
@@ -43,25 +94,96 @@ public:
   void reset(std::unique_ptr<ast::Node>);
   void addAST(std::unique_ptr<ast::Node>);
   int run();
+  // Run the entry point returned by materialize()
+  int run(llvm::JITSymbol &entry);
+
+  // Type check and generate the code of the ASTs added so far. The first type
+  // error is thrown as a TypeError, the syntax errors of the deferred bodies
+  // as a SyntaxError
   llvm::Value *codegen();
+
+  // Hand the generated module to the JIT and return the address of Main.main
+  // without running it. run() does this first
+  llvm::JITSymbol materialize();
+
+  // Compile the generated module to an object file instead of running it
+  bool emitObject(const std::string &path);
+
+  // Write the nand2tetris VM code of each class to <dir>/<Class>.vm instead
+  // of generating LLVM IR. The Jack OS is not part of the Runtime, so the
+  // calls are not type checked
+  bool emitVM(const std::string &dir);
+
+  // Run Main.main on the VMInterpreter instead of the JIT, for the programs
+  // that do not run long enough to pay for the compilation. The errors of the
+  // code are thrown as a SyntaxError, those of the program as a
+  // std::runtime_error
+  int interpret();
+
+  // Incremental interface used by the interpreter. Each definition is
+  // generated into a new module that is handed to the JIT right away, so that
+  // later definitions can refer to everything defined so far. Type errors are
+  // thrown like in codegen()
+  void define(ast::ClassDecl &cls);
+  void define(ast::ClassDecl &cls, ast::VarDecl &var);
+  void define(ast::ClassDecl &cls, ast::FunctionDecl &fcn);
+
+  // Generate a class of the program again while it runs on another thread,
+  // with hotReload. The calls made from then on go to the new definitions of
+  // its functions, its statics keep their values. The fields and signatures
+  // of the class must be the same, otherwise a std::runtime_error is thrown.
+  // Type errors are thrown like in codegen()
+  void reload(std::unique_ptr<ast::ClassDecl> cls);
+
+  // Call a function that takes no arguments and returns an int. The function
+  // must have been handed to the JIT by define()
+  int call(const std::string &cls, const std::string &fcn);
   void clear() {
     m_gen.reset();
-    m_jit.reset();
+    releaseJIT();
   }
 
 private:
   // This needs to be owned by the runtime (and first) so we can delete the
-  // modules before the context is destroyed
-  std::unique_ptr<llvm::LLVMContext> m_context;
+  // modules before the context is destroyed. It is shared with the JIT so that
+  // modules left in a pooled JIT keep their context alive
+  llvm::orc::ThreadSafeContext m_context;
 
   ASTList m_ast;
   std::unique_ptr<ast::LLVMGenerator> m_gen;
   std::unique_ptr<exec::JIT> m_jit;
+  exec::JITPool *m_pool;
+  RuntimeOptions m_options;
+  std::unique_ptr<exec::Profiler> m_profiler;
+  instr::CounterTable m_counters;
+  ast::TypeChecker m_checker;
+  ast::Inliner m_inliner;
+  ast::EscapeAnalysis m_escapes;
+  llvm::orc::JITDylib *m_dylib = nullptr;
+  unsigned m_numModules = 0;
+  // With hotReload, the interface of each class of the program and the
+  // classes that replaced those of the ASTs
+  std::unordered_map<std::string, uint64_t> m_interfaces;
+  std::vector<std::unique_ptr<ast::ClassDecl>> m_reloaded;
 
   // Stream I/O
   std::istream &m_is;
   std::ostream &m_os;
 
+  // Return the JIT to the pool, or destroy it if it is not pooled
+  void releaseJIT();
+
+  // Hand the current module to the JIT and continue in a new one
+  void submitModule();
+
+  // The peephole optimized VM code of a resolved class
+  std::string generateVM(const ast::ClassDecl &cls);
+
+  // Add the memory held by a class once it went through the passes, and by a
+  // module handed to the JIT, to the statistics
+  void recordMemory(const ast::Node &ast);
+  void recordMemory(const llvm::Module &mod);
+
   // Register the builtin functions for manipulating arrays, strings, output,
   // and the AST
   void registerBuiltins();
@@ -72,6 +194,10 @@ private:
   void registerOutput(llvm::Module *);
   void registerAST(llvm::Module *);
   void registerInput(llvm::Module *);
+
+  // Make the builtins registered in the current module known to the
+  // TypeChecker
+  void declareBuiltins();
 };
 
 }  // namespace jcc
@@ -0,0 +1,76 @@
+#ifndef ast_SourcePrinter_hpp
+#define ast_SourcePrinter_hpp
+
+#include <string>
+
+#include "JackAST_fwd.hpp"
+#include "Visitor.hpp"
+
+namespace jcc::ast {
+
+class Node;
+
+// Prints an AST back as Jack source that the CompilationEngine accepts. Unlike
+// the PrettyPrinter, which dumps the structure of the tree, the output of the
+// SourcePrinter can be compiled, so it is used to write out generated programs
+class SourcePrinter : public ImmutableVisitor {
+public:
+  static std::string print(const Node &);
+
+  void visit(const EmptyNode &) override {}
+  void visit(const IntConst &) override;
+  void visit(const CharConst &) override;
+  void visit(const Identifier &) override;
+  void visit(const StrConst &) override;
+  void visit(const IndexExpr &) override;
+  void visit(const True &) override { m_src += "true"; }
+  void visit(const False &) override { m_src += "false"; }
+  void visit(const This &) override { m_src += "this"; }
+
+  void visit(const BinaryOp &) override;
+  void visit(const UnaryOp &) override;
+
+  void visit(const MethodCall &) override;
+  void visit(const FunctionCall &) override;
+
+  void visit(const LetStmt &) override;
+  void visit(const IfStmt &) override;
+  void visit(const WhileStmt &) override;
+  void visit(const ReturnStmt &) override;
+
+  void visit(const VarDecl &) override;
+  void visit(const MethodDecl &) override;
+  void visit(const StaticDecl &) override;
+  void visit(const ConstructorDecl &) override;
+  void visit(const ClassDecl &) override;
+  void visit(const Block &) override;
+
+  void visit(const RValueT &) override;
+
+private:
+  unsigned m_offset = 0;
+  std::string m_src;
+
+  // Set while printing the direct statements of a block, where a call is a
+  // `do` statement and a declaration is a `var`
+  bool m_statement = false;
+
+  // Set while printing the operands of a binary operator. Jack has no operator
+  // precedence, so nested operators are parenthesized
+  bool m_operand = false;
+
+  std::string pad() const { return std::string(m_offset * 2, ' '); }
+  bool enterExpression();
+
+  template <typename ForwardIt>
+  void printArgs(ForwardIt, ForwardIt);
+
+  template <typename FunctionType>
+  void visitFunctionDecl(const char *kind, FunctionType &f, size_t firstParam);
+
+  void printBody(const Block &b);
+};
+
+}  // namespace jcc::ast
+
+#endif /* ast_SourcePrinter_hpp */
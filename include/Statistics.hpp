@@ -0,0 +1,138 @@
+#ifndef jcc_Statistics_hpp
+#define jcc_Statistics_hpp
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace jcc::stats {
+
+// Process wide registry of the time spent in each phase of the compiler, of
+// the size of what each phase produced and of the memory it holds, reported by
+// `jcc --time-report`, `jcc --stats` and `jcc --mem-report`. Entries are keyed
+// by phase and unit, where the unit is the class being compiled (one class per
+// file in Jack) or empty for the phases that work on the whole program. Phases
+// are dotted to show they are included in their parent, e.g. `parse.lex` is
+// part of `parse`. Nothing is recorded unless the registry is enabled
+class Statistics {
+public:
+  enum class Format { Table, JSON };
+
+  static Statistics &get();
+
+  void enable() { m_enabled.store(true, std::memory_order_relaxed); }
+  bool enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+  // A negative CPU time means the phase was only measured with the wall clock
+  void addTime(const std::string &phase, const std::string &unit, double wall,
+               double cpu);
+  void addCount(const std::string &name, const std::string &unit,
+                uint64_t count);
+  void addBytes(const std::string &name, const std::string &unit,
+                uint64_t bytes);
+
+  void print(std::ostream &os, Format format, bool timers, bool counters,
+             bool memory = false) const;
+
+  // Drop everything recorded so far
+  void clear();
+
+private:
+  struct Timer {
+    double wall = 0;
+    double cpu = 0;
+    uint64_t calls = 0;
+  };
+
+  using Key = std::pair<std::string, std::string>;
+
+  std::atomic<bool> m_enabled{false};
+  mutable std::mutex m_mutex;
+
+  // Keys are kept in the order they were first recorded, which follows the
+  // order of the phases
+  std::vector<Key> m_timerKeys;
+  std::map<Key, Timer> m_timers;
+  std::vector<Key> m_counterKeys;
+  std::map<Key, uint64_t> m_counters;
+  std::vector<Key> m_memoryKeys;
+  std::map<Key, uint64_t> m_memory;
+
+  void printTable(std::ostream &os, bool timers, bool counters,
+                  bool memory) const;
+  void printJSON(std::ostream &os, bool timers, bool counters,
+                 bool memory) const;
+};
+
+// Wall and CPU time of the calling thread in seconds
+double wallTime();
+double cpuTime();
+
+// Peak resident set size of the process in kilobytes
+uint64_t peakRSS();
+
+// Records the wall and CPU time between its construction and destruction if
+// statistics are enabled
+class ScopedTimer {
+public:
+  explicit ScopedTimer(const char *phase, const std::string &unit = "")
+      : m_phase{phase}, m_enabled{Statistics::get().enabled()} {
+    if (m_enabled) {
+      m_unit = unit;
+      m_wall = wallTime();
+      m_cpu = cpuTime();
+    }
+  }
+
+  ~ScopedTimer() {
+    if (m_enabled) {
+      Statistics::get().addTime(m_phase, m_unit, wallTime() - m_wall,
+                                cpuTime() - m_cpu);
+    }
+  }
+
+  // Set the unit once it is known, e.g. after parsing the class name
+  void setUnit(const std::string &unit) {
+    if (m_enabled) m_unit = unit;
+  }
+
+  ScopedTimer(const ScopedTimer &) = delete;
+  ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+  const char *m_phase;
+  bool m_enabled;
+  std::string m_unit;
+  double m_wall = 0;
+  double m_cpu = 0;
+};
+
+inline void addCount(const char *name, const std::string &unit,
+                     uint64_t count) {
+  auto &stats = Statistics::get();
+  if (stats.enabled()) stats.addCount(name, unit, count);
+}
+
+inline void addBytes(const char *name, const std::string &unit,
+                     uint64_t bytes) {
+  auto &stats = Statistics::get();
+  if (stats.enabled()) stats.addBytes(name, unit, bytes);
+}
+
+// Bytes a string holds on the heap, none when it is short enough to be stored
+// in the string itself
+inline uint64_t heapBytes(const std::string &str) {
+  const auto *begin = reinterpret_cast<const char *>(&str);
+  const bool inlined = str.data() >= begin && str.data() < begin + sizeof(str);
+  return inlined ? 0 : str.capacity() + 1;
+}
+
+}  // namespace jcc::stats
+
+#endif  // jcc_Statistics_hpp
@@ -2,9 +2,10 @@
 #define SYMBOL_TABLE_HPP
 
 #include <array>
+#include <cstdint>
 #include <memory>
 #include <string>
-#include <unordered_map>
+#include <vector>
 
 namespace jcc {
 
@@ -18,19 +19,49 @@ enum class Kind { STATIC = 0, FIELD, ARG, VAR, NONE, NUM_KINDS };
 
 std::string toSegment(const Kind kind);
 
+// The variables of a class or a function by name. The entries are kept in a
+// vector in declaration order, with the hash of their name. The names are
+// those of the declarations, the table does not copy them, and a name is only
+// compared when its hash matches. Most functions have a few variables, which
+// are scanned; past kMaxScanned an open addressing index of the entries is
+// built, and grown from the stored hashes
 class Table {
 public:
-  using TableEntries = std::unordered_map<std::string, ast::VarDecl *>;
-
-  Table(std::string name) : m_entries{}, m_name{std::move(name)} {}
+  Table(std::string name) : m_name{std::move(name)} {}
 
   const std::string &getName() const { return m_name; }
   const ast::VarDecl *lookup(const std::string &) const;
   bool addValue(ast::VarDecl *);
+  size_t size() const { return m_entries.size(); }
+
+  // The variables added after a push() are removed by the matching pop()
+  void push() { m_scopes.push_back(m_entries.size()); }
+  void pop();
+
+  // Bytes the table holds on the heap
+  size_t memoryUsage() const;
 
 private:
-  TableEntries m_entries;
+  struct Entry {
+    uint32_t hash;
+    ast::VarDecl *var;
+  };
+
+  static constexpr size_t kMaxScanned = 16;
+
+  std::vector<Entry> m_entries;
+  // A power of two of slots, at most half full, holding the position of an
+  // entry plus one or 0 when the slot is free. Empty while the entries are
+  // scanned
+  std::vector<uint32_t> m_index;
+  // The number of entries at each push()
+  std::vector<size_t> m_scopes;
   std::string m_name;
+
+  static uint32_t hash(const std::string &name);
+  const Entry *find(const std::string &name, uint32_t hash) const;
+  void insert(uint32_t position);
+  void rebuildIndex(size_t numSlots);
 };
 
 }  // namespace sym
@@ -0,0 +1,105 @@
+#ifndef ast_TypeChecker_hpp
+#define ast_TypeChecker_hpp
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "JackAST.hpp"
+#include "Visitor.hpp"
+
+namespace jcc::ast {
+
+// Resolves the type of every expression once and records it on the node, see
+// Node::getExprType. Code generation relies on these annotations to emit
+// values of the exact width their use expects.
+//
+// The first error found is thrown as a TypeError, like the parser does for
+// syntax errors
+class TypeChecker : public MutableVisitor {
+public:
+  // Make the functions of a class known to the code checked after. All the
+  // classes of a program are declared before any is checked so that they can
+  // call each other
+  void declare(const ClassDecl &cls);
+  // Declare the node if it is a class. The program held by the runtime is a
+  // list of nodes that are usually, but not always, classes
+  void declare(Node &root);
+
+  // Declare a function that has no Jack declaration, like the builtins. The
+  // parameters of a method start with `this`
+  void declare(const std::string &cls, const std::string &fcn, ExprType ret,
+               std::vector<ExprType> params);
+
+  // Check and annotate a class, a function of a declared class or an
+  // expression
+  void check(Node &root);
+
+  void visit(EmptyNode &) override;
+  void visit(IntConst &) override;
+  void visit(CharConst &) override;
+  void visit(Identifier &) override;
+  void visit(StrConst &) override;
+  void visit(IndexExpr &) override;
+  void visit(True &) override;
+  void visit(False &) override;
+  void visit(This &) override;
+
+  void visit(BinaryOp &) override;
+  void visit(UnaryOp &) override;
+
+  void visit(MethodCall &) override;
+  void visit(FunctionCall &) override;
+
+  void visit(LetStmt &) override;
+  void visit(IfStmt &) override;
+  void visit(WhileStmt &) override;
+  void visit(ReturnStmt &) override;
+
+  void visit(VarDecl &) override;
+  void visit(StaticDecl &) override;
+  void visit(MethodDecl &) override;
+  void visit(ConstructorDecl &) override;
+  void visit(ClassDecl &) override;
+  void visit(Block &) override;
+
+  void visit(RValueT &) override;
+
+private:
+  struct Signature {
+    ExprType ret;
+    std::vector<ExprType> params;
+  };
+
+  // Signatures by "Class.function", and the classes they belong to
+  std::unordered_map<std::string, Signature> m_signatures;
+  std::unordered_set<std::string> m_classes;
+
+  // Set while looking for the classes to declare
+  bool m_declaring = false;
+
+  // Scope of the node being checked
+  const ClassDecl *m_class = nullptr;
+  const FunctionDecl *m_function = nullptr;
+
+  // Check a child and return its type
+  const ExprType &typeOf(Node &node);
+  // Type of the variable a name refers to, the declaration it is bound to if
+  // the Resolver has run
+  ExprType variableType(const NamedValue &value);
+
+  void visitFunction(FunctionDecl &decl);
+
+  // Check the arguments of a call against the signature of the function and
+  // annotate the call with its return type. The first `implicit` arguments
+  // are not written in the call, like the object of a method call
+  void checkCall(Call &call, const std::string &cls,
+                 const std::vector<ExprType> &args, size_t implicit);
+
+  [[noreturn]] void error(const Node &node, const std::string &msg) const;
+};
+
+}  // namespace jcc::ast
+
+#endif /* ast_TypeChecker_hpp */
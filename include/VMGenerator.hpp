@@ -0,0 +1,87 @@
+#ifndef ast_VMGenerator_hpp
+#define ast_VMGenerator_hpp
+
+#include <string>
+
+#include "JackAST_fwd.hpp"
+#include "JackWriter.hpp"
+#include "Visitor.hpp"
+
+namespace jcc::ast {
+
+class Node;
+
+// Generates the nand2tetris VM code of a class through a JackWriter, for the
+// VM emulator and the toolchains built on it. Variables are mapped to the
+// segments by their Slot and the calls follow the conventions of the Jack OS:
+// String literals are built with String.new and String.appendChar, `*` and `/`
+// call Math.multiply and Math.divide, constructors allocate their object with
+// Memory.alloc.
+//
+// The AST must have been resolved by the Resolver. The code is written as it
+// is, see Peephole to optimize it
+class VMGenerator : public ImmutableVisitor {
+public:
+  static std::string generate(const ClassDecl &cls);
+
+  void visit(const EmptyNode &) override { m_empty = true; }
+  void visit(const IntConst &) override;
+  void visit(const CharConst &) override;
+  void visit(const Identifier &) override;
+  void visit(const StrConst &) override;
+  void visit(const IndexExpr &) override;
+  void visit(const True &) override;
+  void visit(const False &) override;
+  void visit(const This &) override;
+
+  void visit(const BinaryOp &) override;
+  void visit(const UnaryOp &) override;
+
+  void visit(const MethodCall &) override;
+  void visit(const FunctionCall &) override;
+
+  void visit(const LetStmt &) override;
+  void visit(const IfStmt &) override;
+  void visit(const WhileStmt &) override;
+  void visit(const ReturnStmt &) override;
+
+  void visit(const VarDecl &) override;
+  void visit(const StaticDecl &) override;
+  void visit(const MethodDecl &) override;
+  void visit(const ConstructorDecl &) override;
+  void visit(const ClassDecl &) override;
+  void visit(const Block &) override;
+
+  void visit(const RValueT &) override;
+
+private:
+  const ClassDecl *m_class = nullptr;
+  std::string m_code;
+
+  // The body of the function being generated, written after its declaration
+  // once the number of locals is known
+  io::JackWriter m_writer;
+  size_t m_numLocals = 0;
+  size_t m_numLabels = 0;
+
+  // The statement just generated left the value of a call on the stack
+  bool m_value = false;
+  // The expression just generated has no value, like that of `return;`
+  bool m_empty = false;
+  // The value of the let statement whose assignee is visited
+  const Node *m_assigned = nullptr;
+
+  void pushConstant(int value);
+  // Push or pop the storage of a variable, the element of an array excluded
+  void pushVariable(const NamedValue &value);
+  void popVariable(const NamedValue &value);
+  void writeCall(const Call &call, const std::string &cls, size_t nArgs);
+
+  // Write the declaration of a function followed by its prologue and body
+  void visitFunction(const FunctionDecl &decl, const std::string &prologue);
+  std::string takeCode();
+};
+
+}  // namespace jcc::ast
+
+#endif /* ast_VMGenerator_hpp */
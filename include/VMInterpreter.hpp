@@ -0,0 +1,124 @@
+#ifndef exec_VMInterpreter_hpp
+#define exec_VMInterpreter_hpp
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace exec {
+
+// Interpreter of the nand2tetris VM code written by the JackWriter, for the
+// programs too short lived to pay for starting the LLVM JIT.
+//
+// The code of each class is assembled into a bytecode of 32 bit words, an
+// opcode followed by its operands, with the segments and the jumps resolved
+// to addresses. The common sequences of the generated code are fused into
+// superinstructions, like a comparison and the branch that tests it, or
+// `i = i + c` on a local. The bytecode is dispatched with computed gotos
+// where the compiler supports them.
+//
+// The memory is that of the Hack platform, 32K words of 16 bits addressed by
+// the pointers of the program: the statics from 16, the stack from 2048 and
+// the heap from 16384. The return addresses and saved segments are kept out
+// of it. The functions of the Jack OS that a program does not define itself
+// are native, see VMInterpreter.cpp for the list.
+//
+// Malformed code is thrown as a SyntaxError, run time errors, Sys.error
+// included, as a std::runtime_error
+class VMInterpreter {
+public:
+  VMInterpreter(std::istream &is, std::ostream &os) : m_is{is}, m_os{os} {}
+
+  // Assemble the code of a class. The file is the class name, which scopes
+  // the static segment, as it does for the VM translator
+  void load(const std::string &code, const std::string &file);
+
+  // Run Sys.init if it was loaded, the entry point otherwise, until it
+  // returns. Returns the value it returned
+  int run(const std::string &entry = "Main.main");
+
+  size_t codeSize() const { return m_code.size(); }
+
+  VMInterpreter(const VMInterpreter &) = delete;
+  VMInterpreter &operator=(const VMInterpreter &) = delete;
+
+private:
+  using Native = int16_t (VMInterpreter::*)(const int16_t *args);
+
+  struct Function {
+    int32_t address = -1;
+    std::string name;
+  };
+
+  struct CallSite {
+    size_t pos;
+    int32_t function;
+    size_t line;
+    std::string file;
+  };
+
+  std::istream &m_is;
+  std::ostream &m_os;
+
+  std::vector<int32_t> m_code;
+  std::vector<Function> m_functions;
+  std::unordered_map<std::string, int32_t> m_functionIds;
+  // Calls resolved once everything is loaded, to a function or a native
+  std::vector<CallSite> m_calls;
+  std::vector<Native> m_natives;
+
+  std::vector<int16_t> m_ram;
+  std::unordered_map<std::string, int32_t> m_staticBases;
+  int32_t m_numStatics = 0;
+  // Free blocks of the heap by size, past the ones never allocated
+  std::unordered_map<int16_t, std::vector<int16_t>> m_free;
+  int32_t m_heapTop = 0;
+
+  int32_t functionId(const std::string &name);
+  void link();
+
+  // The Jack OS
+  int16_t alloc(int32_t size);
+  [[noreturn]] void error(int16_t code);
+  int16_t newString(const std::string &str);
+  void checkAddress(int32_t address, int16_t code);
+
+  int16_t mathMultiply(const int16_t *args);
+  int16_t mathDivide(const int16_t *args);
+  int16_t mathAbs(const int16_t *args);
+  int16_t mathMin(const int16_t *args);
+  int16_t mathMax(const int16_t *args);
+  int16_t mathSqrt(const int16_t *args);
+  int16_t memoryPeek(const int16_t *args);
+  int16_t memoryPoke(const int16_t *args);
+  int16_t memoryAlloc(const int16_t *args);
+  int16_t memoryDeAlloc(const int16_t *args);
+  int16_t stringNew(const int16_t *args);
+  int16_t stringLength(const int16_t *args);
+  int16_t stringCharAt(const int16_t *args);
+  int16_t stringSetCharAt(const int16_t *args);
+  int16_t stringAppendChar(const int16_t *args);
+  int16_t stringEraseLastChar(const int16_t *args);
+  int16_t stringIntValue(const int16_t *args);
+  int16_t stringSetInt(const int16_t *args);
+  int16_t stringNewLine(const int16_t *args);
+  int16_t stringBackSpace(const int16_t *args);
+  int16_t stringDoubleQuote(const int16_t *args);
+  int16_t outputPrintChar(const int16_t *args);
+  int16_t outputPrintString(const int16_t *args);
+  int16_t outputPrintInt(const int16_t *args);
+  int16_t outputPrintln(const int16_t *args);
+  int16_t outputBackSpace(const int16_t *args);
+  int16_t keyboardReadChar(const int16_t *args);
+  int16_t keyboardReadLine(const int16_t *args);
+  int16_t keyboardReadInt(const int16_t *args);
+  int16_t sysHalt(const int16_t *args);
+  int16_t sysError(const int16_t *args);
+  int16_t sysWait(const int16_t *args);
+};
+
+}  // namespace exec
+
+#endif /* exec_VMInterpreter_hpp */
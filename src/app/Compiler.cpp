@@ -4,17 +4,25 @@
 
 #include <cstdio>
 #include <fstream>
+#include <atomic>
 #include <future>
+#include <sstream>
 #include <string>
 #include <thread>
+#include <unordered_map>
 
+#include "ASTCache.hpp"
+#include "BatchServer.hpp"
 #include "CompilationEngine.hpp"
+#include "DependencyGraph.hpp"
 #include "ErrorHandling.hpp"
+#include "FileWatcher.hpp"
 #include "JackAST.hpp"
 #include "JackJIT.hpp"
 #include "LLVMGenerator.hpp"
 #include "PrettyPrinter.hpp"
 #include "Runtime.hpp"
+#include "Statistics.hpp"
 
 namespace {
 using namespace jcc;
@@ -50,12 +58,83 @@ std::vector<std::string> getDirFiles(const std::string &path) {
 
 using ast::NodePtr;
 
-static NodePtr compileFile(const std::string &file) {
+// How the files are parsed, see CompilationEngine
+struct ParseOptions {
+  const io::ASTCache *cache = nullptr;
+  bool deferBodies = false;
+  unsigned threads = 1;
+};
+
+static NodePtr compileFile(const std::string &file,
+                           const ParseOptions &options = {}) {
   printf("Compiling file %s ...\n", file.c_str());
-  auto in = std::make_unique<std::fstream>(file.c_str());
+  const io::ASTCache *cache = options.cache;
+  if (!cache) {
+    auto in = std::make_unique<std::fstream>(file.c_str());
+    jcc::CompilationEngine compEngine{std::move(in), std::string(file)};
+    compEngine.setDeferBodies(options.deferBodies);
+    compEngine.setParseThreads(options.threads);
+    return compEngine.compileClass();
+  }
 
-  jcc::CompilationEngine compEngine{std::move(in), std::string(file)};
-  return compEngine.compileClass();
+  // The source is read once, to be hashed and parsed on a miss
+  std::ostringstream source;
+  source << std::ifstream{file}.rdbuf();
+  if (auto cls = cache->load(source.str())) return cls;
+
+  jcc::CompilationEngine compEngine{
+      std::make_unique<std::istringstream>(source.str()), std::string(file)};
+  compEngine.setParseThreads(options.threads);
+  auto cls = compEngine.compileClass();
+  if (!cache->store(source.str(), *cls)) {
+    fprintf(stderr, "Could not write %s to the AST cache\n", file.c_str());
+  }
+  return cls;
+}
+
+// Run the program on another thread and reload the classes whose file is
+// written in the meantime, until it returns
+int runWatched(Runtime &rt, const std::vector<std::string> &inputs,
+               const ParseOptions &parse) {
+  io::FileWatcher watcher;
+  for (const auto &input : inputs) {
+    std::string dir = input;
+    if (getPathType(input) != PathType::Directory) {
+      const auto slash = input.find_last_of('/');
+      dir = slash == std::string::npos ? "." : input.substr(0, slash);
+    }
+    if (!watcher.add(dir)) {
+      fprintf(stderr, "Could not watch %s\n", dir.c_str());
+    }
+  }
+
+  auto entry = rt.materialize();
+  std::atomic<bool> done{false};
+  int status = 0;
+  std::thread program{[&] {
+    status = rt.run(entry);
+    done = true;
+  }};
+
+  while (!done) {
+    for (const auto &file : watcher.wait(100)) {
+      if (file.size() < 5 || file.compare(file.size() - 5, 5, ".jack") != 0) {
+        continue;
+      }
+      try {
+        NodePtr ast = compileFile(file, parse);
+        rt.reload(std::unique_ptr<ast::ClassDecl>(
+            static_cast<ast::ClassDecl *>(ast.release())));
+        printf("Reloaded %s\n", file.c_str());
+      } catch (const SyntaxError &err) {
+        printf("%s\n", err.what());
+      } catch (const std::runtime_error &err) {
+        printf("Could not reload %s: %s\n", file.c_str(), err.what());
+      }
+    }
+  }
+  program.join();
+  return status;
 }
 
 }  // namespace
@@ -63,16 +142,172 @@ static NodePtr compileFile(const std::string &file) {
 int main(int argc, char *argv[]) {
   using namespace jcc;
   std::vector<std::string> inputs;
-  if (argc < 2) {
+  size_t serverWorkers = 0;
+  bool timeReport = false;
+  bool statsReport = false;
+  bool memReport = false;
+  auto reportFormat = stats::Statistics::Format::Table;
+  RuntimeOptions options;
+  std::string objectFile;
+  std::string vmDir;
+  bool interpret = false;
+  bool incremental = false;
+  bool watch = false;
+  // Only the large classes are split, see CompilationEngine::setParseThreads
+  unsigned parseThreads = std::max(1u, std::thread::hardware_concurrency());
+  std::unique_ptr<io::ASTCache> astCache;
+  std::string profileOut;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];  // NOLINT
+    if (arg == "--time-report" || arg == "--stats") {
+      (arg == "--stats" ? statsReport : timeReport) = true;
+    } else if (arg == "--time-report=json" || arg == "--stats=json") {
+      (arg == "--stats=json" ? statsReport : timeReport) = true;
+      reportFormat = stats::Statistics::Format::JSON;
+    } else if (arg == "--mem-report") {
+      memReport = true;
+    } else if (arg == "--mem-report=json") {
+      memReport = true;
+      reportFormat = stats::Statistics::Format::JSON;
+    } else if (arg == "--perf") {
+      // perf can only unwind through the JIT'd code with frame pointers
+      options.jit.Perf = true;
+      options.jit.FramePointers = true;
+    } else if (arg == "--instrument") {
+      options.instrument = true;
+    } else if (arg == "--no-fold") {
+      options.foldConstants = false;
+    } else if (arg == "--no-inline") {
+      options.inlineCalls = false;
+    } else if (arg == "--no-escape") {
+      options.borrowStrings = false;
+    } else if (arg.rfind("--profile-generate=", 0) == 0) {
+      options.instrument = true;
+      profileOut = arg.substr(19);
+    } else if (arg.rfind("--profile-use=", 0) == 0) {
+      auto profile = instr::Profile::read(arg.substr(14));
+      if (profile.hasError()) {
+        profile.reportError();
+        exit(1);
+      }
+      options.pgo = std::make_shared<instr::Profile>(profile);
+    } else if (arg == "-g") {
+      options.debugInfo = true;
+      options.jit.GDB = true;
+    } else if (arg.rfind("--emit-obj=", 0) == 0) {
+      objectFile = arg.substr(11);
+    } else if (arg == "--vm") {
+      vmDir = ".";
+    } else if (arg.rfind("--vm=", 0) == 0) {
+      vmDir = arg.substr(5);
+    } else if (arg == "--ast-cache") {
+      astCache = std::make_unique<io::ASTCache>(".jcc-cache");
+    } else if (arg.rfind("--ast-cache=", 0) == 0) {
+      astCache = std::make_unique<io::ASTCache>(arg.substr(12));
+    } else if (arg == "--incremental") {
+      incremental = true;
+    } else if (arg.rfind("--parse-threads=", 0) == 0) {
+      parseThreads = std::max(1ul, std::stoul(arg.substr(16)));
+    } else if (arg == "--lazy-parse") {
+      options.lazyBodies = true;
+    } else if (arg == "--watch") {
+      watch = true;
+      options.hotReload = true;
+    } else if (arg == "--interpret") {
+      interpret = true;
+    } else if (arg == "--profile") {
+      options.profile = "profile.folded";
+    } else if (arg.rfind("--profile=", 0) == 0) {
+      options.profile = arg.substr(10);
+    } else if (arg == "--server") {
+      serverWorkers = std::max(1u, std::thread::hardware_concurrency());
+    } else if (arg.rfind("--server=", 0) == 0) {
+      serverWorkers = std::max(1ul, std::stoul(arg.substr(9)));
+    } else {
+      inputs.push_back(arg);
+    }
+  }
+
+  const bool anyReport = timeReport || statsReport || memReport;
+  if (anyReport) stats::Statistics::get().enable();
+  // Print the report on stderr once everything is done so that it does not
+  // mix with the output of the program
+  auto report = [&](int status) {
+    if (anyReport) {
+      stats::Statistics::get().print(std::cerr, reportFormat, timeReport,
+                                     statsReport, memReport);
+    }
+    return status;
+  };
+
+  if (serverWorkers) {
+    // Compile and run jobs read from stdin until it is closed
+    return report(
+        BatchServer(std::cin, std::cout, serverWorkers, options.jit).serve());
+  }
+
+  if (inputs.empty()) {
     printf("Expected using: jcc file1.jack [file2.jack ...]");
-    printf("\n\t\tjcc directory\n");
+    printf("\n\t\tjcc directory");
+    printf("\n\t\tjcc --server[=workers]");
+    printf("\n\toptions: --time-report[=json] --stats[=json] --perf");
+    printf("\n\t         --mem-report[=json]");
+    printf("\n\t         --profile[=file] --instrument -g --emit-obj=file");
+    printf("\n\t         --profile-generate=file --profile-use=file"
+           "\n\t         --no-fold --no-inline --no-escape --vm[=dir]"
+           "\n\t         --interpret --ast-cache[=dir] --incremental --watch"
+           "\n\t         --lazy-parse --parse-threads=n\n");
     exit(1);
-  } else {
-    std::generate_n(std::back_inserter(inputs), argc - 1,
-                    [&, i = 1]() mutable { return argv[i++]; });  // NOLINT
   }
 
-  Runtime rt;
+  if (incremental && vmDir.empty()) {
+    printf("--incremental only applies to the VM code, see --vm\n");
+    exit(1);
+  }
+  if (watch && (!vmDir.empty() || interpret || !objectFile.empty())) {
+    printf("--watch only applies to the programs run by the JIT\n");
+    exit(1);
+  }
+  // The other outputs need every body, and reloading a class needs the
+  // functions that were never called
+  if (options.lazyBodies &&
+      (!vmDir.empty() || interpret || astCache || watch)) {
+    printf("--lazy-parse only applies to the programs run by the JIT\n");
+    exit(1);
+  }
+
+  Runtime rt{std::cin, std::cout, nullptr, options};
+  const ParseOptions parse{astCache.get(), options.lazyBodies, parseThreads};
+
+  // An incremental build skips the files whose class and VM code are up to
+  // date, and rebuilds the classes depending on an interface that changed
+  const std::string graphPath = vmDir + "/jcc.deps";
+  ast::DependencyGraph graph;
+  if (incremental) graph.read(graphPath);
+  const ast::DependencyGraph previous = graph;
+  // The classes depending on a deleted class are rebuilt to report it, and
+  // its VM code is deleted with it
+  for (const auto &cls : graph.removeMissingFiles()) {
+    std::remove((vmDir + '/' + cls + ".vm").c_str());
+  }
+  std::unordered_map<std::string, uint64_t> sourceHashes;
+  auto isUpToDate = [&](const std::string &file) {
+    if (!incremental) return false;
+    std::ostringstream source;
+    source << std::ifstream{file}.rdbuf();
+    const uint64_t hash = io::ASTCache::hash(source.str());
+    sourceHashes[file] = hash;
+    const std::string *cls = graph.findFile(file);
+    return cls && graph.find(*cls)->sourceHash == hash &&
+           getPathType(vmDir + '/' + *cls + ".vm") == PathType::File;
+  };
+  auto addAST = [&](NodePtr ast) {
+    if (incremental) {
+      const auto &cls = static_cast<const ast::ClassDecl &>(*ast);
+      graph.add(cls, sourceHashes[cls.getFile()]);
+    }
+    rt.addAST(std::move(ast));
+  };
 
   std::vector<std::future<Result<NodePtr>>> futs;
   std::vector<std::string> fileList;
@@ -82,16 +317,18 @@ int main(int argc, char *argv[]) {
       type.reportError();
       exit(1);
     } else if (type == PathType::File) {
-      rt.addAST(compileFile(input));
+      if (!isUpToDate(input)) {
+        addAST(compileFile(input, parse));
+      }
     } else if (type == PathType::Directory) {
       printf("Compiling directory %s ...\n", input.c_str());
       fileList = getDirFiles(input);
 
-      auto compileSingle = [](const std::string &fullname) -> Result<NodePtr> {
+      auto compileSingle = [&](const std::string &fullname) -> Result<NodePtr> {
         Result<NodePtr> result{Error("Uninitialized result")};
         try {
           assert(getPathType(fullname) == PathType::File);
-          result = compileFile(fullname);
+          result = compileFile(fullname, parse);
         } catch (const jcc::SyntaxError &err) {
           result = Error(err.what());
         } catch (const std::exception &ex) {
@@ -101,7 +338,8 @@ int main(int argc, char *argv[]) {
       };
 
       for (const auto &file : fileList) {
-        if (file.find(".jack") != std::string::npos) {
+        if (file.find(".jack") != std::string::npos &&
+            !isUpToDate(input + "/" + file)) {
           futs.push_back(std::async(std::launch::async, compileSingle,
                                     input + "/" + file));
         }
@@ -119,21 +357,85 @@ int main(int argc, char *argv[]) {
     auto result = fut.get();
     if (!result.hasError()) {
       NodePtr &ast = result;
-      rt.addAST(std::move(ast));
+      addAST(std::move(ast));
     } else {
       result.reportError();
       hadError = true;
     }
   }
 
+  if (!hadError && incremental) {
+    for (const auto &name : graph.invalidated(previous)) {
+      const std::string file = graph.find(name)->file;
+      sourceHashes[file] = graph.find(name)->sourceHash;
+      try {
+        addAST(compileFile(file, parse));
+      } catch (const SyntaxError &err) {
+        printf("%s\n", err.what());
+        hadError = true;
+      }
+    }
+  }
+
+  if (!hadError && !vmDir.empty()) {
+    printf("Writing the VM code to %s ...\n", vmDir.c_str());
+    try {
+      if (!rt.emitVM(vmDir)) return report(1);
+      if (incremental && !graph.write(graphPath)) {
+        fprintf(stderr, "Could not write %s\n", graphPath.c_str());
+      }
+      return report(0);
+    } catch (const TypeError &err) {
+      printf("%s\n", err.what());
+      return report(1);
+    }
+  }
+
+  if (!hadError && interpret) {
+    printf("Interpreting Main.main ...\n");
+    try {
+      return report(rt.interpret());
+    } catch (const SyntaxError &err) {
+      printf("%s\n", err.what());
+    } catch (const std::runtime_error &err) {
+      printf("Error: %s\n", err.what());
+    }
+    return report(1);
+  }
+
   if (!hadError) {
     // Generate code
-    rt.codegen();
+    try {
+      rt.codegen();
+    } catch (const SyntaxError &err) {
+      printf("%s\n", err.what());
+      return report(1);
+    }
+
+    if (!objectFile.empty()) {
+      printf("Writing %s ...\n", objectFile.c_str());
+      return report(rt.emitObject(objectFile) ? 0 : 1);
+    }
 
     // JIT
     printf("Running Main.main ...\n");
-    return rt.run();
+    int status = 0;
+    try {
+      status = watch ? runWatched(rt, inputs, parse) : rt.run();
+    } catch (const std::runtime_error &err) {
+      printf("Error: %s\n", err.what());
+      return report(1);
+    }
+    if (!profileOut.empty()) {
+      if (!rt.counters().write(profileOut)) {
+        fprintf(stderr, "Could not write the profile to %s\n",
+                profileOut.c_str());
+      }
+    } else if (options.instrument) {
+      rt.counters().print(std::cerr);
+    }
+    return report(status);
   }
 
-  return 1;
+  return report(1);
 }
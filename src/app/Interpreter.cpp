@@ -1 +1,5 @@
-int main(int, char**) { return 0; }
+#include <iostream>
+
+#include "Repl.hpp"
+
+int main(int, char**) { return jcc::Repl(std::cin, std::cout).run(); }
@@ -0,0 +1,81 @@
+#include <sys/stat.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include "ProgramGenerator.hpp"
+
+namespace {
+
+void usage() {
+  printf("Expected using: jackgen [options] directory");
+  printf("\n\toptions: --classes=N --functions=N --statements=N --nesting=N");
+  printf("\n\t         --call-density=P --depth=N --strings=N");
+  printf("\n\t         --string-length=N --seed=N\n");
+}
+
+}  // namespace
+
+// Write a generated Jack program to a directory, one file per class, that can
+// be compiled with jcc
+int main(int argc, char *argv[]) {
+  jcc::gen::ProgramOptions options;
+  std::string outDir;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];  // NOLINT
+    const auto eq = arg.find('=');
+    const auto flag = arg.substr(0, eq);
+    const auto value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+    if (flag.rfind("--", 0) != 0) {
+      outDir = arg;
+      continue;
+    }
+
+    try {
+      if (flag == "--classes") {
+        options.numClasses = std::stoul(value);
+      } else if (flag == "--functions") {
+        options.functionsPerClass = std::stoul(value);
+      } else if (flag == "--statements") {
+        options.statementsPerFunction = std::stoul(value);
+      } else if (flag == "--nesting") {
+        options.maxNesting = std::stoul(value);
+      } else if (flag == "--call-density") {
+        options.callDensity = std::stod(value);
+      } else if (flag == "--depth") {
+        options.expressionDepth = std::stoul(value);
+      } else if (flag == "--strings") {
+        options.stringsPerFunction = std::stoul(value);
+      } else if (flag == "--string-length") {
+        options.stringLength = std::stoul(value);
+      } else if (flag == "--seed") {
+        options.seed = std::stoull(value);
+      } else {
+        printf("Unknown option %s\n", arg.c_str());
+        usage();
+        return 1;
+      }
+    } catch (const std::exception &) {
+      printf("Invalid value for %s\n", flag.c_str());
+      return 1;
+    }
+  }
+
+  if (outDir.empty()) {
+    usage();
+    return 1;
+  }
+
+  mkdir(outDir.c_str(), 0755);
+  for (const auto &[file, source] :
+       jcc::gen::ProgramGenerator(options).generateSources()) {
+    std::ofstream out(outDir + "/" + file);
+    if (!(out << source)) {
+      printf("Error writing %s/%s\n", outDir.c_str(), file.c_str());
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,128 @@
+#include "Counters.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace jcc::instr {
+
+namespace {
+
+// v1 named the statements after their line only
+constexpr auto profileHeader = "# jcc profile v2";
+
+const char *kindName(Counter::Kind kind) {
+  switch (kind) {
+    case Counter::Kind::Function:
+      return "function";
+    case Counter::Kind::Loop:
+      return "loop";
+    case Counter::Kind::Branch:
+      return "branch";
+  }
+  return "";
+}
+
+}  // namespace
+
+Counter &CounterTable::add(std::string name, Counter::Kind kind,
+                           unsigned line) {
+  auto [it, inserted] = m_index.emplace(name, nullptr);
+  if (inserted) {
+    m_counters.push_back({std::move(name), kind, line});
+    it->second = &m_counters.back();
+  }
+  assert(it->second->kind == kind && "Counters of different kinds collide");
+  return *it->second;
+}
+
+const Counter *CounterTable::find(const std::string &name) const {
+  auto it = m_index.find(name);
+  return it != m_index.end() ? it->second : nullptr;
+}
+
+std::vector<const Counter *> CounterTable::sorted() const {
+  std::vector<const Counter *> counters;
+  counters.reserve(m_counters.size());
+  for (const auto &counter : m_counters) { counters.push_back(&counter); }
+  std::stable_sort(counters.begin(), counters.end(),
+                   [](const Counter *lhs, const Counter *rhs) {
+                     return lhs->count > rhs->count;
+                   });
+  return counters;
+}
+
+void CounterTable::print(std::ostream &os) const {
+  char line[160];
+  const char *rule =
+      "===--------------------------------------------------------------===\n";
+  os << rule << "  jcc execution counts\n" << rule;
+  snprintf(line, sizeof(line), "%16s  %-8s %s\n", "Count", "Kind", "Counter");
+  os << line;
+  for (const auto *counter : sorted()) {
+    if (counter->count == 0) break;
+    snprintf(line, sizeof(line), "%16llu  %-8s %s\n",
+             static_cast<unsigned long long>(counter->count),
+             kindName(counter->kind), counter->name.c_str());
+    os << line;
+  }
+}
+
+void CounterTable::write(std::ostream &os) const {
+  os << profileHeader << '\n';
+  for (const auto &counter : m_counters) {
+    os << kindName(counter.kind) << ' ' << counter.count << ' '
+       << counter.name << '\n';
+  }
+}
+
+bool CounterTable::write(const std::string &path) const {
+  std::ofstream out(path);
+  write(out);
+  return static_cast<bool>(out);
+}
+
+Result<Profile> Profile::read(std::istream &is) {
+  std::string line;
+  if (!std::getline(is, line) || line != profileHeader) {
+    return Error("Not a jcc profile");
+  }
+
+  Profile profile;
+  unsigned lineNum = 1;
+  while (std::getline(is, line)) {
+    ++lineNum;
+    if (line.empty()) continue;
+
+    std::istringstream fields(line);
+    std::string kind, name;
+    uint64_t count = 0;
+    if (!(fields >> kind >> count >> name)) {
+      return Error("Malformed profile line " + std::to_string(lineNum));
+    }
+
+    if (!profile.m_counts.emplace(name, count).second) {
+      return Error("Duplicate counter " + name + " at profile line " +
+                   std::to_string(lineNum));
+    }
+    if (kind == kindName(Counter::Kind::Function)) {
+      profile.m_maxFunctionCount = std::max(profile.m_maxFunctionCount, count);
+    }
+  }
+  return profile;
+}
+
+Result<Profile> Profile::read(const std::string &path) {
+  std::ifstream in(path);
+  if (!in) return Error("Cannot open profile " + path);
+  return read(in);
+}
+
+std::optional<uint64_t> Profile::count(const std::string &name) const {
+  auto it = m_counts.find(name);
+  if (it == m_counts.end()) return std::nullopt;
+  return it->second;
+}
+
+}  // namespace jcc::instr
@@ -3,8 +3,13 @@
 #include "LLVMGenerator.hpp"
 
 #include "NameMangling.hpp"
+#include "Statistics.hpp"
+#include "llvm/BinaryFormat/Dwarf.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/MDBuilder.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 
 namespace {
@@ -28,20 +33,50 @@ llvm::APInt Char(T c) {
 namespace jcc::ast {
 
 llvm::Function *LLVMGenerator::getLLVMFunction(const std::string &cls,
-                                               const std::string &fname) const {
-  return module()->getFunction(builtin::generateName(cls, fname));
+                                               const std::string &fname) {
+  const auto name = builtin::generateName(cls, fname);
+  llvm::Function *funcI = module()->getFunction(name);
+  if (!funcI) {
+    // Declare the function if it was defined by a previous module
+    auto external = m_ExternalFunctions.find(name);
+    if (external != m_ExternalFunctions.end()) {
+      funcI = llvm::Function::Create(external->second,
+                                     llvm::Function::ExternalLinkage, name,
+                                     module());
+    }
+  }
+  return funcI;
 }
 
-std::string LLVMGenerator::mangleFunction(const FunctionDecl &f) const {
-  return builtin::generateName(m_class->getName(), f.getName());
+std::unique_ptr<llvm::Module> LLVMGenerator::moveModule() {
+  if (m_module) {
+    for (auto &F : m_module->functions()) {
+      if (!F.isDeclaration()) {
+        m_ExternalFunctions[F.getName().str()] = F.getFunctionType();
+      }
+    }
+    for (auto &G : m_module->globals()) {
+      if (!G.isDeclaration()) {
+        m_ExternalGlobals[G.getName().str()] = G.getValueType();
+      }
+    }
+  }
+  return std::move(m_module);
+}
+
+std::string LLVMGenerator::mangleFunction(const std::string &fname) const {
+  return builtin::generateName(m_className, fname);
 }
 
 std::string LLVMGenerator::mangleStatic(const std::string &varName) const {
-  return builtin::generateName(m_class->getName(), varName);
+  return builtin::generateName(m_className, varName);
 }
 
 llvm::Value *LLVMGenerator::codegen(Node &node) {
-  node.accept(*this);
+  const FlatAST flat = FlatAST::build(node);
+  m_ast = &flat;
+  visit(0);
+  m_ast = nullptr;
 
   auto ReplaceAllUsesWith_Unsafe = [&](llvm::Function *from,
                                        llvm::Function *to) {
@@ -51,35 +86,87 @@ llvm::Value *LLVMGenerator::codegen(Node &node) {
     while (!from->use_empty()) {
       auto &U = *from->use_begin();
       auto *C = llvm::cast<llvm::CallInst>(U.getUser());
-      auto OldRetTy = C->getFunctionType()->getReturnType();
-      auto NewRetTy = to->getFunctionType()->getReturnType();
+      // The placeholder was created with the return type resolved by the
+      // TypeChecker, so the uses of the call stay valid
+      assert(C->getFunctionType()->getReturnType() ==
+                 to->getFunctionType()->getReturnType() &&
+             "Call with a mistyped return value");
       C->mutateFunctionType(to->getFunctionType());
       C->setCalledFunction(to);
-      if (OldRetTy != NewRetTy) {
-        // If the types are not the same, perform a sign ext/trunc to
-        // match the old type since that type was chosen based on the
-        // surrounding IR
-        const auto &uses = C->uses();
-        builder().SetInsertPoint(C->getNextNode());
-        auto Ext = builder().CreateSExtOrTrunc(C, OldRetTy);
-        for (auto &use : uses) { use.set(Ext); }
-      }
     }
     from->eraseFromParent();
   };
 
   // Generate code for the unresolved symbols
   for (auto &unresolved : m_unresolved) {
-    // Ideally we would use replaceAllUsesWith but if there is a return type
+    // Ideally we would use replaceAllUsesWith but if there is a parameter type
     // mismatch we will error. Therefore, we use the above unsafe version
     // that still checks the number of arguments
     // unresolved.ToReplace->replaceAllUsesWith(unresolved.ReplaceWith(*this));
     ReplaceAllUsesWith_Unsafe(unresolved.ToReplace,
                               unresolved.ReplaceWith(*this));
   }
+
+  // The placeholders have been erased, they must not be resolved again by the
+  // next call
+  m_unresolved.clear();
+  if (m_patchable) patchCalls();
   return m_last;
 }
 
+void LLVMGenerator::patchCalls() {
+  std::vector<llvm::CallInst *> calls;
+  for (auto &F : *module()) {
+    if (!F.isDeclaration() && m_jackFunctions.count(F.getName().str())) {
+      callSlot(F);
+    }
+    for (auto &BB : F) {
+      for (auto &I : BB) {
+        auto *call = llvm::dyn_cast<llvm::CallInst>(&I);
+        auto *callee = call ? call->getCalledFunction() : nullptr;
+        if (callee && m_jackFunctions.count(callee->getName().str())) {
+          calls.push_back(call);
+        }
+      }
+    }
+  }
+
+  for (auto *call : calls) {
+    builder().SetInsertPoint(call);
+    auto *callee =
+        builder().CreateLoad(callSlot(*call->getCalledFunction()), "callee");
+    call->setCalledFunction(call->getFunctionType(), callee);
+  }
+}
+
+llvm::GlobalVariable *LLVMGenerator::callSlot(llvm::Function &callee) {
+  const auto name = callee.getName().str() + ".slot";
+  llvm::GlobalVariable *slot = module()->getNamedGlobal(name);
+  if (!slot) {
+    slot = new llvm::GlobalVariable(*module(), callee.getType(), false,
+                                    llvm::GlobalValue::ExternalLinkage,
+                                    nullptr, name);
+  }
+  // The slot is defined with its function, the other modules declare it
+  if (!callee.isDeclaration() && !slot->hasInitializer()) {
+    slot->setInitializer(&callee);
+  }
+  return slot;
+}
+
+llvm::Value *LLVMGenerator::codegen(ClassDecl &cls, FunctionDecl &fcn) {
+  m_className = cls.getName();
+  m_numStatics = cls.numStatics();
+  return codegen(fcn);
+}
+
+llvm::GlobalVariable *LLVMGenerator::codegenStatic(ClassDecl &cls,
+                                                   VarDecl &var) {
+  m_className = cls.getName();
+  m_numStatics = cls.numStatics();
+  return defineStatic(var.getName(), var.getType(), var.getLocation().line);
+}
+
 llvm::Type *LLVMGenerator::getTypeByName(const std::string &name) {
   llvm::Type *varT = nullptr;
   if (name == "int") {
@@ -100,84 +187,182 @@ llvm::Type *LLVMGenerator::getTypeByName(const std::string &name) {
   return varT;
 }
 
-llvm::Value *LLVMGenerator::findIdentifier(const std::string &name) {
-  auto itr = m_ScopedValueTable.find(name);
-  llvm::Value *found = itr != m_ScopedValueTable.end() ? itr->second : nullptr;
+llvm::Type *LLVMGenerator::getType(const ExprType &type) {
+  switch (type.kind) {
+    case ExprType::Kind::Int:
+      return builder().getInt32Ty();
+    case ExprType::Kind::Char:
+      return builder().getInt8Ty();
+    case ExprType::Kind::Boolean:
+      return builder().getInt1Ty();
+    case ExprType::Kind::Void:
+      return builder().getVoidTy();
+    case ExprType::Kind::Class:
+      return getTypeByName(type.name);
+    case ExprType::Kind::Unknown:
+      break;
+  }
+  assert(false && "The AST was not type checked");
+  return nullptr;
+}
 
-  if (!found) {
-    // Check class for member
+llvm::Value *LLVMGenerator::convert(llvm::Value *value, const ExprType &from,
+                                    const ExprType &to) {
+  assert(from.isKnown() && "The AST was not type checked");
+  if (!value || from.kind == to.kind || !from.isInteger() ||
+      !to.isInteger()) {
+    return value;
+  }
+  return builder().CreateSExtOrTrunc(value, getType(to));
+}
+
+void LLVMGenerator::convertArguments(llvm::Function *funcI,
+                                     const Index *arg,
+                                     std::vector<llvm::Value *> &argIs,
+                                     size_t first) {
+  // A call with the wrong number of arguments is rejected by the verifier
+  if (funcI->arg_size() != argIs.size()) return;
+  for (size_t i = first; i < argIs.size(); ++i, ++arg) {
+    llvm::Type *paramT = funcI->getArg(i)->getType();
+    if (m_ast->exprType(*arg).isInteger() && paramT->isIntegerTy() &&
+        argIs[i]->getType() != paramT) {
+      argIs[i] = builder().CreateSExtOrTrunc(argIs[i], paramT);
+    }
+  }
+}
 
-    auto thisItr = m_ScopedValueTable.find("this");
-    if (thisItr != m_ScopedValueTable.end()) {
-      llvm::Value *thisPtr = thisItr->second;
-      auto index = m_class->getFieldIdx(name);
-      if (index <
-          std::distance(m_class->fields_begin(), m_class->fields_end())) {
-        found = builder().CreateInBoundsGEP(
-            thisPtr, {builder().getInt32(0), builder().getInt32(index)});
-      }
+llvm::Value *LLVMGenerator::findVariable(Index value) {
+  const Slot slot = m_ast->slot(value);
+  switch (slot.kind) {
+    case sym::Kind::ARG:
+      return m_args[slot.index];
+    case sym::Kind::VAR:
+      return m_locals[slot.index];
+    case sym::Kind::FIELD: {
+      // The object is the last child of the variable
+      llvm::Value *object =
+          m_ast->hasOptional(value)
+              ? findVariable(m_ast->child(value, m_ast->numChildren(value) - 1))
+              : m_this;
+      assert(object && "Field used outside of a method or constructor");
+      return builder().CreateInBoundsGEP(
+          object, {builder().getInt32(0), builder().getInt32(slot.index)});
     }
-    if (!found) {
-      // Check class for static
-      found = module()->getGlobalVariable(mangleStatic(name));
+    case sym::Kind::STATIC: {
+      auto &varI = m_statics[slot.index];
+      if (!varI) varI = findStatic(m_ast->name(value));
+      return varI;
     }
+    default:
+      assert(false && "Unresolved variable found in backend");
+      return nullptr;
   }
-
-  return found;
 }
 
-void LLVMGenerator::visit(IntConst &i) {
-  m_last = builder().getInt32(i.getInt());
-  m_ExpType = m_last->getType();
+llvm::GlobalVariable *LLVMGenerator::findStatic(const std::string &name) {
+  const auto staticName = mangleStatic(name);
+  llvm::GlobalVariable *varI = module()->getGlobalVariable(staticName);
+  if (!varI) {
+    // Declare the static if it was defined by a previous module
+    auto external = m_ExternalGlobals.find(staticName);
+    if (external != m_ExternalGlobals.end()) {
+      varI = new llvm::GlobalVariable(
+          *module(), external->second, false,
+          llvm::GlobalValue::ExternalLinkage, nullptr, staticName);
+    }
+  }
+  return varI;
+}
+
+llvm::GlobalVariable *LLVMGenerator::defineStatic(const std::string &name,
+                                                  const std::string &type,
+                                                  unsigned line) {
+  llvm::Type *varT = getTypeByName(type);
+  const auto staticName = mangleStatic(name);
+  module()->getOrInsertGlobal(staticName, varT);
+  llvm::GlobalVariable *varI = module()->getNamedGlobal(staticName);
+  varI->setInitializer(llvm::Constant::getNullValue(varT));
+  if (m_di) {
+    varI->addDebugInfo(m_di->createGlobalVariableExpression(
+        m_diClass, name, staticName, m_diFile, line, getDIType(type), false));
+  }
+  return varI;
 }
 
-void LLVMGenerator::visit(CharConst &c) {
-  m_last = builder().getInt8(c.getChar());
-  m_ExpType = m_last->getType();
+void LLVMGenerator::visitInt(Index i) {
+  m_last = builder().getInt32(m_ast->value(i));
 }
 
-void LLVMGenerator::visit(This &) {
-  auto thisItr = m_ScopedValueTable.find("this");
-  assert(thisItr != m_ScopedValueTable.end());
-  m_last = thisItr->second;
-  m_ExpType = builder().getVoidTy();
+void LLVMGenerator::visitChar(Index c) {
+  m_last = builder().getInt8(m_ast->value(c));
 }
 
-void LLVMGenerator::visit(True &) {
-  m_last = builder().getTrue();
-  m_ExpType = m_last->getType();
+void LLVMGenerator::visitThis(Index) {
+  assert(m_this);
+  m_last = m_this;
 }
 
-void LLVMGenerator::visit(False &) {
-  m_last = builder().getFalse();
-  m_ExpType = m_last->getType();
-}
+void LLVMGenerator::visitTrue(Index) { m_last = builder().getTrue(); }
 
-void LLVMGenerator::visit(Identifier &ident) {
-  auto found = findIdentifier(ident.getName());
+void LLVMGenerator::visitFalse(Index) { m_last = builder().getFalse(); }
 
-  // This should be handled in the frontend and we should never not find an
-  // identifier
-  assert(found && "Undefined identifier fouond in backend");
+void LLVMGenerator::visitIdentifier(Index ident) {
+  auto found = findVariable(ident);
+  assert(found && "Undefined identifier found in backend");
   m_last = found;
-  m_ExpType =
-      llvm::cast<llvm::PointerType>(m_last->getType())->getElementType();
 }
 
-void LLVMGenerator::visit(StrConst &str) {
-  auto charPtr = builder().CreateGlobalStringPtr(str.getString());
+void LLVMGenerator::visitStr(Index str) {
+  if (m_ast->isBorrowed(str)) {
+    m_last = borrowedString(m_ast->name(str));
+    return;
+  }
+  auto charPtr = builder().CreateGlobalStringPtr(m_ast->name(str));
   auto strPtr = builder().CreateAlloca(module()->getTypeByName("String"));
   builder().CreateStore(
       builder().CreateCall(getLLVMFunction("String", "ptrtostr"), charPtr),
       strPtr);
   m_last = builder().CreateLoad(strPtr);
-  m_ExpType = m_last->getType();
 }
 
-void LLVMGenerator::visit(BinaryOp &binop) {
-  llvm::Value *lhs = codegenChild(*binop.getLHS());
-  llvm::Value *rhs = codegenChild(*binop.getRHS());
-  switch (binop.getOp()) {
+llvm::Value *LLVMGenerator::borrowedString(const std::string &str) {
+  llvm::Type *strT = module()->getTypeByName("String");
+  auto &strI = m_strings[str];
+  if (!strI) {
+    strI = new llvm::GlobalVariable(*module(), strT, false,
+                                    llvm::GlobalValue::PrivateLinkage,
+                                    llvm::Constant::getNullValue(strT), "str");
+  }
+
+  // The String is created the first time the literal is evaluated
+  llvm::Function *funcI = builder().GetInsertBlock()->getParent();
+  llvm::BasicBlock *initBB =
+      llvm::BasicBlock::Create(context(), "str.init", funcI);
+  llvm::BasicBlock *contBB =
+      llvm::BasicBlock::Create(context(), "str.cont", funcI);
+  llvm::Value *impl =
+      builder().CreateExtractValue(builder().CreateLoad(strI), 0);
+  builder().CreateCondBr(builder().CreateIsNull(impl), initBB, contBB);
+
+  builder().SetInsertPoint(initBB);
+  builder().CreateStore(
+      builder().CreateCall(getLLVMFunction("String", "ptrtostr"),
+                           builder().CreateGlobalStringPtr(str)),
+      strI);
+  builder().CreateBr(contBB);
+
+  builder().SetInsertPoint(contBB);
+  return builder().CreateLoad(strI);
+}
+
+void LLVMGenerator::visitBinary(Index binop) {
+  // chars are promoted to int, booleans are used as they are
+  const ExprType Int{ExprType::Kind::Int};
+  const Index lhsN = m_ast->child(binop, 0);
+  const Index rhsN = m_ast->child(binop, 1);
+  llvm::Value *lhs = convert(codegenChild(lhsN), m_ast->exprType(lhsN), Int);
+  llvm::Value *rhs = convert(codegenChild(rhsN), m_ast->exprType(rhsN), Int);
+  switch (m_ast->op(binop)) {
     case '+':
       m_last = builder().CreateAdd(lhs, rhs, "tmpadd");
       break;
@@ -209,12 +394,14 @@ void LLVMGenerator::visit(BinaryOp &binop) {
       assert(false && "Unsupported binary operator");
       m_last = nullptr;
   }
-  m_ExpType = m_last->getType();
 }
 
-void LLVMGenerator::visit(UnaryOp &unop) {
-  llvm::Value *operand = codegenChild(*unop.getOperand());
-  switch (unop.getOp()) {
+void LLVMGenerator::visitUnary(Index unop) {
+  const Index operandN = m_ast->child(unop, 0);
+  llvm::Value *operand = convert(codegenChild(operandN),
+                                 m_ast->exprType(operandN),
+                                 ExprType::Kind::Int);
+  switch (m_ast->op(unop)) {
     case '-':
       m_last = builder().CreateNeg(operand, "tmpneg");
       break;
@@ -225,25 +412,28 @@ void LLVMGenerator::visit(UnaryOp &unop) {
       assert(false && "Unsupported Unary operator");
       m_last = nullptr;
   }
-  m_ExpType = m_last->getType();
 }
 
-void LLVMGenerator::visit(FunctionCall &call) {
-  auto RetTy = m_ExpType;
-  llvm::Function *funcI = getLLVMFunction(call.getClassType(), call.getName());
+void LLVMGenerator::visitFunctionCall(Index call) {
+  auto RetTy = getType(m_ast->exprType(call));
+  llvm::Function *funcI =
+      getLLVMFunction(m_ast->type(call), m_ast->name(call));
 
   std::vector<llvm::Value *> argIs;
-  std::transform(call.args_begin(), call.args_end(), std::back_inserter(argIs),
-                 [&](auto &arg) { return codegenChild(*arg); });
+  std::transform(m_ast->children_begin(call), m_ast->children_end(call),
+                 std::back_inserter(argIs),
+                 [&](Index arg) { return codegenChild(arg); });
+  if (funcI) convertArguments(funcI, m_ast->children_begin(call), argIs, 0);
 
-  auto resolve = [&call](LLVMGenerator &g) {
-    llvm::Function *funcI =
-        g.getLLVMFunction(call.getClassType(), call.getName());
+  // Resolved after the tree was generated, the names are kept by value
+  auto resolve = [classTStr = m_ast->type(call),
+                  name = m_ast->name(call)](LLVMGenerator &g) {
+    llvm::Function *funcI = g.getLLVMFunction(classTStr, name);
 
     if (!funcI) {
       // Even after parsing everything, the method still does not exist.
       // Throw an error and exit. This is an internal error for now
-      llvm::errs() << "Missing " << call.getName() << '\n';
+      llvm::errs() << "Missing " << name << '\n';
       g.InternalError(nullptr);
     }
     return funcI;
@@ -260,39 +450,43 @@ void LLVMGenerator::visit(FunctionCall &call) {
   }
 }
 
-void LLVMGenerator::visit(MethodCall &call) {
-  auto RetTy = m_ExpType;
+void LLVMGenerator::visitMethodCall(Index call) {
+  auto RetTy = getType(m_ast->exprType(call));
   std::string classTStr;
   llvm::Value *CalleeV = nullptr;
 
-  if (!call.getCallee()) {
+  // The callee comes before the arguments
+  const Index *args = m_ast->children_begin(call);
+  if (!m_ast->hasOptional(call)) {
     // Method call from same class
-    classTStr = m_class->getName();
+    classTStr = m_className;
     CalleeV = builder().GetInsertBlock()->getParent()->getArg(0);
   } else {
     // Method call on an object callee
-    classTStr = call.getCallee()->getType();
-    CalleeV = builder().CreateLoad(codegenChild(*call.getCallee()));
+    const Index callee = *args++;
+    classTStr = m_ast->exprType(callee).name;
+    CalleeV = builder().CreateLoad(codegenChild(callee));
   }
 
   // add this to the argument list
   std::vector<llvm::Value *> argIs;
   argIs.push_back(CalleeV);
-  std::transform(call.args_begin(), call.args_end(), std::back_inserter(argIs),
-                 [&](auto &arg) { return codegenChild(*arg); });
+  std::transform(args, m_ast->children_end(call), std::back_inserter(argIs),
+                 [&](Index arg) { return codegenChild(arg); });
 
-  auto resolve = [&call, classTStr](LLVMGenerator &g) {
-    llvm::Function *funcI = g.getLLVMFunction(classTStr, call.getName());
+  auto resolve = [classTStr, name = m_ast->name(call)](LLVMGenerator &g) {
+    llvm::Function *funcI = g.getLLVMFunction(classTStr, name);
 
     if (!funcI) {
-      llvm::errs() << "Missing " << call.getName() << '\n';
+      llvm::errs() << "Missing " << name << '\n';
       g.InternalError(nullptr);
     }
 
     return funcI;
   };
 
-  llvm::Function *funcI = getLLVMFunction(classTStr, call.getName());
+  llvm::Function *funcI = getLLVMFunction(classTStr, m_ast->name(call));
+  if (funcI) convertArguments(funcI, args, argIs, 1);
 
   if (!funcI) {
     // We could not resolve the symbol, try again once we parse and generate
@@ -305,50 +499,71 @@ void LLVMGenerator::visit(MethodCall &call) {
   }
 }
 
-void LLVMGenerator::visit(LetStmt &let) {
-  llvm::Value *LHS = codegenChild(*let.getAssignee());
+void LLVMGenerator::visitLet(Index let) {
+  const Index assignee = m_ast->child(let, 0);
+  const Index expression = m_ast->child(let, 1);
+  llvm::Value *LHS = codegenChild(assignee);
   assert(llvm::isa<llvm::PointerType>(LHS->getType()));
-  llvm::Value *RHS = codegenChild(*let.getExpression());
+  llvm::Value *RHS = convert(codegenChild(expression),
+                             m_ast->exprType(expression),
+                             m_ast->exprType(assignee));
   m_last = builder().CreateStore(RHS, LHS);
-  m_ExpType = m_last->getType();
 }
 
 // For now, create a default version of thet type specified in the var expr.
 // We can then use getType() to find the type in thet class
-void LLVMGenerator::visit(VarDecl &decl) {
-  llvm::Type *VarT = getTypeByName(decl.getType());
-  m_last = builder().CreateAlloca(VarT, nullptr, decl.getName());
-  m_ScopedValueTable.insert({decl.getName(), m_last});
-  m_ExpType = builder().getVoidTy();
-}
+void LLVMGenerator::visitVar(Index decl) {
+  llvm::Type *VarT = getTypeByName(m_ast->type(decl));
+  m_last = builder().CreateAlloca(VarT, nullptr, m_ast->name(decl));
+  const auto index = m_ast->slot(decl).index;
+  if (m_locals.size() <= index) m_locals.resize(index + 1);
+  m_locals[index] = m_last;
+  if (m_di) declareVariable(decl, m_last, 0);
+}
+
+void LLVMGenerator::visitIf(Index stmt) {
+  if (m_counters) {
+    incrementCounter(stmt, ":entry", instr::Counter::Kind::Branch);
+  }
 
-void LLVMGenerator::visit(IfStmt &stmt) {
   llvm::BasicBlock *preBB = builder().GetInsertBlock();
   llvm::Function *funcI = preBB->getParent();
-  llvm::Value *condV = builder().CreateICmpEQ(codegenChild(*stmt.getCond()),
-                                              builder().getTrue(), "ifcond");
+  llvm::Value *condV = builder().CreateICmpEQ(
+      codegenChild(m_ast->child(stmt, 0)), builder().getTrue(), "ifcond");
   llvm::BasicBlock *thenBB = llvm::BasicBlock::Create(context(), "then", funcI);
 
   llvm::BasicBlock *contBB =
       llvm::BasicBlock::Create(context(), "ifcont", funcI);
 
-  // FIXME: Not sure how I was using this before
-  // llvm::BranchInst *preBranch = nullptr;
-  if (stmt.getElseBlock()) {
+  llvm::BranchInst *preBranch = nullptr;
+  if (m_ast->hasOptional(stmt)) {
     llvm::BasicBlock *elseBB =
         llvm::BasicBlock::Create(context(), "else", funcI);
-    /* preBranch = */ builder().CreateCondBr(condV, thenBB, elseBB);
+    preBranch = builder().CreateCondBr(condV, thenBB, elseBB);
 
     builder().SetInsertPoint(elseBB);
-    if (!llvm::isa<llvm::ReturnInst>(codegenChild(*stmt.getElseBlock()))) {
+    if (!llvm::isa<llvm::ReturnInst>(codegenChild(m_ast->child(stmt, 2)))) {
       builder().CreateBr(contBB);
     }
   } else {
-    /* preBranch = */ builder().CreateCondBr(condV, thenBB, contBB);
+    preBranch = builder().CreateCondBr(condV, thenBB, contBB);
+  }
+
+  if (m_profile) {
+    // The else side is taken whenever the statement runs and the then branch
+    // does not
+    auto entries = profileCount(counterName(stmt, ":entry"));
+    auto taken = profileCount(counterName(stmt, ":then"));
+    if (entries && taken && *taken <= *entries) {
+      setBranchWeights(preBranch, *taken, *entries - *taken);
+    }
   }
 
   builder().SetInsertPoint(thenBB);
-  if (!llvm::isa<llvm::ReturnInst>(codegenChild(*stmt.getIfBlock()))) {
+  if (m_counters) {
+    incrementCounter(stmt, ":then", instr::Counter::Kind::Branch);
+  }
+  if (!llvm::isa<llvm::ReturnInst>(codegenChild(m_ast->child(stmt, 1)))) {
     builder().CreateBr(contBB);
   }
 
@@ -367,18 +582,20 @@ void LLVMGenerator::visit(IfStmt &stmt) {
   // thenBB = builder().GetInsertBlock();
 
   builder().SetInsertPoint(contBB);
-  m_ExpType = builder().getVoidTy();
 }
 
-void LLVMGenerator::visit(WhileStmt &stmt) {
+void LLVMGenerator::visitWhile(Index stmt) {
   llvm::Function *funcI = builder().GetInsertBlock()->getParent();
+  if (m_counters) {
+    incrementCounter(stmt, ":entry", instr::Counter::Kind::Branch);
+  }
 
   llvm::BasicBlock *preHeaderBB =
       llvm::BasicBlock::Create(context(), "preheader", funcI);
   builder().CreateBr(preHeaderBB);
   builder().SetInsertPoint(preHeaderBB);
 
-  llvm::Value *condV = codegenChild(*stmt.getCond());
+  llvm::Value *condV = codegenChild(m_ast->child(stmt, 0));
   llvm::Value *whileV =
       builder().CreateICmpEQ(condV, builder().getTrue(), "whilecond");
 
@@ -386,56 +603,191 @@ void LLVMGenerator::visit(WhileStmt &stmt) {
   llvm::BasicBlock *contBB =
       llvm::BasicBlock::Create(context(), "endloop", funcI);
 
-  builder().CreateCondBr(whileV, loopBB, contBB);
+  llvm::BranchInst *loopBranch =
+      builder().CreateCondBr(whileV, loopBB, contBB);
+  if (m_profile) {
+    // Every time the loop runs it exits once, and it iterates once per
+    // backedge
+    auto entries = profileCount(counterName(stmt, ":entry"));
+    auto iterations = profileCount(counterName(stmt, ""));
+    if (entries && iterations) {
+      setBranchWeights(loopBranch, *iterations, *entries);
+    }
+  }
+
   builder().SetInsertPoint(loopBB);
-  codegenChild(*stmt.getBlock());  // TODO(matt): need to get the second use
-                                   // of the identifier in the conditional
+  // TODO(matt): need to get the second use of the identifier in the
+  // conditional
+  codegenChild(m_ast->child(stmt, 1));
+  if (m_counters) incrementCounter(stmt, "", instr::Counter::Kind::Loop);
   builder().CreateBr(preHeaderBB);
 
   builder().SetInsertPoint(contBB);
-  m_ExpType = builder().getVoidTy();
 }
 
-void LLVMGenerator::visit(ReturnStmt &stmt) {
-  m_ExpType = builder().GetInsertBlock()->getParent()->getReturnType();
-  llvm::Value *Expr = codegenChild(*stmt.getExpr());
-  m_ExpType = builder().GetInsertBlock()->getParent()->getReturnType();
-  if (Expr && Expr->getType() != m_ExpType &&
-      llvm::isa<llvm::IntegerType>(Expr->getType()) &&
-      llvm::isa<llvm::IntegerType>(m_ExpType)) {
-    Expr = builder().CreateSExtOrTrunc(Expr, m_ExpType);
-  }
+void LLVMGenerator::visitReturn(Index stmt) {
+  const Index expr = m_ast->child(stmt, 0);
+  llvm::Value *Expr =
+      convert(codegenChild(expr), m_ast->exprType(expr), m_returnType);
   m_last = builder().CreateRet(Expr);
-  m_ExpType = builder().getVoidTy();
 }
 
-void LLVMGenerator::visit(ClassDecl &cls) {
-  m_class = &cls;
+void LLVMGenerator::visitClass(Index cls) {
+  stats::ScopedTimer timer("codegen", m_ast->name(cls));
+  m_className = m_ast->name(cls);
+  if (m_debugInfo) beginDebugInfo(cls);
 
-  std::vector<llvm::Type *> memTs;
-  memTs.reserve(cls.numFields());
+  // The members are the fields, the statics, the functions and the methods
+  auto isVar = [&](Index member, sym::Kind kind) {
+    return m_ast->kind(member) == FlatAST::Kind::Var &&
+           m_ast->value(member) == static_cast<int32_t>(kind);
+  };
+  const Index *begin = m_ast->children_begin(cls);
+  const Index *end = m_ast->children_end(cls);
 
-  std::transform(cls.fields_begin(), cls.fields_end(),
-                 std::back_inserter(memTs),
-                 [&](const auto &f) { return getTypeByName(f->getType()); });
+  std::vector<llvm::Type *> memTs;
+  for (auto it = begin; it != end; ++it) {
+    if (isVar(*it, sym::Kind::FIELD)) {
+      memTs.push_back(getTypeByName(m_ast->type(*it)));
+    }
+  }
 
   // define this class type for use in methods and statics
-  llvm::StructType::create(context(), memTs, cls.getName());
+  llvm::StructType::create(context(), memTs, m_className);
+
+  // define the static variables of the class globally. A class defined again
+  // keeps the statics of its previous definition, and their values
+  m_numStatics = 0;
+  for (auto it = begin; it != end; ++it) {
+    if (!isVar(*it, sym::Kind::STATIC)) continue;
+    ++m_numStatics;
+    const auto &name = m_ast->name(*it);
+    if (!m_ExternalGlobals.count(mangleStatic(name))) {
+      defineStatic(name, m_ast->type(*it), m_ast->location(*it).line);
+    }
+  }
 
-  // define the static variables of the class globally
-  std::for_each(cls.statics_begin(), cls.statics_end(), [&](auto &s) {
-    llvm::Type *varT = getTypeByName(s->getType());
-    const auto staticName = mangleStatic(s->getName());
-    module()->getOrInsertGlobal(staticName, varT);
-    // llvm::GlobalVariable *varI = module()->getNamedGlobal(staticName);
-    // varI->setInitializer(
-    //     llvm::Constant::getIntegerValue(varT, ::ir::Int(0)));
-  });
+  for (auto it = begin; it != end; ++it) {
+    if (m_ast->kind(*it) == FlatAST::Kind::Method) visit(*it);
+  }
+  for (auto it = begin; it != end; ++it) {
+    if (m_ast->kind(*it) == FlatAST::Kind::Static ||
+        m_ast->kind(*it) == FlatAST::Kind::Constructor) {
+      visit(*it);
+    }
+  }
+
+  if (m_di) endDebugInfo();
+}
+
+void LLVMGenerator::beginDebugInfo(Index cls) {
+  if (!module()->getModuleFlag("Debug Info Version")) {
+    module()->addModuleFlag(llvm::Module::Warning, "Debug Info Version",
+                            llvm::DEBUG_METADATA_VERSION);
+    module()->addModuleFlag(llvm::Module::Warning, "Dwarf Version", 4);
+  }
+
+  // Debuggers find the source from the absolute path of the file
+  const auto &file = m_ast->type(cls);
+  llvm::SmallString<128> path(file.empty() ? m_className + ".jack" : file);
+  llvm::sys::fs::make_absolute(path);
 
-  std::for_each(cls.mths_begin(), cls.mths_end(),
-                [&](auto &e) { e->accept(*this); });
-  std::for_each(cls.fcns_begin(), cls.fcns_end(),
-                [&](auto &e) { e->accept(*this); });
+  m_di = std::make_unique<llvm::DIBuilder>(*module());
+  m_diFile = m_di->createFile(llvm::sys::path::filename(path),
+                              llvm::sys::path::parent_path(path));
+  // There is no DWARF language for Jack, C is the closest debuggers know
+  auto *unit = m_di->createCompileUnit(llvm::dwarf::DW_LANG_C, m_diFile,
+                                       "jcc", false, "", 0);
+  m_diClass = m_di->createNameSpace(unit, m_className, false);
+}
+
+void LLVMGenerator::endDebugInfo() {
+  m_di->finalize();
+  m_di.reset();
+  m_diFile = nullptr;
+  m_diClass = nullptr;
+  m_diFunction = nullptr;
+  builder().SetCurrentDebugLocation(llvm::DebugLoc());
+}
+
+llvm::DIType *LLVMGenerator::getDIType(const std::string &name) {
+  if (name == "int") {
+    return m_di->createBasicType(name, 32, llvm::dwarf::DW_ATE_signed);
+  } else if (name == "char") {
+    return m_di->createBasicType(name, 8, llvm::dwarf::DW_ATE_signed_char);
+  } else if (name == "boolean") {
+    return m_di->createBasicType(name, 8, llvm::dwarf::DW_ATE_boolean);
+  } else if (name == "void") {
+    return nullptr;
+  }
+
+  // Objects and builtin types are described by their name and size only
+  llvm::Type *type = getTypeByName(name);
+  const uint64_t size =
+      type->isSized() ? module()->getDataLayout().getTypeAllocSizeInBits(type)
+                      : 0;
+  return m_di->createStructType(m_diFile, name, m_diFile, 0, size, 0,
+                                llvm::DINode::FlagZero, nullptr,
+                                m_di->getOrCreateArray({}));
+}
+
+llvm::DISubprogram *LLVMGenerator::createSubprogram(Index decl,
+                                                    llvm::Function *funcI) {
+  std::vector<llvm::Metadata *> types{getDIType(m_ast->type(decl))};
+  for (size_t i = 0; i < numParams(decl); ++i) {
+    types.push_back(getDIType(m_ast->type(m_ast->child(decl, i))));
+  }
+
+  const unsigned line = m_ast->location(decl).line;
+  auto *subprogram = m_di->createFunction(
+      m_diClass, m_ast->name(decl), funcI->getName(), m_diFile, line,
+      m_di->createSubroutineType(m_di->getOrCreateTypeArray(types)), line,
+      llvm::DINode::FlagPrototyped, llvm::DISubprogram::SPFlagDefinition);
+  funcI->setSubprogram(subprogram);
+  return subprogram;
+}
+
+void LLVMGenerator::declareVariable(Index var, llvm::Value *storage,
+                                    unsigned argNo) {
+  // The implicit this of methods has no location of its own
+  auto loc = m_ast->location(var);
+  if (!loc.isValid()) loc.line = m_diFunction->getLine();
+  const auto &name = m_ast->name(var);
+  llvm::DIType *type = getDIType(m_ast->type(var));
+  llvm::DILocalVariable *diVar =
+      argNo ? m_di->createParameterVariable(m_diFunction, name, argNo,
+                                            m_diFile, loc.line, type)
+            : m_di->createAutoVariable(m_diFunction, name, m_diFile,
+                                       loc.line, type);
+  m_di->insertDeclare(
+      storage, diVar, m_di->createExpression(),
+      llvm::DILocation::get(context(), loc.line, loc.column, m_diFunction),
+      builder().GetInsertBlock());
+}
+
+llvm::Value *LLVMGenerator::codegenWithLocation(Index n) {
+  // Nested expressions only override the location while they are generated,
+  // the rest of the statement keeps its own
+  const llvm::DebugLoc saved = builder().getCurrentDebugLocation();
+  const auto loc = m_ast->location(n);
+  if (loc.isValid() && m_diFunction) {
+    builder().SetCurrentDebugLocation(
+        llvm::DILocation::get(context(), loc.line, loc.column, m_diFunction));
+  }
+  visit(n);
+  builder().SetCurrentDebugLocation(saved);
+  return m_last;
+}
+
+void LLVMGenerator::verifyFunction(llvm::Function *funcI) {
+  {
+    stats::ScopedTimer timer("codegen.verify", m_className);
+    if (llvm::verifyFunction(*funcI, &llvm::errs())) { InternalError(funcI); }
+  }
+
+  stats::addCount("functions", m_className, 1);
+  stats::addCount("instructions", m_className,
+                  funcI->getInstructionCount());
 }
 
 [[noreturn]] void LLVMGenerator::InternalError(llvm::Function *f) {
@@ -452,84 +804,126 @@ void LLVMGenerator::visit(ClassDecl &cls) {
   assert(false && "Internal error");
 }
 
-void LLVMGenerator::allocateArguments(llvm::Function *funcI,
-                                      FunctionDecl &decl) {
+void LLVMGenerator::allocateArguments(llvm::Function *funcI, Index decl) {
   std::vector<llvm::AllocaInst *> allocs;
-  allocs.reserve(decl.numParams());
-  auto prm = decl.prms_begin();
+  allocs.reserve(numParams(decl));
+  auto prm = m_ast->children_begin(decl);
   for (auto &arg : funcI->args()) {
     auto alloc = builder().CreateAlloca(arg.getType());
     allocs.push_back(alloc);
-    m_ScopedValueTable.insert({(*prm++)->getName(), alloc});
+    if (m_di) declareVariable(*prm, alloc, arg.getArgNo() + 1);
+    m_args.push_back(alloc);
+    ++prm;
   }
 
   auto alloc = allocs.begin();
   for (auto &arg : funcI->args()) { builder().CreateStore(&arg, (*alloc++)); }
 }
 
-template <typename FunctionType>
-llvm::Function *LLVMGenerator::visitFunction(FunctionType &decl) {
+llvm::Function *LLVMGenerator::visitFunction(Index decl) {
   std::vector<llvm::Type *> argTs;
-  argTs.reserve(decl.numParams());
+  argTs.reserve(numParams(decl));
 
-  m_ScopedValueTable.clear();
+  m_args.clear();
+  m_locals.clear();
+  m_statics.assign(m_numStatics, nullptr);
+  m_this = nullptr;
+  m_returnType = ExprType::fromName(m_ast->type(decl));
+  m_jackName = m_className + '.' + m_ast->name(decl);
 
-  std::transform(decl.prms_begin(), decl.prms_end(), std::back_inserter(argTs),
-                 [&](const auto &p) { return getTypeByName(p->getType()); });
+  for (size_t i = 0; i < numParams(decl); ++i) {
+    argTs.push_back(getTypeByName(m_ast->type(m_ast->child(decl, i))));
+  }
 
   llvm::FunctionType *funcT = llvm::FunctionType::get(
-      getTypeByName(decl.getReturnType()), argTs, false);
+      getTypeByName(m_ast->type(decl)), argTs, false);
+  auto name = mangleFunction(m_ast->name(decl));
+  if (m_patchable) {
+    if (m_ExternalFunctions.count(name)) {
+      // The calls keep naming the first definition and go through its slot
+      auto redefinition = name + ".r" + std::to_string(++m_numRedefinitions);
+      m_redefinitions.emplace_back(name, redefinition);
+      name = std::move(redefinition);
+    } else {
+      m_jackFunctions.insert(name);
+    }
+  }
   auto funcI = llvm::Function::Create(funcT, llvm::Function::ExternalLinkage,
-                                      mangleFunction(decl), module());
+                                      name, module());
 
   llvm::BasicBlock *bb = llvm::BasicBlock::Create(context(), "entry", funcI);
   builder().SetInsertPoint(bb);
 
+  if (m_di) {
+    // The prologue is attributed to the declaration of the function
+    m_diFunction = createSubprogram(decl, funcI);
+    builder().SetCurrentDebugLocation(
+        llvm::DILocation::get(context(), m_diFunction->getLine(),
+                              m_ast->location(decl).column, m_diFunction));
+  }
+
   allocateArguments(funcI, decl);
+  if (m_counters) incrementCounter(decl, "", instr::Counter::Kind::Function);
+  if (m_profile) {
+    if (auto entries = profileCount(m_jackName)) {
+      funcI->setEntryCount(llvm::Function::ProfileCount(
+          *entries, llvm::Function::PCT_Real));
+      // Never called in the training run, keep it out of the hot code.
+      // Otherwise suggest inlining the functions called at least a hundredth
+      // as often as the hottest one
+      if (*entries == 0) {
+        funcI->addFnAttr(llvm::Attribute::Cold);
+      } else if (*entries * 100 >= m_profile->maxFunctionCount()) {
+        funcI->addFnAttr(llvm::Attribute::InlineHint);
+      }
+    }
+  }
 
   return funcI;
 }
 
-void LLVMGenerator::visit(StaticDecl &decl) {
+void LLVMGenerator::visitStatic(Index decl) {
   auto funcI = visitFunction(decl);
-  decl.getDefinition()->accept(*this);
+  visit(body(decl));
 
-  if (llvm::verifyFunction(*funcI, &llvm::errs())) { InternalError(funcI); }
+  verifyFunction(funcI);
 
   m_last = funcI;
 }
 
 // Constructors are strange - we need to use them as statics, but provide *this*
 // as an argument so it can be used in the rest of the function as a keyword
-void LLVMGenerator::visit(ConstructorDecl &decl) {
+void LLVMGenerator::visitConstructor(Index decl) {
   auto funcI = visitFunction(decl);
 
   // allocate the object and store the address in this
-  auto thisT = getTypeByName(m_class->getName());
+  auto thisT = getTypeByName(m_className);
   assert(thisT && "Undefined class type");
-  llvm::AllocaInst *thisPtr = builder().CreateAlloca(thisT);
-  m_ScopedValueTable.insert({"this", thisPtr});
+  m_this = builder().CreateAlloca(thisT);
 
   // codegen rest of the function
-  decl.getDefinition()->accept(*this);
+  visit(body(decl));
 
-  if (llvm::verifyFunction(*funcI, &llvm::errs())) { InternalError(funcI); }
+  verifyFunction(funcI);
 
   m_last = funcI;
 }
 
-void LLVMGenerator::visit(MethodDecl &decl) {
+void LLVMGenerator::visitMethod(Index decl) {
   auto funcI = visitFunction(decl);
-  decl.getDefinition()->accept(*this);
+  // The object is the first parameter
+  m_this = m_args.front();
+  visit(body(decl));
 
-  if (llvm::verifyFunction(*funcI, &llvm::errs())) { InternalError(funcI); }
+  verifyFunction(funcI);
 
   m_last = funcI;
 }
 
-void LLVMGenerator::visit(Block &block) {
-  for (auto stmt = block.stmts_begin(); stmt != block.stmts_end(); ++stmt) {
-    m_last = codegenChild(**stmt);
+void LLVMGenerator::visitBlock(Index block) {
+  for (auto stmt = m_ast->children_begin(block);
+       stmt != m_ast->children_end(block); ++stmt) {
+    m_last = codegenChild(*stmt);
   }
 
   if (builder().GetInsertBlock()->getInstList().empty()) {
@@ -537,25 +931,62 @@ void LLVMGenerator::visit(Block &block) {
   }
 }
 
-void LLVMGenerator::visit(IndexExpr &expr) {
-  llvm::Value *idx = codegenChild(*expr.getIndex());
-  auto v = findIdentifier(expr.getName());
+void LLVMGenerator::visitIndex(Index expr) {
+  const Index index = m_ast->child(expr, 0);
+  llvm::Value *idx = convert(codegenChild(index), m_ast->exprType(index),
+                             ExprType::Kind::Int);
+  auto v = findVariable(expr);
   assert(v);
 
   auto dataPtr = builder().CreateInBoundsGEP(
       v, {builder().getInt32(0), builder().getInt32(0)});
   auto data = builder().CreateLoad(dataPtr);
   m_last = builder().CreateInBoundsGEP(data, idx);
-  m_ExpType =
-      llvm::cast<llvm::PointerType>(m_last->getType())->getElementType();
 }
 
-void LLVMGenerator::visit(EmptyNode &) { m_last = nullptr; }
+void LLVMGenerator::visitEmpty(Index) { m_last = nullptr; }
 
-void LLVMGenerator::visit(RValueT &rv) {
-  llvm::Value *V = codegenChild(*rv.getWrapped());
+void LLVMGenerator::visitRValue(Index rv) {
+  llvm::Value *V = codegenChild(m_ast->child(rv, 0));
   m_last = builder().CreateLoad(V);
-  m_ExpType = m_last->getType();
+}
+
+std::string LLVMGenerator::counterName(Index stmt, const char *suffix) const {
+  const auto loc = m_ast->location(stmt);
+  return m_jackName + ':' + std::to_string(loc.line) + ':' +
+         std::to_string(loc.column) + suffix;
+}
+
+void LLVMGenerator::incrementCounter(Index node, const char *suffix,
+                                     instr::Counter::Kind kind) {
+  const bool isFunction = kind == instr::Counter::Kind::Function;
+  auto &counter =
+      m_counters->add(isFunction ? m_jackName : counterName(node, suffix),
+                      kind, m_ast->location(node).line);
+
+  // The counters live in the runtime, so like the builtins their address is
+  // baked into the code. Programs are single threaded, a plain add is enough
+  auto *counterTy = builder().getInt64Ty();
+  auto *addr = builder().CreateIntToPtr(
+      builder().getInt64(reinterpret_cast<uintptr_t>(&counter.count)),
+      counterTy->getPointerTo());
+  auto *count = builder().CreateLoad(counterTy, addr);
+  builder().CreateStore(builder().CreateAdd(count, builder().getInt64(1)),
+                        addr);
+}
+
+std::optional<uint64_t> LLVMGenerator::profileCount(
+    const std::string &name) const {
+  return m_profile->count(name);
+}
+
+void LLVMGenerator::setBranchWeights(llvm::BranchInst *branch, uint64_t taken,
+                                     uint64_t notTaken) {
+  // Weights are 32 bits, scale the counts down to fit
+  const uint64_t scale = std::max(taken, notTaken) / UINT32_MAX + 1;
+  branch->setMetadata(llvm::LLVMContext::MD_prof,
+                      llvm::MDBuilder(context()).createBranchWeights(
+                          taken / scale, notTaken / scale));
 }
 
 void LLVMGenerator::dumpModule() const { module()->print(llvm::errs(), 0); }
@@ -0,0 +1,186 @@
+#include "Peephole.hpp"
+
+#include <sstream>
+#include <utility>
+
+namespace jcc::io {
+
+namespace {
+
+// Operators of the VM, `*` and `/` are calls to the Jack OS
+std::optional<char> binaryOp(const std::string &op, const std::string &arg) {
+  if (op == "add") return '+';
+  if (op == "sub") return '-';
+  if (op == "and") return '&';
+  if (op == "or") return '|';
+  if (op == "eq") return '=';
+  if (op == "gt") return '>';
+  if (op == "lt") return '<';
+  if (op == "call" && arg == "Math.multiply") return '*';
+  if (op == "call" && arg == "Math.divide") return '/';
+  return std::nullopt;
+}
+
+std::optional<int16_t> fold(char op, int16_t lhs, int16_t rhs) {
+  switch (op) {
+    case '+':
+      return lhs + rhs;
+    case '-':
+      return lhs - rhs;
+    case '&':
+      return lhs & rhs;
+    case '|':
+      return lhs | rhs;
+    case '=':
+      return lhs == rhs ? -1 : 0;
+    case '>':
+      return lhs > rhs ? -1 : 0;
+    case '<':
+      return lhs < rhs ? -1 : 0;
+    case '*':
+      return lhs * rhs;
+    case '/':
+      // Left to the OS, which reports the division by zero
+      if (rhs == 0) return std::nullopt;
+      return lhs / rhs;
+    default:
+      return std::nullopt;
+  }
+}
+
+}  // namespace
+
+std::string Peephole::optimize(const std::string &code, size_t *numRemoved) {
+  Peephole peephole;
+  std::istringstream in{code};
+  size_t numRead = 0;
+  for (std::string line; std::getline(in, line);) {
+    Instr instr;
+    std::istringstream{line.substr(0, line.find("//"))} >> instr.op >>
+        instr.arg >> instr.num;
+    if (instr.op.empty()) continue;
+    ++numRead;
+    peephole.add(std::move(instr));
+  }
+
+  std::string out;
+  for (const Instr &instr : peephole.m_code) {
+    out += instr.op;
+    if (!instr.arg.empty()) out += ' ' + instr.arg;
+    if (!instr.num.empty()) out += ' ' + instr.num;
+    out += '\n';
+  }
+  if (numRemoved) *numRemoved = numRead - peephole.m_code.size();
+  return out;
+}
+
+bool Peephole::tailIs(size_t back, const std::string &op) const {
+  return back < m_code.size() && m_code[m_code.size() - 1 - back].op == op;
+}
+
+std::optional<std::pair<int16_t, size_t>> Peephole::constantAt(
+    size_t back) const {
+  if (back >= m_code.size()) return std::nullopt;
+  const Instr &last = m_code[m_code.size() - 1 - back];
+  if (last.op == "push") {
+    if (last.arg != "constant") return std::nullopt;
+    return std::make_pair(static_cast<int16_t>(std::stoi(last.num)), 1);
+  }
+  if (last.op == "neg" || last.op == "not") {
+    const auto operand = constantAt(back + 1);
+    if (!operand || operand->second != 1) return std::nullopt;
+    const int16_t value = operand->first;
+    return std::make_pair(
+        static_cast<int16_t>(last.op == "neg" ? -value : ~value), 2);
+  }
+  return std::nullopt;
+}
+
+void Peephole::pushConstant(int16_t value) {
+  // Constants are 15 bit, the others are complemented
+  if (value >= 0) {
+    m_code.push_back({"push", "constant", std::to_string(value)});
+  } else {
+    m_code.push_back({"push", "constant", std::to_string(~value)});
+    m_code.push_back({"not", "", ""});
+  }
+}
+
+bool Peephole::foldUnary(const Instr &instr) {
+  if (instr.op != "neg" && instr.op != "not") return false;
+  if (const auto operand = constantAt(0)) {
+    drop(operand->second);
+    pushConstant(instr.op == "neg" ? -operand->first : ~operand->first);
+    return true;
+  }
+  if (tailIs(0, instr.op)) {
+    drop(1);
+    return true;
+  }
+  return false;
+}
+
+bool Peephole::foldBinary(const Instr &instr) {
+  const auto op = binaryOp(instr.op, instr.arg);
+  if (!op) return false;
+  const auto rhs = constantAt(0);
+  if (!rhs) return false;
+
+  if (const auto lhs = constantAt(rhs->second)) {
+    if (const auto value = fold(*op, lhs->first, rhs->first)) {
+      drop(lhs->second + rhs->second);
+      pushConstant(*value);
+      return true;
+    }
+  }
+
+  // Identities
+  const bool zero = rhs->first == 0 && (*op == '+' || *op == '-' || *op == '|');
+  const bool one = rhs->first == 1 && (*op == '*' || *op == '/');
+  if (zero || one) {
+    drop(rhs->second);
+    return true;
+  }
+  return false;
+}
+
+bool Peephole::foldBranch(const Instr &instr) {
+  if (instr.op != "if-goto") return false;
+  if (const auto cond = constantAt(0)) {
+    drop(cond->second);
+    if (cond->first != 0) add({"goto", instr.arg, ""});
+    return true;
+  }
+  // x != y is x - y != 0, without the comparison and its complement
+  if (tailIs(0, "not") && tailIs(1, "eq")) {
+    drop(2);
+    add({"sub", "", ""});
+    add(instr);
+    return true;
+  }
+  return false;
+}
+
+void Peephole::add(Instr instr) {
+  if (m_dead) {
+    if (instr.op != "label" && instr.op != "function") return;
+    m_dead = false;
+  }
+
+  if (foldUnary(instr) || foldBinary(instr) || foldBranch(instr)) return;
+
+  if (instr.op == "pop" && tailIs(0, "push") &&
+      m_code.back().arg == instr.arg && m_code.back().num == instr.num) {
+    drop(1);
+    return;
+  }
+  if (instr.op == "label" && tailIs(0, "goto") &&
+      m_code.back().arg == instr.arg) {
+    drop(1);
+  }
+
+  m_dead = instr.op == "goto" || instr.op == "return";
+  m_code.push_back(std::move(instr));
+}
+
+}  // namespace jcc::io
@@ -4,167 +4,157 @@
 
 namespace jcc::ast {
 
-template <typename ForwardIt>
-void PrettyPrinter::printExprList(ForwardIt beg, ForwardIt end) {
-  for (; beg != end; ++beg) { (*beg)->accept(*this); };
+std::string PrettyPrinter::print(const Node &root) {
+  return print(FlatAST::build(root));
 }
 
-std::string PrettyPrinter::print(const Node &cls) {
-  PrettyPrinter p;
-  cls.accept(p);
-  return p.m_ast;
+std::string PrettyPrinter::print(const FlatAST &ast) {
+  PrettyPrinter p{ast};
+  p.visit(0);
+  return std::move(p.m_out);
 }
 
 std::string PrettyPrinter::pad() const {
   return std::string(m_offset * 2, ' ');
 }
 
-void PrettyPrinter::visit(const IntConst &integer) {
+void PrettyPrinter::visitInt(Index node) {
   Pad p(this);
-  m_ast += pad() + "IntConst: " + std::to_string(integer.getInt()) + '\n';
+  m_out += pad() + "IntConst: " + std::to_string(m_ast->value(node)) + '\n';
 }
 
-void PrettyPrinter::visit(const CharConst &c) {
+void PrettyPrinter::visitChar(Index node) {
   Pad p(this);
-  m_ast += pad() + "CharConst: " + std::to_string(c.getChar()) + '\n';
+  m_out += pad() + "CharConst: " + std::to_string(m_ast->value(node)) + '\n';
 }
 
-void PrettyPrinter::visit(const Identifier &identifier) {
+void PrettyPrinter::visitIdentifier(Index node) {
   Pad p(this);
-  if (!identifier.getName().empty()) {
-    m_ast += pad() + "Identifier: " + identifier.getName() + '\n';
+  if (!m_ast->name(node).empty()) {
+    m_out += pad() + "Identifier: " + m_ast->name(node) + '\n';
   }
 }
 
-void PrettyPrinter::visit(const StrConst &str) {
+void PrettyPrinter::visitStr(Index node) {
   Pad p(this);
-  m_ast += pad() + "StrConst: " + str.getString() + '\n';
+  m_out += pad() + "StrConst: " + m_ast->name(node) + '\n';
 }
 
-void PrettyPrinter::visit(const BinaryOp &binop) {
+void PrettyPrinter::visitBinary(Index node) {
   Pad p(this);
-  m_ast += pad() + binop.getOp() + '\n';
-  binop.getLHS()->accept(*this);
-  binop.getRHS()->accept(*this);
+  m_out += pad() + m_ast->op(node) + '\n';
+  visitChildren(node);
 }
 
-void PrettyPrinter::visit(const UnaryOp &unop) {
+void PrettyPrinter::visitUnary(Index node) {
   Pad p(this);
-  m_ast += pad() + "UnaryExpr: " + unop.getOp() + '\n';
-  unop.getOperand()->accept(*this);
+  m_out += pad() + "UnaryExpr: " + m_ast->op(node) + '\n';
+  visitChildren(node);
 }
 
-void PrettyPrinter::visit(const FunctionCall &call) {
+void PrettyPrinter::visitFunctionCall(Index node) {
   Pad p(this);
-  m_ast += pad() + "FunctionCall: " + call.getClassType() + '.' +
-           call.getName() + '\n' + pad() + "Args:\n";
-  for (auto arg = call.args_begin(); arg != call.args_end(); ++arg) {
-    (*arg)->accept(*this);
-  }
-}
-
-void PrettyPrinter::visit(const MethodCall &call) {
-  Pad p(this);
-  m_ast += pad() + "FunctionCall: " + call.getName() + '\n';
-  if (call.getCallee()) { call.getCallee()->accept(*this); }
-
-  m_ast += pad() + "Args:\n";
-  for (auto arg = call.args_begin(); arg != call.args_end(); ++arg) {
-    (*arg)->accept(*this);
-  }
+  m_out += pad() + "FunctionCall: " + m_ast->type(node) + '.' +
+           m_ast->name(node) + '\n' + pad() + "Args:\n";
+  visitChildren(node);
 }
 
-void PrettyPrinter::visit(const LetStmt &let) {
+void PrettyPrinter::visitMethodCall(Index node) {
   Pad p(this);
-  m_ast += pad() + "LetStmt: \n";
-  let.getAssignee()->accept(*this);
-  let.getExpression()->accept(*this);
+  m_out += pad() + "FunctionCall: " + m_ast->name(node) + '\n';
+  const bool callee = m_ast->hasOptional(node);
+  if (callee) visit(m_ast->child(node, 0));
+  m_out += pad() + "Args:\n";
+  visitChildren(node, callee ? 1 : 0);
 }
 
-void PrettyPrinter::visit(const VarDecl &var) {
+void PrettyPrinter::visitLet(Index node) {
   Pad p(this);
-  m_ast += pad() + "VarDecl: " + var.getType() + ' ' + var.getName() + '\n';
+  m_out += pad() + "LetStmt: \n";
+  visitChildren(node);
 }
 
-void PrettyPrinter::visit(const IfStmt &expr) {
+void PrettyPrinter::visitIf(Index node) {
   Pad p(this);
-  m_ast += pad() + "IfStmt: \n";
-  expr.getCond()->accept(*this);
-  expr.getIfBlock()->accept(*this);
-  if (expr.getElseBlock()) { expr.getElseBlock()->accept(*this); }
+  m_out += pad() + "IfStmt: \n";
+  visitChildren(node);
 }
 
-void PrettyPrinter::visit(const WhileStmt &expr) {
+void PrettyPrinter::visitWhile(Index node) {
   Pad p(this);
-  m_ast += pad() + "WhileStmt: \n";
-  expr.getCond()->accept(*this);
-  m_ast += pad() + "{\n";
-  expr.getBlock()->accept(*this);
-  m_ast += pad() + "}\n";
-}
-
-void PrettyPrinter::visit(const ReturnStmt &expr) {
-  Pad p(this);
-  m_ast += pad() + "ReturnStmt: \n";
-  expr.getExpr()->accept(*this);
-}
-
-template <typename FunctionType>
-void PrettyPrinter::visitFunctionDecl(FunctionType &f) {
-  m_ast += f.getReturnType() + ' ' + f.getName() + '\n' + pad() + "Params: \n";
-  printExprList(f.prms_begin(), f.prms_end());
-  f.getDefinition()->accept(*this);
+  m_out += pad() + "WhileStmt: \n";
+  visit(m_ast->child(node, 0));
+  m_out += pad() + "{\n";
+  visit(m_ast->child(node, 1));
+  m_out += pad() + "}\n";
 }
 
-void PrettyPrinter::visit(const ConstructorDecl &f) {
+void PrettyPrinter::visitReturn(Index node) {
   Pad p(this);
-  m_ast += pad() + "ConstructorDecl: ";
-  visitFunctionDecl(f);
+  m_out += pad() + "ReturnStmt: \n";
+  visitChildren(node);
 }
 
-void PrettyPrinter::visit(const MethodDecl &f) {
+void PrettyPrinter::visitVar(Index node) {
   Pad p(this);
-  m_ast += pad() + "MethodDecl: ";
-  visitFunctionDecl(f);
+  m_out +=
+      pad() + "VarDecl: " + m_ast->type(node) + ' ' + m_ast->name(node) + '\n';
 }
 
-void PrettyPrinter::visit(const StaticDecl &f) {
+void PrettyPrinter::visitFunction(Index node, const char *title) {
   Pad p(this);
-  m_ast += pad() + "StaticDecl: ";
-  visitFunctionDecl(f);
+  m_out += pad() + title + m_ast->type(node) + ' ' + m_ast->name(node) + '\n' +
+           pad() + "Params: \n";
+  visitChildren(node);
 }
 
-void PrettyPrinter::visit(const Block &b) {
+void PrettyPrinter::visitClass(Index node) {
+  using Kind = FlatAST::Kind;
   Pad p(this);
-  m_ast += pad() + "Block: {\n";
-  printExprList(b.stmts_begin(), b.stmts_end());
-  m_ast += pad() + "}\n";
+  auto visitMembers = [&](const char *title, auto isMember) {
+    m_out += pad() + title;
+    for (auto it = m_ast->children_begin(node);
+         it != m_ast->children_end(node); ++it) {
+      if (isMember(*it)) visit(*it);
+    }
+  };
+  auto isVar = [&](sym::Kind kind) {
+    return [this, kind](Index member) {
+      return m_ast->kind(member) == Kind::Var &&
+             m_ast->value(member) == static_cast<int32_t>(kind);
+    };
+  };
+  m_out += pad() + "Class: " + m_ast->name(node) + '\n';
+  visitMembers("Fields: \n", isVar(sym::Kind::FIELD));
+  visitMembers("Statics: \n", isVar(sym::Kind::STATIC));
+  visitMembers("Functions: \n", [&](Index member) {
+    return m_ast->kind(member) == Kind::Static ||
+           m_ast->kind(member) == Kind::Constructor;
+  });
+  visitMembers("Methods: \n", [&](Index member) {
+    return m_ast->kind(member) == Kind::Method;
+  });
 }
 
-void PrettyPrinter::visit(const ClassDecl &cls) {
+void PrettyPrinter::visitBlock(Index node) {
   Pad p(this);
-  m_ast += pad() + "Class: " + cls.getName() + '\n' + pad() + "Fields: \n";
-  printExprList(cls.fields_begin(), cls.fields_end());
-  m_ast += pad() + "Statics: \n";
-  printExprList(cls.statics_begin(), cls.statics_end());
-  m_ast += pad() + "Functions: \n";
-  printExprList(cls.fcns_begin(), cls.fcns_end());
-  m_ast += pad() + "Methods: \n";
-  printExprList(cls.mths_begin(), cls.mths_end());
+  m_out += pad() + "Block: {\n";
+  visitChildren(node);
+  m_out += pad() + "}\n";
 }
 
-void PrettyPrinter::visit(const IndexExpr &expr) {
+void PrettyPrinter::visitIndex(Index node) {
   Pad p(this);
-  m_ast += pad() + "IndexExpr:" + expr.getName() + '\n' + pad() + "[\n";
-  expr.getIndex()->accept(*this);
-  m_ast += pad() + "]\n";
+  m_out += pad() + "IndexExpr:" + m_ast->name(node) + '\n' + pad() + "[\n";
+  visit(m_ast->child(node, 0));
+  m_out += pad() + "]\n";
 }
 
-void PrettyPrinter::visit(const RValueT &expr) {
+void PrettyPrinter::visitRValue(Index node) {
   Pad p(this);
-  m_ast += pad() + "RValue (\n";
-  expr.getWrapped()->accept(*this);
-  m_ast += pad() + ")\n";
+  m_out += pad() + "RValue (\n";
+  visitChildren(node);
+  m_out += pad() + ")\n";
 }
 
 }  // namespace jcc::ast
@@ -0,0 +1,204 @@
+#include "ProgramGenerator.hpp"
+
+#include "ASTBuilder.hpp"
+#include "SourcePrinter.hpp"
+
+namespace jcc::gen {
+
+namespace {
+
+// Variables of every generated function. `a` and `b` are the parameters, the
+// loops at each level of nesting count with their own variable
+constexpr const char *int_vars[] = {"a", "b", "x", "y"};
+constexpr const char arith_ops[] = {'+', '-', '*', '&', '|'};
+constexpr const char cmp_ops[] = {'<', '>', '='};
+constexpr int loop_trip_count = 4;
+
+std::string loopVar(unsigned nesting) { return "i" + std::to_string(nesting); }
+
+}  // namespace
+
+ProgramGenerator::ProgramGenerator(ProgramOptions options)
+    : m_options{options}, m_state{options.seed ? options.seed : 1} {}
+
+// xorshift64*, which gives the same programs on every platform unlike the
+// standard distributions
+uint64_t ProgramGenerator::next() {
+  m_state ^= m_state >> 12;
+  m_state ^= m_state << 25;
+  m_state ^= m_state >> 27;
+  return m_state * 0x2545F4914F6CDD1DULL;
+}
+
+bool ProgramGenerator::chance(double p) {
+  return static_cast<double>(next() >> 11) * 0x1.0p-53 < p;
+}
+
+std::vector<std::unique_ptr<ast::ClassDecl>> ProgramGenerator::generate() {
+  m_state = m_options.seed ? m_options.seed : 1;
+  m_callees.clear();
+
+  std::vector<std::unique_ptr<ast::ClassDecl>> classes;
+  classes.reserve(m_options.numClasses + 1);
+  for (unsigned i = 0; i < m_options.numClasses; ++i) {
+    classes.push_back(generateClass(i));
+  }
+  classes.push_back(generateMain());
+  return classes;
+}
+
+std::vector<std::pair<std::string, std::string>>
+ProgramGenerator::generateSources() {
+  std::vector<std::pair<std::string, std::string>> sources;
+  for (const auto &cls : generate()) {
+    sources.emplace_back(cls->getName() + ".jack",
+                         ast::SourcePrinter::print(*cls));
+  }
+  return sources;
+}
+
+std::unique_ptr<ast::ClassDecl> ProgramGenerator::generateClass(unsigned idx) {
+  auto cls = std::make_unique<ast::ClassDecl>("C" + std::to_string(idx));
+  auto builder = ast::Builder().setClass(cls.get());
+
+  for (unsigned i = 0; i < m_options.functionsPerClass; ++i) {
+    ast::ParamList params;
+    params.push_back(builder.CreateParameter("a", "int"));
+    params.push_back(builder.CreateParameter("b", "int"));
+    auto *fcn = builder.CreateStaticDecl("f" + std::to_string(i), "int",
+                                         std::move(params));
+    generateBody(builder, *fcn);
+    m_callees.push_back({cls->getName(), fcn->getName()});
+  }
+  return cls;
+}
+
+std::unique_ptr<ast::ClassDecl> ProgramGenerator::generateMain() {
+  auto cls = std::make_unique<ast::ClassDecl>("Main");
+  auto builder = ast::Builder().setClass(cls.get());
+  auto *main = builder.CreateStaticDecl("main", "int");
+  auto *body = main->getDefinition();
+
+  body->addStmt(builder.CreateVarDecl("result", "int"));
+  body->addStmt(builder.CreateLet("result", 0));
+  for (unsigned i = 0; i < m_options.numClasses; ++i) {
+    if (m_options.functionsPerClass == 0) break;
+    ast::NodeList args;
+    args.push_back(std::make_unique<ast::IntConst>(i));
+    args.push_back(std::make_unique<ast::IntConst>(1));
+    body->addStmt(builder.CreateLet(
+        "result",
+        builder.CreateArithmetic(
+            '+', RValue(builder.CreateIdentifier("result")),
+            builder.CreateFunctionCall(
+                "C" + std::to_string(i),
+                "f" + std::to_string(m_options.functionsPerClass - 1),
+                std::move(args)))));
+  }
+  body->addStmt(builder.CreateReturn("result"));
+  return cls;
+}
+
+void ProgramGenerator::generateBody(ast::Builder &builder,
+                                    ast::FunctionDecl &fcn) {
+  auto *body = fcn.getDefinition();
+  body->addStmt(builder.CreateVarDecl("x", "int"));
+  body->addStmt(builder.CreateVarDecl("y", "int"));
+  for (unsigned i = 0; i < m_options.maxNesting; ++i) {
+    body->addStmt(builder.CreateVarDecl(loopVar(i), "int"));
+  }
+  if (m_options.stringsPerFunction) {
+    body->addStmt(builder.CreateVarDecl("s", "String"));
+  }
+
+  body->addStmt(builder.CreateLet("x", "a"));
+  body->addStmt(builder.CreateLet("y", "b"));
+  for (unsigned i = 0; i < m_options.stringsPerFunction; ++i) {
+    body->addStmt(builder.CreateLet(
+        "s", std::make_unique<ast::StrConst>(generateString())));
+    body->addStmt(builder.CreateMethodCall("s", "dispose"));
+  }
+
+  generateStatements(builder, *body, m_options.statementsPerFunction, 0);
+  body->addStmt(builder.CreateReturn("x"));
+}
+
+void ProgramGenerator::generateStatements(ast::Builder &builder,
+                                          ast::Block &block, unsigned count,
+                                          unsigned nesting) {
+  while (count > 0) {
+    // Nested statements count towards the total
+    const unsigned nested = count > 2 ? 1 + uniform(count / 2) : 0;
+    const unsigned kind = nesting < m_options.maxNesting && nested ? uniform(4)
+                                                                   : 0;
+    if (kind == 2) {
+      auto cond = std::make_unique<ast::BinaryOp>(
+          cmp_ops[uniform(std::size(cmp_ops))],
+          RValue(builder.CreateIdentifier(int_vars[2 + uniform(2)])),
+          generateExpression(builder, 1));
+      auto ifBlock = std::make_unique<ast::Block>();
+      std::unique_ptr<ast::Block> elseBlock;
+      generateStatements(builder, *ifBlock, (nested + 1) / 2, nesting + 1);
+      if (nested / 2) {
+        elseBlock = std::make_unique<ast::Block>();
+        generateStatements(builder, *elseBlock, nested / 2, nesting + 1);
+      }
+      block.addStmt(builder.CreateIf(std::move(cond), std::move(ifBlock),
+                                     std::move(elseBlock)));
+      count -= nested;
+    } else if (kind == 3) {
+      const auto counter = loopVar(nesting);
+      auto loopBlock = std::make_unique<ast::Block>();
+      generateStatements(builder, *loopBlock, nested, nesting + 1);
+      loopBlock->addStmt(builder.CreateLet(
+          counter, builder.CreateArithmetic(
+                       '+', RValue(builder.CreateIdentifier(counter)),
+                       std::make_unique<ast::IntConst>(1))));
+      block.addStmt(builder.CreateLet(counter, 0));
+      block.addStmt(builder.CreateWhile('<', counter, loop_trip_count,
+                                        std::move(loopBlock)));
+      count -= nested;
+    } else {
+      block.addStmt(builder.CreateLet(
+          int_vars[2 + uniform(2)],
+          generateExpression(builder, m_options.expressionDepth)));
+      --count;
+    }
+  }
+}
+
+std::unique_ptr<ast::Node> ProgramGenerator::generateExpression(
+    ast::Builder &builder, unsigned depth) {
+  if (depth <= 1) return generateTerm(builder, depth);
+  return builder.CreateArithmetic(arith_ops[uniform(std::size(arith_ops))],
+                                  generateExpression(builder, depth - 1),
+                                  generateTerm(builder, depth - 1));
+}
+
+std::unique_ptr<ast::Node> ProgramGenerator::generateTerm(
+    ast::Builder &builder, unsigned depth) {
+  // The arguments of a call are shallower than the call so that the nesting of
+  // calls is bounded by the depth of the expression
+  if (depth > 0 && !m_callees.empty() && chance(m_options.callDensity)) {
+    const auto &callee = m_callees[uniform(m_callees.size())];
+    ast::NodeList args;
+    args.push_back(generateExpression(builder, depth - 1));
+    args.push_back(generateExpression(builder, depth - 1));
+    return builder.CreateFunctionCall(callee.cls, callee.name,
+                                      std::move(args));
+  }
+
+  if (uniform(4) == 0) {
+    return std::make_unique<ast::IntConst>(uniform(100));
+  }
+  return RValue(builder.CreateIdentifier(int_vars[uniform(4)]));
+}
+
+std::string ProgramGenerator::generateString() {
+  static constexpr char alphabet[] = "abcdefghijklmnopqrstuvwxyz ";
+  std::string str(m_options.stringLength, ' ');
+  for (auto &c : str) { c = alphabet[uniform(sizeof(alphabet) - 1)]; }
+  return str;
+}
+
+}  // namespace jcc::gen
@@ -0,0 +1,224 @@
+#include "SourcePrinter.hpp"
+
+#include <utility>
+
+#include "JackAST.hpp"
+
+namespace jcc::ast {
+
+std::string SourcePrinter::print(const Node &node) {
+  SourcePrinter p;
+  node.accept(p);
+  return p.m_src;
+}
+
+bool SourcePrinter::enterExpression() {
+  m_operand = false;
+  return std::exchange(m_statement, false);
+}
+
+template <typename ForwardIt>
+void SourcePrinter::printArgs(ForwardIt beg, ForwardIt end) {
+  m_src += '(';
+  for (auto arg = beg; arg != end; ++arg) {
+    if (arg != beg) m_src += ", ";
+    enterExpression();
+    (*arg)->accept(*this);
+  }
+  m_src += ')';
+}
+
+void SourcePrinter::visit(const IntConst &integer) {
+  enterExpression();
+  m_src += std::to_string(integer.getInt());
+}
+
+// Jack has no character literals
+void SourcePrinter::visit(const CharConst &c) {
+  enterExpression();
+  m_src += std::to_string(c.getChar());
+}
+
+void SourcePrinter::visit(const Identifier &identifier) {
+  enterExpression();
+  if (identifier.getObject()) m_src += identifier.getObject()->getName() + '.';
+  m_src += identifier.getName();
+}
+
+void SourcePrinter::visit(const StrConst &str) {
+  enterExpression();
+  m_src += '"' + str.getString() + '"';
+}
+
+void SourcePrinter::visit(const IndexExpr &expr) {
+  enterExpression();
+  if (expr.getObject()) m_src += expr.getObject()->getName() + '.';
+  m_src += expr.getName() + '[';
+  expr.getIndex()->accept(*this);
+  m_src += ']';
+}
+
+void SourcePrinter::visit(const BinaryOp &binop) {
+  const bool nested = m_operand;
+  enterExpression();
+  if (nested) m_src += '(';
+
+  m_operand = true;
+  binop.getLHS()->accept(*this);
+  m_src += std::string(" ") + binop.getOp() + ' ';
+  m_operand = true;
+  binop.getRHS()->accept(*this);
+
+  if (nested) m_src += ')';
+}
+
+void SourcePrinter::visit(const UnaryOp &unop) {
+  enterExpression();
+  m_src += unop.getOp();
+  // The operand of a unary operator is a term, which can only be a nested
+  // operator in parentheses
+  m_operand = true;
+  unop.getOperand()->accept(*this);
+}
+
+void SourcePrinter::visit(const MethodCall &call) {
+  const bool statement = enterExpression();
+  if (statement) m_src += pad() + "do ";
+  if (call.getCallee()) {
+    call.getCallee()->accept(*this);
+    m_src += '.';
+  }
+  m_src += call.getName();
+  printArgs(call.args_begin(), call.args_end());
+  if (statement) m_src += ";\n";
+}
+
+void SourcePrinter::visit(const FunctionCall &call) {
+  const bool statement = enterExpression();
+  if (statement) m_src += pad() + "do ";
+  m_src += call.getClassType() + '.' + call.getName();
+  printArgs(call.args_begin(), call.args_end());
+  if (statement) m_src += ";\n";
+}
+
+void SourcePrinter::visit(const LetStmt &let) {
+  enterExpression();
+  m_src += pad() + "let ";
+  let.getAssignee()->accept(*this);
+  m_src += " = ";
+  enterExpression();
+  let.getExpression()->accept(*this);
+  m_src += ";\n";
+}
+
+void SourcePrinter::visit(const IfStmt &stmt) {
+  enterExpression();
+  m_src += pad() + "if (";
+  stmt.getCond()->accept(*this);
+  m_src += ") ";
+  printBody(*stmt.getIfBlock());
+  if (stmt.getElseBlock()) {
+    m_src += " else ";
+    printBody(*stmt.getElseBlock());
+  }
+  m_src += '\n';
+}
+
+void SourcePrinter::visit(const WhileStmt &stmt) {
+  enterExpression();
+  m_src += pad() + "while (";
+  stmt.getCond()->accept(*this);
+  m_src += ") ";
+  printBody(*stmt.getBlock());
+  m_src += '\n';
+}
+
+void SourcePrinter::visit(const ReturnStmt &stmt) {
+  enterExpression();
+  m_src += pad() + "return";
+  std::string expr = print(*stmt.getExpr());
+  if (!expr.empty()) m_src += ' ' + expr;
+  m_src += ";\n";
+}
+
+void SourcePrinter::visit(const VarDecl &var) {
+  const bool statement = enterExpression();
+  if (statement) {
+    m_src += pad() + "var " + var.getType() + ' ' + var.getName() + ";\n";
+  } else {
+    m_src += var.getType() + ' ' + var.getName();
+  }
+}
+
+template <typename FunctionType>
+void SourcePrinter::visitFunctionDecl(const char *kind, FunctionType &f,
+                                      size_t firstParam) {
+  m_src += pad() + kind + ' ' + f.getReturnType() + ' ' + f.getName();
+  printArgs(f.prms_begin() + firstParam, f.prms_end());
+  m_src += ' ';
+  printBody(*f.getDefinition());
+  m_src += "\n\n";
+}
+
+void SourcePrinter::visit(const ConstructorDecl &f) {
+  visitFunctionDecl("constructor", f, 0);
+}
+
+// The implicit `this` parameter is not part of the source
+void SourcePrinter::visit(const MethodDecl &f) {
+  visitFunctionDecl("method", f, 1);
+}
+
+void SourcePrinter::visit(const StaticDecl &f) {
+  visitFunctionDecl("function", f, 0);
+}
+
+void SourcePrinter::printBody(const Block &b) {
+  m_src += "{\n";
+  ++m_offset;
+  b.accept(*this);
+  --m_offset;
+  m_src += pad() + '}';
+}
+
+void SourcePrinter::visit(const Block &b) {
+  for (auto stmt = b.stmts_begin(); stmt != b.stmts_end(); ++stmt) {
+    m_statement = true;
+    (*stmt)->accept(*this);
+  }
+  m_statement = false;
+}
+
+void SourcePrinter::visit(const ClassDecl &cls) {
+  m_src += pad() + "class " + cls.getName() + " {\n";
+  ++m_offset;
+  for (auto f = cls.fields_begin(); f != cls.fields_end(); ++f) {
+    m_src += pad() + "field " + (*f)->getType() + ' ' + (*f)->getName() +
+             ";\n";
+  }
+  for (auto s = cls.statics_begin(); s != cls.statics_end(); ++s) {
+    m_src += pad() + "static " + (*s)->getType() + ' ' + (*s)->getName() +
+             ";\n";
+  }
+  if (cls.numFields() || cls.numStatics()) m_src += '\n';
+
+  for (auto f = cls.fcns_begin(); f != cls.fcns_end(); ++f) {
+    (*f)->accept(*this);
+  }
+  for (auto m = cls.mths_begin(); m != cls.mths_end(); ++m) {
+    (*m)->accept(*this);
+  }
+  --m_offset;
+
+  // Drop the blank line after the last subroutine
+  if (m_src.size() > 1 && m_src.compare(m_src.size() - 2, 2, "\n\n") == 0) {
+    m_src.pop_back();
+  }
+  m_src += pad() + "}\n";
+}
+
+void SourcePrinter::visit(const RValueT &expr) {
+  expr.getWrapped()->accept(*this);
+}
+
+}  // namespace jcc::ast
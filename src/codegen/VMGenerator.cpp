@@ -0,0 +1,256 @@
+#include "VMGenerator.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <sstream>
+#include <utility>
+
+#include "JackAST.hpp"
+#include "Statistics.hpp"
+
+namespace jcc::ast {
+
+std::string VMGenerator::generate(const ClassDecl &cls) {
+  stats::ScopedTimer timer("vmgen", cls.getName());
+  VMGenerator gen;
+  cls.accept(gen);
+  return std::move(gen.m_code);
+}
+
+std::string VMGenerator::takeCode() {
+  auto code =
+      static_cast<const std::ostringstream &>(*m_writer.getOutput()).str();
+  m_writer = io::JackWriter{std::make_unique<std::ostringstream>()};
+  return code;
+}
+
+void VMGenerator::pushConstant(int value) {
+  // Constants are 15 bit and the words 16 bit: a value out of range is pushed
+  // as the word with the same low 16 bits, which is what the arithmetic on it
+  // computes. A negative word is the complement of a constant, like true
+  const int16_t word = static_cast<int16_t>(value);
+  if (word >= 0) {
+    m_writer.writePush("constant", word);
+  } else {
+    m_writer.writePush("constant", ~word);
+    m_writer.writeUnaryOp('~');
+  }
+}
+
+void VMGenerator::pushVariable(const NamedValue &value) {
+  const Slot slot = value.getSlot();
+  assert(slot.isResolved() && "The AST was not resolved");
+  if (const NamedValue *object = value.getObject()) {
+    pushVariable(*object);
+    m_writer.writePop("pointer", 1);
+    m_writer.writePush("that", slot.index);
+  } else {
+    m_writer.writePush(sym::toSegment(slot.kind), slot.index);
+  }
+}
+
+void VMGenerator::popVariable(const NamedValue &value) {
+  const Slot slot = value.getSlot();
+  assert(slot.isResolved() && "The AST was not resolved");
+  assert(!value.getObject() && "Only the fields of `this` are assigned");
+  m_writer.writePop(sym::toSegment(slot.kind), slot.index);
+}
+
+void VMGenerator::writeCall(const Call &call, const std::string &cls,
+                            size_t nArgs) {
+  for (auto arg = call.args_begin(); arg != call.args_end(); ++arg) {
+    (*arg)->accept(*this);
+    ++nArgs;
+  }
+  m_writer.writeCall(cls + '.' + call.getName(), nArgs);
+  m_value = true;
+}
+
+void VMGenerator::visit(const IntConst &i) { pushConstant(i.getInt()); }
+
+void VMGenerator::visit(const CharConst &c) { pushConstant(c.getChar()); }
+
+void VMGenerator::visit(const True &) { pushConstant(-1); }
+
+void VMGenerator::visit(const False &) { pushConstant(0); }
+
+void VMGenerator::visit(const This &) { m_writer.writePush("pointer", 0); }
+
+void VMGenerator::visit(const Identifier &ident) {
+  if (const Node *value = std::exchange(m_assigned, nullptr)) {
+    value->accept(*this);
+    popVariable(ident);
+  } else {
+    pushVariable(ident);
+  }
+}
+
+void VMGenerator::visit(const StrConst &str) {
+  const std::string &chars = str.getString();
+  pushConstant(chars.size());
+  m_writer.writeCall("String.new", 1);
+  for (const unsigned char c : chars) {
+    pushConstant(c);
+    m_writer.writeCall("String.appendChar", 2);
+  }
+}
+
+void VMGenerator::visit(const IndexExpr &expr) {
+  const Node *value = std::exchange(m_assigned, nullptr);
+  pushVariable(expr);
+  expr.getIndex()->accept(*this);
+  m_writer.writeBinOp('+');
+  if (!value) {
+    m_writer.writePop("pointer", 1);
+    m_writer.writePush("that", 0);
+    return;
+  }
+
+  // The address is computed before the value, which may use `that` itself
+  value->accept(*this);
+  m_writer.writePop("temp", 0);
+  m_writer.writePop("pointer", 1);
+  m_writer.writePush("temp", 0);
+  m_writer.writePop("that", 0);
+}
+
+void VMGenerator::visit(const BinaryOp &binop) {
+  binop.getLHS()->accept(*this);
+  binop.getRHS()->accept(*this);
+  m_writer.writeBinOp(binop.getOp());
+}
+
+void VMGenerator::visit(const UnaryOp &unop) {
+  unop.getOperand()->accept(*this);
+  m_writer.writeUnaryOp(unop.getOp());
+}
+
+void VMGenerator::visit(const MethodCall &call) {
+  const NamedValue *callee = call.getCallee();
+  if (!callee) {
+    m_writer.writePush("pointer", 0);
+    return writeCall(call, m_class->getName(), 1);
+  }
+
+  callee->accept(*this);
+  const auto &type = callee->getExprType();
+  writeCall(call,
+            type.isKnown() ? type.name
+            : callee->getDecl() ? callee->getDecl()->getType()
+                                : callee->getType(),
+            1);
+}
+
+void VMGenerator::visit(const FunctionCall &call) {
+  writeCall(call, call.getClassType(), 0);
+}
+
+void VMGenerator::visit(const LetStmt &let) {
+  // The assignee writes the value where it is stored, see visit(IndexExpr)
+  m_assigned = let.getExpression();
+  let.getAssignee()->accept(*this);
+  m_value = false;
+}
+
+void VMGenerator::visit(const IfStmt &stmt) {
+  const auto id = std::to_string(m_numLabels++);
+  stmt.getCond()->accept(*this);
+  m_writer.writeUnaryOp('~');
+
+  if (stmt.getElseBlock()) {
+    m_writer.writeIf("IF_FALSE" + id);
+    stmt.getIfBlock()->accept(*this);
+    m_writer.writeGoto("IF_END" + id);
+    m_writer.writeLabel("IF_FALSE" + id);
+    stmt.getElseBlock()->accept(*this);
+  } else {
+    m_writer.writeIf("IF_END" + id);
+    stmt.getIfBlock()->accept(*this);
+  }
+  m_writer.writeLabel("IF_END" + id);
+  m_value = false;
+}
+
+void VMGenerator::visit(const WhileStmt &stmt) {
+  const auto id = std::to_string(m_numLabels++);
+  m_writer.writeLabel("WHILE_EXP" + id);
+  stmt.getCond()->accept(*this);
+  m_writer.writeUnaryOp('~');
+  m_writer.writeIf("WHILE_END" + id);
+  stmt.getBlock()->accept(*this);
+  m_writer.writeGoto("WHILE_EXP" + id);
+  m_writer.writeLabel("WHILE_END" + id);
+  m_value = false;
+}
+
+void VMGenerator::visit(const ReturnStmt &stmt) {
+  // Every function returns a value, 0 for void ones
+  m_empty = false;
+  stmt.getExpr()->accept(*this);
+  if (m_empty) pushConstant(0);
+  m_writer.writeReturn();
+  m_value = false;
+}
+
+void VMGenerator::visit(const VarDecl &var) {
+  const Slot slot = var.getSlot();
+  if (slot.kind == sym::Kind::VAR) {
+    m_numLocals = std::max<size_t>(m_numLocals, slot.index + 1);
+  }
+  m_value = false;
+}
+
+void VMGenerator::visit(const Block &block) {
+  for (auto stmt = block.stmts_begin(); stmt != block.stmts_end(); ++stmt) {
+    m_value = false;
+    (*stmt)->accept(*this);
+    // The value of a `do` call is discarded
+    if (m_value) m_writer.writePop("temp", 0);
+  }
+  m_value = false;
+}
+
+void VMGenerator::visit(const RValueT &rv) { rv.getWrapped()->accept(*this); }
+
+void VMGenerator::visitFunction(const FunctionDecl &decl,
+                                const std::string &prologue) {
+  m_numLocals = 0;
+  m_numLabels = 0;
+  takeCode();
+  decl.getDefinition()->accept(*this);
+  const std::string body = takeCode();
+
+  m_writer.writeFunction(m_class->getName() + '.' + decl.getName(),
+                         m_numLocals);
+  m_code += takeCode() + prologue + body;
+}
+
+void VMGenerator::visit(const StaticDecl &decl) { visitFunction(decl, ""); }
+
+void VMGenerator::visit(const MethodDecl &decl) {
+  m_writer.writePush("argument", 0);
+  m_writer.writePop("pointer", 0);
+  visitFunction(decl, takeCode());
+}
+
+void VMGenerator::visit(const ConstructorDecl &decl) {
+  pushConstant(m_class->numFields());
+  m_writer.writeCall("Memory.alloc", 1);
+  m_writer.writePop("pointer", 0);
+  visitFunction(decl, takeCode());
+}
+
+void VMGenerator::visit(const ClassDecl &cls) {
+  m_class = &cls;
+  m_writer = io::JackWriter{std::make_unique<std::ostringstream>()};
+  for (auto fcn = cls.fcns_begin(); fcn != cls.fcns_end(); ++fcn) {
+    (*fcn)->accept(*this);
+  }
+  for (auto mth = cls.mths_begin(); mth != cls.mths_end(); ++mth) {
+    (*mth)->accept(*this);
+  }
+  m_class = nullptr;
+}
+
+}  // namespace jcc::ast
@@ -0,0 +1,632 @@
+#include "ASTCache.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include "JackAST.hpp"
+#include "Statistics.hpp"
+
+namespace jcc::io {
+
+namespace {
+
+constexpr char kMagic[4] = {'J', 'A', 'S', 'T'};
+// Bumped whenever the layout or the meaning of a field changes
+constexpr uint32_t kVersion = 1;
+
+enum class Kind : uint8_t {
+  Empty,
+  Int,
+  Char,
+  Str,
+  Identifier,
+  Index,
+  This,
+  True,
+  False,
+  Binary,
+  Unary,
+  MethodCall,
+  FunctionCall,
+  Let,
+  If,
+  While,
+  Return,
+  Var,
+  Block,
+  Static,
+  Method,
+  Constructor,
+  Class,
+  RValue,
+};
+
+struct Header {
+  char magic[4];
+  uint32_t version;
+  uint32_t numNodes;
+  uint32_t numChildren;
+  uint32_t namesSize;
+};
+
+struct Record {
+  Kind kind;
+  char op;
+  // The optional child is present: the callee of a MethodCall, the else of an
+  // IfStmt, the body of a function
+  uint8_t hasOptional;
+  uint8_t unused;
+  uint32_t line;
+  uint32_t column;
+  // The constant, or the kind of a variable of a class
+  int32_t value;
+  uint32_t name;
+  uint32_t type;
+  uint32_t children;
+  uint32_t numChildren;
+};
+static_assert(sizeof(Record) == 32, "Records are packed");
+
+class Serializer : public ast::ImmutableVisitor {
+public:
+  std::string take() {
+    const Header header{{kMagic[0], kMagic[1], kMagic[2], kMagic[3]},
+                        kVersion,
+                        static_cast<uint32_t>(m_nodes.size()),
+                        static_cast<uint32_t>(m_children.size()),
+                        static_cast<uint32_t>(m_names.size())};
+    std::string out;
+    out.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.append(reinterpret_cast<const char *>(m_nodes.data()),
+               m_nodes.size() * sizeof(Record));
+    out.append(reinterpret_cast<const char *>(m_children.data()),
+               m_children.size() * sizeof(uint32_t));
+    out += m_names;
+    return out;
+  }
+
+  uint32_t write(const ast::Node &node) {
+    node.accept(*this);
+    return m_last;
+  }
+
+  void visit(const ast::EmptyNode &node) override { add(node, Kind::Empty); }
+  void visit(const ast::True &node) override { add(node, Kind::True); }
+  void visit(const ast::False &node) override { add(node, Kind::False); }
+  void visit(const ast::This &node) override { add(node, Kind::This); }
+  void visit(const ast::IntConst &node) override {
+    m_nodes[add(node, Kind::Int)].value = node.getInt();
+  }
+  void visit(const ast::CharConst &node) override {
+    m_nodes[add(node, Kind::Char)].value = node.getChar();
+  }
+  void visit(const ast::StrConst &node) override {
+    add(node, Kind::Str, node.getString());
+  }
+  void visit(const ast::Identifier &node) override {
+    add(node, Kind::Identifier, node.getName());
+  }
+  void visit(const ast::IndexExpr &node) override {
+    const auto idx = add(node, Kind::Index, node.getName());
+    setChildren(idx, {write(*node.getIndex())});
+  }
+
+  void visit(const ast::BinaryOp &node) override {
+    const auto idx = add(node, Kind::Binary);
+    m_nodes[idx].op = node.getOp();
+    setChildren(idx, {write(*node.getLHS()), write(*node.getRHS())});
+  }
+  void visit(const ast::UnaryOp &node) override {
+    const auto idx = add(node, Kind::Unary);
+    m_nodes[idx].op = node.getOp();
+    setChildren(idx, {write(*node.getOperand())});
+  }
+
+  void visit(const ast::MethodCall &node) override {
+    const auto idx = add(node, Kind::MethodCall, node.getName());
+    std::vector<uint32_t> children;
+    if (node.getCallee()) {
+      m_nodes[idx].hasOptional = true;
+      children.push_back(write(*node.getCallee()));
+    }
+    writeAll(node.args_begin(), node.args_end(), children);
+    setChildren(idx, children);
+  }
+  void visit(const ast::FunctionCall &node) override {
+    const auto idx = add(node, Kind::FunctionCall, node.getName(),
+                         node.getClassType());
+    std::vector<uint32_t> children;
+    writeAll(node.args_begin(), node.args_end(), children);
+    setChildren(idx, children);
+  }
+
+  void visit(const ast::LetStmt &node) override {
+    const auto idx = add(node, Kind::Let);
+    setChildren(idx,
+                {write(*node.getAssignee()), write(*node.getExpression())});
+  }
+  void visit(const ast::IfStmt &node) override {
+    const auto idx = add(node, Kind::If);
+    std::vector<uint32_t> children{write(*node.getCond()),
+                                   write(*node.getIfBlock())};
+    if (node.getElseBlock()) {
+      m_nodes[idx].hasOptional = true;
+      children.push_back(write(*node.getElseBlock()));
+    }
+    setChildren(idx, children);
+  }
+  void visit(const ast::WhileStmt &node) override {
+    const auto idx = add(node, Kind::While);
+    setChildren(idx, {write(*node.getCond()), write(*node.getBlock())});
+  }
+  void visit(const ast::ReturnStmt &node) override {
+    const auto idx = add(node, Kind::Return);
+    setChildren(idx, {write(*node.getExpr())});
+  }
+
+  void visit(const ast::VarDecl &node) override {
+    add(node, Kind::Var, node.getName(), node.getType());
+  }
+  void visit(const ast::StaticDecl &node) override {
+    visitFunction(node, Kind::Static);
+  }
+  void visit(const ast::MethodDecl &node) override {
+    visitFunction(node, Kind::Method);
+  }
+  void visit(const ast::ConstructorDecl &node) override {
+    visitFunction(node, Kind::Constructor);
+  }
+  void visit(const ast::ClassDecl &node) override {
+    const auto idx = add(node, Kind::Class, node.getName(), node.getFile());
+    std::vector<uint32_t> children;
+    for (auto it = node.fields_begin(); it != node.fields_end(); ++it) {
+      children.push_back(write(**it));
+      m_nodes[children.back()].value = static_cast<int32_t>(sym::Kind::FIELD);
+    }
+    for (auto it = node.statics_begin(); it != node.statics_end(); ++it) {
+      children.push_back(write(**it));
+      m_nodes[children.back()].value = static_cast<int32_t>(sym::Kind::STATIC);
+    }
+    writeAll(node.fcns_begin(), node.fcns_end(), children);
+    writeAll(node.mths_begin(), node.mths_end(), children);
+    setChildren(idx, children);
+  }
+  void visit(const ast::Block &node) override {
+    const auto idx = add(node, Kind::Block);
+    std::vector<uint32_t> children;
+    writeAll(node.stmts_begin(), node.stmts_end(), children);
+    setChildren(idx, children);
+  }
+
+  void visit(const ast::RValueT &node) override {
+    const auto idx = add(node, Kind::RValue);
+    setChildren(idx, {write(*node.getWrapped())});
+  }
+
+private:
+  std::vector<Record> m_nodes;
+  std::vector<uint32_t> m_children;
+  // Starts with the empty name
+  std::string m_names{'\0'};
+  std::unordered_map<std::string, uint32_t> m_nameOffsets{{"", 0}};
+  uint32_t m_last = 0;
+
+  uint32_t name(const std::string &str) {
+    auto [found, inserted] = m_nameOffsets.emplace(
+        str, static_cast<uint32_t>(m_names.size()));
+    if (inserted) m_names.append(str.c_str(), str.size() + 1);
+    return found->second;
+  }
+
+  uint32_t add(const ast::Node &node, Kind kind, const std::string &str = {},
+               const std::string &type = {}) {
+    Record record{};
+    record.kind = kind;
+    record.line = node.getLocation().line;
+    record.column = node.getLocation().column;
+    record.name = name(str);
+    record.type = name(type);
+    m_last = static_cast<uint32_t>(m_nodes.size());
+    m_nodes.push_back(record);
+    return m_last;
+  }
+
+  // The children are written after their own children, so that the children
+  // of a node are contiguous
+  void setChildren(uint32_t idx, const std::vector<uint32_t> &children) {
+    m_nodes[idx].children = static_cast<uint32_t>(m_children.size());
+    m_nodes[idx].numChildren = static_cast<uint32_t>(children.size());
+    m_children.insert(m_children.end(), children.begin(), children.end());
+    m_last = idx;
+  }
+
+  template <typename ForwardIt>
+  void writeAll(ForwardIt begin, ForwardIt end,
+                std::vector<uint32_t> &children) {
+    for (; begin != end; ++begin) children.push_back(write(**begin));
+  }
+
+  void visitFunction(const ast::FunctionDecl &node, Kind kind) {
+    const auto idx = add(node, kind, node.getName(), node.getReturnType());
+    std::vector<uint32_t> children;
+    auto param = node.prms_begin();
+    // `this` is declared by the MethodDecl
+    if (kind == Kind::Method) ++param;
+    writeAll(param, node.prms_end(), children);
+    if (node.getDefinition()) {
+      m_nodes[idx].hasOptional = true;
+      children.push_back(write(*node.getDefinition()));
+    }
+    setChildren(idx, children);
+  }
+};
+
+// Thrown when the entry does not validate
+struct Invalid {};
+
+class Deserializer {
+public:
+  Deserializer(const char *data, size_t size) {
+    Header header;
+    if (size < sizeof(header)) throw Invalid{};
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+        header.version != kVersion) {
+      throw Invalid{};
+    }
+    const uint64_t expected = sizeof(header) +
+                              uint64_t{header.numNodes} * sizeof(Record) +
+                              uint64_t{header.numChildren} * sizeof(uint32_t) +
+                              header.namesSize;
+    if (expected != size || header.numNodes == 0 || header.namesSize == 0 ||
+        data[size - 1] != '\0') {
+      throw Invalid{};
+    }
+    m_nodes = data + sizeof(header);
+    m_numNodes = header.numNodes;
+    m_children = m_nodes + m_numNodes * sizeof(Record);
+    m_numChildren = header.numChildren;
+    m_names = m_children + m_numChildren * sizeof(uint32_t);
+    m_namesSize = header.namesSize;
+  }
+
+  std::unique_ptr<ast::ClassDecl> cls() {
+    const Record rec = record(0);
+    expect(rec, Kind::Class);
+    auto cls = std::make_unique<ast::ClassDecl>(name(rec.name));
+    cls->setLocation({rec.line, rec.column});
+    cls->setFile(name(rec.type));
+    m_cls = cls.get();
+
+    for (uint32_t i = 0; i < rec.numChildren; ++i) {
+      const uint32_t idx = child(0, rec, i);
+      const Record member = record(idx);
+      switch (member.kind) {
+        case Kind::Var:
+          if (member.value == static_cast<int32_t>(sym::Kind::FIELD)) {
+            cls->addField(var(idx));
+          } else if (member.value == static_cast<int32_t>(sym::Kind::STATIC)) {
+            cls->addStatic(var(idx));
+          } else {
+            throw Invalid{};
+          }
+          break;
+        case Kind::Method:
+          cls->addMethod(function(idx));
+          break;
+        default:
+          cls->addFunction(function(idx));
+      }
+    }
+    return cls;
+  }
+
+private:
+  const char *m_nodes;
+  uint32_t m_numNodes;
+  const char *m_children;
+  uint32_t m_numChildren;
+  const char *m_names;
+  uint32_t m_namesSize;
+
+  // The scope of the names, as set by the CompilationEngine
+  ast::ClassDecl *m_cls = nullptr;
+  ast::FunctionDecl *m_fcn = nullptr;
+
+  Record record(uint32_t idx) const {
+    Record rec;
+    std::memcpy(&rec, m_nodes + size_t{idx} * sizeof(Record), sizeof(rec));
+    if (rec.kind > Kind::RValue) throw Invalid{};
+    return rec;
+  }
+
+  // Children follow their parent, which rules out cycles
+  uint32_t child(uint32_t parent, const Record &rec, uint32_t i) const {
+    if (uint64_t{rec.children} + rec.numChildren > m_numChildren) {
+      throw Invalid{};
+    }
+    uint32_t idx;
+    std::memcpy(&idx, m_children + size_t{rec.children + i} * sizeof(idx),
+                sizeof(idx));
+    if (idx <= parent || idx >= m_numNodes) throw Invalid{};
+    return idx;
+  }
+
+  std::string name(uint32_t offset) const {
+    if (offset >= m_namesSize) throw Invalid{};
+    return m_names + offset;
+  }
+
+  static void expect(const Record &rec, Kind kind, uint32_t numChildren = 0) {
+    if (rec.kind != kind || rec.numChildren < numChildren) throw Invalid{};
+  }
+
+  template <typename T>
+  std::unique_ptr<T> located(std::unique_ptr<T> node, const Record &rec) {
+    node->setLocation({rec.line, rec.column});
+    return node;
+  }
+
+  std::unique_ptr<ast::VarDecl> var(uint32_t idx) {
+    const Record rec = record(idx);
+    expect(rec, Kind::Var);
+    return located(
+        std::make_unique<ast::VarDecl>(name(rec.name), name(rec.type)), rec);
+  }
+
+  std::unique_ptr<ast::FunctionDecl> function(uint32_t idx) {
+    const Record rec = record(idx);
+    if (rec.kind != Kind::Static && rec.kind != Kind::Method &&
+        rec.kind != Kind::Constructor) {
+      throw Invalid{};
+    }
+    const uint32_t numParams = rec.numChildren - (rec.hasOptional ? 1 : 0);
+    if (numParams > rec.numChildren) throw Invalid{};
+    ast::ParamList params;
+    for (uint32_t i = 0; i < numParams; ++i) {
+      params.push_back(var(child(idx, rec, i)));
+    }
+
+    std::unique_ptr<ast::FunctionDecl> fcn;
+    auto fcnName = name(rec.name);
+    auto returnType = name(rec.type);
+    if (rec.kind == Kind::Static) {
+      fcn = std::make_unique<ast::StaticDecl>(
+          std::move(fcnName), std::move(returnType), std::move(params));
+    } else if (rec.kind == Kind::Method) {
+      fcn = std::make_unique<ast::MethodDecl>(
+          std::move(fcnName), std::move(returnType), std::move(params));
+    } else {
+      fcn = std::make_unique<ast::ConstructorDecl>(
+          std::move(fcnName), std::move(returnType), std::move(params));
+    }
+    fcn->setLocation({rec.line, rec.column});
+
+    if (rec.hasOptional) {
+      m_fcn = fcn.get();
+      fcn->addDefinition(block(child(idx, rec, numParams)));
+      m_fcn = nullptr;
+    }
+    return fcn;
+  }
+
+  std::unique_ptr<ast::Block> block(uint32_t idx) {
+    const Record rec = record(idx);
+    expect(rec, Kind::Block);
+    auto block = located(std::make_unique<ast::Block>(), rec);
+    for (uint32_t i = 0; i < rec.numChildren; ++i) {
+      block->addStmt(node(child(idx, rec, i)));
+    }
+    return block;
+  }
+
+  std::unique_ptr<ast::NamedValue> named(uint32_t idx) {
+    const Record rec = record(idx);
+    if (!m_fcn) throw Invalid{};
+    std::unique_ptr<ast::NamedValue> value;
+    if (rec.kind == Kind::Identifier) {
+      value = std::make_unique<ast::Identifier>(name(rec.name), m_fcn);
+    } else {
+      expect(rec, Kind::Index, 1);
+      value = std::make_unique<ast::IndexExpr>(
+          name(rec.name), node(child(idx, rec, 0)), m_fcn);
+    }
+    return located(std::move(value), rec);
+  }
+
+  ast::NodeList nodes(uint32_t idx, const Record &rec, uint32_t first) {
+    ast::NodeList list;
+    for (uint32_t i = first; i < rec.numChildren; ++i) {
+      list.push_back(node(child(idx, rec, i)));
+    }
+    return list;
+  }
+
+  std::unique_ptr<ast::Node> node(uint32_t idx) {
+    const Record rec = record(idx);
+    std::unique_ptr<ast::Node> expr;
+    switch (rec.kind) {
+      case Kind::Empty:
+        expr = std::make_unique<ast::EmptyNode>();
+        break;
+      case Kind::Int:
+        expr = std::make_unique<ast::IntConst>(rec.value);
+        break;
+      case Kind::Char:
+        expr = std::make_unique<ast::CharConst>(rec.value);
+        break;
+      case Kind::Str:
+        expr = std::make_unique<ast::StrConst>(name(rec.name));
+        break;
+      case Kind::Identifier:
+      case Kind::Index:
+        return named(idx);
+      case Kind::This:
+        expr = ast::Constant::getThis();
+        break;
+      case Kind::True:
+        expr = ast::Constant::getTrue();
+        break;
+      case Kind::False:
+        expr = ast::Constant::getFalse();
+        break;
+      case Kind::Binary:
+        expect(rec, Kind::Binary, 2);
+        expr = std::make_unique<ast::BinaryOp>(rec.op, node(child(idx, rec, 0)),
+                                               node(child(idx, rec, 1)));
+        break;
+      case Kind::Unary:
+        expect(rec, Kind::Unary, 1);
+        expr = std::make_unique<ast::UnaryOp>(rec.op, node(child(idx, rec, 0)));
+        break;
+      case Kind::MethodCall: {
+        expect(rec, Kind::MethodCall, rec.hasOptional ? 1 : 0);
+        auto callee = rec.hasOptional ? named(child(idx, rec, 0)) : nullptr;
+        expr = std::make_unique<ast::MethodCall>(
+            std::move(callee), name(rec.name),
+            nodes(idx, rec, rec.hasOptional ? 1 : 0));
+      } break;
+      case Kind::FunctionCall:
+        expr = std::make_unique<ast::FunctionCall>(
+            name(rec.type), name(rec.name), nodes(idx, rec, 0));
+        break;
+      case Kind::Let:
+        expect(rec, Kind::Let, 2);
+        expr = std::make_unique<ast::LetStmt>(named(child(idx, rec, 0)),
+                                              node(child(idx, rec, 1)));
+        break;
+      case Kind::If: {
+        expect(rec, Kind::If, rec.hasOptional ? 3 : 2);
+        auto cond = node(child(idx, rec, 0));
+        auto ifBlock = block(child(idx, rec, 1));
+        auto elseBlock = rec.hasOptional ? block(child(idx, rec, 2)) : nullptr;
+        expr = std::make_unique<ast::IfStmt>(
+            std::move(cond), std::move(ifBlock), std::move(elseBlock));
+      } break;
+      case Kind::While: {
+        expect(rec, Kind::While, 2);
+        auto cond = node(child(idx, rec, 0));
+        expr = std::make_unique<ast::WhileStmt>(std::move(cond),
+                                                block(child(idx, rec, 1)));
+      } break;
+      case Kind::Return:
+        expect(rec, Kind::Return, 1);
+        expr = std::make_unique<ast::ReturnStmt>(node(child(idx, rec, 0)));
+        break;
+      case Kind::Var: {
+        // Declared in the scope of the function, like the parser does
+        if (!m_fcn) throw Invalid{};
+        auto decl = var(idx);
+        m_fcn->getTable().addValue(decl.get());
+        return decl;
+      }
+      case Kind::Block:
+        return block(idx);
+      case Kind::RValue:
+        expect(rec, Kind::RValue, 1);
+        expr = ast::RValue(terminal(child(idx, rec, 0)));
+        break;
+      default:
+        throw Invalid{};
+    }
+    expr->setLocation({rec.line, rec.column});
+    return expr;
+  }
+
+  // The value wrapped by an RValue
+  std::unique_ptr<ast::Terminal> terminal(uint32_t idx) {
+    const Record rec = record(idx);
+    if (rec.kind == Kind::This) {
+      return located(ast::Constant::getThis(), rec);
+    }
+    return named(idx);
+  }
+};
+
+}  // namespace
+
+std::string ASTCache::serialize(const ast::ClassDecl &cls) {
+  Serializer serializer;
+  serializer.write(cls);
+  return serializer.take();
+}
+
+std::unique_ptr<ast::ClassDecl> ASTCache::deserialize(const char *data,
+                                                      size_t size) {
+  try {
+    return Deserializer{data, size}.cls();
+  } catch (const Invalid &) {
+    return nullptr;
+  }
+}
+
+uint64_t ASTCache::hash(const std::string &source) {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (const unsigned char c : source) {
+    hash ^= c;
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
+
+std::string ASTCache::path(const std::string &source) const {
+  char key[17];
+  snprintf(key, sizeof(key), "%016llx",
+           static_cast<unsigned long long>(hash(source)));
+  return m_dir + '/' + key + ".jast";
+}
+
+std::unique_ptr<ast::ClassDecl> ASTCache::load(
+    const std::string &source) const {
+  stats::ScopedTimer timer("parse.cache");
+  const int fd = open(path(source).c_str(), O_RDONLY);
+  if (fd < 0) return nullptr;
+
+  std::unique_ptr<ast::ClassDecl> cls;
+  struct stat st {};
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    const auto size = static_cast<size_t>(st.st_size);
+    void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED) {
+      cls = deserialize(static_cast<const char *>(data), size);
+      munmap(data, size);
+    }
+  }
+  close(fd);
+
+  if (cls) {
+    timer.setUnit(cls->getName());
+    stats::addCount("ast cache hits", cls->getName(), 1);
+  }
+  return cls;
+}
+
+bool ASTCache::store(const std::string &source,
+                     const ast::ClassDecl &cls) const {
+  mkdir(m_dir.c_str(), 0755);
+  const std::string data = serialize(cls);
+
+  // Written aside and renamed, so that a concurrent load never sees a partial
+  // entry
+  const std::string entry = path(source);
+  std::string tmp = entry + ".XXXXXX";
+  const int fd = mkstemp(tmp.data());
+  if (fd < 0) return false;
+  const bool written =
+      write(fd, data.data(), data.size()) == static_cast<ssize_t>(data.size());
+  close(fd);
+  if (!written || rename(tmp.c_str(), entry.c_str()) != 0) {
+    unlink(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+}  // namespace jcc::io
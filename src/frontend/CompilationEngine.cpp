@@ -1,11 +1,19 @@
 #include "CompilationEngine.hpp"
 
+#include <future>
+
 #include "ErrorHandling.hpp"
 #include "JackLexer.hpp"
+#include "Statistics.hpp"
 #include "SymbolTable.hpp"
 
 namespace jcc {
 
+namespace {
+// Below this many tokens per thread, the threads cost more than they save
+constexpr size_t kMinTokensPerThread = 8192;
+}  // namespace
+
 void reportError(const std::string &sourceFile, unsigned column, unsigned line,
                  const Token &actual, const Token &expected) {
   std::string msg =
@@ -21,6 +29,10 @@ void reportError(const std::string &sourceFile, unsigned column, unsigned line,
 }
 
 std::unique_ptr<ast::ClassDecl> CompilationEngine::compileClass() {
+  stats::ScopedTimer timer("parse");
+  const auto numNodes = ast::Node::numCreated();
+  const auto loc = getLoc();
+
   // class
   match(getTok(), Keyword(Keyword::Type::CLASS));
   m_tokenizer.advance();
@@ -29,7 +41,10 @@ std::unique_ptr<ast::ClassDecl> CompilationEngine::compileClass() {
   match(m_tokenizer.tokenType(), Token::Kind::IDENTIFIER);
   const auto clsName = m_tokenizer.getIdentifier();
   m_tokenizer.advance();
+  timer.setUnit(clsName);
   auto clsAst = std::make_unique<ast::ClassDecl>(clsName);
+  clsAst->setLocation(loc);
+  clsAst->setFile(m_filename);
   m_cls = clsAst.get();
   m_currentTable = &clsAst->getTable();
 
@@ -53,21 +68,38 @@ std::unique_ptr<ast::ClassDecl> CompilationEngine::compileClass() {
                   });
   }
 
-  // constructor | function | method  | []
-  while (getTok() == Keyword(Keyword::Type::CONSTRUCTOR) ||
-         getTok() == Keyword(Keyword::Type::FUNCTION) ||
-         getTok() == Keyword(Keyword::Type::METHOD)) {
-    if (getTok() == Keyword(Keyword::Type::METHOD)) {
-      clsAst->addMethod(compileSubroutineDec());
-    } else {
-      clsAst->addFunction(compileSubroutineDec());
+  try {
+    // constructor | function | method  | []
+    while (getTok() == Keyword(Keyword::Type::CONSTRUCTOR) ||
+           getTok() == Keyword(Keyword::Type::FUNCTION) ||
+           getTok() == Keyword(Keyword::Type::METHOD)) {
+      if (getTok() == Keyword(Keyword::Type::METHOD)) {
+        clsAst->addMethod(compileSubroutineDec());
+      } else {
+        clsAst->addFunction(compileSubroutineDec());
+      }
     }
-  }
-
-  // '}'
-  match(getTok(), Symbol('}'));
-  m_tokenizer.advance();
 
+    // '}'
+    match(getTok(), Symbol('}'));
+    m_tokenizer.advance();
+  } catch (const SyntaxError &) {
+    // The bodies recorded so far come first in the file, so do their errors
+    if (!m_recorded.empty()) compileRecordedBodies(*clsAst);
+    throw;
+  }
+  if (!m_recorded.empty()) compileRecordedBodies(*clsAst);
+
+  if (stats::Statistics::get().enabled()) {
+    stats::Statistics::get().addTime("parse.lex", clsName,
+                                     m_tokenizer.getLexTime(), -1);
+    stats::addCount("tokens", clsName, m_tokenizer.getNumTokens());
+    stats::addCount("ast nodes", clsName,
+                    ast::Node::numCreated() - numNodes + m_numRecordedNodes);
+    // As if the tokens were kept, only those of deferred bodies are
+    stats::addBytes("tokens", clsName,
+                    m_tokenizer.getNumTokens() * sizeof(LexedToken));
+  }
   return clsAst;
 }
 
@@ -91,10 +123,11 @@ ast::VarDecList CompilationEngine::compileClassVarDec() {
   // varName
   match(m_tokenizer.tokenType(), Token::Kind::IDENTIFIER);
   auto name = m_tokenizer.getIdentifier();
+  auto loc = getLoc();
   m_tokenizer.advance();
 
   // define the symbol in the table
-  vars.push_back(CreateVarDecl(std::move(name), type), kind);
+  vars.push_back(CreateVarDecl(std::move(name), type, loc), kind);
 
   // (',' varName)*
   const auto comma = Symbol(',');
@@ -106,9 +139,10 @@ ast::VarDecList CompilationEngine::compileClassVarDec() {
     // varName
     match(m_tokenizer.tokenType(), Token::Kind::IDENTIFIER);
     name = m_tokenizer.getIdentifier();
+    loc = getLoc();
     m_tokenizer.advance();
 
-    vars.push_back(CreateVarDecl(std::move(name), type), kind);
+    vars.push_back(CreateVarDecl(std::move(name), type, loc), kind);
   }
 
   // ;
@@ -118,6 +152,8 @@ ast::VarDecList CompilationEngine::compileClassVarDec() {
 }
 
 std::unique_ptr<ast::FunctionDecl> CompilationEngine::compileSubroutineDec() {
+  const auto loc = getLoc();
+
   // constructor | function | method
   match(getTok(), Keyword(Keyword::Type::CONSTRUCTOR),
         Keyword(Keyword::Type::FUNCTION), Keyword(Keyword::Type::METHOD));
@@ -161,8 +197,21 @@ std::unique_ptr<ast::FunctionDecl> CompilationEngine::compileSubroutineDec() {
     default:
       assert(false);
   }
+  fcn->setLocation(loc);
 
   // subroutineBody
+  if (m_deferBodies) {
+    fcn->deferDefinition(
+        [tokens = recordBody(), cls = m_cls, file = m_filename](
+            ast::FunctionDecl &decl) {
+          return CompilationEngine{tokens, file}.compileBody(*cls, decl);
+        });
+    return fcn;
+  }
+  if (m_parseThreads > 1) {
+    m_recorded.emplace_back(fcn.get(), recordBody());
+    return fcn;
+  }
   m_currentFcn = fcn.get();
   m_currentTable = &fcn->getTable();
   fcn->addDefinition(compileBody());
@@ -188,10 +237,12 @@ ast::ParamList CompilationEngine::compileParameterList() {
   // varName
   match(m_tokenizer.tokenType(), Token::Kind::IDENTIFIER);
   auto name = m_tokenizer.getIdentifier();
+  auto loc = getLoc();
   m_tokenizer.advance();
 
-  // Define symbols in the symbol table
-  params.push_back(CreateVarDecl(name, type));
+  // The parameters are declared in the table of their function when it is
+  // created, not in the current table
+  params.push_back(CreateParam(name, type, loc));
 
   // (',' varName)*
   const Token comma = Symbol(',');
@@ -207,9 +258,10 @@ ast::ParamList CompilationEngine::compileParameterList() {
     // varName
     match(m_tokenizer.tokenType(), Token::Kind::IDENTIFIER);
     name = m_tokenizer.getIdentifier();
+    loc = getLoc();
     m_tokenizer.advance();
 
-    params.push_back(CreateVarDecl(name, type));
+    params.push_back(CreateParam(name, type, loc));
   }
 
   return params;
@@ -217,6 +269,7 @@ ast::ParamList CompilationEngine::compileParameterList() {
 
 std::unique_ptr<ast::Block> CompilationEngine::compileBody() {
   auto expr = std::make_unique<ast::Block>();
+  expr->setLocation(getLoc());
 
   // {
   match(getTok(), Symbol('{'));
@@ -232,30 +285,7 @@ std::unique_ptr<ast::Block> CompilationEngine::compileBody() {
   }
 
   // statement
-  if (getTok() != Symbol('}')) {
-    while (m_tokenizer.tokenType() == Token::Kind::KEYWORD) {
-      match(m_tokenizer.tokenType(), Token::Kind::KEYWORD);
-      switch (m_tokenizer.getKeyword()) {
-        case Keyword::Type::LET:
-          expr->addStmt(compileLet());
-          break;
-        case Keyword::Type::IF:
-          expr->addStmt(compileIf());
-          break;
-        case Keyword::Type::WHILE:
-          expr->addStmt(compileWhile());
-          break;
-        case Keyword::Type::DO:
-          expr->addStmt(compileDo());
-          break;
-        case Keyword::Type::RETURN:
-          expr->addStmt(compileReturn());
-          break;
-        default:
-          assert(false);
-      }
-    }
-  }
+  if (getTok() != Symbol('}')) { compileStatementList(*expr); }
 
   // }
   match(getTok(), Symbol('}'));
@@ -264,6 +294,173 @@ std::unique_ptr<ast::Block> CompilationEngine::compileBody() {
   return expr;
 }
 
+std::shared_ptr<const TokenList> CompilationEngine::recordBody() {
+  const Token open = Symbol('{');
+  const Token close = Symbol('}');
+  match(getTok(), open);
+
+  auto tokens = std::make_shared<TokenList>();
+  size_t depth = 0;
+  do {
+    if (getTok().isNull()) {
+      throw SyntaxError(m_filename, m_tokenizer.getColNumber(),
+                        m_tokenizer.getLineNumber(),
+                        "Unexpected end of file in a subroutine body");
+    }
+    if (getTok() == open) {
+      ++depth;
+    } else if (getTok() == close) {
+      --depth;
+    }
+    tokens->push_back({getTok(), m_tokenizer.getTokenLine(),
+                       m_tokenizer.getTokenColumn(),
+                       m_tokenizer.getLineNumber(),
+                       m_tokenizer.getColNumber()});
+    m_tokenizer.advance();
+  } while (depth > 0);
+  return tokens;
+}
+
+void CompilationEngine::compileRecordedBodies(ast::ClassDecl &cls) {
+  auto bodies = std::move(m_recorded);
+  m_recorded.clear();
+  size_t numTokens = 0;
+  for (const auto &body : bodies) numTokens += body.second->size();
+
+  // Parse the bodies [begin, end) in the order of the file. Returns the
+  // number of nodes created and the first syntax error
+  using RangeResult = std::pair<size_t, std::exception_ptr>;
+  auto compileRange = [&](size_t begin, size_t end) {
+    const auto numNodes = ast::Node::numCreated();
+    std::exception_ptr error;
+    for (size_t i = begin; i < end && !error; ++i) {
+      auto &[fcn, tokens] = bodies[i];
+      try {
+        fcn->addDefinition(
+            CompilationEngine{tokens, m_filename}.compileBody(cls, *fcn));
+      } catch (const SyntaxError &) {
+        error = std::current_exception();
+      }
+    }
+    return RangeResult{ast::Node::numCreated() - numNodes, error};
+  };
+
+  const size_t numThreads = std::min<size_t>(
+      {m_parseThreads, bodies.size(), numTokens / kMinTokensPerThread});
+  if (numThreads <= 1) {
+    if (auto error = compileRange(0, bodies.size()).second) {
+      std::rethrow_exception(error);
+    }
+    return;
+  }
+
+  // Each range but the last has at least its share of the tokens, so there
+  // are no more ranges than threads
+  const size_t share = (numTokens + numThreads - 1) / numThreads;
+  std::vector<std::future<RangeResult>> ranges;
+  for (size_t begin = 0, end = 0; begin < bodies.size(); begin = end) {
+    for (size_t size = 0; end < bodies.size() && size < share; ++end) {
+      size += bodies[end].second->size();
+    }
+    ranges.push_back(std::async(std::launch::async, compileRange, begin, end));
+  }
+
+  // The nodes of the other threads are not counted by this one
+  std::exception_ptr first;
+  for (auto &range : ranges) {
+    const auto [numNodes, error] = range.get();
+    m_numRecordedNodes += numNodes;
+    if (!first) first = error;
+  }
+  if (first) std::rethrow_exception(first);
+}
+
+void CompilationEngine::compileStatementList(ast::Block &block) {
+  while (m_tokenizer.tokenType() == Token::Kind::KEYWORD) {
+    match(m_tokenizer.tokenType(), Token::Kind::KEYWORD);
+    switch (m_tokenizer.getKeyword()) {
+      case Keyword::Type::LET:
+        block.addStmt(compileLet());
+        break;
+      case Keyword::Type::IF:
+        block.addStmt(compileIf());
+        break;
+      case Keyword::Type::WHILE:
+        block.addStmt(compileWhile());
+        break;
+      case Keyword::Type::DO:
+        block.addStmt(compileDo());
+        break;
+      case Keyword::Type::RETURN:
+        block.addStmt(compileReturn());
+        break;
+      default:
+        assert(false);
+    }
+  }
+}
+
+ast::ParamList CompilationEngine::compileStaticVarDec(ast::ClassDecl &cls) {
+  // Declare the variables in a scope of the class table so that a declaration
+  // that fails to parse leaves the class untouched. The caller adds them
+  enterScope(cls, nullptr);
+  cls.getTable().push();
+
+  ast::ParamList statics;
+  try {
+    for (auto &var : compileVarDec()) {
+      statics.emplace_back(static_cast<ast::VarDecl *>(var.release()));
+    }
+    expectEnd();
+  } catch (...) {
+    cls.getTable().pop();
+    throw;
+  }
+
+  cls.getTable().pop();
+  return statics;
+}
+
+std::unique_ptr<ast::Block> CompilationEngine::compileStatements(
+    ast::ClassDecl &cls, ast::FunctionDecl &fcn) {
+  enterScope(cls, &fcn);
+  auto block = std::make_unique<ast::Block>();
+  compileStatementList(*block);
+  expectEnd();
+  return block;
+}
+
+std::unique_ptr<ast::Node> CompilationEngine::compileExpression(
+    ast::ClassDecl &cls, ast::FunctionDecl &fcn) {
+  enterScope(cls, &fcn);
+  auto expr = compileExpression();
+  expectEnd();
+  return expr;
+}
+
+std::unique_ptr<ast::Block> CompilationEngine::compileBody(
+    ast::ClassDecl &cls, ast::FunctionDecl &fcn) {
+  enterScope(cls, &fcn);
+  auto body = compileBody();
+  expectEnd();
+  return body;
+}
+
+void CompilationEngine::enterScope(ast::ClassDecl &cls,
+                                   ast::FunctionDecl *fcn) {
+  m_cls = &cls;
+  m_currentFcn = fcn;
+  m_currentTable = fcn ? &fcn->getTable() : &cls.getTable();
+}
+
+void CompilationEngine::expectEnd() {
+  if (!getTok().isNull()) {
+    throw SyntaxError(m_filename, m_tokenizer.getColNumber(),
+                      m_tokenizer.getLineNumber(),
+                      "Unexpected " + getTok().print());
+  }
+}
+
 ast::NodeList CompilationEngine::compileVarDec() {
   ast::NodeList vars;
 
@@ -278,9 +475,10 @@ ast::NodeList CompilationEngine::compileVarDec() {
   // varName
   match(m_tokenizer.tokenType(), Token::Kind::IDENTIFIER);
   auto name = m_tokenizer.getIdentifier();
+  auto loc = getLoc();
   m_tokenizer.advance();
 
-  vars.push_back(CreateVarDecl(name, type));
+  vars.push_back(CreateVarDecl(name, type, loc));
 
   // (, varName)*
   while (getTok() == Symbol(',')) {
@@ -291,9 +489,10 @@ ast::NodeList CompilationEngine::compileVarDec() {
     // varName
     match(m_tokenizer.tokenType(), Token::Kind::IDENTIFIER);
     name = m_tokenizer.getIdentifier();
+    loc = getLoc();
     m_tokenizer.advance();
 
-    vars.push_back(CreateVarDecl(name, type));
+    vars.push_back(CreateVarDecl(name, type, loc));
   }
 
   // ;
@@ -314,17 +513,21 @@ std::unique_ptr<ast::Node> CompilationEngine::compileExpression() {
         op != Symbol::GT && op != Symbol::LT && op != Symbol::EQ) {
       break;
     }
+    const auto loc = getLoc();
     m_tokenizer.advance();
 
     // term
     expr = std::make_unique<ast::BinaryOp>(Symbol::toChar(op), std::move(expr),
                                            compileTerm());
+    expr->setLocation(loc);
   }
 
   return expr;
 }
 
 std::unique_ptr<ast::Node> CompilationEngine::compileLet() {
+  const auto loc = getLoc();
+
   // let
   match(getTok(), Keyword(Keyword::Type::LET));
   m_tokenizer.advance();
@@ -332,6 +535,7 @@ std::unique_ptr<ast::Node> CompilationEngine::compileLet() {
   // varName
   match(m_tokenizer.tokenType(), Token::Kind::IDENTIFIER);
   const auto varName = m_tokenizer.getIdentifier();
+  const auto varLoc = getLoc();
   m_tokenizer.advance();
 
   // ?[ (array)
@@ -348,6 +552,7 @@ std::unique_ptr<ast::Node> CompilationEngine::compileLet() {
   } else {
     lhs = CreateNamedValue<ast::Identifier>(varName);
   }
+  lhs->setLocation(varLoc);
 
   // =
   match(getTok(), Symbol('='));
@@ -356,6 +561,7 @@ std::unique_ptr<ast::Node> CompilationEngine::compileLet() {
   // expression
   auto expr =
       std::make_unique<ast::LetStmt>(std::move(lhs), compileExpression());
+  expr->setLocation(loc);
 
   // ;
   match(getTok(), Symbol(';'));
@@ -365,6 +571,8 @@ std::unique_ptr<ast::Node> CompilationEngine::compileLet() {
 }
 
 std::unique_ptr<ast::Node> CompilationEngine::compileIf() {
+  const auto loc = getLoc();
+
   // if
   match(getTok(), Keyword(Keyword::Type::IF));
   m_tokenizer.advance();
@@ -390,11 +598,15 @@ std::unique_ptr<ast::Node> CompilationEngine::compileIf() {
     elseBranch = compileBody();
   }
 
-  return std::make_unique<ast::IfStmt>(
+  auto stmt = std::make_unique<ast::IfStmt>(
       std::move(condition), std::move(ifBranch), std::move(elseBranch));
+  stmt->setLocation(loc);
+  return stmt;
 }
 
 std::unique_ptr<ast::Node> CompilationEngine::compileWhile() {
+  const auto loc = getLoc();
+
   // while
   match(getTok(), Keyword(Keyword::Type::WHILE));
   m_tokenizer.advance();
@@ -411,11 +623,15 @@ std::unique_ptr<ast::Node> CompilationEngine::compileWhile() {
   m_tokenizer.advance();
 
   // { statements }
-  return std::make_unique<ast::WhileStmt>(std::move(condition), compileBody());
+  auto stmt =
+      std::make_unique<ast::WhileStmt>(std::move(condition), compileBody());
+  stmt->setLocation(loc);
+  return stmt;
 }
 
 std::unique_ptr<ast::Node> CompilationEngine::compileDo() {
   std::unique_ptr<ast::Node> call;
+  const auto loc = getLoc();
 
   // do
   match(getTok(), Keyword(Keyword::Type::DO));
@@ -487,10 +703,14 @@ std::unique_ptr<ast::Node> CompilationEngine::compileDo() {
   match(getTok(), Symbol(';'));
   m_tokenizer.advance();
 
-  return CreateCall(std::move(args));
+  call = CreateCall(std::move(args));
+  call->setLocation(loc);
+  return call;
 }
 
 std::unique_ptr<ast::ReturnStmt> CompilationEngine::compileReturn() {
+  const auto loc = getLoc();
+
   // return
   match(getTok(), Keyword(Keyword::Type::RETURN));
   m_tokenizer.advance();
@@ -499,6 +719,7 @@ std::unique_ptr<ast::ReturnStmt> CompilationEngine::compileReturn() {
   auto expr = std::make_unique<ast::ReturnStmt>(
       getTok() != Symbol(';') ? compileExpression()
                               : std::make_unique<ast::EmptyNode>());
+  expr->setLocation(loc);
 
   // ;
   match(getTok(), Symbol(';'));
@@ -509,6 +730,7 @@ std::unique_ptr<ast::ReturnStmt> CompilationEngine::compileReturn() {
 
 std::unique_ptr<ast::Node> CompilationEngine::compileTerm() {
   std::unique_ptr<ast::Node> expr;
+  const auto loc = getLoc();
   // identifier, integer constant, or string constant
   switch (m_tokenizer.tokenType()) {
     case Token::Kind::IDENTIFIER: {
@@ -532,6 +754,7 @@ std::unique_ptr<ast::Node> CompilationEngine::compileTerm() {
       } else if (isNamedValue(identifier)) {
         namedValue = CreateNamedValue<ast::Identifier>(identifier);
       }
+      if (namedValue) namedValue->setLocation(loc);
 
       if (getTok() == Symbol('.')) {
         // the identifier is a function call for another class or a
@@ -583,6 +806,10 @@ std::unique_ptr<ast::Node> CompilationEngine::compileTerm() {
 
       } else {
         // just a varName
+        if (!namedValue) {
+          throw SyntaxError(m_filename, loc.column, loc.line,
+                            "Undefined variable " + identifier);
+        }
         expr = RValue(std::move(namedValue));
       }
     } break;
@@ -596,12 +823,13 @@ std::unique_ptr<ast::Node> CompilationEngine::compileTerm() {
           assert(false && "unreachable!");
         case Symbol::L_PAREN:
           expr = compileExpression();
-          match(getTok(), Symbol(sym));
+          match(getTok(), Symbol(')'));
           m_tokenizer.advance();
           break;
         case Symbol::NOT:
         case Symbol::MINUS:
-          expr = std::make_unique<ast::UnaryOp>(sym, compileTerm());
+          expr = std::make_unique<ast::UnaryOp>(Symbol::toChar(sym),
+                                                compileTerm());
       }
     } break;
     case Token::Kind::INTEGER_CONSTANT: {
@@ -639,6 +867,8 @@ std::unique_ptr<ast::Node> CompilationEngine::compileTerm() {
       assert(false);  // won't get here
   }
   assert(expr);
+  // A parenthesized expression keeps the location of its first operand
+  if (!expr->getLocation().isValid()) expr->setLocation(loc);
   return expr;
 }
 
@@ -685,21 +915,33 @@ std::unique_ptr<ast::NamedValue> CompilationEngine::CreateNamedValue(
 
   // Check for the existance of the identifier. If it does not exist, the we
   // should throw an error
-  assert(m_currentFcn->getTable().lookup(v->getName()) ||
-         m_cls->getTable().lookup(v->getName()));
+  if (!isNamedValue(v->getName())) {
+    throw SyntaxError(m_filename, m_tokenizer.getColNumber(),
+                      m_tokenizer.getLineNumber(),
+                      "Undefined identifier " + v->getName());
+  }
 
   return v;
 }
 
 std::unique_ptr<ast::VarDecl> CompilationEngine::CreateVarDecl(
-    std::string name, std::string type) {
+    std::string name, std::string type, ast::SourceLocation loc) {
   auto var = std::make_unique<ast::VarDecl>(std::move(name), std::move(type));
+  var->setLocation(loc);
   m_currentTable->addValue(var.get());
   return var;
 }
 
+std::unique_ptr<ast::VarDecl> CompilationEngine::CreateParam(
+    std::string name, std::string type, ast::SourceLocation loc) {
+  auto param =
+      std::make_unique<ast::VarDecl>(std::move(name), std::move(type));
+  param->setLocation(loc);
+  return param;
+}
+
 bool CompilationEngine::isNamedValue(const std::string &name) const {
-  return m_currentFcn->getTable().lookup(name) ||
+  return (m_currentFcn && m_currentFcn->getTable().lookup(name)) ||
          m_cls->getTable().lookup(name);
 }
 
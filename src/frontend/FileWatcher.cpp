@@ -0,0 +1,69 @@
+#include "FileWatcher.hpp"
+
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+namespace jcc::io {
+
+#ifdef __linux__
+
+FileWatcher::FileWatcher() : m_fd{inotify_init1(IN_NONBLOCK | IN_CLOEXEC)} {}
+
+FileWatcher::~FileWatcher() {
+  if (m_fd >= 0) close(m_fd);
+}
+
+bool FileWatcher::add(const std::string &dir) {
+  if (m_fd < 0) return false;
+  const int wd =
+      inotify_add_watch(m_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+  if (wd < 0) return false;
+  m_dirs[wd] = dir;
+  return true;
+}
+
+std::vector<std::string> FileWatcher::wait(int timeoutMs) {
+  std::vector<std::string> paths;
+  if (m_fd < 0) return paths;
+  pollfd pfd{m_fd, POLLIN, 0};
+  if (poll(&pfd, 1, timeoutMs) <= 0) return paths;
+
+  alignas(inotify_event) char buffer[4096];
+  ssize_t size = 0;
+  while ((size = read(m_fd, buffer, sizeof(buffer))) > 0) {
+    for (ssize_t offset = 0; offset < size;) {
+      const auto *event = reinterpret_cast<const inotify_event *>(
+          buffer + offset);  // NOLINT
+      offset += sizeof(inotify_event) + event->len;
+      auto dir = m_dirs.find(event->wd);
+      if (event->len == 0 || dir == m_dirs.end()) continue;
+
+      std::string path = dir->second + '/' + event->name;
+      if (std::find(paths.begin(), paths.end(), path) == paths.end()) {
+        paths.push_back(std::move(path));
+      }
+    }
+  }
+  return paths;
+}
+
+#else
+
+FileWatcher::FileWatcher() = default;
+FileWatcher::~FileWatcher() = default;
+bool FileWatcher::add(const std::string &) { return false; }
+
+std::vector<std::string> FileWatcher::wait(int timeoutMs) {
+  poll(nullptr, 0, timeoutMs);
+  return {};
+}
+
+#endif
+
+}  // namespace jcc::io
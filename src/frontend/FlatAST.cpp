@@ -0,0 +1,242 @@
+#include "FlatAST.hpp"
+
+namespace jcc::ast {
+
+// Appends the nodes of a tree in preorder
+class FlatBuilder : public ImmutableVisitor {
+public:
+  FlatAST take() { return std::move(m_ast); }
+
+  FlatAST::Index write(const Node &node) {
+    node.accept(*this);
+    return m_last;
+  }
+
+  void visit(const EmptyNode &node) override {
+    add(node, FlatAST::Kind::Empty);
+  }
+  void visit(const True &node) override { add(node, FlatAST::Kind::True); }
+  void visit(const False &node) override { add(node, FlatAST::Kind::False); }
+  void visit(const This &node) override { add(node, FlatAST::Kind::This); }
+  void visit(const IntConst &node) override {
+    m_ast.m_values[add(node, FlatAST::Kind::Int)] = node.getInt();
+  }
+  void visit(const CharConst &node) override {
+    m_ast.m_values[add(node, FlatAST::Kind::Char)] = node.getChar();
+  }
+  void visit(const StrConst &node) override {
+    const auto idx = add(node, FlatAST::Kind::Str, node.getString());
+    if (node.isBorrowed()) m_ast.m_flags[idx] |= FlatAST::kBorrowed;
+  }
+  void visit(const Identifier &node) override {
+    const auto idx = add(node, FlatAST::Kind::Identifier, node.getName());
+    m_ast.m_slots[idx] = node.getSlot();
+    std::vector<FlatAST::Index> children;
+    writeObject(idx, node, children);
+    setChildren(idx, children);
+  }
+  void visit(const IndexExpr &node) override {
+    const auto idx = add(node, FlatAST::Kind::Index, node.getName());
+    m_ast.m_slots[idx] = node.getSlot();
+    std::vector<FlatAST::Index> children{write(*node.getIndex())};
+    writeObject(idx, node, children);
+    setChildren(idx, children);
+  }
+
+  void visit(const BinaryOp &node) override {
+    const auto idx = add(node, FlatAST::Kind::Binary);
+    m_ast.m_values[idx] = node.getOp();
+    setChildren(idx, {write(*node.getLHS()), write(*node.getRHS())});
+  }
+  void visit(const UnaryOp &node) override {
+    const auto idx = add(node, FlatAST::Kind::Unary);
+    m_ast.m_values[idx] = node.getOp();
+    setChildren(idx, {write(*node.getOperand())});
+  }
+
+  void visit(const MethodCall &node) override {
+    const auto idx = add(node, FlatAST::Kind::MethodCall, node.getName());
+    std::vector<FlatAST::Index> children;
+    if (node.getCallee()) {
+      m_ast.m_flags[idx] |= FlatAST::kOptional;
+      children.push_back(write(*node.getCallee()));
+    }
+    writeAll(node.args_begin(), node.args_end(), children);
+    setChildren(idx, children);
+  }
+  void visit(const FunctionCall &node) override {
+    const auto idx = add(node, FlatAST::Kind::FunctionCall, node.getName(),
+                         node.getClassType());
+    std::vector<FlatAST::Index> children;
+    writeAll(node.args_begin(), node.args_end(), children);
+    setChildren(idx, children);
+  }
+
+  void visit(const LetStmt &node) override {
+    const auto idx = add(node, FlatAST::Kind::Let);
+    setChildren(idx,
+                {write(*node.getAssignee()), write(*node.getExpression())});
+  }
+  void visit(const IfStmt &node) override {
+    const auto idx = add(node, FlatAST::Kind::If);
+    std::vector<FlatAST::Index> children{write(*node.getCond()),
+                                         write(*node.getIfBlock())};
+    if (node.getElseBlock()) {
+      m_ast.m_flags[idx] |= FlatAST::kOptional;
+      children.push_back(write(*node.getElseBlock()));
+    }
+    setChildren(idx, children);
+  }
+  void visit(const WhileStmt &node) override {
+    const auto idx = add(node, FlatAST::Kind::While);
+    setChildren(idx, {write(*node.getCond()), write(*node.getBlock())});
+  }
+  void visit(const ReturnStmt &node) override {
+    const auto idx = add(node, FlatAST::Kind::Return);
+    setChildren(idx, {write(*node.getExpr())});
+  }
+
+  void visit(const VarDecl &node) override {
+    const auto idx =
+        add(node, FlatAST::Kind::Var, node.getName(), node.getType());
+    m_ast.m_slots[idx] = node.getSlot();
+  }
+  void visit(const StaticDecl &node) override {
+    visitFunction(node, FlatAST::Kind::Static);
+  }
+  void visit(const MethodDecl &node) override {
+    visitFunction(node, FlatAST::Kind::Method);
+  }
+  void visit(const ConstructorDecl &node) override {
+    visitFunction(node, FlatAST::Kind::Constructor);
+  }
+  void visit(const ClassDecl &node) override {
+    const auto idx =
+        add(node, FlatAST::Kind::Class, node.getName(), node.getFile());
+    std::vector<FlatAST::Index> children;
+    for (auto it = node.fields_begin(); it != node.fields_end(); ++it) {
+      children.push_back(write(**it));
+      m_ast.m_values[children.back()] = static_cast<int32_t>(sym::Kind::FIELD);
+    }
+    for (auto it = node.statics_begin(); it != node.statics_end(); ++it) {
+      children.push_back(write(**it));
+      m_ast.m_values[children.back()] =
+          static_cast<int32_t>(sym::Kind::STATIC);
+    }
+    writeAll(node.fcns_begin(), node.fcns_end(), children);
+    writeAll(node.mths_begin(), node.mths_end(), children);
+    setChildren(idx, children);
+  }
+  void visit(const Block &node) override {
+    const auto idx = add(node, FlatAST::Kind::Block);
+    std::vector<FlatAST::Index> children;
+    writeAll(node.stmts_begin(), node.stmts_end(), children);
+    setChildren(idx, children);
+  }
+
+  void visit(const RValueT &node) override {
+    const auto idx = add(node, FlatAST::Kind::RValue);
+    setChildren(idx, {write(*node.getWrapped())});
+  }
+
+private:
+  FlatAST m_ast;
+  std::unordered_map<std::string, uint32_t> m_stringIds;
+  // ExprTypes by their printed form, which tells them apart
+  std::unordered_map<std::string, uint32_t> m_exprTypeIds;
+  FlatAST::Index m_last = 0;
+
+  uint32_t intern(const std::string &str) {
+    auto [found, inserted] = m_stringIds.emplace(
+        str, static_cast<uint32_t>(m_ast.m_strings.size()));
+    if (inserted) m_ast.m_strings.push_back(str);
+    return found->second;
+  }
+
+  uint32_t intern(const ExprType &type) {
+    auto [found, inserted] = m_exprTypeIds.emplace(
+        type.toString(), static_cast<uint32_t>(m_ast.m_exprTypes.size()));
+    if (inserted) m_ast.m_exprTypes.push_back(type);
+    return found->second;
+  }
+
+  FlatAST::Index add(const Node &node, FlatAST::Kind kind,
+                     const std::string &name = {},
+                     const std::string &type = {}) {
+    m_last = static_cast<FlatAST::Index>(m_ast.m_kinds.size());
+    m_ast.m_kinds.push_back(kind);
+    m_ast.m_flags.push_back(0);
+    m_ast.m_locations.push_back(node.getLocation().pack());
+    m_ast.m_values.push_back(0);
+    m_ast.m_names.push_back(intern(name));
+    m_ast.m_types.push_back(intern(type));
+    m_ast.m_exprTypeIds.push_back(intern(node.getExprType()));
+    m_ast.m_slots.emplace_back();
+    m_ast.m_firstChild.push_back(0);
+    m_ast.m_numChildren.push_back(0);
+    return m_last;
+  }
+
+  // The children are recorded after their own children, so that the
+  // children of a node are contiguous
+  void setChildren(FlatAST::Index idx,
+                   const std::vector<FlatAST::Index> &children) {
+    m_ast.m_firstChild[idx] = static_cast<FlatAST::Index>(
+        m_ast.m_children.size());
+    m_ast.m_numChildren[idx] = static_cast<uint32_t>(children.size());
+    m_ast.m_children.insert(m_ast.m_children.end(), children.begin(),
+                            children.end());
+    m_last = idx;
+  }
+
+  template <typename ForwardIt>
+  void writeAll(ForwardIt begin, ForwardIt end,
+                std::vector<FlatAST::Index> &children) {
+    for (; begin != end; ++begin) children.push_back(write(**begin));
+  }
+
+  void writeObject(FlatAST::Index idx, const NamedValue &node,
+                   std::vector<FlatAST::Index> &children) {
+    if (node.getObject()) {
+      m_ast.m_flags[idx] |= FlatAST::kOptional;
+      children.push_back(write(*node.getObject()));
+    }
+  }
+
+  void visitFunction(const FunctionDecl &node, FlatAST::Kind kind) {
+    const auto idx = add(node, kind, node.getName(), node.getReturnType());
+    std::vector<FlatAST::Index> children;
+    writeAll(node.prms_begin(), node.prms_end(), children);
+    if (node.getDefinition()) {
+      m_ast.m_flags[idx] |= FlatAST::kOptional;
+      children.push_back(write(*node.getDefinition()));
+    }
+    setChildren(idx, children);
+  }
+};
+
+FlatAST FlatAST::build(const Node &root) {
+  FlatBuilder builder;
+  builder.write(root);
+  return builder.take();
+}
+
+size_t FlatAST::memoryUsage() const {
+  size_t bytes = m_kinds.capacity() * sizeof(Kind) + m_flags.capacity() +
+                 m_locations.capacity() * sizeof(uint32_t) +
+                 m_values.capacity() * sizeof(int32_t) +
+                 m_names.capacity() * sizeof(uint32_t) +
+                 m_types.capacity() * sizeof(uint32_t) +
+                 m_exprTypeIds.capacity() * sizeof(uint32_t) +
+                 m_slots.capacity() * sizeof(Slot) +
+                 m_firstChild.capacity() * sizeof(Index) +
+                 m_numChildren.capacity() * sizeof(uint32_t) +
+                 m_children.capacity() * sizeof(Index);
+  for (const auto &str : m_strings) bytes += sizeof(str) + str.capacity();
+  for (const auto &type : m_exprTypes) {
+    bytes += sizeof(type) + type.name.capacity();
+  }
+  return bytes;
+}
+
+}  // namespace jcc::ast
@@ -53,6 +53,8 @@ ReParse:
     eat();
   }
 
+  m_tokLine = m_lineNum;
+  m_tokCol = m_colNum;
   if (peek() == '/') {
     auto c = eat();
     if (peek() == '/') {
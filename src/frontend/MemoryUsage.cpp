@@ -0,0 +1,165 @@
+#include "MemoryUsage.hpp"
+
+#include "JackAST.hpp"
+#include "Statistics.hpp"
+
+namespace jcc::ast {
+
+namespace {
+
+class Counter : public ImmutableVisitor {
+public:
+  explicit Counter(MemoryUsage &usage) : m_usage{usage} {}
+
+  void visit(const EmptyNode &node) override { add("EmptyNode", node); }
+  void visit(const True &node) override { add("True", node); }
+  void visit(const False &node) override { add("False", node); }
+  void visit(const This &node) override { add("This", node); }
+  void visit(const IntConst &node) override { add("IntConst", node); }
+  void visit(const CharConst &node) override { add("CharConst", node); }
+  void visit(const StrConst &node) override {
+    add("StrConst", node, stats::heapBytes(node.getString()));
+  }
+  void visit(const Identifier &node) override {
+    add("Identifier", node, stats::heapBytes(node.getName()));
+    if (node.getObject()) node.getObject()->accept(*this);
+  }
+  void visit(const IndexExpr &node) override {
+    add("IndexExpr", node, stats::heapBytes(node.getName()));
+    if (node.getObject()) node.getObject()->accept(*this);
+    node.getIndex()->accept(*this);
+  }
+
+  void visit(const BinaryOp &node) override {
+    add("BinaryOp", node);
+    node.getLHS()->accept(*this);
+    node.getRHS()->accept(*this);
+  }
+  void visit(const UnaryOp &node) override {
+    add("UnaryOp", node);
+    node.getOperand()->accept(*this);
+  }
+
+  void visit(const MethodCall &node) override {
+    add("MethodCall", node, callBytes(node));
+    if (node.getCallee()) node.getCallee()->accept(*this);
+    visitAll(node.args_begin(), node.args_end());
+  }
+  void visit(const FunctionCall &node) override {
+    add("FunctionCall", node,
+        callBytes(node) + stats::heapBytes(node.getClassType()));
+    visitAll(node.args_begin(), node.args_end());
+  }
+
+  void visit(const LetStmt &node) override {
+    add("LetStmt", node);
+    node.getAssignee()->accept(*this);
+    node.getExpression()->accept(*this);
+  }
+  void visit(const IfStmt &node) override {
+    add("IfStmt", node);
+    node.getCond()->accept(*this);
+    node.getIfBlock()->accept(*this);
+    if (node.getElseBlock()) node.getElseBlock()->accept(*this);
+  }
+  void visit(const WhileStmt &node) override {
+    add("WhileStmt", node);
+    node.getCond()->accept(*this);
+    node.getBlock()->accept(*this);
+  }
+  void visit(const ReturnStmt &node) override {
+    add("ReturnStmt", node);
+    node.getExpr()->accept(*this);
+  }
+
+  void visit(const VarDecl &node) override {
+    add("VarDecl", node,
+        stats::heapBytes(node.getName()) + stats::heapBytes(node.getType()));
+  }
+  void visit(const StaticDecl &node) override {
+    visitFunction("StaticDecl", node);
+  }
+  void visit(const MethodDecl &node) override {
+    visitFunction("MethodDecl", node);
+  }
+  void visit(const ConstructorDecl &node) override {
+    visitFunction("ConstructorDecl", node);
+  }
+  void visit(const ClassDecl &node) override {
+    const size_t numMembers = node.numFields() + node.numStatics() +
+                              node.numFunctions() + node.numMethods();
+    add("ClassDecl", node,
+        stats::heapBytes(node.getName()) + stats::heapBytes(node.getFile()) +
+            numMembers * sizeof(NodePtr));
+    m_usage.symbols += node.getTable().memoryUsage();
+    if (m_usage.cls.empty()) m_usage.cls = node.getName();
+    visitAll(node.fields_begin(), node.fields_end());
+    visitAll(node.statics_begin(), node.statics_end());
+    visitAll(node.fcns_begin(), node.fcns_end());
+    visitAll(node.mths_begin(), node.mths_end());
+  }
+  void visit(const Block &node) override {
+    add("Block", node, node.numStmts() * sizeof(NodePtr));
+    visitAll(node.stmts_begin(), node.stmts_end());
+  }
+
+  void visit(const RValueT &node) override {
+    add("RValueT", node);
+    node.getWrapped()->accept(*this);
+  }
+
+private:
+  MemoryUsage &m_usage;
+
+  // The object of the node, its type and what it owns besides its children
+  template <typename T>
+  void add(const char *kind, const T &node, uint64_t owned = 0) {
+    m_usage.nodes[kind] +=
+        sizeof(T) + stats::heapBytes(node.getExprType().name) + owned;
+  }
+
+  static uint64_t callBytes(const Call &call) {
+    return stats::heapBytes(call.getName()) +
+           std::distance(call.args_begin(), call.args_end()) * sizeof(NodePtr);
+  }
+
+  template <typename ForwardIt>
+  void visitAll(ForwardIt begin, ForwardIt end) {
+    for (; begin != end; ++begin) (*begin)->accept(*this);
+  }
+
+  template <typename T>
+  void visitFunction(const char *kind, const T &node) {
+    add(kind, node,
+        stats::heapBytes(node.getName()) +
+            stats::heapBytes(node.getReturnType()) +
+            node.numParams() * sizeof(NodePtr));
+    m_usage.symbols += node.getTable().memoryUsage();
+    visitAll(node.prms_begin(), node.prms_end());
+    if (node.getDefinition()) node.getDefinition()->accept(*this);
+  }
+};
+
+}  // namespace
+
+MemoryUsage MemoryUsage::of(const Node &root) {
+  MemoryUsage usage;
+  Counter counter{usage};
+  root.accept(counter);
+  return usage;
+}
+
+uint64_t MemoryUsage::numNodeBytes() const {
+  uint64_t bytes = 0;
+  for (const auto &[kind, kindBytes] : nodes) bytes += kindBytes;
+  return bytes;
+}
+
+void MemoryUsage::record() const {
+  for (const auto &[kind, bytes] : nodes) {
+    stats::addBytes(("ast." + kind).c_str(), cls, bytes);
+  }
+  stats::addBytes("symbols", cls, symbols);
+}
+
+}  // namespace jcc::ast
@@ -0,0 +1,221 @@
+#include "Statistics.hpp"
+
+#include <sys/resource.h>
+
+#include <cstdio>
+#include <ctime>
+
+namespace jcc::stats {
+
+namespace {
+
+// Escape a string for use as a JSON string literal
+std::string quote(const std::string &str) {
+  std::string quoted = "\"";
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      quoted += '\\';
+      quoted += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\u%04x", c);
+      quoted += buf;
+    } else {
+      quoted += c;
+    }
+  }
+  return quoted + '"';
+}
+
+std::string milliseconds(double seconds) {
+  if (seconds < 0) return "-";
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.3f", seconds * 1e3);
+  return buf;
+}
+
+}  // namespace
+
+Statistics &Statistics::get() {
+  static Statistics stats;
+  return stats;
+}
+
+void Statistics::addTime(const std::string &phase, const std::string &unit,
+                         double wall, double cpu) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto key = std::make_pair(phase, unit);
+  auto [it, inserted] = m_timers.try_emplace(key);
+  if (inserted) m_timerKeys.push_back(std::move(key));
+
+  auto &timer = it->second;
+  timer.wall += wall;
+  // Once a phase is measured without the CPU clock, its CPU time is unknown
+  timer.cpu = cpu < 0 || timer.cpu < 0 ? -1 : timer.cpu + cpu;
+  ++timer.calls;
+}
+
+void Statistics::addCount(const std::string &name, const std::string &unit,
+                          uint64_t count) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto key = std::make_pair(name, unit);
+  auto [it, inserted] = m_counters.try_emplace(key, 0);
+  if (inserted) m_counterKeys.push_back(std::move(key));
+  it->second += count;
+}
+
+void Statistics::addBytes(const std::string &name, const std::string &unit,
+                          uint64_t bytes) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto key = std::make_pair(name, unit);
+  auto [it, inserted] = m_memory.try_emplace(key, 0);
+  if (inserted) m_memoryKeys.push_back(std::move(key));
+  it->second += bytes;
+}
+
+void Statistics::clear() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_timerKeys.clear();
+  m_timers.clear();
+  m_counterKeys.clear();
+  m_counters.clear();
+  m_memoryKeys.clear();
+  m_memory.clear();
+}
+
+void Statistics::print(std::ostream &os, Format format, bool timers,
+                       bool counters, bool memory) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (format == Format::JSON) {
+    printJSON(os, timers, counters, memory);
+  } else {
+    printTable(os, timers, counters, memory);
+  }
+}
+
+void Statistics::printTable(std::ostream &os, bool timers, bool counters,
+                            bool memory) const {
+  char line[128];
+  const char *rule =
+      "===--------------------------------------------------------------===\n";
+  if (timers) {
+    os << rule << "  jcc time report\n" << rule;
+    snprintf(line, sizeof(line), "%12s %12s %8s  %-16s %s\n", "Wall (ms)",
+             "CPU (ms)", "Calls", "Phase", "Unit");
+    os << line;
+    for (const auto &key : m_timerKeys) {
+      const auto &timer = m_timers.at(key);
+      snprintf(line, sizeof(line), "%12s %12s %8llu  %-16s %s\n",
+               milliseconds(timer.wall).c_str(),
+               milliseconds(timer.cpu).c_str(),
+               static_cast<unsigned long long>(timer.calls),
+               key.first.c_str(), key.second.c_str());
+      os << line;
+    }
+  }
+
+  if (counters) {
+    os << rule << "  jcc statistics\n" << rule;
+    snprintf(line, sizeof(line), "%12s  %-16s %s\n", "Value", "Statistic",
+             "Unit");
+    os << line;
+    for (const auto &key : m_counterKeys) {
+      snprintf(line, sizeof(line), "%12llu  %-16s %s\n",
+               static_cast<unsigned long long>(m_counters.at(key)),
+               key.first.c_str(), key.second.c_str());
+      os << line;
+    }
+  }
+
+  if (memory) {
+    os << rule << "  jcc memory report\n" << rule;
+    snprintf(line, sizeof(line), "%12s  %-16s %s\n", "Bytes", "Category",
+             "Unit");
+    os << line;
+    uint64_t total = 0;
+    for (const auto &key : m_memoryKeys) {
+      total += m_memory.at(key);
+      snprintf(line, sizeof(line), "%12llu  %-16s %s\n",
+               static_cast<unsigned long long>(m_memory.at(key)),
+               key.first.c_str(), key.second.c_str());
+      os << line;
+    }
+    snprintf(line, sizeof(line), "%12llu  %-16s\n",
+             static_cast<unsigned long long>(total), "total");
+    os << line;
+  }
+
+  snprintf(line, sizeof(line), "%12llu  %-16s\n",
+           static_cast<unsigned long long>(peakRSS()), "peak RSS (kB)");
+  os << line;
+}
+
+void Statistics::printJSON(std::ostream &os, bool timers, bool counters,
+                           bool memory) const {
+  os << "{\n";
+  if (timers) {
+    os << "  \"timers\": [";
+    const char *sep = "\n";
+    for (const auto &key : m_timerKeys) {
+      const auto &timer = m_timers.at(key);
+      os << sep << "    {\"phase\": " << quote(key.first)
+         << ", \"unit\": " << quote(key.second)
+         << ", \"wall_ms\": " << milliseconds(timer.wall) << ", \"cpu_ms\": "
+         << (timer.cpu < 0 ? "null" : milliseconds(timer.cpu))
+         << ", \"calls\": " << timer.calls << "}";
+      sep = ",\n";
+    }
+    os << "\n  ],\n";
+  }
+
+  if (counters) {
+    os << "  \"statistics\": [";
+    const char *sep = "\n";
+    for (const auto &key : m_counterKeys) {
+      os << sep << "    {\"name\": " << quote(key.first)
+         << ", \"unit\": " << quote(key.second)
+         << ", \"value\": " << m_counters.at(key) << "}";
+      sep = ",\n";
+    }
+    os << "\n  ],\n";
+  }
+
+  if (memory) {
+    os << "  \"memory\": [";
+    const char *sep = "\n";
+    for (const auto &key : m_memoryKeys) {
+      os << sep << "    {\"name\": " << quote(key.first)
+         << ", \"unit\": " << quote(key.second)
+         << ", \"bytes\": " << m_memory.at(key) << "}";
+      sep = ",\n";
+    }
+    os << "\n  ],\n";
+  }
+
+  os << "  \"peak_rss_kb\": " << peakRSS() << "\n}\n";
+}
+
+double wallTime() {
+  using namespace std::chrono;
+  return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+double cpuTime() {
+  // Files are compiled on separate threads, so only count the calling thread
+  timespec ts{};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+}
+
+uint64_t peakRSS() {
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+#if __APPLE__
+  // Reported in bytes on mac
+  return static_cast<uint64_t>(usage.ru_maxrss) / 1024;
+#else
+  return static_cast<uint64_t>(usage.ru_maxrss);
+#endif
+}
+
+}  // namespace jcc::stats
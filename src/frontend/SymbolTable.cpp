@@ -5,18 +5,98 @@
 #include <iostream>
 
 #include "JackAST.hpp"
+#include "Statistics.hpp"
 
 namespace jcc::sym {
 
+std::string toSegment(const Kind kind) {
+  switch (kind) {
+    case Kind::STATIC:
+      return "static";
+    case Kind::FIELD:
+      return "this";
+    case Kind::ARG:
+      return "argument";
+    case Kind::VAR:
+      return "local";
+    default:
+      assert(false && "The variable has no segment");
+      return "";
+  }
+}
+
+uint32_t Table::hash(const std::string &name) {
+  // FNV-1a, names are short
+  uint32_t h = 2166136261u;
+  for (char c : name) {
+    h ^= static_cast<unsigned char>(c);
+    h *= 16777619u;
+  }
+  return h;
+}
+
+const Table::Entry *Table::find(const std::string &name, uint32_t h) const {
+  if (m_index.empty()) {
+    for (const auto &entry : m_entries) {
+      if (entry.hash == h && entry.var->getName() == name) return &entry;
+    }
+    return nullptr;
+  }
+
+  const size_t mask = m_index.size() - 1;
+  for (size_t slot = h & mask;; slot = (slot + 1) & mask) {
+    if (m_index[slot] == 0) return nullptr;
+    const Entry &entry = m_entries[m_index[slot] - 1];
+    if (entry.hash == h && entry.var->getName() == name) return &entry;
+  }
+}
+
+void Table::insert(uint32_t position) {
+  const size_t mask = m_index.size() - 1;
+  size_t slot = m_entries[position].hash & mask;
+  while (m_index[slot] != 0) slot = (slot + 1) & mask;
+  m_index[slot] = position + 1;
+}
+
+void Table::rebuildIndex(size_t numSlots) {
+  m_index.assign(numSlots, 0);
+  for (uint32_t i = 0; i < m_entries.size(); ++i) insert(i);
+}
+
 bool Table::addValue(ast::VarDecl *v) {
-  auto [itr, success] = m_entries.insert({v->getName(), v});
-  return success;
+  const uint32_t h = hash(v->getName());
+  if (find(v->getName(), h)) return false;
+
+  m_entries.push_back({h, v});
+  if (m_entries.size() <= kMaxScanned) return true;
+  if (m_index.size() < 2 * m_entries.size()) {
+    rebuildIndex(std::max<size_t>(4 * kMaxScanned, 2 * m_index.size()));
+  } else {
+    insert(static_cast<uint32_t>(m_entries.size() - 1));
+  }
+  return true;
 }
 
 const ast::VarDecl *Table::lookup(const std::string &name) const {
-  auto found = m_entries.find(name);
+  const Entry *entry = find(name, hash(name));
+  return entry ? entry->var : nullptr;
+}
+
+void Table::pop() {
+  assert(!m_scopes.empty() && "pop() without a push()");
+  m_entries.resize(m_scopes.back());
+  m_scopes.pop_back();
+  if (m_entries.size() <= kMaxScanned) {
+    m_index.clear();
+  } else {
+    rebuildIndex(m_index.size());
+  }
+}
 
-  return (found != m_entries.end()) ? found->second : nullptr;
+size_t Table::memoryUsage() const {
+  return m_entries.capacity() * sizeof(Entry) +
+         m_index.capacity() * sizeof(uint32_t) +
+         m_scopes.capacity() * sizeof(size_t) + stats::heapBytes(m_name);
 }
 
 }  // namespace jcc::sym
@@ -0,0 +1,321 @@
+#include "ConstantFolder.hpp"
+
+#include <cstdint>
+#include <limits>
+
+#include "JackAST.hpp"
+#include "Statistics.hpp"
+
+namespace jcc::ast {
+
+namespace {
+
+// Jack integers are 32 bits and wrap around like the generated code
+int wrap(int64_t value) {
+  return static_cast<int32_t>(static_cast<uint32_t>(value));
+}
+
+}  // namespace
+
+size_t ConstantFolder::run(Node &root) {
+  ConstantFolder folder;
+  root.accept(folder);
+  return folder.m_numFolded + folder.m_numRemoved;
+}
+
+void ConstantFolder::fold(std::unique_ptr<Node> &node) {
+  m_result.reset();
+  m_value.reset();
+  m_pure = true;
+  m_unary = nullptr;
+  node->accept(*this);
+
+  if (m_result) {
+    // A reused operand keeps its own location
+    if (!m_result->getLocation().isValid()) {
+      m_result->setLocation(node->getLocation());
+    }
+    node = std::move(m_result);
+    ++m_numFolded;
+  }
+}
+
+void ConstantFolder::replaceWith(Value value) {
+  m_value = value;
+  if (value.kind == Value::Kind::Int) {
+    m_result = std::make_unique<IntConst>(value.value);
+    m_result->setExprType(ExprType::Kind::Int);
+  } else {
+    if (value.value) {
+      m_result = Constant::getTrue();
+    } else {
+      m_result = Constant::getFalse();
+    }
+    m_result->setExprType(ExprType::Kind::Boolean);
+  }
+}
+
+void ConstantFolder::visit(IntConst &i) {
+  m_value = Value{Value::Kind::Int, i.getInt()};
+}
+
+void ConstantFolder::visit(True &) {
+  m_value = Value{Value::Kind::Bool, 1};
+}
+
+void ConstantFolder::visit(False &) {
+  m_value = Value{Value::Kind::Bool, 0};
+}
+
+void ConstantFolder::visit(IndexExpr &expr) {
+  fold(expr.getIndexRef());
+  // Indexing out of bounds can fault, so the access is never removed
+  m_pure = false;
+}
+
+void ConstantFolder::visit(BinaryOp &binop) {
+  fold(binop.getLHSRef());
+  const auto lhs = m_value;
+  const bool lhsPure = m_pure;
+  fold(binop.getRHSRef());
+  const auto rhs = m_value;
+  const bool rhsPure = m_pure;
+
+  m_value.reset();
+  m_pure = lhsPure && rhsPure;
+  m_unary = nullptr;
+
+  using Kind = Value::Kind;
+  const char op = binop.getOp();
+  if (lhs && rhs && lhs->kind == rhs->kind) {
+    const int64_t l = lhs->value;
+    const int64_t r = rhs->value;
+    if (lhs->kind == Kind::Int) {
+      switch (op) {
+        case '+':
+          return replaceWith({Kind::Int, wrap(l + r)});
+        case '-':
+          return replaceWith({Kind::Int, wrap(l - r)});
+        case '*':
+          return replaceWith({Kind::Int, wrap(l * r)});
+        case '/':
+          // Leave the division by zero and the overflow to the program
+          if (r == 0 || (l == std::numeric_limits<int32_t>::min() && r == -1)) {
+            return;
+          }
+          return replaceWith({Kind::Int, static_cast<int>(l / r)});
+        case '&':
+          return replaceWith({Kind::Int, static_cast<int>(l & r)});
+        case '|':
+          return replaceWith({Kind::Int, static_cast<int>(l | r)});
+        case '<':
+          return replaceWith({Kind::Bool, l < r});
+        case '>':
+          return replaceWith({Kind::Bool, l > r});
+        case '=':
+          return replaceWith({Kind::Bool, l == r});
+      }
+    } else {
+      switch (op) {
+        case '&':
+          return replaceWith({Kind::Bool, l && r});
+        case '|':
+          return replaceWith({Kind::Bool, l || r});
+        case '=':
+          return replaceWith({Kind::Bool, l == r});
+      }
+    }
+    return;
+  }
+
+  // Identities with a constant on one side. The other side is kept, or only
+  // dropped when it has no side effects
+  auto is = [](const std::optional<Value> &c, Kind kind, int value) {
+    return c && c->kind == kind && c->value == value;
+  };
+  auto keepLHS = [&] {
+    m_value = lhs;
+    m_pure = lhsPure;
+    replaceWith(std::move(binop.getLHSRef()));
+  };
+  auto keepRHS = [&] {
+    m_value = rhs;
+    m_pure = rhsPure;
+    replaceWith(std::move(binop.getRHSRef()));
+  };
+  switch (op) {
+    case '+':
+      if (is(rhs, Kind::Int, 0)) return keepLHS();
+      if (is(lhs, Kind::Int, 0)) return keepRHS();
+      break;
+    case '-':
+      if (is(rhs, Kind::Int, 0)) return keepLHS();
+      break;
+    case '*':
+      if (is(rhs, Kind::Int, 1)) return keepLHS();
+      if (is(lhs, Kind::Int, 1)) return keepRHS();
+      if ((is(rhs, Kind::Int, 0) && lhsPure) ||
+          (is(lhs, Kind::Int, 0) && rhsPure)) {
+        return replaceWith({Kind::Int, 0});
+      }
+      break;
+    case '/':
+      if (is(rhs, Kind::Int, 1)) return keepLHS();
+      break;
+    case '&':
+      if (is(rhs, Kind::Bool, 1)) return keepLHS();
+      if (is(lhs, Kind::Bool, 1)) return keepRHS();
+      if ((is(rhs, Kind::Bool, 0) && lhsPure) ||
+          (is(lhs, Kind::Bool, 0) && rhsPure)) {
+        return replaceWith({Kind::Bool, 0});
+      }
+      break;
+    case '|':
+      if (is(rhs, Kind::Bool, 0)) return keepLHS();
+      if (is(lhs, Kind::Bool, 0)) return keepRHS();
+      if ((is(rhs, Kind::Bool, 1) && lhsPure) ||
+          (is(lhs, Kind::Bool, 1) && rhsPure)) {
+        return replaceWith({Kind::Bool, 1});
+      }
+      break;
+  }
+}
+
+void ConstantFolder::visit(UnaryOp &unop) {
+  fold(unop.getOperandRef());
+  const auto operand = m_value;
+  UnaryOp *inner = m_unary;
+  m_value.reset();
+  m_unary = nullptr;
+
+  using Kind = Value::Kind;
+  const char op = unop.getOp();
+  if (operand) {
+    if (op == '-' && operand->kind == Kind::Int) {
+      return replaceWith({Kind::Int, wrap(-int64_t{operand->value})});
+    } else if (op == '~' && operand->kind == Kind::Int) {
+      return replaceWith({Kind::Int, ~operand->value});
+    } else if (op == '~' && operand->kind == Kind::Bool) {
+      return replaceWith({Kind::Bool, !operand->value});
+    }
+  } else if (inner && inner->getOp() == op) {
+    // Both operators cancel out
+    return replaceWith(std::move(inner->getOperandRef()));
+  }
+  m_unary = &unop;
+}
+
+void ConstantFolder::visit(MethodCall &call) {
+  if (call.getCallee()) call.getCallee()->accept(*this);
+  for (auto arg = call.args_begin(); arg != call.args_end(); ++arg) {
+    fold(*arg);
+  }
+  m_value.reset();
+  m_pure = false;
+  m_unary = nullptr;
+}
+
+void ConstantFolder::visit(FunctionCall &call) {
+  for (auto arg = call.args_begin(); arg != call.args_end(); ++arg) {
+    fold(*arg);
+  }
+  m_value.reset();
+  m_pure = false;
+  m_unary = nullptr;
+}
+
+void ConstantFolder::visit(RValueT &rv) { rv.getWrapped()->accept(*this); }
+
+void ConstantFolder::visit(LetStmt &let) {
+  let.getAssignee()->accept(*this);
+  fold(let.getExpressionRef());
+}
+
+void ConstantFolder::visit(IfStmt &stmt) {
+  fold(stmt.getCondRef());
+  const auto cond = m_value;
+
+  if (cond && cond->kind == Value::Kind::Bool) {
+    // Only the branch that runs is kept, in place of the statement
+    Block *taken = cond->value ? stmt.getIfBlock() : stmt.getElseBlock();
+    m_returned = false;
+    if (taken) taken->accept(*this);
+    m_pruned = taken ? taken->takeStmts() : NodeList{};
+    return;
+  }
+
+  stmt.getIfBlock()->accept(*this);
+  if (stmt.getElseBlock()) stmt.getElseBlock()->accept(*this);
+  m_returned = false;
+}
+
+void ConstantFolder::visit(WhileStmt &stmt) {
+  fold(stmt.getCondRef());
+  const auto cond = m_value;
+
+  if (cond && cond->kind == Value::Kind::Bool && !cond->value) {
+    // The loop never runs
+    m_pruned = NodeList{};
+    return;
+  }
+
+  stmt.getBlock()->accept(*this);
+  m_returned = false;
+}
+
+void ConstantFolder::visit(ReturnStmt &stmt) {
+  fold(stmt.getExprRef());
+  m_returned = true;
+}
+
+void ConstantFolder::visit(Block &block) {
+  auto stmts = block.takeStmts();
+  for (auto stmt = stmts.begin(); stmt != stmts.end(); ++stmt) {
+    m_pruned.reset();
+    m_returned = false;
+    fold(*stmt);
+
+    if (m_pruned) {
+      ++m_numRemoved;
+      for (auto &pruned : *m_pruned) { block.addStmt(std::move(pruned)); }
+      m_pruned.reset();
+    } else {
+      block.addStmt(std::move(*stmt));
+    }
+
+    if (m_returned) {
+      // Nothing after a return runs
+      m_numRemoved += std::distance(stmt, stmts.end()) - 1;
+      break;
+    }
+  }
+}
+
+void ConstantFolder::visit(StaticDecl &decl) {
+  decl.getDefinition()->accept(*this);
+}
+
+void ConstantFolder::visit(MethodDecl &decl) {
+  decl.getDefinition()->accept(*this);
+}
+
+void ConstantFolder::visit(ConstructorDecl &decl) {
+  decl.getDefinition()->accept(*this);
+}
+
+void ConstantFolder::visit(ClassDecl &cls) {
+  stats::ScopedTimer timer("fold", cls.getName());
+  const auto before = m_numFolded + m_numRemoved;
+
+  for (auto fcn = cls.fcns_begin(); fcn != cls.fcns_end(); ++fcn) {
+    (*fcn)->accept(*this);
+  }
+  for (auto mth = cls.mths_begin(); mth != cls.mths_end(); ++mth) {
+    (*mth)->accept(*this);
+  }
+
+  stats::addCount("folded nodes", cls.getName(),
+                  m_numFolded + m_numRemoved - before);
+}
+
+}  // namespace jcc::ast
@@ -0,0 +1,253 @@
+#include "DependencyGraph.hpp"
+
+#include <fstream>
+#include <sstream>
+
+#include "ASTCache.hpp"
+#include "JackAST.hpp"
+
+namespace jcc::ast {
+
+namespace {
+
+constexpr const char *kHeader = "jcc-deps 1";
+
+// Collects the classes named by a class
+class Collector : public ImmutableVisitor {
+public:
+  std::set<std::string> names;
+
+  void visit(const EmptyNode &) override {}
+  void visit(const True &) override {}
+  void visit(const False &) override {}
+  void visit(const This &) override {}
+  void visit(const IntConst &) override {}
+  void visit(const CharConst &) override {}
+  void visit(const StrConst &) override {}
+  void visit(const Identifier &) override {}
+  void visit(const IndexExpr &node) override { node.getIndex()->accept(*this); }
+
+  void visit(const BinaryOp &node) override {
+    node.getLHS()->accept(*this);
+    node.getRHS()->accept(*this);
+  }
+  void visit(const UnaryOp &node) override {
+    node.getOperand()->accept(*this);
+  }
+
+  void visit(const MethodCall &node) override {
+    if (const auto *callee = node.getCallee()) {
+      addType(callee->getType());
+      callee->accept(*this);
+    }
+    visitArgs(node);
+  }
+  void visit(const FunctionCall &node) override {
+    addType(node.getClassType());
+    visitArgs(node);
+  }
+
+  void visit(const LetStmt &node) override {
+    node.getAssignee()->accept(*this);
+    node.getExpression()->accept(*this);
+  }
+  void visit(const IfStmt &node) override {
+    node.getCond()->accept(*this);
+    node.getIfBlock()->accept(*this);
+    if (node.getElseBlock()) node.getElseBlock()->accept(*this);
+  }
+  void visit(const WhileStmt &node) override {
+    node.getCond()->accept(*this);
+    node.getBlock()->accept(*this);
+  }
+  void visit(const ReturnStmt &node) override { node.getExpr()->accept(*this); }
+
+  void visit(const VarDecl &node) override { addType(node.getType()); }
+  void visit(const StaticDecl &node) override { visitFunction(node); }
+  void visit(const MethodDecl &node) override { visitFunction(node); }
+  void visit(const ConstructorDecl &node) override { visitFunction(node); }
+  void visit(const ClassDecl &node) override {
+    for (auto it = node.fields_begin(); it != node.fields_end(); ++it) {
+      (*it)->accept(*this);
+    }
+    for (auto it = node.statics_begin(); it != node.statics_end(); ++it) {
+      (*it)->accept(*this);
+    }
+    for (auto it = node.fcns_begin(); it != node.fcns_end(); ++it) {
+      (*it)->accept(*this);
+    }
+    for (auto it = node.mths_begin(); it != node.mths_end(); ++it) {
+      (*it)->accept(*this);
+    }
+    names.erase(node.getName());
+  }
+  void visit(const Block &node) override {
+    for (auto it = node.stmts_begin(); it != node.stmts_end(); ++it) {
+      (*it)->accept(*this);
+    }
+  }
+
+  void visit(const RValueT &node) override { node.getWrapped()->accept(*this); }
+
+private:
+  void addType(const std::string &name) {
+    if (ExprType::fromName(name).kind == ExprType::Kind::Class) {
+      names.insert(name);
+    }
+  }
+
+  void visitArgs(const Call &call) {
+    for (auto it = call.args_begin(); it != call.args_end(); ++it) {
+      (*it)->accept(*this);
+    }
+  }
+
+  void visitFunction(const FunctionDecl &decl) {
+    addType(decl.getReturnType());
+    for (auto it = decl.prms_begin(); it != decl.prms_end(); ++it) {
+      (*it)->accept(*this);
+    }
+    if (decl.getDefinition()) decl.getDefinition()->accept(*this);
+  }
+};
+
+std::string toHex(uint64_t value) {
+  std::ostringstream out;
+  out << std::hex << value;
+  return out.str();
+}
+
+}  // namespace
+
+std::set<std::string> DependencyGraph::dependencies(const ClassDecl &cls) {
+  Collector collector;
+  cls.accept(collector);
+  return std::move(collector.names);
+}
+
+uint64_t DependencyGraph::interfaceHash(const ClassDecl &cls) {
+  // The fields give the layout of the objects, the Inliner accesses them from
+  // other classes
+  std::string interface = cls.getName() + '\n';
+  for (auto it = cls.fields_begin(); it != cls.fields_end(); ++it) {
+    interface += "field " + (*it)->getType() + ' ' + (*it)->getName() + '\n';
+  }
+  auto addSignatures = [&](auto begin, auto end, const char *kind) {
+    for (; begin != end; ++begin) {
+      const FunctionDecl &fcn = **begin;
+      interface += kind + (' ' + fcn.getReturnType()) + ' ' + fcn.getName();
+      for (auto prm = fcn.prms_begin(); prm != fcn.prms_end(); ++prm) {
+        interface += ' ' + (*prm)->getType();
+      }
+      interface += '\n';
+    }
+  };
+  // Constructors are functions of the class
+  addSignatures(cls.fcns_begin(), cls.fcns_end(), "function");
+  addSignatures(cls.mths_begin(), cls.mths_end(), "method");
+  return io::ASTCache::hash(interface);
+}
+
+void DependencyGraph::add(const ClassDecl &cls, uint64_t sourceHash) {
+  m_classes[cls.getName()] = {cls.getFile(), sourceHash, interfaceHash(cls),
+                              dependencies(cls)};
+  m_rebuilt.insert(cls.getName());
+}
+
+const DependencyGraph::ClassInfo *DependencyGraph::find(
+    const std::string &cls) const {
+  auto found = m_classes.find(cls);
+  return found != m_classes.end() ? &found->second : nullptr;
+}
+
+const std::string *DependencyGraph::findFile(const std::string &file) const {
+  for (const auto &[name, info] : m_classes) {
+    if (info.file == file) return &name;
+  }
+  return nullptr;
+}
+
+std::vector<std::string> DependencyGraph::removeMissingFiles() {
+  std::vector<std::string> removed;
+  for (auto it = m_classes.begin(); it != m_classes.end();) {
+    if (std::ifstream{it->second.file}) {
+      ++it;
+      continue;
+    }
+    removed.push_back(it->first);
+    it = m_classes.erase(it);
+  }
+  return removed;
+}
+
+std::vector<std::string> DependencyGraph::invalidated(
+    const DependencyGraph &previous) const {
+  auto changed = [&](const std::string &dep) {
+    const ClassInfo *before = previous.find(dep);
+    const ClassInfo *after = find(dep);
+    if (!before) return false;
+    // A dependency that was removed is an error the class must report
+    return !after || before->interfaceHash != after->interfaceHash;
+  };
+
+  std::vector<std::string> classes;
+  for (const auto &[name, info] : m_classes) {
+    if (m_rebuilt.count(name)) continue;
+    for (const auto &dep : info.dependencies) {
+      if (changed(dep)) {
+        classes.push_back(name);
+        break;
+      }
+    }
+  }
+  return classes;
+}
+
+bool DependencyGraph::read(const std::string &path) {
+  m_classes.clear();
+  m_rebuilt.clear();
+  std::ifstream in{path};
+  std::string line;
+  if (!std::getline(in, line)) return false;
+  if (line != kHeader) return true;
+
+  // One class per line, tab separated: name, hashes, file and dependencies
+  while (std::getline(in, line)) {
+    std::istringstream fields{line};
+    std::string name, source, interface, deps;
+    ClassInfo info;
+    if (!std::getline(fields, name, '\t') ||
+        !std::getline(fields, source, '\t') ||
+        !std::getline(fields, interface, '\t') ||
+        !std::getline(fields, info.file, '\t')) {
+      m_classes.clear();
+      return false;
+    }
+    try {
+      info.sourceHash = std::stoull(source, nullptr, 16);
+      info.interfaceHash = std::stoull(interface, nullptr, 16);
+    } catch (const std::exception &) {
+      m_classes.clear();
+      return false;
+    }
+    std::getline(fields, deps);
+    std::istringstream depNames{deps};
+    for (std::string dep; depNames >> dep;) info.dependencies.insert(dep);
+    m_classes[name] = std::move(info);
+  }
+  return true;
+}
+
+bool DependencyGraph::write(const std::string &path) const {
+  std::ofstream out{path};
+  out << kHeader << '\n';
+  for (const auto &[name, info] : m_classes) {
+    out << name << '\t' << toHex(info.sourceHash) << '\t'
+        << toHex(info.interfaceHash) << '\t' << info.file << '\t';
+    for (const auto &dep : info.dependencies) out << dep << ' ';
+    out << '\n';
+  }
+  return static_cast<bool>(out);
+}
+
+}  // namespace jcc::ast
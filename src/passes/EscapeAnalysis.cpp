@@ -0,0 +1,198 @@
+#include "EscapeAnalysis.hpp"
+
+#include "JackAST.hpp"
+#include "Statistics.hpp"
+
+namespace jcc::ast {
+
+namespace {
+
+std::string functionName(const std::string &cls, const std::string &fcn) {
+  return cls + '.' + fcn;
+}
+
+}  // namespace
+
+void EscapeAnalysis::borrow(const std::string &cls, const std::string &fcn,
+                            size_t param) {
+  auto &params = m_borrowed[functionName(cls, fcn)];
+  if (params.size() <= param) params.resize(param + 1, false);
+  params[param] = true;
+}
+
+void EscapeAnalysis::declare(ClassDecl &cls) {
+  auto declareAll = [&](auto begin, auto end) {
+    for (auto fcn = begin; fcn != end; ++fcn) {
+      // Until proven otherwise, so that recursive functions can borrow
+      m_borrowed[functionName(cls.getName(), (*fcn)->getName())].assign(
+          (*fcn)->numParams(), true);
+      m_functions.push_back(fcn->get());
+    }
+  };
+  declareAll(cls.fcns_begin(), cls.fcns_end());
+  declareAll(cls.mths_begin(), cls.mths_end());
+  m_resolved = false;
+}
+
+void EscapeAnalysis::declare(Node &root) {
+  // Only a class declares anything, any other node is left as it is
+  if (!m_declaring) {
+    m_declaring = true;
+    root.accept(*this);
+    m_declaring = false;
+  }
+}
+
+void EscapeAnalysis::resolve() {
+  // A parameter that escapes may make the parameters it is passed from
+  // escape too, until nothing changes
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (FunctionDecl *fcn : m_functions) {
+      auto &borrowed =
+          m_borrowed[functionName(fcn->getParent()->getName(), fcn->getName())];
+      auto params = borrowed;
+      m_params = &params;
+      fcn->accept(*this);
+      m_params = nullptr;
+
+      if (params != borrowed) {
+        borrowed = std::move(params);
+        changed = true;
+      }
+    }
+  }
+  m_resolved = true;
+}
+
+size_t EscapeAnalysis::run(Node &root) {
+  if (!m_resolved) resolve();
+  const auto before = m_numBorrowed;
+  root.accept(*this);
+  return m_numBorrowed - before;
+}
+
+bool EscapeAnalysis::isBorrowed(const std::string &cls, const std::string &fcn,
+                                size_t param) const {
+  auto found = m_borrowed.find(functionName(cls, fcn));
+  return found != m_borrowed.end() && param < found->second.size() &&
+         found->second[param];
+}
+
+void EscapeAnalysis::visitArgument(Node &arg, bool borrowed) {
+  m_borrowing = borrowed;
+  arg.accept(*this);
+  m_borrowing = false;
+}
+
+void EscapeAnalysis::visitCall(Call &call, const std::string &cls,
+                               size_t first) {
+  size_t param = first;
+  for (auto arg = call.args_begin(); arg != call.args_end(); ++arg) {
+    visitArgument(**arg, isBorrowed(cls, call.getName(), param++));
+  }
+}
+
+void EscapeAnalysis::visit(Identifier &ident) {
+  const Slot slot = ident.getSlot();
+  if (m_params && !m_borrowing && slot.kind == sym::Kind::ARG &&
+      slot.index < m_params->size()) {
+    (*m_params)[slot.index] = false;
+  }
+}
+
+void EscapeAnalysis::visit(StrConst &str) {
+  // Only the final parameters decide, not the ones being resolved
+  if (m_params) return;
+  str.setBorrowed(m_borrowing);
+  if (m_borrowing) ++m_numBorrowed;
+}
+
+void EscapeAnalysis::visit(IndexExpr &expr) {
+  // Reading an element of an array does not make the array escape
+  visitArgument(*expr.getIndex(), false);
+}
+
+void EscapeAnalysis::visit(BinaryOp &binop) {
+  visitArgument(*binop.getLHS(), false);
+  visitArgument(*binop.getRHS(), false);
+}
+
+void EscapeAnalysis::visit(UnaryOp &unop) {
+  visitArgument(*unop.getOperand(), false);
+}
+
+void EscapeAnalysis::visit(MethodCall &call) {
+  if (NamedValue *callee = call.getCallee()) {
+    const auto &cls = callee->getExprType().name;
+    visitArgument(*callee, isBorrowed(cls, call.getName(), 0));
+    visitCall(call, cls, 1);
+  } else {
+    visitCall(call, m_class ? m_class->getName() : "", 1);
+  }
+}
+
+void EscapeAnalysis::visit(FunctionCall &call) {
+  visitCall(call, call.getClassType(), 0);
+}
+
+void EscapeAnalysis::visit(RValueT &rv) { rv.getWrapped()->accept(*this); }
+
+void EscapeAnalysis::visit(LetStmt &let) {
+  // Assigning a parameter does not change the value that was passed
+  visitArgument(*let.getAssignee(), true);
+  visitArgument(*let.getExpression(), false);
+}
+
+void EscapeAnalysis::visit(IfStmt &stmt) {
+  visitArgument(*stmt.getCond(), false);
+  stmt.getIfBlock()->accept(*this);
+  if (stmt.getElseBlock()) stmt.getElseBlock()->accept(*this);
+}
+
+void EscapeAnalysis::visit(WhileStmt &stmt) {
+  visitArgument(*stmt.getCond(), false);
+  stmt.getBlock()->accept(*this);
+}
+
+void EscapeAnalysis::visit(ReturnStmt &stmt) {
+  visitArgument(*stmt.getExpr(), false);
+}
+
+void EscapeAnalysis::visit(Block &block) {
+  for (auto stmt = block.stmts_begin(); stmt != block.stmts_end(); ++stmt) {
+    (*stmt)->accept(*this);
+  }
+}
+
+void EscapeAnalysis::visitFunction(FunctionDecl &decl) {
+  if (m_declaring) return;
+  const ClassDecl *cls = m_class;
+  m_class = decl.getParent() ? decl.getParent() : cls;
+  decl.getDefinition()->accept(*this);
+  m_class = cls;
+}
+
+void EscapeAnalysis::visit(StaticDecl &decl) { visitFunction(decl); }
+void EscapeAnalysis::visit(MethodDecl &decl) { visitFunction(decl); }
+void EscapeAnalysis::visit(ConstructorDecl &decl) { visitFunction(decl); }
+
+void EscapeAnalysis::visit(ClassDecl &cls) {
+  if (m_declaring) return declare(cls);
+  stats::ScopedTimer timer("escape", cls.getName());
+  const auto before = m_numBorrowed;
+
+  m_class = &cls;
+  for (auto fcn = cls.fcns_begin(); fcn != cls.fcns_end(); ++fcn) {
+    (*fcn)->accept(*this);
+  }
+  for (auto mth = cls.mths_begin(); mth != cls.mths_end(); ++mth) {
+    (*mth)->accept(*this);
+  }
+  m_class = nullptr;
+
+  stats::addCount("borrowed strings", cls.getName(), m_numBorrowed - before);
+}
+
+}  // namespace jcc::ast
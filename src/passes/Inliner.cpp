@@ -0,0 +1,435 @@
+#include "Inliner.hpp"
+
+#include <vector>
+
+#include "JackAST.hpp"
+#include "Statistics.hpp"
+
+namespace jcc::ast {
+
+namespace {
+
+// What the inliner needs to know of a node, the AST has no RTTI
+class Shape : public ImmutableVisitor {
+public:
+  static Shape of(const Node &node) {
+    Shape shape;
+    node.accept(shape);
+    return shape;
+  }
+
+  const ClassDecl *cls = nullptr;
+  const ReturnStmt *ret = nullptr;
+  // A function or method, not a constructor
+  bool function = false;
+  bool method = false;
+  // A constant, or a variable that no call can change. Only statics are
+  // shared, the objects are copied when they are passed
+  bool trivial = false;
+
+  void visit(const EmptyNode &) override {}
+  void visit(const IntConst &) override { trivial = true; }
+  void visit(const CharConst &) override { trivial = true; }
+  void visit(const Identifier &ident) override {
+    const auto kind = ident.getSlot().kind;
+    trivial = kind != sym::Kind::NONE && kind != sym::Kind::STATIC &&
+              !ident.getObject();
+  }
+  void visit(const StrConst &) override {}
+  void visit(const IndexExpr &) override {}
+  void visit(const True &) override { trivial = true; }
+  void visit(const False &) override { trivial = true; }
+  void visit(const This &) override { trivial = true; }
+
+  void visit(const BinaryOp &) override {}
+  void visit(const UnaryOp &) override {}
+  void visit(const MethodCall &) override {}
+  void visit(const FunctionCall &) override {}
+
+  void visit(const LetStmt &) override {}
+  void visit(const IfStmt &) override {}
+  void visit(const WhileStmt &) override {}
+  void visit(const ReturnStmt &stmt) override { ret = &stmt; }
+
+  void visit(const VarDecl &) override {}
+  void visit(const StaticDecl &) override { function = true; }
+  void visit(const MethodDecl &) override { function = method = true; }
+  void visit(const ConstructorDecl &) override {}
+  void visit(const ClassDecl &c) override { cls = &c; }
+  void visit(const Block &) override {}
+
+  void visit(const RValueT &rv) override { rv.getWrapped()->accept(*this); }
+};
+
+// Copies the expression returned by a function for one of its calls, with the
+// arguments substituted for the parameters and the fields read from the
+// object of the call. Fails on anything the caller cannot express
+class Cloner : public ImmutableVisitor {
+public:
+  Cloner(const ClassDecl &cls, FunctionDecl &fcn, FunctionDecl *caller,
+         std::vector<const Node *> args, const NamedValue *object,
+         bool sameClass, SourceLocation loc, size_t maxSize)
+      : m_cls{cls},
+        m_fcn{fcn},
+        m_caller{caller},
+        m_args{std::move(args)},
+        m_object{object},
+        m_sameClass{sameClass},
+        m_loc{loc},
+        m_maxSize{maxSize} {}
+
+  // Returns null if the expression cannot be inlined
+  std::unique_ptr<Node> clone(const Node &node) {
+    // The size is that of the function, the arguments are variables
+    if (m_failed || (!m_plain && ++m_size > m_maxSize)) {
+      fail();
+      return nullptr;
+    }
+    m_substituted = false;
+    node.accept(*this);
+    if (m_failed) return nullptr;
+
+    // The substituted arguments keep their own type
+    if (!m_result->getExprType().isKnown()) {
+      m_result->setExprType(node.getExprType());
+    }
+    m_result->setLocation(m_loc);
+    return std::move(m_result);
+  }
+
+  void visit(const EmptyNode &) override { fail(); }
+  void visit(const IntConst &i) override {
+    m_result = std::make_unique<IntConst>(i.getInt());
+  }
+  void visit(const CharConst &c) override {
+    m_result = std::make_unique<CharConst>(c.getChar());
+  }
+  void visit(const StrConst &str) override {
+    m_result = std::make_unique<StrConst>(str.getString());
+  }
+  void visit(const True &) override { m_result = Constant::getTrue(); }
+  void visit(const False &) override { m_result = Constant::getFalse(); }
+
+  void visit(const This &) override {
+    if (m_plain || !m_object) {
+      m_result = Constant::getThis();
+    } else {
+      m_result = copyObject();
+    }
+  }
+
+  void visit(const Identifier &ident) override {
+    if (m_plain) {
+      m_result = copy(ident, m_caller);
+    } else if (ident.getSlot().kind == sym::Kind::ARG) {
+      substitute(ident);
+    } else if (canAccess(ident)) {
+      auto copied = copy(ident, &m_fcn);
+      if (m_object) copied->setObject(copyObject());
+      m_result = std::move(copied);
+    }
+  }
+
+  void visit(const IndexExpr &expr) override {
+    if (m_plain || !canAccess(expr)) return fail();
+    auto idx = clone(*expr.getIndex());
+    if (!idx) return;
+    auto copied =
+        std::make_unique<IndexExpr>(expr.getName(), std::move(idx), &m_fcn);
+    copied->setDecl(expr.getDecl());
+    if (m_object) copied->setObject(copyObject());
+    m_result = std::move(copied);
+  }
+
+  void visit(const BinaryOp &binop) override {
+    auto lhs = clone(*binop.getLHS());
+    auto rhs = lhs ? clone(*binop.getRHS()) : nullptr;
+    if (!rhs) return;
+    m_result = std::make_unique<BinaryOp>(binop.getOp(), std::move(lhs),
+                                          std::move(rhs));
+  }
+
+  void visit(const UnaryOp &unop) override {
+    auto operand = clone(*unop.getOperand());
+    if (!operand) return;
+    m_result = std::make_unique<UnaryOp>(unop.getOp(), std::move(operand));
+  }
+
+  void visit(const MethodCall &) override { fail(); }
+
+  void visit(const FunctionCall &call) override {
+    if (call.getClassType() == m_cls.getName() &&
+        call.getName() == m_fcn.getName()) {
+      return fail();
+    }
+    NodeList args;
+    for (auto arg = call.args_begin(); arg != call.args_end(); ++arg) {
+      args.push_back(clone(**arg));
+      if (!args.back()) return;
+    }
+    m_result = std::make_unique<FunctionCall>(call.getClassType(),
+                                              call.getName(), std::move(args));
+  }
+
+  void visit(const RValueT &rv) override {
+    auto wrapped = clone(*rv.getWrapped());
+    if (!wrapped) return;
+    if (m_substituted) {
+      // The argument is already a value
+      m_result = std::move(wrapped);
+    } else {
+      m_result = RValue(std::unique_ptr<Terminal>(
+          static_cast<Terminal *>(wrapped.release())));
+    }
+  }
+
+  void visit(const LetStmt &) override { fail(); }
+  void visit(const IfStmt &) override { fail(); }
+  void visit(const WhileStmt &) override { fail(); }
+  void visit(const ReturnStmt &) override { fail(); }
+  void visit(const VarDecl &) override { fail(); }
+  void visit(const StaticDecl &) override { fail(); }
+  void visit(const MethodDecl &) override { fail(); }
+  void visit(const ConstructorDecl &) override { fail(); }
+  void visit(const ClassDecl &) override { fail(); }
+  void visit(const Block &) override { fail(); }
+
+private:
+  const ClassDecl &m_cls;
+  FunctionDecl &m_fcn;
+  FunctionDecl *m_caller;
+  // By parameter slot, `this` is null
+  std::vector<const Node *> m_args;
+  const NamedValue *m_object;
+  bool m_sameClass;
+  SourceLocation m_loc;
+  size_t m_maxSize;
+
+  size_t m_size = 0;
+  bool m_failed = false;
+  // Copying an argument, whose variables are the caller's
+  bool m_plain = false;
+  // The node just copied is an argument substituted for a parameter
+  bool m_substituted = false;
+  std::unique_ptr<Node> m_result;
+
+  void fail() {
+    m_failed = true;
+    m_result.reset();
+  }
+
+  // Variables of the callee that the caller can read: the fields of the
+  // object, and the statics of its own class
+  bool canAccess(const NamedValue &value) {
+    const auto kind = value.getSlot().kind;
+    if (value.getObject() || !(kind == sym::Kind::FIELD ||
+                               (kind == sym::Kind::STATIC && m_sameClass))) {
+      fail();
+      return false;
+    }
+    return true;
+  }
+
+  void substitute(const Identifier &param) {
+    const auto index = param.getSlot().index;
+    if (index >= m_args.size() || !m_args[index]) return fail();
+    m_plain = true;
+    m_result = clone(*m_args[index]);
+    m_plain = false;
+    m_substituted = true;
+  }
+
+  std::unique_ptr<Identifier> copy(const Identifier &ident,
+                                   FunctionDecl *parent) {
+    auto copied = std::make_unique<Identifier>(ident.getName(), parent);
+    copied->setDecl(ident.getDecl());
+    copied->setExprType(ident.getExprType());
+    copied->setLocation(m_loc);
+    return copied;
+  }
+
+  std::unique_ptr<Identifier> copyObject() {
+    // The object of a call is always a variable, see Shape::trivial
+    return copy(static_cast<const Identifier &>(*m_object), m_caller);
+  }
+};
+
+}  // namespace
+
+void Inliner::setCallCounts(CallCounts counts, uint64_t maxCount) {
+  m_counts = std::move(counts);
+  m_maxCount = maxCount;
+}
+
+void Inliner::declare(ClassDecl &cls) {
+  auto declareAll = [&](auto begin, auto end) {
+    for (auto fcn = begin; fcn != end; ++fcn) {
+      const auto shape = Shape::of(**fcn);
+      const Block &body = *(*fcn)->getDefinition();
+      if (!shape.function || body.numStmts() != 1) continue;
+      if (const ReturnStmt *ret = Shape::of(**body.stmts_begin()).ret) {
+        m_candidates[cls.getName() + '.' + (*fcn)->getName()] = {
+            &cls, fcn->get(), ret, shape.method};
+      }
+    }
+  };
+  declareAll(cls.fcns_begin(), cls.fcns_end());
+  declareAll(cls.mths_begin(), cls.mths_end());
+}
+
+void Inliner::declare(Node &root) {
+  if (Shape::of(root).cls) declare(static_cast<ClassDecl &>(root));
+}
+
+size_t Inliner::run(Node &root) {
+  const auto before = m_numInlined;
+  root.accept(*this);
+  m_result.reset();
+  return m_numInlined - before;
+}
+
+void Inliner::inlineChild(std::unique_ptr<Node> &node) {
+  m_result.reset();
+  node->accept(*this);
+  if (m_result) {
+    node = std::move(m_result);
+    ++m_numInlined;
+  }
+}
+
+void Inliner::inlineCall(Call &call, const std::string &cls,
+                         const NamedValue *object, bool method) {
+  const auto found = m_candidates.find(cls + '.' + call.getName());
+  if (found == m_candidates.end()) return;
+  const Candidate &callee = found->second;
+  // A method called on `this` needs one
+  if (callee.method != method || callee.fcn == m_function ||
+      (method && !object && !m_method)) {
+    return;
+  }
+
+  size_t maxSize = m_maxSize;
+  if (m_counts) {
+    if (const auto count = m_counts(found->first)) {
+      if (*count == 0) return;
+      if (*count * 100 >= m_maxCount) maxSize *= 4;
+    }
+  }
+
+  if (object && !Shape::of(*object).trivial) return;
+  std::vector<const Node *> args;
+  if (method) args.push_back(nullptr);
+  for (auto arg = call.args_begin(); arg != call.args_end(); ++arg) {
+    if (!Shape::of(**arg).trivial) return;
+    args.push_back(arg->get());
+  }
+  if (args.size() != callee.fcn->numParams()) return;
+
+  const bool sameClass = m_class && m_class->getName() == cls;
+  Cloner cloner{*callee.cls, *callee.fcn,       m_function, std::move(args),
+                object,      sameClass,          call.getLocation(), maxSize};
+  m_result = cloner.clone(*callee.ret->getExpr());
+}
+
+void Inliner::visit(IndexExpr &expr) { inlineChild(expr.getIndexRef()); }
+
+void Inliner::visit(BinaryOp &binop) {
+  inlineChild(binop.getLHSRef());
+  inlineChild(binop.getRHSRef());
+  m_result.reset();
+}
+
+void Inliner::visit(UnaryOp &unop) {
+  inlineChild(unop.getOperandRef());
+  m_result.reset();
+}
+
+void Inliner::visit(MethodCall &call) {
+  for (auto arg = call.args_begin(); arg != call.args_end(); ++arg) {
+    inlineChild(*arg);
+  }
+  m_result.reset();
+
+  const NamedValue *object = call.getCallee();
+  std::string cls = object ? object->getExprType().name
+                           : m_class ? m_class->getName() : "";
+  inlineCall(call, cls, object, true);
+}
+
+void Inliner::visit(FunctionCall &call) {
+  for (auto arg = call.args_begin(); arg != call.args_end(); ++arg) {
+    inlineChild(*arg);
+  }
+  m_result.reset();
+  inlineCall(call, call.getClassType(), nullptr, false);
+}
+
+void Inliner::visit(RValueT &rv) {
+  rv.getWrapped()->accept(*this);
+  m_result.reset();
+}
+
+void Inliner::visit(LetStmt &let) {
+  let.getAssignee()->accept(*this);
+  inlineChild(let.getExpressionRef());
+  m_result.reset();
+}
+
+void Inliner::visit(IfStmt &stmt) {
+  inlineChild(stmt.getCondRef());
+  stmt.getIfBlock()->accept(*this);
+  if (stmt.getElseBlock()) stmt.getElseBlock()->accept(*this);
+  m_result.reset();
+}
+
+void Inliner::visit(WhileStmt &stmt) {
+  inlineChild(stmt.getCondRef());
+  stmt.getBlock()->accept(*this);
+  m_result.reset();
+}
+
+void Inliner::visit(ReturnStmt &stmt) {
+  inlineChild(stmt.getExprRef());
+  m_result.reset();
+}
+
+void Inliner::visit(Block &block) {
+  // A call made for its side effects is left as it is
+  for (auto stmt = block.stmts_begin(); stmt != block.stmts_end(); ++stmt) {
+    (*stmt)->accept(*this);
+    m_result.reset();
+  }
+}
+
+void Inliner::visitFunction(FunctionDecl &decl, bool method) {
+  const ClassDecl *cls = m_class;
+  m_class = decl.getParent() ? decl.getParent() : cls;
+  m_function = &decl;
+  m_method = method;
+  decl.getDefinition()->accept(*this);
+  m_function = nullptr;
+  m_method = false;
+  m_class = cls;
+}
+
+void Inliner::visit(StaticDecl &decl) { visitFunction(decl, false); }
+void Inliner::visit(MethodDecl &decl) { visitFunction(decl, true); }
+void Inliner::visit(ConstructorDecl &decl) { visitFunction(decl, false); }
+
+void Inliner::visit(ClassDecl &cls) {
+  stats::ScopedTimer timer("inline", cls.getName());
+  const auto before = m_numInlined;
+
+  m_class = &cls;
+  for (auto fcn = cls.fcns_begin(); fcn != cls.fcns_end(); ++fcn) {
+    (*fcn)->accept(*this);
+  }
+  for (auto mth = cls.mths_begin(); mth != cls.mths_end(); ++mth) {
+    (*mth)->accept(*this);
+  }
+  m_class = nullptr;
+
+  stats::addCount("inlined calls", cls.getName(), m_numInlined - before);
+}
+
+}  // namespace jcc::ast
@@ -0,0 +1,152 @@
+#include "LazyBodies.hpp"
+
+#include <unordered_map>
+#include <unordered_set>
+
+#include "JackAST.hpp"
+#include "Statistics.hpp"
+
+namespace jcc::ast {
+
+namespace {
+
+// Finds the classes among the roots, and the functions a body calls
+class CallCollector : public MutableVisitor {
+public:
+  std::vector<ClassDecl *> classes;
+  // "Class.function" of each call
+  std::vector<std::string> callees;
+
+  void setCaller(const ClassDecl &cls) { m_class = &cls; }
+
+  void visit(EmptyNode &) override {}
+  void visit(True &) override {}
+  void visit(False &) override {}
+  void visit(This &) override {}
+  void visit(IntConst &) override {}
+  void visit(CharConst &) override {}
+  void visit(StrConst &) override {}
+  void visit(Identifier &) override {}
+  void visit(IndexExpr &node) override { node.getIndex()->accept(*this); }
+
+  void visit(BinaryOp &node) override {
+    node.getLHS()->accept(*this);
+    node.getRHS()->accept(*this);
+  }
+  void visit(UnaryOp &node) override { node.getOperand()->accept(*this); }
+
+  void visit(MethodCall &node) override {
+    const auto *callee = node.getCallee();
+    callees.push_back((callee ? callee->getType() : m_class->getName()) + '.' +
+                      node.getName());
+    visitArgs(node);
+  }
+  void visit(FunctionCall &node) override {
+    callees.push_back(node.getClassType() + '.' + node.getName());
+    visitArgs(node);
+  }
+
+  void visit(LetStmt &node) override {
+    node.getAssignee()->accept(*this);
+    node.getExpression()->accept(*this);
+  }
+  void visit(IfStmt &node) override {
+    node.getCond()->accept(*this);
+    node.getIfBlock()->accept(*this);
+    if (node.getElseBlock()) node.getElseBlock()->accept(*this);
+  }
+  void visit(WhileStmt &node) override {
+    node.getCond()->accept(*this);
+    node.getBlock()->accept(*this);
+  }
+  void visit(ReturnStmt &node) override { node.getExpr()->accept(*this); }
+
+  // The bodies are visited one at a time by run()
+  void visit(VarDecl &) override {}
+  void visit(StaticDecl &) override {}
+  void visit(MethodDecl &) override {}
+  void visit(ConstructorDecl &) override {}
+  void visit(ClassDecl &node) override { classes.push_back(&node); }
+  void visit(Block &node) override {
+    for (auto it = node.stmts_begin(); it != node.stmts_end(); ++it) {
+      (*it)->accept(*this);
+    }
+  }
+
+  void visit(RValueT &node) override { node.getWrapped()->accept(*this); }
+
+private:
+  const ClassDecl *m_class = nullptr;
+
+  void visitArgs(Call &call) {
+    for (auto it = call.args_begin(); it != call.args_end(); ++it) {
+      (*it)->accept(*this);
+    }
+  }
+};
+
+}  // namespace
+
+LazyBodies::Result LazyBodies::run(
+    const std::vector<std::unique_ptr<Node>> &roots, const std::string &cls,
+    const std::string &fcn) {
+  stats::ScopedTimer timer("parse.deferred");
+  CallCollector collector;
+  for (const auto &root : roots) root->accept(collector);
+
+  using Function = std::pair<ClassDecl *, FunctionDecl *>;
+  std::unordered_map<std::string, Function> functions;
+  std::vector<Function> worklist;
+  for (auto *c : collector.classes) {
+    auto addAll = [&](auto begin, auto end) {
+      for (; begin != end; ++begin) {
+        const Function f{c, begin->get()};
+        functions[c->getName() + '.' + f.second->getName()] = f;
+        if (!f.second->isDeferred()) worklist.push_back(f);
+      }
+    };
+    addAll(c->fcns_begin(), c->fcns_end());
+    addAll(c->mths_begin(), c->mths_end());
+  }
+
+  auto entry = functions.find(cls + '.' + fcn);
+  if (entry != functions.end()) {
+    worklist.push_back(entry->second);
+  } else {
+    for (const auto &[name, f] : functions) worklist.push_back(f);
+  }
+
+  Result result;
+  std::unordered_set<const FunctionDecl *> reached;
+  while (!worklist.empty()) {
+    auto [c, f] = worklist.back();
+    worklist.pop_back();
+    if (!reached.insert(f).second) continue;
+    if (f->isDeferred()) {
+      f->parseDefinition();
+      ++result.numParsed;
+    }
+
+    collector.callees.clear();
+    collector.setCaller(*c);
+    f->getDefinition()->accept(collector);
+    for (const auto &callee : collector.callees) {
+      auto found = functions.find(callee);
+      if (found != functions.end()) worklist.push_back(found->second);
+    }
+  }
+
+  // What was not reached is still deferred
+  for (auto *c : collector.classes) {
+    c->removeFunctions([&](const FunctionDecl &f) {
+      if (!f.isDeferred()) return false;
+      ++result.numRemoved;
+      return true;
+    });
+  }
+  stats::addCount("deferred bodies parsed", "", result.numParsed);
+  stats::addCount("deferred bodies skipped", "", result.numRemoved);
+  return result;
+}
+
+}  // namespace jcc::ast
@@ -0,0 +1,132 @@
+#include "Resolver.hpp"
+
+#include "ErrorHandling.hpp"
+#include "JackAST.hpp"
+#include "Statistics.hpp"
+
+namespace jcc::ast {
+
+namespace {
+
+template <typename Iterator>
+void number(Iterator begin, Iterator end, sym::Kind kind) {
+  unsigned index = 0;
+  for (auto var = begin; var != end; ++var) (*var)->setSlot({kind, index++});
+}
+
+}  // namespace
+
+void Resolver::run(Node &root) {
+  Resolver resolver;
+  root.accept(resolver);
+}
+
+void Resolver::numberMembers(const ClassDecl &cls) {
+  number(cls.statics_begin(), cls.statics_end(), sym::Kind::STATIC);
+  number(cls.fields_begin(), cls.fields_end(), sym::Kind::FIELD);
+}
+
+void Resolver::resolve(NamedValue &value) {
+  // Variables are either local to the function or members of its class
+  const FunctionDecl *fcn = value.getParent();
+  const VarDecl *var = fcn ? fcn->getTable().lookup(value.getName()) : nullptr;
+  if (!var && fcn && fcn->getParent()) {
+    var = fcn->getParent()->getTable().lookup(value.getName());
+  }
+  if (!var) {
+    const auto loc = value.getLocation();
+    throw TypeError(m_class ? m_class->getFile() : "", loc.column, loc.line,
+                    "Undefined variable " + value.getName());
+  }
+  value.setDecl(var);
+  if (value.getObject()) resolve(*value.getObject());
+}
+
+void Resolver::visit(Identifier &ident) { resolve(ident); }
+
+void Resolver::visit(IndexExpr &expr) {
+  resolve(expr);
+  expr.getIndex()->accept(*this);
+}
+
+void Resolver::visit(BinaryOp &binop) {
+  binop.getLHS()->accept(*this);
+  binop.getRHS()->accept(*this);
+}
+
+void Resolver::visit(UnaryOp &unop) { unop.getOperand()->accept(*this); }
+
+void Resolver::visit(FunctionCall &call) {
+  for (auto arg = call.args_begin(); arg != call.args_end(); ++arg) {
+    (*arg)->accept(*this);
+  }
+}
+
+void Resolver::visit(MethodCall &call) {
+  if (call.getCallee()) resolve(*call.getCallee());
+  for (auto arg = call.args_begin(); arg != call.args_end(); ++arg) {
+    (*arg)->accept(*this);
+  }
+}
+
+void Resolver::visit(LetStmt &let) {
+  let.getAssignee()->accept(*this);
+  let.getExpression()->accept(*this);
+}
+
+void Resolver::visit(IfStmt &stmt) {
+  stmt.getCond()->accept(*this);
+  stmt.getIfBlock()->accept(*this);
+  if (stmt.getElseBlock()) stmt.getElseBlock()->accept(*this);
+}
+
+void Resolver::visit(WhileStmt &stmt) {
+  stmt.getCond()->accept(*this);
+  stmt.getBlock()->accept(*this);
+}
+
+void Resolver::visit(ReturnStmt &stmt) { stmt.getExpr()->accept(*this); }
+
+void Resolver::visit(RValueT &rv) { rv.getWrapped()->accept(*this); }
+
+void Resolver::visit(VarDecl &decl) {
+  decl.setSlot({sym::Kind::VAR, m_numLocals++});
+}
+
+void Resolver::visit(Block &block) {
+  for (auto stmt = block.stmts_begin(); stmt != block.stmts_end(); ++stmt) {
+    (*stmt)->accept(*this);
+  }
+}
+
+void Resolver::visitFunction(FunctionDecl &decl) {
+  const ClassDecl *cls = m_class;
+  m_class = decl.getParent() ? decl.getParent() : cls;
+  // A function resolved on its own may use statics added since its class was
+  if (!cls && m_class) numberMembers(*m_class);
+
+  number(decl.prms_begin(), decl.prms_end(), sym::Kind::ARG);
+  m_numLocals = 0;
+  decl.getDefinition()->accept(*this);
+  m_class = cls;
+}
+
+void Resolver::visit(StaticDecl &decl) { visitFunction(decl); }
+void Resolver::visit(MethodDecl &decl) { visitFunction(decl); }
+void Resolver::visit(ConstructorDecl &decl) { visitFunction(decl); }
+
+void Resolver::visit(ClassDecl &cls) {
+  stats::ScopedTimer timer("resolve", cls.getName());
+
+  m_class = &cls;
+  numberMembers(cls);
+  for (auto fcn = cls.fcns_begin(); fcn != cls.fcns_end(); ++fcn) {
+    (*fcn)->accept(*this);
+  }
+  for (auto mth = cls.mths_begin(); mth != cls.mths_end(); ++mth) {
+    (*mth)->accept(*this);
+  }
+  m_class = nullptr;
+}
+
+}  // namespace jcc::ast
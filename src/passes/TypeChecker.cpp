@@ -0,0 +1,303 @@
+#include "TypeChecker.hpp"
+
+#include "ErrorHandling.hpp"
+#include "Statistics.hpp"
+
+namespace jcc::ast {
+
+namespace {
+
+using Kind = ExprType::Kind;
+
+// Whether a value of type `from` can be used where `to` is expected. Integers
+// of both widths are converted by codegen
+bool isAssignable(const ExprType &from, const ExprType &to) {
+  return from == to || (from.isInteger() && to.isInteger());
+}
+
+std::string signatureName(const std::string &cls, const std::string &fcn) {
+  return cls + '.' + fcn;
+}
+
+}  // namespace
+
+void TypeChecker::declare(const ClassDecl &cls) {
+  m_classes.insert(cls.getName());
+
+  auto declareAll = [&](auto begin, auto end) {
+    for (auto fcn = begin; fcn != end; ++fcn) {
+      std::vector<ExprType> params;
+      for (auto prm = (*fcn)->prms_begin(); prm != (*fcn)->prms_end(); ++prm) {
+        params.push_back(ExprType::fromName((*prm)->getType()));
+      }
+      declare(cls.getName(), (*fcn)->getName(),
+              ExprType::fromName((*fcn)->getReturnType()), std::move(params));
+    }
+  };
+  declareAll(cls.fcns_begin(), cls.fcns_end());
+  declareAll(cls.mths_begin(), cls.mths_end());
+}
+
+void TypeChecker::declare(const std::string &cls, const std::string &fcn,
+                          ExprType ret, std::vector<ExprType> params) {
+  m_classes.insert(cls);
+  m_signatures[signatureName(cls, fcn)] = {std::move(ret), std::move(params)};
+}
+
+void TypeChecker::declare(Node &root) {
+  // Only a class declares anything, any other node is simply annotated
+  if (!m_declaring) {
+    m_declaring = true;
+    root.accept(*this);
+    m_declaring = false;
+  }
+}
+
+void TypeChecker::check(Node &root) { root.accept(*this); }
+
+const ExprType &TypeChecker::typeOf(Node &node) {
+  node.accept(*this);
+  return node.getExprType();
+}
+
+ExprType TypeChecker::variableType(const NamedValue &value) {
+  if (const VarDecl *decl = value.getDecl()) {
+    return ExprType::fromName(decl->getType());
+  }
+
+  // Variables are either local to the function or members of its class
+  const FunctionDecl *fcn = value.getParent();
+  const VarDecl *var = fcn ? fcn->getTable().lookup(value.getName()) : nullptr;
+  if (!var && fcn && fcn->getParent()) {
+    var = fcn->getParent()->getTable().lookup(value.getName());
+  }
+  if (!var) error(value, "Undefined variable " + value.getName());
+  return ExprType::fromName(var->getType());
+}
+
+[[noreturn]] void TypeChecker::error(const Node &node,
+                                     const std::string &msg) const {
+  const auto loc = node.getLocation();
+  throw TypeError(m_class ? m_class->getFile() : "", loc.column, loc.line,
+                  msg);
+}
+
+void TypeChecker::visit(EmptyNode &node) { node.setExprType(Kind::Void); }
+void TypeChecker::visit(IntConst &node) { node.setExprType(Kind::Int); }
+void TypeChecker::visit(CharConst &node) { node.setExprType(Kind::Char); }
+void TypeChecker::visit(True &node) { node.setExprType(Kind::Boolean); }
+void TypeChecker::visit(False &node) { node.setExprType(Kind::Boolean); }
+
+void TypeChecker::visit(StrConst &node) {
+  node.setExprType({Kind::Class, "String"});
+}
+
+void TypeChecker::visit(This &node) {
+  if (!m_class) error(node, "this used outside of a class");
+  node.setExprType({Kind::Class, m_class->getName()});
+}
+
+void TypeChecker::visit(Identifier &ident) {
+  ident.setExprType(variableType(ident));
+}
+
+void TypeChecker::visit(IndexExpr &expr) {
+  const auto arr = variableType(expr);
+  if (arr != ExprType{Kind::Class, "Array"}) {
+    error(expr, "Cannot index " + expr.getName() + " of type " +
+                    arr.toString());
+  }
+  const auto &idx = typeOf(*expr.getIndex());
+  if (!idx.isInteger()) {
+    error(*expr.getIndex(), "Array index must be an int, got " +
+                                idx.toString());
+  }
+  // Arrays hold ints
+  expr.setExprType(Kind::Int);
+}
+
+void TypeChecker::visit(BinaryOp &binop) {
+  const auto &lhs = typeOf(*binop.getLHS());
+  const auto &rhs = typeOf(*binop.getRHS());
+  const bool integers = lhs.isInteger() && rhs.isInteger();
+  const bool booleans = lhs.kind == Kind::Boolean && rhs.kind == Kind::Boolean;
+
+  switch (binop.getOp()) {
+    case '+':
+    case '-':
+    case '*':
+    case '/':
+      if (integers) return binop.setExprType(Kind::Int);
+      break;
+    case '<':
+    case '>':
+      if (integers) return binop.setExprType(Kind::Boolean);
+      break;
+    case '&':
+    case '|':
+      // Bitwise on integers, logical on booleans
+      if (integers) return binop.setExprType(Kind::Int);
+      if (booleans) return binop.setExprType(Kind::Boolean);
+      break;
+    case '=':
+      if (integers || booleans) return binop.setExprType(Kind::Boolean);
+      break;
+  }
+  error(binop, std::string("Invalid operands to ") + binop.getOp() + ": " +
+                   lhs.toString() + " and " + rhs.toString());
+}
+
+void TypeChecker::visit(UnaryOp &unop) {
+  const auto &operand = typeOf(*unop.getOperand());
+  if (operand.isInteger()) return unop.setExprType(Kind::Int);
+  if (unop.getOp() == '~' && operand.kind == Kind::Boolean) {
+    return unop.setExprType(Kind::Boolean);
+  }
+  error(unop, std::string("Invalid operand to ") + unop.getOp() + ": " +
+                  operand.toString());
+}
+
+void TypeChecker::visit(FunctionCall &call) {
+  std::vector<ExprType> args;
+  for (auto arg = call.args_begin(); arg != call.args_end(); ++arg) {
+    args.push_back(typeOf(**arg));
+  }
+  checkCall(call, call.getClassType(), args, 0);
+}
+
+void TypeChecker::visit(MethodCall &call) {
+  // The object is passed as the first argument
+  std::vector<ExprType> args;
+  if (call.getCallee()) {
+    args.push_back(typeOf(*call.getCallee()));
+    if (args[0].kind != Kind::Class) {
+      error(call, "Cannot call " + call.getName() + " on " +
+                      call.getCallee()->getName() + " of type " +
+                      args[0].toString());
+    }
+  } else if (m_class) {
+    args.emplace_back(Kind::Class, m_class->getName());
+  } else {
+    error(call, "Method " + call.getName() + " called outside of a class");
+  }
+
+  for (auto arg = call.args_begin(); arg != call.args_end(); ++arg) {
+    args.push_back(typeOf(**arg));
+  }
+  checkCall(call, args[0].name, args, 1);
+}
+
+void TypeChecker::checkCall(Call &call, const std::string &cls,
+                            const std::vector<ExprType> &args,
+                            size_t implicit) {
+  const auto name = signatureName(cls, call.getName());
+  const auto sig = m_signatures.find(name);
+  if (sig == m_signatures.end()) {
+    error(call, (m_classes.count(cls) ? "Undefined function " + name
+                                      : "Undefined class " + cls));
+  }
+
+  const auto &params = sig->second.params;
+  if (params.size() != args.size()) {
+    error(call, name + " expects " + std::to_string(params.size() - implicit) +
+                    " arguments, got " +
+                    std::to_string(args.size() - implicit));
+  }
+  for (size_t i = 0; i < args.size(); ++i) {
+    if (!isAssignable(args[i], params[i])) {
+      error(call, "Argument " + std::to_string(i + 1 - implicit) + " of " +
+                      name + " expects " + params[i].toString() + ", got " +
+                      args[i].toString());
+    }
+  }
+  call.setExprType(sig->second.ret);
+}
+
+void TypeChecker::visit(LetStmt &let) {
+  const auto &var = typeOf(*let.getAssignee());
+  const auto &value = typeOf(*let.getExpression());
+  if (!isAssignable(value, var)) {
+    error(let, "Cannot assign " + value.toString() + " to " +
+                   let.getAssignee()->getName() + " of type " +
+                   var.toString());
+  }
+  let.setExprType(Kind::Void);
+}
+
+void TypeChecker::visit(IfStmt &stmt) {
+  const auto &cond = typeOf(*stmt.getCond());
+  if (cond.kind != Kind::Boolean) {
+    error(*stmt.getCond(), "Condition must be a boolean, got " +
+                               cond.toString());
+  }
+  stmt.getIfBlock()->accept(*this);
+  if (stmt.getElseBlock()) stmt.getElseBlock()->accept(*this);
+  stmt.setExprType(Kind::Void);
+}
+
+void TypeChecker::visit(WhileStmt &stmt) {
+  const auto &cond = typeOf(*stmt.getCond());
+  if (cond.kind != Kind::Boolean) {
+    error(*stmt.getCond(), "Condition must be a boolean, got " +
+                               cond.toString());
+  }
+  stmt.getBlock()->accept(*this);
+  stmt.setExprType(Kind::Void);
+}
+
+void TypeChecker::visit(ReturnStmt &stmt) {
+  const auto &value = typeOf(*stmt.getExpr());
+  if (m_function) {
+    const auto ret = ExprType::fromName(m_function->getReturnType());
+    if (!isAssignable(value, ret)) {
+      error(stmt, m_function->getName() + " returns " + ret.toString() +
+                      ", got " + value.toString());
+    }
+  }
+  stmt.setExprType(Kind::Void);
+}
+
+void TypeChecker::visit(RValueT &rv) {
+  rv.setExprType(typeOf(*rv.getWrapped()));
+}
+
+void TypeChecker::visit(VarDecl &decl) { decl.setExprType(Kind::Void); }
+
+void TypeChecker::visit(Block &block) {
+  for (auto stmt = block.stmts_begin(); stmt != block.stmts_end(); ++stmt) {
+    (*stmt)->accept(*this);
+  }
+  block.setExprType(Kind::Void);
+}
+
+void TypeChecker::visitFunction(FunctionDecl &decl) {
+  const ClassDecl *cls = m_class;
+  m_class = decl.getParent() ? decl.getParent() : cls;
+  m_function = &decl;
+  decl.getDefinition()->accept(*this);
+  decl.setExprType(Kind::Void);
+  m_function = nullptr;
+  m_class = cls;
+}
+
+void TypeChecker::visit(StaticDecl &decl) { visitFunction(decl); }
+void TypeChecker::visit(MethodDecl &decl) { visitFunction(decl); }
+void TypeChecker::visit(ConstructorDecl &decl) { visitFunction(decl); }
+
+void TypeChecker::visit(ClassDecl &cls) {
+  declare(cls);
+  if (m_declaring) return;
+  stats::ScopedTimer timer("typecheck", cls.getName());
+
+  m_class = &cls;
+  for (auto fcn = cls.fcns_begin(); fcn != cls.fcns_end(); ++fcn) {
+    (*fcn)->accept(*this);
+  }
+  for (auto mth = cls.mths_begin(); mth != cls.mths_end(); ++mth) {
+    (*mth)->accept(*this);
+  }
+  cls.setExprType(Kind::Void);
+  m_class = nullptr;
+}
+
+}  // namespace jcc::ast
@@ -0,0 +1,140 @@
+#include "BatchServer.hpp"
+
+#include <sstream>
+
+#include "CompilationEngine.hpp"
+#include "ErrorHandling.hpp"
+#include "Runtime.hpp"
+
+namespace jcc {
+
+int BatchServer::serve() {
+  std::string line;
+  int status = 0;
+  while (std::getline(m_is, line)) {
+    if (line.empty()) continue;
+
+    std::istringstream header(line);
+    std::string command;
+    header >> command;
+
+    if (command == "QUIT") break;
+
+    std::string id;
+    if (command != "JOB" || !(header >> id)) {
+      std::cerr << "Unexpected command: " << line << '\n';
+      status = 1;
+      break;
+    }
+
+    Job job;
+    job.id = id;
+    if (!readJob(id, job)) {
+      status = 1;
+      break;
+    }
+    submit(std::move(job));
+  }
+
+  for (auto &fut : m_pending) { fut.get(); }
+  m_pending.clear();
+  return status;
+}
+
+bool BatchServer::readJob(const std::string &id, Job &job) {
+  std::string line;
+  while (std::getline(m_is, line)) {
+    std::istringstream header(line);
+    std::string command;
+    header >> command;
+
+    size_t length = 0;
+    if (command == "RUN") {
+      return true;
+    } else if (command == "FILE") {
+      std::string name;
+      if (!(header >> name >> length)) break;
+      std::string source;
+      if (!readPayload(length, source)) break;
+      job.files.emplace_back(std::move(name), std::move(source));
+    } else if (command == "INPUT") {
+      if (!(header >> length) || !readPayload(length, job.input)) break;
+    } else {
+      break;
+    }
+  }
+
+  std::cerr << "Malformed job " << id << '\n';
+  return false;
+}
+
+bool BatchServer::readPayload(size_t length, std::string &payload) {
+  payload.resize(length);
+  if (!m_is.read(&payload[0], length)) return false;
+
+  // The next command starts on its own line
+  if (m_is.peek() == '\n') m_is.get();
+  return true;
+}
+
+void BatchServer::submit(Job job) {
+  // Bound the number of jobs in flight to the number of warm JITs
+  if (m_pending.size() >= m_workers) {
+    m_pending.front().get();
+    m_pending.erase(m_pending.begin());
+  }
+
+  m_pending.push_back(
+      std::async(std::launch::async, [this, job = std::move(job)] {
+        respond(job.id, runJob(job));
+      }));
+}
+
+BatchServer::Response BatchServer::runJob(const Job &job) {
+  Response response;
+  std::istringstream in(job.input);
+  std::ostringstream out;
+
+  try {
+    Runtime rt(in, out, &m_pool);
+
+    bool hasMain = false;
+    for (const auto &[name, source] : job.files) {
+      CompilationEngine engine{std::make_unique<std::istringstream>(source),
+                               name};
+      auto cls = engine.compileClass();
+      hasMain = hasMain || cls->getName() == "Main";
+      rt.addAST(std::move(cls));
+    }
+
+    if (!hasMain) {
+      response.error = "Missing class Main";
+      return response;
+    }
+
+    rt.codegen();
+    response.status = rt.run();
+  } catch (const SyntaxError &err) {
+    response.error = err.what();
+  } catch (const std::exception &ex) {
+    response.error = std::string("Caught Exception: ") + ex.what();
+  }
+
+  response.output = out.str();
+  return response;
+}
+
+void BatchServer::respond(const std::string &id, const Response &response) {
+  std::lock_guard<std::mutex> lock(m_osMutex);
+  if (!response.error.empty()) {
+    m_os << "ERROR " << id << ' ' << response.error.size() << '\n'
+         << response.error << '\n';
+  } else {
+    m_os << "OUTPUT " << id << ' ' << response.output.size() << '\n'
+         << response.output << '\n'
+         << "EXIT " << id << ' ' << response.status << '\n';
+  }
+  m_os.flush();
+}
+
+}  // namespace jcc
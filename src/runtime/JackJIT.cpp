@@ -1,6 +1,12 @@
 #include "JackJIT.hpp"
 
+#include <algorithm>
+#include <stdexcept>
+
+#include "PerfListener.hpp"
+#include "Statistics.hpp"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ExecutionEngine/JITEventListener.h"
 #include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
 #include "llvm/ExecutionEngine/Orc/OrcABISupport.h"
 #include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
@@ -9,8 +15,11 @@
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Mangler.h"
 #include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Target/TargetMachine.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/IPO/PassManagerBuilder.h"
 #include "llvm/Transforms/InstCombine/InstCombine.h"
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/Transforms/Scalar/GVN.h"
@@ -20,15 +29,59 @@ namespace exec {
 using namespace llvm;
 using namespace orc;
 
-JIT::JIT(JITTargetMachineBuilder JTMB, DataLayout aDL)
+namespace {
+
+// Compiler that records the time spent generating machine code for a module
+class TimedIRCompiler : public IRCompileLayer::IRCompiler {
+public:
+  explicit TimedIRCompiler(std::unique_ptr<IRCompiler> Compile)
+      : IRCompiler(Compile->getManglingOptions()),
+        Compile(std::move(Compile)) {}
+
+  Expected<std::unique_ptr<MemoryBuffer>> operator()(Module &M) override {
+    jcc::stats::ScopedTimer Timer("jit.codegen");
+    return (*Compile)(M);
+  }
+
+private:
+  std::unique_ptr<IRCompiler> Compile;
+};
+
+// Memory manager that records the bytes of the sections of the compiled code
+class CountingMemoryManager : public SectionMemoryManager {
+public:
+  uint8_t *allocateCodeSection(uintptr_t Size, unsigned Alignment,
+                               unsigned SectionID,
+                               StringRef SectionName) override {
+    jcc::stats::addBytes("jit code", "", Size);
+    return SectionMemoryManager::allocateCodeSection(Size, Alignment,
+                                                     SectionID, SectionName);
+  }
+
+  uint8_t *allocateDataSection(uintptr_t Size, unsigned Alignment,
+                               unsigned SectionID, StringRef SectionName,
+                               bool IsReadOnly) override {
+    jcc::stats::addBytes("jit data", "", Size);
+    return SectionMemoryManager::allocateDataSection(
+        Size, Alignment, SectionID, SectionName, IsReadOnly);
+  }
+};
+
+}  // namespace
+
+JIT::JIT(JITTargetMachineBuilder JTMB, DataLayout aDL,
+         const JITOptions &Options)
     : ES(),
       ObjectLayer(ES,
-                  []() { return std::make_unique<SectionMemoryManager>(); }),
+                  []() { return std::make_unique<CountingMemoryManager>(); }),
       CompileLayer(ES, ObjectLayer,
-                   std::make_unique<ConcurrentIRCompiler>(JTMB)),
+                   std::make_unique<TimedIRCompiler>(
+                       std::make_unique<ConcurrentIRCompiler>(JTMB))),
       OptimizeLayer(
           ES, CompileLayer,
-          [](ThreadSafeModule M, const MaterializationResponsibility &) {
+          [FramePointers = Options.FramePointers](
+              ThreadSafeModule M, const MaterializationResponsibility &) {
+            jcc::stats::ScopedTimer Timer("jit.optimize");
             auto FPM = std::make_unique<legacy::FunctionPassManager>(
                 M.getModuleUnlocked());
 
@@ -36,7 +89,12 @@ JIT::JIT(JITTargetMachineBuilder JTMB, DataLayout aDL)
             FPM->add(createPromoteMemoryToRegisterPass());
             FPM->doInitialization();
 
-            for (auto &F : *M.getModuleUnlocked()) FPM->run(F);
+            for (auto &F : *M.getModuleUnlocked()) {
+              if (FramePointers && !F.isDeclaration()) {
+                F.addFnAttr("frame-pointer", "all");
+              }
+              FPM->run(F);
+            }
 
             return M;
           }),
@@ -52,14 +110,26 @@ JIT::JIT(JITTargetMachineBuilder JTMB, DataLayout aDL)
   MainJD.addGenerator(
       cantFail(DynamicLibrarySearchGenerator::GetForCurrentProcess(
           DL.getGlobalPrefix())));
+
+  if (Options.Perf) ObjectLayer.registerJITEventListener(PerfListener::get());
+  if (Options.GDB) {
+    ObjectLayer.registerJITEventListener(
+        *JITEventListener::createGDBRegistrationListener());
+  }
+  for (auto *Listener : Options.Listeners) {
+    ObjectLayer.registerJITEventListener(*Listener);
+  }
 }
 
 llvm::JITSymbol JIT::findSymbol(StringRef symbol) {
-  auto sym = ES.lookup({&MainJD}, Mangle(symbol));
+  return findSymbol(MainJD, symbol);
+}
+
+llvm::JITSymbol JIT::findSymbol(JITDylib &JD, StringRef symbol) {
+  auto sym = ES.lookup({&JD}, Mangle(symbol));
   if (!sym) {
-    llvm::errs() << "Missing Main.main\n\n";
-    dumpEngine();
-    exit(1);
+    throw std::runtime_error("Missing symbol " + symbol.str() + ": " +
+                             llvm::toString(sym.takeError()));
   }
 
   return sym.get();
@@ -70,14 +140,15 @@ int JIT::run(llvm::JITSymbol &symbol) {
       cantFail(symbol.getAddress()))();
 }
 
-std::unique_ptr<JIT> JIT::Create() {
+std::unique_ptr<JIT> JIT::Create(const JITOptions &Options) {
   LLVMInitializeNativeTarget();
   LLVMInitializeNativeAsmPrinter();
   LLVMInitializeNativeAsmParser();
 
   auto JTMB = cantFail(JITTargetMachineBuilder::detectHost());
   auto aDL = cantFail(JTMB.getDefaultDataLayoutForTarget());
-  return std::unique_ptr<JIT>(new JIT(std::move(JTMB), std::move(aDL)));
+  return std::unique_ptr<JIT>(
+      new JIT(std::move(JTMB), std::move(aDL), Options));
 }
 
 void JIT::addModule(std::unique_ptr<Module> M) {
@@ -85,6 +156,85 @@ void JIT::addModule(std::unique_ptr<Module> M) {
   cantFail(CODLayer.add(MainJD, ThreadSafeModule(std::move(M), Ctx)));
 }
 
+void JIT::addModule(JITDylib &JD, std::unique_ptr<Module> M,
+                    ThreadSafeContext TSCtx) {
+  M->setDataLayout(DL);
+  cantFail(CODLayer.add(JD, ThreadSafeModule(std::move(M), std::move(TSCtx))));
+}
+
+JITDylib &JIT::createJobDylib() {
+  auto &JD = ES.createJITDylib("<job-" + std::to_string(NumJobs++) + ">");
+  JD.addGenerator(cantFail(DynamicLibrarySearchGenerator::GetForCurrentProcess(
+      DL.getGlobalPrefix())));
+  return JD;
+}
+
+bool emitObjectFile(Module &M, StringRef Path) {
+  LLVMInitializeNativeTarget();
+  LLVMInitializeNativeAsmPrinter();
+
+  auto JTMB = cantFail(JITTargetMachineBuilder::detectHost());
+  auto TM = JTMB.createTargetMachine();
+  if (!TM) {
+    logAllUnhandledErrors(TM.takeError(), errs(), "Cannot emit object: ");
+    return false;
+  }
+  M.setDataLayout((*TM)->createDataLayout());
+  M.setTargetTriple((*TM)->getTargetTriple().str());
+
+  std::error_code EC;
+  raw_fd_ostream Out(Path, EC, sys::fs::OF_None);
+  if (EC) {
+    errs() << "Cannot open " << Path << ": " << EC.message() << '\n';
+    return false;
+  }
+
+  // Objects are optimized with the usual -O2 pipeline, which is where the
+  // profile of a --profile-use build drives inlining and block layout
+  PassManagerBuilder PMB;
+  PMB.OptLevel = 2;
+  PMB.Inliner = createFunctionInliningPass(PMB.OptLevel, 0, false);
+  legacy::PassManager PM;
+  (*TM)->adjustPassManager(PMB);
+  PMB.populateModulePassManager(PM);
+  if ((*TM)->addPassesToEmitFile(PM, Out, nullptr, CGFT_ObjectFile)) {
+    errs() << "The target cannot emit object files\n";
+    return false;
+  }
+  PM.run(M);
+  return true;
+}
+
+JITPool::JITPool(size_t size, unsigned maxJobs, JITOptions options)
+    : MaxJobs{maxJobs}, Options{options} {
+  Free.reserve(size);
+  std::generate_n(std::back_inserter(Free), size,
+                  [&] { return JIT::Create(Options); });
+}
+
+std::unique_ptr<JIT> JITPool::acquire() {
+  {
+    std::lock_guard<std::mutex> lock(Mutex);
+    if (!Free.empty()) {
+      auto jit = std::move(Free.back());
+      Free.pop_back();
+      return jit;
+    }
+  }
+  // Every warm instance is busy, pay for a new one
+  return JIT::Create(Options);
+}
+
+void JITPool::release(std::unique_ptr<JIT> jit) {
+  if (jit->numJobs() >= MaxJobs) {
+    // Drop the instance along with every dylib it accumulated and replace it
+    // with a fresh one
+    jit = JIT::Create(Options);
+  }
+  std::lock_guard<std::mutex> lock(Mutex);
+  Free.push_back(std::move(jit));
+}
+
 void JIT::dumpEngine() const { MainJD.dump(llvm::errs()); }
 
 }  // namespace exec
@@ -0,0 +1,172 @@
+#include "PerfListener.hpp"
+
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cstdlib>
+
+#include "llvm/Object/SymbolSize.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace exec {
+using namespace llvm;
+
+namespace {
+
+// Layout of the jitdump format, see
+// tools/perf/Documentation/jitdump-specification.txt in the Linux sources
+constexpr uint32_t JitDumpMagic = 0x4A695444;
+constexpr uint32_t JitDumpVersion = 1;
+constexpr uint32_t JitCodeLoad = 0;
+
+struct JitDumpHeader {
+  uint32_t Magic;
+  uint32_t Version;
+  uint32_t TotalSize;
+  uint32_t ElfMach;
+  uint32_t Pad1;
+  uint32_t Pid;
+  uint64_t Timestamp;
+  uint64_t Flags;
+};
+
+struct JitCodeLoadRecord {
+  uint32_t Id;
+  uint32_t TotalSize;
+  uint64_t Timestamp;
+  uint32_t Pid;
+  uint32_t Tid;
+  uint64_t Vma;
+  uint64_t CodeAddr;
+  uint64_t CodeSize;
+  uint64_t CodeIndex;
+};
+
+// perf record -k 1 timestamps its samples with the monotonic clock
+uint64_t timestamp() {
+  timespec ts{};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL +
+         static_cast<uint64_t>(ts.tv_nsec);
+}
+
+bool writeAll(int fd, const void *data, size_t size) {
+  const auto *bytes = static_cast<const char *>(data);
+  while (size > 0) {
+    const auto written = ::write(fd, bytes, size);
+    if (written <= 0) return false;
+    bytes += written;
+    size -= static_cast<size_t>(written);
+  }
+  return true;
+}
+
+}  // namespace
+
+PerfListener &PerfListener::get() {
+  static PerfListener Listener;
+  return Listener;
+}
+
+PerfListener::PerfListener() {
+  const auto Pid = std::to_string(getpid());
+  const std::string MapPath = "/tmp/perf-" + Pid + ".map";
+  PerfMap = fopen(MapPath.c_str(), "w");
+  if (!PerfMap) errs() << "Could not open " << MapPath << '\n';
+
+  const char *Dir = getenv("JITDUMPDIR");
+  const std::string DumpPath =
+      std::string(Dir ? Dir : "/tmp") + "/jit-" + Pid + ".dump";
+  DumpFd = open(DumpPath.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0666);
+  if (DumpFd < 0) {
+    errs() << "Could not open " << DumpPath << '\n';
+    return;
+  }
+
+  DumpMarkerSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  DumpMarker = mmap(nullptr, DumpMarkerSize, PROT_READ | PROT_EXEC,
+                    MAP_PRIVATE, DumpFd, 0);
+  if (DumpMarker == MAP_FAILED) DumpMarker = nullptr;
+
+  JitDumpHeader Header{};
+  Header.Magic = JitDumpMagic;
+  Header.Version = JitDumpVersion;
+  Header.TotalSize = sizeof(Header);
+  Header.ElfMach = EM_X86_64;
+  Header.Pid = static_cast<uint32_t>(getpid());
+  Header.Timestamp = timestamp();
+  if (!writeAll(DumpFd, &Header, sizeof(Header))) {
+    close(DumpFd);
+    DumpFd = -1;
+  }
+}
+
+PerfListener::~PerfListener() {
+  if (PerfMap) fclose(PerfMap);
+  if (DumpMarker) munmap(DumpMarker, DumpMarkerSize);
+  if (DumpFd >= 0) close(DumpFd);
+}
+
+void PerfListener::notifyObjectLoaded(ObjectKey, const object::ObjectFile &Obj,
+                                      const RuntimeDyld::LoadedObjectInfo &L) {
+  // The symbols of the debug object hold the addresses the code was loaded at
+  auto DebugObj = L.getObjectForDebug(Obj);
+  const object::ObjectFile &LoadedObj =
+      DebugObj.getBinary() ? *DebugObj.getBinary() : Obj;
+
+  std::lock_guard<std::mutex> Lock(Mutex);
+  for (const auto &[Sym, Size] : object::computeSymbolSizes(LoadedObj)) {
+    auto Type = Sym.getType();
+    if (!Type || *Type != object::SymbolRef::ST_Function) {
+      consumeError(Type.takeError());
+      continue;
+    }
+
+    auto Name = Sym.getName();
+    auto Addr = Sym.getAddress();
+    if (!Name || !Addr || Size == 0) {
+      consumeError(Name.takeError());
+      consumeError(Addr.takeError());
+      continue;
+    }
+
+    if (PerfMap) {
+      fprintf(PerfMap, "%llx %llx %s\n",
+              static_cast<unsigned long long>(*Addr),
+              static_cast<unsigned long long>(Size), Name->str().c_str());
+    }
+    writeCodeLoad(Name->str(), *Addr, Size);
+  }
+  if (PerfMap) fflush(PerfMap);
+}
+
+void PerfListener::writeCodeLoad(const std::string &Name, uint64_t Addr,
+                                 uint64_t Size) {
+  if (DumpFd < 0) return;
+
+  JitCodeLoadRecord Record{};
+  Record.Id = JitCodeLoad;
+  Record.TotalSize =
+      static_cast<uint32_t>(sizeof(Record) + Name.size() + 1 + Size);
+  Record.Timestamp = timestamp();
+  Record.Pid = static_cast<uint32_t>(getpid());
+  Record.Tid = static_cast<uint32_t>(syscall(SYS_gettid));
+  Record.Vma = Addr;
+  Record.CodeAddr = Addr;
+  Record.CodeSize = Size;
+  Record.CodeIndex = CodeIndex++;
+
+  if (!writeAll(DumpFd, &Record, sizeof(Record)) ||
+      !writeAll(DumpFd, Name.c_str(), Name.size() + 1) ||
+      !writeAll(DumpFd, reinterpret_cast<const void *>(Addr), Size)) {
+    errs() << "Error writing the jitdump, no more functions are recorded\n";
+    close(DumpFd);
+    DumpFd = -1;
+  }
+}
+
+}  // namespace exec
@@ -0,0 +1,236 @@
+#include "Profiler.hpp"
+
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+
+#include "NameMangling.hpp"
+#include "llvm/DebugInfo/DWARF/DWARFContext.h"
+#include "llvm/Object/SymbolSize.h"
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+namespace exec {
+using namespace llvm;
+
+std::atomic<Profiler *> Profiler::Active{nullptr};
+
+Profiler::Profiler(unsigned periodUs)
+    : PeriodUs{periodUs}, Buffer{new uintptr_t[BufferSize]} {}
+
+Profiler::~Profiler() { stop(); }
+
+void Profiler::notifyObjectLoaded(ObjectKey, const object::ObjectFile &Obj,
+                                  const RuntimeDyld::LoadedObjectInfo &L) {
+  // The symbols of the debug object hold the addresses the code was loaded at
+  auto DebugObj = L.getObjectForDebug(Obj);
+  const object::ObjectFile &LoadedObj =
+      DebugObj.getBinary() ? *DebugObj.getBinary() : Obj;
+
+  std::lock_guard<std::mutex> Lock(SymbolsMutex);
+  DIContext *Lines = nullptr;
+  if (DebugObj.getBinary()) {
+    LineTables.push_back(DWARFContext::create(LoadedObj));
+    Lines = LineTables.back().get();
+    DebugObjects.push_back(std::move(DebugObj));
+  }
+
+  for (const auto &[Sym, Size] : object::computeSymbolSizes(LoadedObj)) {
+    auto Type = Sym.getType();
+    if (!Type || *Type != object::SymbolRef::ST_Function) {
+      consumeError(Type.takeError());
+      continue;
+    }
+
+    auto Name = Sym.getName();
+    auto Addr = Sym.getAddress();
+    if (!Name || !Addr || Size == 0) {
+      consumeError(Name.takeError());
+      consumeError(Addr.takeError());
+      continue;
+    }
+    Symbols.push_back(
+        {*Addr, Size, jcc::builtin::demangle(Name->str()), Lines});
+  }
+}
+
+bool Profiler::start() {
+#if defined(__x86_64__) && defined(__linux__)
+  Profiler *Expected = nullptr;
+  if (Running || !Active.compare_exchange_strong(Expected, this)) {
+    errs() << "A profiler is already running\n";
+    return false;
+  }
+
+  pthread_attr_t Attr;
+  if (pthread_getattr_np(pthread_self(), &Attr) == 0) {
+    void *Addr = nullptr;
+    size_t Size = 0;
+    pthread_attr_getstack(&Attr, &Addr, &Size);
+    StackLow = reinterpret_cast<uintptr_t>(Addr);
+    StackHigh = StackLow + Size;
+    pthread_attr_destroy(&Attr);
+  }
+
+  struct sigaction Action {};
+  Action.sa_sigaction = handleSignal;
+  Action.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigemptyset(&Action.sa_mask);
+  sigaction(SIGPROF, &Action, nullptr);
+
+  // Sample the CPU time of this thread only, the program runs on it
+  struct sigevent Event {};
+  Event.sigev_notify = SIGEV_THREAD_ID;
+  Event.sigev_signo = SIGPROF;
+  Event.sigev_notify_thread_id = static_cast<pid_t>(syscall(SYS_gettid));
+  timer_t Id;
+  if (timer_create(CLOCK_THREAD_CPUTIME_ID, &Event, &Id) != 0) {
+    errs() << "Could not create the profiling timer\n";
+    Active.store(nullptr);
+    return false;
+  }
+
+  itimerspec Spec{};
+  Spec.it_interval.tv_nsec = static_cast<long>(PeriodUs) * 1000;
+  Spec.it_value = Spec.it_interval;
+  timer_settime(Id, 0, &Spec, nullptr);
+
+  Timer = Id;
+  Running = true;
+  return true;
+#else
+  errs() << "The profiler is only supported on x86-64 Linux\n";
+  return false;
+#endif
+}
+
+void Profiler::stop() {
+#if defined(__x86_64__) && defined(__linux__)
+  if (!Running) return;
+  timer_delete(static_cast<timer_t>(Timer));
+  Timer = nullptr;
+  Running = false;
+
+  // A signal may still be pending, ignore it rather than crash
+  signal(SIGPROF, SIG_IGN);
+  Active.store(nullptr);
+#endif
+}
+
+void Profiler::handleSignal(int, siginfo_t *, void *Context) {
+#if defined(__x86_64__) && defined(__linux__)
+  Profiler *P = Active.load();
+  if (!P) return;
+
+  const auto *UC = static_cast<const ucontext_t *>(Context);
+  P->recordSample(static_cast<uintptr_t>(UC->uc_mcontext.gregs[REG_RIP]),
+                  static_cast<uintptr_t>(UC->uc_mcontext.gregs[REG_RSP]),
+                  static_cast<uintptr_t>(UC->uc_mcontext.gregs[REG_RBP]));
+#else
+  (void)Context;
+#endif
+}
+
+// Runs in the signal handler, so it only touches the preallocated buffer
+void Profiler::recordSample(uintptr_t PC, uintptr_t SP, uintptr_t FP) {
+  uintptr_t Frames[MaxDepth];
+  size_t Depth = 0;
+  Frames[Depth++] = PC;
+
+  // Each frame starts with the frame pointer of its caller followed by the
+  // return address. Stop at anything that does not look like a frame of this
+  // stack, which also covers native code built without frame pointers
+  while (Depth < MaxDepth && FP >= SP && FP % sizeof(uintptr_t) == 0 &&
+         FP >= StackLow && FP + 2 * sizeof(uintptr_t) <= StackHigh) {
+    const auto *Frame = reinterpret_cast<const uintptr_t *>(FP);
+    if (!Frame[1]) break;
+    Frames[Depth++] = Frame[1];
+    if (Frame[0] <= FP) break;
+    FP = Frame[0];
+  }
+
+  const size_t Begin = Used.fetch_add(Depth + 1);
+  if (Begin + Depth + 1 > BufferSize) {
+    Used.fetch_sub(Depth + 1);
+    Dropped.fetch_add(1);
+    return;
+  }
+  Buffer[Begin] = Depth;
+  std::copy(Frames, Frames + Depth, &Buffer[Begin + 1]);
+}
+
+size_t Profiler::numSamples() const {
+  size_t Count = 0;
+  const size_t End = std::min(Used.load(), BufferSize);
+  for (size_t I = 0; I < End; I += Buffer[I] + 1) { ++Count; }
+  return Count;
+}
+
+std::string Profiler::symbolize(uintptr_t PC) const {
+  auto It = std::upper_bound(
+      Symbols.begin(), Symbols.end(), PC,
+      [](uintptr_t Addr, const Symbol &S) { return Addr < S.Start; });
+  if (It != Symbols.begin()) {
+    --It;
+    if (PC < It->Start + It->Size) {
+      if (!It->Lines) return It->Name;
+      const auto Info = It->Lines->getLineInfoForAddress(
+          {PC, object::SectionedAddress::UndefSection});
+      return Info.Line ? It->Name + ':' + std::to_string(Info.Line) : It->Name;
+    }
+  }
+
+  // Native code, such as the builtins and the runtime itself
+  Dl_info Info{};
+  if (dladdr(reinterpret_cast<void *>(PC), &Info) && Info.dli_sname) {
+    return Info.dli_sname;
+  }
+  return "[unknown]";
+}
+
+void Profiler::writeFolded(std::ostream &os) const {
+  std::lock_guard<std::mutex> Lock(SymbolsMutex);
+  std::sort(Symbols.begin(), Symbols.end(),
+            [](const Symbol &L, const Symbol &R) { return L.Start < R.Start; });
+
+  std::map<std::string, size_t> Stacks;
+  const size_t End = std::min(Used.load(), BufferSize);
+  for (size_t I = 0; I < End; I += Buffer[I] + 1) {
+    const size_t Depth = Buffer[I];
+    std::string Stack;
+    std::string Last;
+    for (size_t F = Depth; F > 0; --F) {
+      // Return addresses point after the call, which may be the start of the
+      // next function
+      const uintptr_t PC = Buffer[I + F] - (F > 1 ? 1 : 0);
+      auto Name = symbolize(PC);
+      // Collapse consecutive frames of the same native library function
+      if (Name == Last && Name.find('.') == std::string::npos) continue;
+      if (!Stack.empty()) Stack += ';';
+      Stack += Name;
+      Last = std::move(Name);
+    }
+    ++Stacks[Stack];
+  }
+
+  for (const auto &[Stack, Count] : Stacks) {
+    os << Stack << ' ' << Count << '\n';
+  }
+}
+
+bool Profiler::writeFolded(const std::string &path) const {
+  std::ofstream out(path);
+  writeFolded(out);
+  return static_cast<bool>(out);
+}
+
+}  // namespace exec
@@ -0,0 +1,156 @@
+#include "Repl.hpp"
+
+#include <sstream>
+#include <stdexcept>
+
+#include "CompilationEngine.hpp"
+#include "ErrorHandling.hpp"
+#include "PrettyPrinter.hpp"
+
+namespace jcc {
+
+namespace {
+
+InputStream toStream(const std::string &input) {
+  return std::make_unique<std::istringstream>(input);
+}
+
+// Returns the first word of the input, which decides how it is compiled
+std::string firstWord(const std::string &input) {
+  std::istringstream is(input);
+  std::string word;
+  is >> word;
+  return word.substr(0, word.find_first_of("({[;.="));
+}
+
+}  // namespace
+
+int Repl::braceDepth(const std::string &input) {
+  int depth = 0;
+  bool inString = false;
+  for (char c : input) {
+    if (c == '"' || (inString && c == '\n')) {
+      // Jack strings have no escapes and end at the end of the line
+      inString = c == '"' && !inString;
+    } else if (!inString) {
+      depth += c == '{' ? 1 : c == '}' ? -1 : 0;
+    }
+  }
+  return depth;
+}
+
+Repl::Repl(std::istream &is, std::ostream &os)
+    : m_rt{is, os}, m_is{is}, m_os{os} {
+  auto cls = std::make_unique<ast::ClassDecl>(class_name);
+  m_cls = cls.get();
+  m_classes.insert(class_name);
+  m_rt.addAST(std::move(cls));
+}
+
+int Repl::run() {
+  std::string input;
+  std::string line;
+
+  m_os << "> " << std::flush;
+  while (std::getline(m_is, line)) {
+    input += line + '\n';
+    if (braceDepth(input) > 0) {
+      m_os << ". " << std::flush;
+      continue;
+    }
+
+    if (!eval(input)) break;
+    input.clear();
+    m_os << "> " << std::flush;
+  }
+  return 0;
+}
+
+bool Repl::eval(const std::string &input) {
+  const auto word = firstWord(input);
+  if (word.empty()) return true;
+  if (word == ":quit") return false;
+
+  try {
+    if (word == ":ast") {
+      m_os << ast::PrettyPrinter::print(*m_cls);
+    } else if (word == "class") {
+      defineClass(input);
+    } else if (word == "var") {
+      defineVars(input);
+    } else if (word == "let" || word == "do" || word == "if" ||
+               word == "while") {
+      evalStatements(input);
+    } else if (word == "return") {
+      m_os << "return is not allowed outside of a function\n";
+    } else {
+      evalExpression(input);
+    }
+  } catch (const SyntaxError &err) {
+    m_os << err.what() << '\n';
+  } catch (const std::runtime_error &err) {
+    m_os << "Error: " << err.what() << '\n';
+  }
+  return true;
+}
+
+void Repl::defineClass(const std::string &input) {
+  CompilationEngine engine{toStream(input), "<repl>"};
+  auto cls = engine.compileClass();
+  if (!m_classes.insert(cls->getName()).second) {
+    m_os << "Class " << cls->getName() << " is already defined\n";
+    return;
+  }
+
+  m_rt.define(*cls);
+  m_rt.addAST(std::move(cls));
+}
+
+void Repl::defineVars(const std::string &input) {
+  CompilationEngine engine{toStream(input), "<repl>"};
+  for (auto &var : engine.compileStaticVarDec(*m_cls)) {
+    if (m_cls->getTable().lookup(var->getName())) {
+      m_os << "Variable " << var->getName() << " is already defined\n";
+      continue;
+    }
+
+    auto *rawVar = var.get();
+    m_cls->addStatic(std::move(var));
+    m_rt.define(*m_cls, *rawVar);
+  }
+}
+
+void Repl::evalStatements(const std::string &input) {
+  auto fcn = newInputFunction();
+  CompilationEngine engine{toStream(input), "<repl>"};
+  auto body = engine.compileStatements(*m_cls, *fcn);
+  body->addStmt(std::make_unique<ast::ReturnStmt>(0));
+  fcn->addDefinition(std::move(body));
+
+  callInputFunction(std::move(fcn));
+}
+
+void Repl::evalExpression(const std::string &input) {
+  auto fcn = newInputFunction();
+  CompilationEngine engine{toStream(input), "<repl>"};
+  auto body = std::make_unique<ast::Block>();
+  body->addStmt(std::make_unique<ast::ReturnStmt>(
+      engine.compileExpression(*m_cls, *fcn)));
+  fcn->addDefinition(std::move(body));
+
+  m_os << callInputFunction(std::move(fcn)) << '\n';
+}
+
+std::unique_ptr<ast::StaticDecl> Repl::newInputFunction() {
+  return std::make_unique<ast::StaticDecl>(
+      "input" + std::to_string(m_numInputs++), "int");
+}
+
+int Repl::callInputFunction(std::unique_ptr<ast::StaticDecl> fcn) {
+  auto *rawF = fcn.get();
+  m_cls->addFunction(std::move(fcn));
+  m_rt.define(*m_cls, *rawF);
+  return m_rt.call(m_cls->getName(), rawF->getName());
+}
+
+}  // namespace jcc
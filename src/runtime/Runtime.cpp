@@ -1,10 +1,22 @@
 #include "Runtime.hpp"
 
+#include <algorithm>
+#include <fstream>
 #include <sstream>
 
 #include "Builtins.hpp"
+#include "ConstantFolder.hpp"
+#include "DependencyGraph.hpp"
+#include "EscapeAnalysis.hpp"
 #include "JackAST.hpp"
+#include "LazyBodies.hpp"
+#include "MemoryUsage.hpp"
+#include "Peephole.hpp"
 #include "PrettyPrinter.hpp"
+#include "Resolver.hpp"
+#include "Statistics.hpp"
+#include "VMGenerator.hpp"
+#include "VMInterpreter.hpp"
 
 namespace jcc::builtin {
 
@@ -217,14 +229,51 @@ void Runtime::reset(std::unique_ptr<ast::Node> ast) {
 
 void Runtime::reset() {
   m_ast.clear();
+  m_interfaces.clear();
+  m_reloaded.clear();
   m_gen.reset();
-  m_jit.reset();
-  m_context.reset(new llvm::LLVMContext);
-  m_gen = ast::LLVMGenerator::Create(*m_context);
-  m_jit = exec::JIT::Create();
+  releaseJIT();
+  m_context =
+      llvm::orc::ThreadSafeContext(std::make_unique<llvm::LLVMContext>());
+  m_gen = ast::LLVMGenerator::Create(*m_context.getContext(),
+                                     m_options.debugInfo);
+  // The code of the counters is gone with the JIT
+  m_counters.clear();
+  if (m_options.instrument) m_gen->setCounters(&m_counters);
+  m_gen->setProfile(m_options.pgo.get());
+  m_gen->setPatchable(m_options.hotReload);
+  if (m_pool) {
+    m_jit = m_pool->acquire();
+    m_dylib = &m_jit->createJobDylib();
+  } else {
+    auto jitOptions = m_options.jit;
+    if (m_profiler) {
+      jitOptions.FramePointers = true;
+      jitOptions.Listeners.push_back(m_profiler.get());
+    }
+    m_jit = exec::JIT::Create(jitOptions);
+    m_dylib = &m_jit->MainJD;
+  }
 
   // Initailize runtime and builtins
   registerBuiltins();
+  m_checker = ast::TypeChecker{};
+  declareBuiltins();
+
+  m_inliner = ast::Inliner{};
+  if (const auto &pgo = m_options.pgo) {
+    m_inliner.setCallCounts(
+        [pgo](const std::string &name) { return pgo->count(name); },
+        pgo->maxFunctionCount());
+  }
+
+  // The builtins that only read the String they are passed
+  m_escapes = ast::EscapeAnalysis{};
+  m_escapes.borrow("Output", "printString", 0);
+  m_escapes.borrow("Keyboard", "readLine", 0);
+  m_escapes.borrow("Keyboard", "readInt", 0);
+  m_escapes.borrow("String", "length", 0);
+  m_escapes.borrow("String", "charAt", 0);
 }
 
 void Runtime::addAST(std::unique_ptr<ast::Node> ast) {
@@ -240,24 +289,268 @@ void Runtime::registerBuiltins() {
   registerInput(m_gen->module());
 }
 
+namespace {
+
+// Jack type of the values of the builtins, unknown for the types that are
+// only used internally
+ast::ExprType toExprType(llvm::Type *type) {
+  using Kind = ast::ExprType::Kind;
+  if (type->isVoidTy()) return Kind::Void;
+  if (type->isIntegerTy(32)) return Kind::Int;
+  if (type->isIntegerTy(8)) return Kind::Char;
+  if (type->isIntegerTy(1)) return Kind::Boolean;
+  if (auto *cls = llvm::dyn_cast<llvm::StructType>(type)) {
+    if (cls->hasName()) return {Kind::Class, cls->getName().str()};
+  }
+  return {};
+}
+
+}  // namespace
+
+void Runtime::declareBuiltins() {
+  for (auto &fcn : m_gen->module()->functions()) {
+    const auto name = builtin::demangle(fcn.getName().str());
+    const auto sep = name.find('.');
+    if (sep == std::string::npos) continue;
+
+    auto ret = toExprType(fcn.getReturnType());
+    std::vector<ast::ExprType> params;
+    for (auto &arg : fcn.args()) params.push_back(toExprType(arg.getType()));
+    const bool internal =
+        !ret.isKnown() ||
+        std::any_of(params.begin(), params.end(),
+                    [](const auto &param) { return !param.isKnown(); });
+    if (!internal) {
+      m_checker.declare(name.substr(0, sep), name.substr(sep + 1),
+                        std::move(ret), std::move(params));
+    }
+  }
+}
+
 llvm::Module &Runtime::module() {
   llvm::Module *mod = m_gen->module();
   assert(mod && "Uninitialized Jack Runtime!");
   return *mod;
 }
 
-llvm::orc::JITDylib &Runtime::engine() { return m_jit->MainJD; }
+llvm::orc::JITDylib &Runtime::engine() { return *m_dylib; }
+
+void Runtime::releaseJIT() {
+  m_dylib = nullptr;
+  if (m_pool && m_jit) { m_pool->release(std::move(m_jit)); }
+  m_jit.reset();
+}
 
 llvm::Value *Runtime::codegen() {
+  if (m_options.lazyBodies) ast::LazyBodies::run(m_ast);
+  // The classes are declared first so that they can call each other
+  for (auto &ast : m_ast) ast::Resolver::run(*ast);
+  for (auto &ast : m_ast) m_checker.declare(*ast);
+  for (auto &ast : m_ast) m_checker.check(*ast);
+  if (m_options.inlineCalls) {
+    for (auto &ast : m_ast) m_inliner.declare(*ast);
+  }
+  if (m_options.borrowStrings) {
+    for (auto &ast : m_ast) m_escapes.declare(*ast);
+  }
+  if (m_options.hotReload) {
+    // The programs that are reloaded are made of classes
+    for (auto &ast : m_ast) {
+      const auto &cls = static_cast<const ast::ClassDecl &>(*ast);
+      m_interfaces[cls.getName()] = ast::DependencyGraph::interfaceHash(cls);
+    }
+  }
+
   llvm::Value *ret = nullptr;
-  for (auto &ast : m_ast) { ret = m_gen->codegen(*ast); }
+  for (auto &ast : m_ast) {
+    if (m_options.inlineCalls) m_inliner.run(*ast);
+    if (m_options.foldConstants) ast::ConstantFolder::run(*ast);
+    if (m_options.borrowStrings) m_escapes.run(*ast);
+    recordMemory(*ast);
+    ret = m_gen->codegen(*ast);
+  }
   return ret;
 }
 
-int Runtime::run() {
-  m_jit->addModule(m_gen->moveModule());
-  auto sym = m_jit->findSymbol(builtin::generateName("Main", "main"));
+void Runtime::define(ast::ClassDecl &cls) {
+  ast::Resolver::run(cls);
+  m_checker.check(cls);
+  if (m_options.inlineCalls) {
+    m_inliner.declare(cls);
+    m_inliner.run(cls);
+  }
+  if (m_options.foldConstants) ast::ConstantFolder::run(cls);
+  if (m_options.borrowStrings) {
+    m_escapes.declare(cls);
+    m_escapes.run(cls);
+  }
+  m_gen->codegen(cls);
+  submitModule();
+}
+
+void Runtime::define(ast::ClassDecl &cls, ast::VarDecl &var) {
+  m_gen->codegenStatic(cls, var);
+  submitModule();
+}
+
+void Runtime::define(ast::ClassDecl &cls, ast::FunctionDecl &fcn) {
+  ast::Resolver::run(fcn);
+  m_checker.check(fcn);
+  if (m_options.inlineCalls) m_inliner.run(fcn);
+  if (m_options.foldConstants) ast::ConstantFolder::run(fcn);
+  if (m_options.borrowStrings) m_escapes.run(fcn);
+  m_gen->codegen(cls, fcn);
+  submitModule();
+}
+
+void Runtime::reload(std::unique_ptr<ast::ClassDecl> cls) {
+  assert(m_options.hotReload && "The calls of the program are not patchable");
+  stats::ScopedTimer timer("reload", cls->getName());
+  auto interface = m_interfaces.find(cls->getName());
+  if (interface == m_interfaces.end()) {
+    throw std::runtime_error("Class " + cls->getName() +
+                             " is not part of the program");
+  }
+  if (interface->second != ast::DependencyGraph::interfaceHash(*cls)) {
+    throw std::runtime_error("The fields or signatures of " + cls->getName() +
+                             " changed, the program must be restarted");
+  }
+
+  // The JIT compiles the functions of the running program in the same context
+  auto lock = m_context.getLock();
+  // The class is declared already, by the definition it replaces
+  ast::Resolver::run(*cls);
+  m_checker.check(*cls);
+  if (m_options.foldConstants) ast::ConstantFolder::run(*cls);
+  if (m_options.borrowStrings) {
+    m_escapes.declare(*cls);
+    m_escapes.run(*cls);
+  }
+  // materialize() leaves the generator without a module
+  if (!m_gen->module()) {
+    m_gen->newModule("module." + std::to_string(++m_numModules));
+  }
+  m_gen->codegen(*cls);
+  auto redefinitions = m_gen->takeRedefinitions();
+  submitModule();
+
+  // The program reads the slots while they are patched, each is replaced at
+  // once. The new definitions are compiled on their first call
+  for (const auto &[name, redefinition] : redefinitions) {
+    auto slot = m_jit->findSymbol(*m_dylib, name + ".slot");
+    auto fcn = m_jit->findSymbol(*m_dylib, redefinition);
+    auto *slotAddress = reinterpret_cast<llvm::JITTargetAddress *>(
+        llvm::cantFail(slot.getAddress()));
+    __atomic_store_n(slotAddress, llvm::cantFail(fcn.getAddress()),
+                     __ATOMIC_RELEASE);
+  }
+  m_reloaded.push_back(std::move(cls));
+}
+
+int Runtime::call(const std::string &cls, const std::string &fcn) {
+  auto sym = m_jit->findSymbol(*m_dylib, builtin::generateName(cls, fcn));
   return m_jit->run(sym);
 }
 
+void Runtime::submitModule() {
+  recordMemory(module());
+  m_jit->addModule(*m_dylib, m_gen->moveModule(), m_context);
+  m_gen->newModule("module." + std::to_string(++m_numModules));
+}
+
+llvm::JITSymbol Runtime::materialize() {
+  // Only the entry point is materialized here, the rest of the program is
+  // compiled lazily while it runs
+  stats::ScopedTimer timer("jit.lookup");
+  recordMemory(module());
+  m_jit->addModule(*m_dylib, m_gen->moveModule(), m_context);
+  return m_jit->findSymbol(*m_dylib, builtin::generateName("Main", "main"));
+}
+
+void Runtime::recordMemory(const ast::Node &ast) {
+  if (stats::Statistics::get().enabled()) ast::MemoryUsage::of(ast).record();
+}
+
+void Runtime::recordMemory(const llvm::Module &mod) {
+  if (!stats::Statistics::get().enabled()) return;
+  // LLVM does not track the memory of its IR, this counts the objects of the
+  // module
+  uint64_t bytes = sizeof(llvm::Module);
+  for (const auto &global : mod.globals()) {
+    bytes += sizeof(global) + global.getNumOperands() * sizeof(llvm::Use);
+  }
+  for (const auto &fcn : mod) {
+    bytes += sizeof(fcn) + fcn.arg_size() * sizeof(llvm::Argument);
+    for (const auto &block : fcn) {
+      bytes += sizeof(block);
+      for (const auto &inst : block) {
+        bytes += sizeof(inst) + inst.getNumOperands() * sizeof(llvm::Use);
+      }
+    }
+  }
+  stats::addBytes("llvm modules", "", bytes);
+}
+
+bool Runtime::emitObject(const std::string &path) {
+  return exec::emitObjectFile(module(), path);
+}
+
+std::string Runtime::generateVM(const ast::ClassDecl &cls) {
+  recordMemory(cls);
+  size_t numRemoved = 0;
+  auto code =
+      io::Peephole::optimize(ast::VMGenerator::generate(cls), &numRemoved);
+  stats::addCount("vm instructions removed", cls.getName(), numRemoved);
+  return code;
+}
+
+bool Runtime::emitVM(const std::string &dir) {
+  for (auto &ast : m_ast) ast::Resolver::run(*ast);
+  for (auto &ast : m_ast) {
+    // The programs compiled to files are made of classes
+    const auto &cls = static_cast<const ast::ClassDecl &>(*ast);
+    std::ofstream out{dir + '/' + cls.getName() + ".vm"};
+    if (!(out << generateVM(cls))) return false;
+  }
+  return true;
+}
+
+int Runtime::interpret() {
+  exec::VMInterpreter vm{m_is, m_os};
+  for (auto &ast : m_ast) ast::Resolver::run(*ast);
+  for (auto &ast : m_ast) {
+    const auto &cls = static_cast<const ast::ClassDecl &>(*ast);
+    vm.load(generateVM(cls), cls.getName());
+  }
+  return vm.run();
+}
+
+int Runtime::run() {
+  auto sym = materialize();
+  return run(sym);
+}
+
+int Runtime::run(llvm::JITSymbol &sym) {
+  if (!m_profiler) {
+    stats::ScopedTimer timer("exec");
+    return m_jit->run(sym);
+  }
+
+  int status = 0;
+  {
+    stats::ScopedTimer timer("exec");
+    const bool sampling = m_profiler->start();
+    status = m_jit->run(sym);
+    if (sampling) m_profiler->stop();
+  }
+  if (!m_profiler->writeFolded(m_options.profile)) {
+    llvm::errs() << "Could not write the profile to " << m_options.profile
+                 << "\n";
+  } else if (m_profiler->numDropped() > 0) {
+    llvm::errs() << "Profile buffer full, dropped "
+                 << m_profiler->numDropped() << " samples\n";
+  }
+  return status;
+}
+
 }  // namespace jcc
@@ -0,0 +1,792 @@
+#include "VMInterpreter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+#include "ErrorHandling.hpp"
+#include "Statistics.hpp"
+
+// Computed gotos are a GNU extension, other compilers dispatch with a switch
+#if defined(__GNUC__)
+#define JCC_VM_THREADED 1
+#endif
+
+namespace exec {
+
+namespace {
+
+constexpr int32_t kStaticBase = 16;
+constexpr int32_t kStackBase = 2048;
+constexpr int32_t kHeapBase = 16384;
+constexpr int32_t kRamSize = 32768;
+constexpr int32_t kAddressMask = kRamSize - 1;
+// Room left on the stack for the operands when a function is entered
+constexpr int32_t kStackSlack = 1024;
+constexpr size_t kMaxFrames = 1 << 16;
+
+// The instructions of the VM, with their segment when they have one, and the
+// superinstructions that fuse the sequences the VMGenerator writes the most
+#define JCC_VM_OPCODES(X)                                                   \
+  X(PushConstant) X(PushLocal) X(PushArgument) X(PushThis) X(PushThat)      \
+  X(PushAbsolute) X(PushPointer0) X(PushPointer1) X(PopLocal) X(PopArgument) \
+  X(PopThis) X(PopThat) X(PopAbsolute) X(PopPointer0) X(PopPointer1) X(Add) \
+  X(Sub) X(Neg) X(Eq) X(Gt) X(Lt) X(And) X(Or) X(Not) X(Goto) X(IfGoto)     \
+  X(Function) X(Call) X(CallNative) X(Return) X(AddConstant)               \
+  X(SubConstant) X(IncLocal) X(IfNotGoto) X(JumpEq) X(JumpNe) X(JumpGt)     \
+  X(JumpLe) X(JumpLt) X(JumpGe)
+
+#define JCC_VM_ENUM(op) op,
+enum class Op : int32_t { JCC_VM_OPCODES(JCC_VM_ENUM) };
+#undef JCC_VM_ENUM
+
+// Halts the program from a native
+struct Halt {};
+
+struct Instr {
+  std::string op;
+  std::string arg;
+  std::string num;
+  size_t line;
+};
+
+}  // namespace
+
+int32_t VMInterpreter::functionId(const std::string &name) {
+  auto [found, inserted] =
+      m_functionIds.emplace(name, static_cast<int32_t>(m_functions.size()));
+  if (inserted) m_functions.push_back({-1, name});
+  return found->second;
+}
+
+void VMInterpreter::load(const std::string &code, const std::string &file) {
+  jcc::stats::ScopedTimer timer("vmload", file);
+  auto fail = [&](size_t line, const std::string &msg) {
+    throw jcc::SyntaxError(file, 1, line, msg);
+  };
+
+  std::vector<Instr> instrs;
+  std::istringstream in{code};
+  size_t lineNo = 0;
+  for (std::string line; std::getline(in, line);) {
+    Instr instr{"", "", "", ++lineNo};
+    std::istringstream{line.substr(0, line.find("//"))} >> instr.op >>
+        instr.arg >> instr.num;
+    if (!instr.op.empty()) instrs.push_back(std::move(instr));
+  }
+
+  auto number = [&](const Instr &instr) -> int32_t {
+    try {
+      size_t end = 0;
+      const int value = std::stoi(instr.num, &end);
+      if (end == instr.num.size() && value >= 0 && value < kRamSize) {
+        return value;
+      }
+    } catch (const std::exception &) {
+    }
+    fail(instr.line, "Expected a number in `" + instr.op + ' ' + instr.arg +
+                         ' ' + instr.num + '`');
+    return 0;
+  };
+
+  // The statics of the class follow those of the classes loaded before
+  int32_t numStatics = 0;
+  for (const auto &instr : instrs) {
+    if ((instr.op == "push" || instr.op == "pop") && instr.arg == "static") {
+      numStatics = std::max(numStatics, number(instr) + 1);
+    }
+  }
+  const int32_t staticBase = kStaticBase + m_numStatics;
+  if (staticBase + numStatics > kStackBase) {
+    fail(1, "Too many statics, the segment is full");
+  }
+  m_numStatics += numStatics;
+  m_staticBases[file] = staticBase;
+
+  // Jumps are resolved at the end of each function, where its labels are
+  // all known
+  std::unordered_map<std::string, int32_t> labels;
+  std::vector<std::pair<size_t, const Instr *>> jumps;
+  auto resolveJumps = [&]() {
+    for (const auto &[pos, instr] : jumps) {
+      const auto found = labels.find(instr->arg);
+      if (found == labels.end()) {
+        fail(instr->line, "Undefined label " + instr->arg);
+      }
+      m_code[pos] = found->second;
+    }
+    labels.clear();
+    jumps.clear();
+  };
+
+  auto emit = [&](Op op, std::initializer_list<int32_t> operands = {}) {
+    m_code.push_back(static_cast<int32_t>(op));
+    m_code.insert(m_code.end(), operands);
+  };
+  auto emitJump = [&](Op op, const Instr &target) {
+    emit(op, {0});
+    jumps.emplace_back(m_code.size() - 1, &target);
+  };
+
+  auto is = [&](size_t i, const char *op, const char *arg = nullptr) {
+    return i < instrs.size() && instrs[i].op == op &&
+           (!arg || instrs[i].arg == arg);
+  };
+  auto segment = [&](const Instr &instr, bool push) -> std::pair<Op, int32_t> {
+    const int32_t index = number(instr);
+    const auto &seg = instr.arg;
+    if (seg == "constant" && push) return {Op::PushConstant, index};
+    if (seg == "local") return {push ? Op::PushLocal : Op::PopLocal, index};
+    if (seg == "argument") {
+      return {push ? Op::PushArgument : Op::PopArgument, index};
+    }
+    if (seg == "this") return {push ? Op::PushThis : Op::PopThis, index};
+    if (seg == "that") return {push ? Op::PushThat : Op::PopThat, index};
+    if (seg == "temp" && index < 8) {
+      return {push ? Op::PushAbsolute : Op::PopAbsolute, 5 + index};
+    }
+    if (seg == "static") {
+      return {push ? Op::PushAbsolute : Op::PopAbsolute, staticBase + index};
+    }
+    if (seg == "pointer" && index < 2) {
+      if (push) return {index ? Op::PushPointer1 : Op::PushPointer0, 0};
+      return {index ? Op::PopPointer1 : Op::PopPointer0, 0};
+    }
+    fail(instr.line, "Invalid segment `" + instr.op + ' ' + seg + '`');
+    return {};
+  };
+
+  bool inFunction = false;
+  for (size_t i = 0; i < instrs.size(); ++i) {
+    const Instr &instr = instrs[i];
+    const auto &op = instr.op;
+    if (op == "function") {
+      resolveJumps();
+      Function &fcn = m_functions[functionId(instr.arg)];
+      if (fcn.address >= 0) fail(instr.line, "Redefinition of " + instr.arg);
+      fcn.address = static_cast<int32_t>(m_code.size());
+      emit(Op::Function, {number(instr)});
+      inFunction = true;
+      continue;
+    }
+    if (!inFunction) fail(instr.line, "Code outside of a function");
+
+    // Superinstructions, a label cannot be in the middle of them
+    if (is(i, "push", "local") && is(i + 1, "push", "constant") &&
+        (is(i + 2, "add") || is(i + 2, "sub")) && is(i + 3, "pop", "local") &&
+        instrs[i + 3].num == instr.num) {
+      const int32_t step = number(instrs[i + 1]);
+      emit(Op::IncLocal, {number(instr), is(i + 2, "add") ? step : -step});
+      i += 3;
+      continue;
+    }
+    if (is(i, "push", "constant") && (is(i + 1, "add") || is(i + 1, "sub"))) {
+      emit(is(i + 1, "add") ? Op::AddConstant : Op::SubConstant,
+           {number(instr)});
+      i += 1;
+      continue;
+    }
+    if (is(i, "not") && is(i + 1, "if-goto")) {
+      emitJump(Op::IfNotGoto, instrs[i + 1]);
+      i += 1;
+      continue;
+    }
+    if (is(i, "eq") || is(i, "gt") || is(i, "lt") || is(i, "sub")) {
+      // A comparison and its complement, `sub` tests that it is not zero
+      const bool negated = is(i + 1, "not") && is(i + 2, "if-goto");
+      const bool direct = is(i + 1, "if-goto");
+      if ((negated && op != "sub") || direct) {
+        Op jump = Op::JumpNe;
+        if (op == "eq") jump = negated ? Op::JumpNe : Op::JumpEq;
+        if (op == "gt") jump = negated ? Op::JumpLe : Op::JumpGt;
+        if (op == "lt") jump = negated ? Op::JumpGe : Op::JumpLt;
+        i += negated ? 2 : 1;
+        emitJump(jump, instrs[i]);
+        continue;
+      }
+    }
+
+    if (op == "push" || op == "pop") {
+      const auto [code, operand] = segment(instr, op == "push");
+      if (code == Op::PushPointer0 || code == Op::PushPointer1 ||
+          code == Op::PopPointer0 || code == Op::PopPointer1) {
+        emit(code);
+      } else {
+        emit(code, {operand});
+      }
+    } else if (op == "add") {
+      emit(Op::Add);
+    } else if (op == "sub") {
+      emit(Op::Sub);
+    } else if (op == "neg") {
+      emit(Op::Neg);
+    } else if (op == "eq") {
+      emit(Op::Eq);
+    } else if (op == "gt") {
+      emit(Op::Gt);
+    } else if (op == "lt") {
+      emit(Op::Lt);
+    } else if (op == "and") {
+      emit(Op::And);
+    } else if (op == "or") {
+      emit(Op::Or);
+    } else if (op == "not") {
+      emit(Op::Not);
+    } else if (op == "label") {
+      labels[instr.arg] = static_cast<int32_t>(m_code.size());
+    } else if (op == "goto") {
+      emitJump(Op::Goto, instr);
+    } else if (op == "if-goto") {
+      emitJump(Op::IfGoto, instr);
+    } else if (op == "call") {
+      emit(Op::Call, {0, number(instr)});
+      m_calls.push_back(
+          {m_code.size() - 2, functionId(instr.arg), instr.line, file});
+    } else if (op == "return") {
+      emit(Op::Return);
+    } else {
+      fail(instr.line, "Unknown command " + op);
+    }
+  }
+  resolveJumps();
+}
+
+void VMInterpreter::link() {
+  struct NativeDecl {
+    const char *name;
+    int32_t numArgs;
+    Native fcn;
+  };
+  static const NativeDecl natives[] = {
+      {"Math.multiply", 2, &VMInterpreter::mathMultiply},
+      {"Math.divide", 2, &VMInterpreter::mathDivide},
+      {"Math.abs", 1, &VMInterpreter::mathAbs},
+      {"Math.min", 2, &VMInterpreter::mathMin},
+      {"Math.max", 2, &VMInterpreter::mathMax},
+      {"Math.sqrt", 1, &VMInterpreter::mathSqrt},
+      {"Memory.peek", 1, &VMInterpreter::memoryPeek},
+      {"Memory.poke", 2, &VMInterpreter::memoryPoke},
+      {"Memory.alloc", 1, &VMInterpreter::memoryAlloc},
+      {"Memory.deAlloc", 1, &VMInterpreter::memoryDeAlloc},
+      {"Array.new", 1, &VMInterpreter::memoryAlloc},
+      {"Array.dispose", 1, &VMInterpreter::memoryDeAlloc},
+      {"String.new", 1, &VMInterpreter::stringNew},
+      {"String.dispose", 1, &VMInterpreter::memoryDeAlloc},
+      {"String.length", 1, &VMInterpreter::stringLength},
+      {"String.charAt", 2, &VMInterpreter::stringCharAt},
+      {"String.setCharAt", 3, &VMInterpreter::stringSetCharAt},
+      {"String.appendChar", 2, &VMInterpreter::stringAppendChar},
+      {"String.eraseLastChar", 1, &VMInterpreter::stringEraseLastChar},
+      {"String.intValue", 1, &VMInterpreter::stringIntValue},
+      {"String.setInt", 2, &VMInterpreter::stringSetInt},
+      {"String.newLine", 0, &VMInterpreter::stringNewLine},
+      {"String.backSpace", 0, &VMInterpreter::stringBackSpace},
+      {"String.doubleQuote", 0, &VMInterpreter::stringDoubleQuote},
+      {"Output.printChar", 1, &VMInterpreter::outputPrintChar},
+      {"Output.printString", 1, &VMInterpreter::outputPrintString},
+      {"Output.printInt", 1, &VMInterpreter::outputPrintInt},
+      {"Output.println", 0, &VMInterpreter::outputPrintln},
+      {"Output.backSpace", 0, &VMInterpreter::outputBackSpace},
+      {"Keyboard.readChar", 0, &VMInterpreter::keyboardReadChar},
+      {"Keyboard.readLine", 1, &VMInterpreter::keyboardReadLine},
+      {"Keyboard.readInt", 1, &VMInterpreter::keyboardReadInt},
+      {"Sys.halt", 0, &VMInterpreter::sysHalt},
+      {"Sys.error", 1, &VMInterpreter::sysError},
+      {"Sys.wait", 1, &VMInterpreter::sysWait},
+  };
+  if (m_natives.empty()) {
+    for (const auto &native : natives) m_natives.push_back(native.fcn);
+  }
+
+  for (const CallSite &call : m_calls) {
+    const Function &fcn = m_functions[call.function];
+    if (fcn.address >= 0) {
+      m_code[call.pos] = fcn.address;
+      continue;
+    }
+
+    const auto *native = std::find_if(
+        std::begin(natives), std::end(natives),
+        [&](const NativeDecl &decl) { return fcn.name == decl.name; });
+    if (native == std::end(natives)) {
+      throw jcc::SyntaxError(call.file, 1, call.line,
+                             "Undefined function " + fcn.name);
+    }
+    if (native->numArgs != m_code[call.pos + 1]) {
+      throw jcc::SyntaxError(call.file, 1, call.line,
+                             fcn.name + " takes " +
+                                 std::to_string(native->numArgs) +
+                                 " arguments");
+    }
+    m_code[call.pos - 1] = static_cast<int32_t>(Op::CallNative);
+    m_code[call.pos] = static_cast<int32_t>(native - std::begin(natives));
+  }
+  m_calls.clear();
+}
+
+#ifdef JCC_VM_THREADED
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+int VMInterpreter::run(const std::string &entry) {
+  link();
+  const auto found = m_functionIds.find(
+      m_functionIds.count("Sys.init") ? "Sys.init" : entry);
+  if (found == m_functionIds.end() ||
+      m_functions[found->second].address < 0) {
+    throw std::runtime_error("Undefined function " + entry);
+  }
+
+  m_ram.assign(kRamSize, 0);
+  m_free.clear();
+  m_heapTop = kHeapBase;
+
+  struct Frame {
+    const int32_t *ret;
+    int32_t lcl, arg, thisp, thatp;
+  };
+  std::vector<Frame> frames;
+  frames.push_back({nullptr, 0, 0, 0, 0});
+
+  jcc::stats::ScopedTimer timer("exec");
+  int16_t *const ram = m_ram.data();
+  const int32_t *const code = m_code.data();
+  const int32_t *pc = code + m_functions[found->second].address;
+  int32_t sp = kStackBase, lcl = sp, arg = sp, thisp = 0, thatp = 0;
+
+#define VM_AT(address) ram[(address)&kAddressMask]
+#define VM_PUSH(value) VM_AT(sp++) = static_cast<int16_t>(value)
+#define VM_POP() VM_AT(--sp)
+#define VM_TOP() VM_AT(sp - 1)
+#define VM_BINARY(expr)                      \
+  {                                          \
+    const int32_t y = VM_POP();              \
+    const int32_t x = VM_TOP();              \
+    VM_TOP() = static_cast<int16_t>(expr);   \
+    pc += 1;                                 \
+    VM_DISPATCH();                           \
+  }
+#define VM_JUMP(cond)                         \
+  {                                           \
+    const int32_t y = VM_POP();               \
+    const int32_t x = VM_POP();               \
+    pc = (cond) ? code + pc[1] : pc + 2;      \
+    VM_DISPATCH();                            \
+  }
+
+#ifdef JCC_VM_THREADED
+#define JCC_VM_LABEL(op) &&op_##op,
+  static const void *const labels[] = {JCC_VM_OPCODES(JCC_VM_LABEL)};
+#undef JCC_VM_LABEL
+#define VM_CASE(op) op_##op:
+#define VM_DISPATCH() goto *labels[*pc]
+#else
+#define VM_CASE(op) case Op::op:
+#define VM_DISPATCH() goto dispatch
+#endif
+
+  try {
+#ifdef JCC_VM_THREADED
+    VM_DISPATCH();
+    {
+#else
+  dispatch:
+    switch (static_cast<Op>(*pc)) {
+#endif
+      VM_CASE(PushConstant) {
+        VM_PUSH(pc[1]);
+        pc += 2;
+        VM_DISPATCH();
+      }
+      VM_CASE(PushLocal) {
+        VM_PUSH(VM_AT(lcl + pc[1]));
+        pc += 2;
+        VM_DISPATCH();
+      }
+      VM_CASE(PushArgument) {
+        VM_PUSH(VM_AT(arg + pc[1]));
+        pc += 2;
+        VM_DISPATCH();
+      }
+      VM_CASE(PushThis) {
+        VM_PUSH(VM_AT(thisp + pc[1]));
+        pc += 2;
+        VM_DISPATCH();
+      }
+      VM_CASE(PushThat) {
+        VM_PUSH(VM_AT(thatp + pc[1]));
+        pc += 2;
+        VM_DISPATCH();
+      }
+      VM_CASE(PushAbsolute) {
+        VM_PUSH(VM_AT(pc[1]));
+        pc += 2;
+        VM_DISPATCH();
+      }
+      VM_CASE(PushPointer0) {
+        VM_PUSH(thisp);
+        pc += 1;
+        VM_DISPATCH();
+      }
+      VM_CASE(PushPointer1) {
+        VM_PUSH(thatp);
+        pc += 1;
+        VM_DISPATCH();
+      }
+      VM_CASE(PopLocal) {
+        VM_AT(lcl + pc[1]) = VM_POP();
+        pc += 2;
+        VM_DISPATCH();
+      }
+      VM_CASE(PopArgument) {
+        VM_AT(arg + pc[1]) = VM_POP();
+        pc += 2;
+        VM_DISPATCH();
+      }
+      VM_CASE(PopThis) {
+        VM_AT(thisp + pc[1]) = VM_POP();
+        pc += 2;
+        VM_DISPATCH();
+      }
+      VM_CASE(PopThat) {
+        VM_AT(thatp + pc[1]) = VM_POP();
+        pc += 2;
+        VM_DISPATCH();
+      }
+      VM_CASE(PopAbsolute) {
+        VM_AT(pc[1]) = VM_POP();
+        pc += 2;
+        VM_DISPATCH();
+      }
+      VM_CASE(PopPointer0) {
+        thisp = static_cast<uint16_t>(VM_POP());
+        pc += 1;
+        VM_DISPATCH();
+      }
+      VM_CASE(PopPointer1) {
+        thatp = static_cast<uint16_t>(VM_POP());
+        pc += 1;
+        VM_DISPATCH();
+      }
+      VM_CASE(Add) VM_BINARY(x + y)
+      VM_CASE(Sub) VM_BINARY(x - y)
+      VM_CASE(Eq) VM_BINARY(x == y ? -1 : 0)
+      VM_CASE(Gt) VM_BINARY(x > y ? -1 : 0)
+      VM_CASE(Lt) VM_BINARY(x < y ? -1 : 0)
+      VM_CASE(And) VM_BINARY(x & y)
+      VM_CASE(Or) VM_BINARY(x | y)
+      VM_CASE(Neg) {
+        VM_TOP() = static_cast<int16_t>(-VM_TOP());
+        pc += 1;
+        VM_DISPATCH();
+      }
+      VM_CASE(Not) {
+        VM_TOP() = static_cast<int16_t>(~VM_TOP());
+        pc += 1;
+        VM_DISPATCH();
+      }
+      VM_CASE(Goto) {
+        pc = code + pc[1];
+        VM_DISPATCH();
+      }
+      VM_CASE(IfGoto) {
+        pc = VM_POP() != 0 ? code + pc[1] : pc + 2;
+        VM_DISPATCH();
+      }
+      VM_CASE(Function) {
+        lcl = sp;
+        for (int32_t i = 0; i < pc[1]; ++i) VM_PUSH(0);
+        if (sp > kHeapBase - kStackSlack) {
+          throw std::runtime_error("Stack overflow");
+        }
+        pc += 2;
+        VM_DISPATCH();
+      }
+      VM_CASE(Call) {
+        if (frames.size() == kMaxFrames) {
+          throw std::runtime_error("Stack overflow");
+        }
+        frames.push_back({pc + 3, lcl, arg, thisp, thatp});
+        arg = sp - pc[2];
+        pc = code + pc[1];
+        VM_DISPATCH();
+      }
+      VM_CASE(CallNative) {
+        sp -= pc[2];
+        const int16_t value = (this->*m_natives[pc[1]])(&VM_AT(sp));
+        VM_PUSH(value);
+        pc += 3;
+        VM_DISPATCH();
+      }
+      VM_CASE(Return) {
+        const int16_t value = VM_TOP();
+        VM_AT(arg) = value;
+        sp = arg + 1;
+        const Frame frame = frames.back();
+        frames.pop_back();
+        if (!frame.ret) return value;
+        pc = frame.ret;
+        lcl = frame.lcl;
+        arg = frame.arg;
+        thisp = frame.thisp;
+        thatp = frame.thatp;
+        VM_DISPATCH();
+      }
+      VM_CASE(AddConstant) {
+        VM_TOP() = static_cast<int16_t>(VM_TOP() + pc[1]);
+        pc += 2;
+        VM_DISPATCH();
+      }
+      VM_CASE(SubConstant) {
+        VM_TOP() = static_cast<int16_t>(VM_TOP() - pc[1]);
+        pc += 2;
+        VM_DISPATCH();
+      }
+      VM_CASE(IncLocal) {
+        int16_t &local = VM_AT(lcl + pc[1]);
+        local = static_cast<int16_t>(local + pc[2]);
+        pc += 3;
+        VM_DISPATCH();
+      }
+      VM_CASE(IfNotGoto) {
+        // The complement is not zero unless all the bits are set
+        pc = VM_POP() != -1 ? code + pc[1] : pc + 2;
+        VM_DISPATCH();
+      }
+      VM_CASE(JumpEq) VM_JUMP(x == y)
+      VM_CASE(JumpNe) VM_JUMP(x != y)
+      VM_CASE(JumpGt) VM_JUMP(x > y)
+      VM_CASE(JumpLe) VM_JUMP(x <= y)
+      VM_CASE(JumpLt) VM_JUMP(x < y)
+      VM_CASE(JumpGe) VM_JUMP(x >= y)
+    }
+  } catch (const Halt &) {
+  }
+  return 0;
+
+#undef VM_AT
+#undef VM_PUSH
+#undef VM_POP
+#undef VM_TOP
+#undef VM_BINARY
+#undef VM_JUMP
+#undef VM_CASE
+#undef VM_DISPATCH
+}
+
+#ifdef JCC_VM_THREADED
+#pragma GCC diagnostic pop
+#endif
+
+// The Jack OS. The error codes are those of the nand2tetris implementation
+
+void VMInterpreter::error(int16_t code) {
+  throw std::runtime_error("ERR" + std::to_string(code));
+}
+
+void VMInterpreter::checkAddress(int32_t address, int16_t code) {
+  if (address < kHeapBase || address >= m_heapTop) error(code);
+}
+
+int16_t VMInterpreter::alloc(int32_t size) {
+  if (size <= 0) error(5);
+  auto &free = m_free[static_cast<int16_t>(size)];
+  if (!free.empty()) {
+    const int16_t block = free.back();
+    free.pop_back();
+    return block;
+  }
+  // The size of each block is stored before it
+  if (m_heapTop + size + 1 > kRamSize) error(6);
+  m_ram[m_heapTop] = static_cast<int16_t>(size);
+  const auto block = static_cast<int16_t>(m_heapTop + 1);
+  m_heapTop += size + 1;
+  return block;
+}
+
+// A String is its capacity, its length and its characters
+int16_t VMInterpreter::newString(const std::string &str) {
+  const int16_t s = alloc(str.size() + 2);
+  m_ram[s] = m_ram[s + 1] = static_cast<int16_t>(str.size());
+  std::copy(str.begin(), str.end(), m_ram.begin() + s + 2);
+  return s;
+}
+
+int16_t VMInterpreter::mathMultiply(const int16_t *args) {
+  return static_cast<int16_t>(args[0] * args[1]);
+}
+
+int16_t VMInterpreter::mathDivide(const int16_t *args) {
+  if (args[1] == 0) error(3);
+  return static_cast<int16_t>(args[0] / args[1]);
+}
+
+int16_t VMInterpreter::mathAbs(const int16_t *args) {
+  return static_cast<int16_t>(std::abs(args[0]));
+}
+
+int16_t VMInterpreter::mathMin(const int16_t *args) {
+  return std::min(args[0], args[1]);
+}
+
+int16_t VMInterpreter::mathMax(const int16_t *args) {
+  return std::max(args[0], args[1]);
+}
+
+int16_t VMInterpreter::mathSqrt(const int16_t *args) {
+  if (args[0] < 0) error(4);
+  return static_cast<int16_t>(std::sqrt(args[0]));
+}
+
+int16_t VMInterpreter::memoryPeek(const int16_t *args) {
+  return m_ram[args[0] & kAddressMask];
+}
+
+int16_t VMInterpreter::memoryPoke(const int16_t *args) {
+  m_ram[args[0] & kAddressMask] = args[1];
+  return 0;
+}
+
+int16_t VMInterpreter::memoryAlloc(const int16_t *args) {
+  return alloc(args[0]);
+}
+
+int16_t VMInterpreter::memoryDeAlloc(const int16_t *args) {
+  const int32_t block = static_cast<uint16_t>(args[0]);
+  if (block > kHeapBase && block < m_heapTop) {
+    m_free[m_ram[block - 1]].push_back(args[0]);
+  }
+  return 0;
+}
+
+int16_t VMInterpreter::stringNew(const int16_t *args) {
+  if (args[0] < 0) error(14);
+  const int16_t s = alloc(args[0] + 2);
+  m_ram[s] = args[0];
+  m_ram[s + 1] = 0;
+  return s;
+}
+
+int16_t VMInterpreter::stringLength(const int16_t *args) {
+  checkAddress(args[0], 15);
+  return m_ram[args[0] + 1];
+}
+
+int16_t VMInterpreter::stringCharAt(const int16_t *args) {
+  checkAddress(args[0], 15);
+  if (args[1] < 0 || args[1] >= m_ram[args[0] + 1]) error(15);
+  return m_ram[args[0] + 2 + args[1]];
+}
+
+int16_t VMInterpreter::stringSetCharAt(const int16_t *args) {
+  checkAddress(args[0], 16);
+  if (args[1] < 0 || args[1] >= m_ram[args[0] + 1]) error(16);
+  m_ram[args[0] + 2 + args[1]] = args[2];
+  return 0;
+}
+
+int16_t VMInterpreter::stringAppendChar(const int16_t *args) {
+  checkAddress(args[0], 17);
+  int16_t &length = m_ram[args[0] + 1];
+  if (length >= m_ram[args[0]]) error(17);
+  m_ram[args[0] + 2 + length++] = args[1];
+  return args[0];
+}
+
+int16_t VMInterpreter::stringEraseLastChar(const int16_t *args) {
+  checkAddress(args[0], 18);
+  if (m_ram[args[0] + 1] == 0) error(18);
+  --m_ram[args[0] + 1];
+  return 0;
+}
+
+int16_t VMInterpreter::stringIntValue(const int16_t *args) {
+  checkAddress(args[0], 15);
+  const int16_t *chars = &m_ram[args[0] + 2];
+  const int16_t length = m_ram[args[0] + 1];
+  const bool negative = length > 0 && chars[0] == '-';
+  int32_t value = 0;
+  for (int16_t i = negative; i < length && chars[i] >= '0' && chars[i] <= '9';
+       ++i) {
+    value = value * 10 + (chars[i] - '0');
+  }
+  return static_cast<int16_t>(negative ? -value : value);
+}
+
+int16_t VMInterpreter::stringSetInt(const int16_t *args) {
+  checkAddress(args[0], 19);
+  const std::string digits = std::to_string(args[1]);
+  if (static_cast<int32_t>(digits.size()) > m_ram[args[0]]) error(19);
+  m_ram[args[0] + 1] = static_cast<int16_t>(digits.size());
+  std::copy(digits.begin(), digits.end(), m_ram.begin() + args[0] + 2);
+  return 0;
+}
+
+int16_t VMInterpreter::stringNewLine(const int16_t *) { return 128; }
+int16_t VMInterpreter::stringBackSpace(const int16_t *) { return 129; }
+int16_t VMInterpreter::stringDoubleQuote(const int16_t *) { return '"'; }
+
+int16_t VMInterpreter::outputPrintChar(const int16_t *args) {
+  // The Jack character set has its own new line and backspace
+  switch (args[0]) {
+    case 128:
+      m_os << '\n';
+      break;
+    case 129:
+      m_os << '\b';
+      break;
+    default:
+      m_os << static_cast<char>(args[0]);
+  }
+  return 0;
+}
+
+int16_t VMInterpreter::outputPrintString(const int16_t *args) {
+  checkAddress(args[0], 15);
+  const int16_t length = m_ram[args[0] + 1];
+  for (int16_t i = 0; i < length; ++i) outputPrintChar(&m_ram[args[0] + 2 + i]);
+  return 0;
+}
+
+int16_t VMInterpreter::outputPrintInt(const int16_t *args) {
+  m_os << args[0];
+  return 0;
+}
+
+int16_t VMInterpreter::outputPrintln(const int16_t *) {
+  m_os << '\n';
+  return 0;
+}
+
+int16_t VMInterpreter::outputBackSpace(const int16_t *) {
+  m_os << '\b';
+  return 0;
+}
+
+int16_t VMInterpreter::keyboardReadChar(const int16_t *) {
+  const int c = m_is.get();
+  return c == std::char_traits<char>::eof() ? 0 : static_cast<int16_t>(c);
+}
+
+int16_t VMInterpreter::keyboardReadLine(const int16_t *args) {
+  outputPrintString(args);
+  std::string line;
+  std::getline(m_is, line);
+  return newString(line);
+}
+
+int16_t VMInterpreter::keyboardReadInt(const int16_t *args) {
+  const int16_t line = keyboardReadLine(args);
+  return stringIntValue(&line);
+}
+
+int16_t VMInterpreter::sysHalt(const int16_t *) { throw Halt{}; }
+
+int16_t VMInterpreter::sysError(const int16_t *args) { error(args[0]); }
+
+int16_t VMInterpreter::sysWait(const int16_t *) { return 0; }
+
+}  // namespace exec
@@ -0,0 +1,123 @@
+#include <stdlib.h>
+
+#include <cstring>
+#include <filesystem>
+#include <sstream>
+
+#include "ASTCache.hpp"
+#include "CompilationEngine.hpp"
+#include "PrettyPrinter.hpp"
+#include "Resolver.hpp"
+#include "VMGenerator.hpp"
+#include "gtest/gtest.h"
+
+using namespace jcc;
+using namespace jcc::ast;
+
+namespace {
+
+const std::string kSource =
+    "class Main {\n"
+    "  static int count;\n"
+    "  field Array values;\n"
+    "  field char c;\n"
+    "  constructor Main new(int n) {\n"
+    "    let values = Array.new(n);\n"
+    "    let c = 65;\n"
+    "    return this;\n"
+    "  }\n"
+    "  method int sum(int n) {\n"
+    "    var int i, total;\n"
+    "    while (i < n) {\n"
+    "      let total = total + values[i];\n"
+    "      let i = i + 1;\n"
+    "    }\n"
+    "    if (~(total = 0) & true) { do print(\"sum\"); } else { return -1; }\n"
+    "    return total;\n"
+    "  }\n"
+    "  method void print(String s) {\n"
+    "    do Output.printString(s);\n"
+    "    return;\n"
+    "  }\n"
+    "  function void main() {\n"
+    "    var Main m;\n"
+    "    let m = Main.new(3);\n"
+    "    do m.print(null);\n"
+    "    let count = m.sum(false);\n"
+    "    return;\n"
+    "  }\n"
+    "}\n";
+
+std::unique_ptr<ClassDecl> parse(const std::string &source) {
+  CompilationEngine engine{std::make_unique<std::istringstream>(source),
+                           "Main.jack"};
+  return engine.compileClass();
+}
+
+// The deserialized class must be usable by the passes like a parsed one
+std::string generate(ClassDecl &cls) {
+  Resolver::run(cls);
+  return VMGenerator::generate(cls);
+}
+
+}  // namespace
+
+TEST(ASTCacheTest, RoundTrip) {
+  auto cls = parse(kSource);
+  const auto data = io::ASTCache::serialize(*cls);
+  auto copy = io::ASTCache::deserialize(data.data(), data.size());
+  ASSERT_TRUE(copy);
+
+  EXPECT_EQ(PrettyPrinter::print(*copy), PrettyPrinter::print(*cls));
+  EXPECT_EQ(copy->getFile(), "Main.jack");
+  EXPECT_EQ(copy->numFields(), 2u);
+  EXPECT_EQ(copy->numStatics(), 1u);
+  EXPECT_EQ(copy->numFunctions(), 2u);
+  EXPECT_EQ(copy->numMethods(), 2u);
+
+  const auto &sum = **(copy->mths_begin());
+  EXPECT_EQ(sum.numParams(), 2u);
+  EXPECT_EQ(sum.getLocation().line, 10u);
+  EXPECT_EQ(sum.getLocation().column, 3u);
+  EXPECT_TRUE(sum.getTable().lookup("total"));
+  EXPECT_EQ(generate(*copy), generate(*cls));
+}
+
+TEST(ASTCacheTest, Invalid) {
+  auto cls = parse(kSource);
+  auto data = io::ASTCache::serialize(*cls);
+
+  EXPECT_FALSE(io::ASTCache::deserialize(data.data(), data.size() - 1));
+  EXPECT_FALSE(io::ASTCache::deserialize(data.data(), 8));
+
+  // Another version of the format
+  auto version = data;
+  version[4] ^= 1;
+  EXPECT_FALSE(io::ASTCache::deserialize(version.data(), version.size()));
+
+  // A child that points back at its parent, the children follow the header
+  // and the records of the nodes
+  auto cycle = data;
+  uint32_t numNodes = 0;
+  std::memcpy(&numNodes, cycle.data() + 8, sizeof(numNodes));
+  std::fill_n(cycle.begin() + 20 + numNodes * 32, 4, 0);
+  EXPECT_FALSE(io::ASTCache::deserialize(cycle.data(), cycle.size()));
+}
+
+TEST(ASTCacheTest, LoadStore) {
+  char dir[] = "/tmp/jcc-cache-XXXXXX";
+  ASSERT_TRUE(mkdtemp(dir));
+  io::ASTCache cache{dir};
+
+  EXPECT_FALSE(cache.load(kSource));
+  auto cls = parse(kSource);
+  ASSERT_TRUE(cache.store(kSource, *cls));
+
+  auto cached = cache.load(kSource);
+  ASSERT_TRUE(cached);
+  EXPECT_EQ(PrettyPrinter::print(*cached), PrettyPrinter::print(*cls));
+  // Keyed by the content
+  EXPECT_FALSE(cache.load(kSource + "\n"));
+  EXPECT_NE(io::ASTCache::hash(kSource), io::ASTCache::hash(kSource + "\n"));
+  std::filesystem::remove_all(dir);
+}
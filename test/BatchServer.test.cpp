@@ -0,0 +1,115 @@
+#include "BatchServer.hpp"
+
+#include <sstream>
+
+#include "gtest/gtest.h"
+
+using namespace jcc;
+
+namespace {
+
+const std::string kEcho =
+    "class Main {\n"
+    "  function int main() {\n"
+    "    var int n;\n"
+    "    let n = Keyboard.readInt();\n"
+    "    do Output.printInt(n * 2);\n"
+    "    return n;\n"
+    "  }\n"
+    "}\n";
+
+std::string file(const std::string &name, const std::string &source) {
+  return "FILE " + name + ' ' + std::to_string(source.size()) + '\n' + source +
+         '\n';
+}
+
+std::string input(const std::string &data) {
+  return "INPUT " + std::to_string(data.size()) + '\n' + data + '\n';
+}
+
+// A single worker runs the jobs one after the other and answers in order
+int serve(const std::string &requests, std::string &answers) {
+  std::istringstream is{requests};
+  std::ostringstream os;
+  const int status = BatchServer{is, os, 1}.serve();
+  answers = os.str();
+  return status;
+}
+
+}  // namespace
+
+TEST(BatchServerTest, Framing) {
+  // The payloads are read by length, the commands they contain are not parsed
+  const std::string source = "// RUN\n// QUIT\n" + kEcho;
+  std::string answers;
+  ASSERT_EQ(serve("JOB a\n" + file("Main.jack", source) + input("21\n") +
+                      "RUN\n"
+                      "\n"
+                      "JOB b\n" +
+                      file("Main.jack", kEcho) + input("4\n") + "RUN\nQUIT\n",
+                  answers),
+            0);
+  EXPECT_EQ(answers,
+            "OUTPUT a 2\n42\n"
+            "EXIT a 21\n"
+            "OUTPUT b 1\n8\n"
+            "EXIT b 4\n");
+}
+
+TEST(BatchServerTest, Truncated) {
+  std::string answers;
+  EXPECT_EQ(serve("JOB a\nFILE Main.jack 1000\nclass Main {", answers), 1);
+  EXPECT_EQ(serve("JOB a\n" + file("Main.jack", kEcho), answers), 1);
+  EXPECT_EQ(serve("JOB a\nINPUT 10\n4\n", answers), 1);
+  EXPECT_EQ(answers, "");
+}
+
+TEST(BatchServerTest, Malformed) {
+  std::string answers;
+  EXPECT_EQ(serve("RUN\n", answers), 1);
+  EXPECT_EQ(serve("JOB\n", answers), 1);
+  EXPECT_EQ(serve("JOB a\nFILE Main.jack many\n", answers), 1);
+  EXPECT_EQ(serve("JOB a\nINPUT -\n", answers), 1);
+  EXPECT_EQ(serve("JOB a\nLINK\nRUN\n", answers), 1);
+  EXPECT_EQ(answers, "");
+
+  // The jobs read before the bad command are still answered
+  EXPECT_EQ(serve("JOB a\n" + file("Main.jack", kEcho) + input("1\n") +
+                      "RUN\nJOB b\nLINK\n",
+                  answers),
+            1);
+  EXPECT_EQ(answers, "OUTPUT a 1\n2\nEXIT a 1\n");
+}
+
+TEST(BatchServerTest, FailedJobs) {
+  const std::string noMain = "class Main { function int f() { return 0; } }";
+  const std::string syntax = "class Main { function int main() { return } }";
+  const std::string noClass = "class Other { function int f() { return 0; } }";
+
+  std::string answers;
+  ASSERT_EQ(serve("JOB a\n" + file("Main.jack", noMain) + "RUN\n" +
+                      "JOB b\n" + file("Main.jack", syntax) + "RUN\n" +
+                      "JOB c\n" + file("Other.jack", noClass) + "RUN\n" +
+                      "JOB d\n" + file("Main.jack", kEcho) + input("3\n") +
+                      "RUN\n",
+                  answers),
+            0);
+
+  // Each failure is reported and the server goes on with the next job
+  std::istringstream lines{answers};
+  std::string line;
+  std::vector<std::string> headers;
+  while (std::getline(lines, line)) {
+    if (line.rfind("ERROR", 0) == 0 || line.rfind("OUTPUT", 0) == 0 ||
+        line.rfind("EXIT", 0) == 0) {
+      headers.push_back(line.substr(0, line.rfind(' ')));
+    }
+  }
+  EXPECT_EQ(headers, (std::vector<std::string>{"ERROR a", "ERROR b",
+                                               "ERROR c", "OUTPUT d",
+                                               "EXIT d"}));
+  EXPECT_NE(answers.find("Missing symbol"), std::string::npos) << answers;
+  EXPECT_NE(answers.find("Missing class Main"), std::string::npos) << answers;
+  EXPECT_NE(answers.find("OUTPUT d 1\n6\nEXIT d 3\n"), std::string::npos)
+      << answers;
+}
@@ -1,6 +1,8 @@
 #include <sstream>
 
 #include "CompilationEngine.hpp"
+#include "ErrorHandling.hpp"
+#include "PrettyPrinter.hpp"
 #include "gtest/gtest.h"
 
 using namespace jcc;
@@ -17,3 +19,176 @@ TEST(CompilationEngineTest, CompileReturn) {}
 TEST(CompilationEngineTest, CompileExpression) {}
 TEST(CompilationEngineTest, CompileTerm) {}
 TEST(CompilationEngineTest, CompileExpressionList) {}
+
+TEST(CompilationEngineTest, SourceLocations) {
+  auto in = std::make_unique<std::istringstream>(
+      "class Main {\n"
+      "  function int main() {\n"
+      "    var int x;\n"
+      "    let x = 1 + 2;\n"
+      "    // comment\n"
+      "    return x;\n"
+      "  }\n"
+      "}\n");
+  CompilationEngine engine{std::move(in), "Main.jack"};
+  auto cls = engine.compileClass();
+  EXPECT_EQ(cls->getFile(), "Main.jack");
+  EXPECT_EQ(cls->getLocation().line, 1u);
+  EXPECT_EQ(cls->getLocation().column, 1u);
+
+  auto &main = **cls->fcns_begin();
+  EXPECT_EQ(main.getLocation().line, 2u);
+  EXPECT_EQ(main.getLocation().column, 3u);
+
+  auto stmt = main.getDefinition()->stmts_begin();
+  EXPECT_EQ((*stmt)->getLocation().line, 3u);
+  EXPECT_EQ((*stmt)->getLocation().column, 13u);
+
+  auto &let = static_cast<ast::LetStmt &>(**++stmt);
+  EXPECT_EQ(let.getLocation().line, 4u);
+  EXPECT_EQ(let.getLocation().column, 5u);
+  EXPECT_EQ(let.getAssignee()->getLocation().column, 9u);
+  EXPECT_EQ(let.getExpression()->getLocation().column, 15u);
+
+  EXPECT_EQ((*++stmt)->getLocation().line, 6u);
+}
+
+TEST(CompilationEngineTest, PackedSourceLocations) {
+  ast::IntConst node{1};
+  node.setLocation({70000, 4000});
+  EXPECT_EQ(node.getLocation().line, 70000u);
+  EXPECT_EQ(node.getLocation().column, 4000u);
+
+  // Clamped to what fits in 32 bits
+  node.setLocation({1u << 21, 1u << 13});
+  EXPECT_EQ(node.getLocation().line, ast::SourceLocation::kMaxLine);
+  EXPECT_EQ(node.getLocation().column, ast::SourceLocation::kMaxColumn);
+  EXPECT_FALSE(ast::IntConst{1}.getLocation().isValid());
+}
+
+TEST(CompilationEngineTest, UndefinedVariable) {
+  CompilationEngine engine{std::make_unique<std::istringstream>(
+                               "class Main {\n"
+                               "  function int f() { return 1 + y; }\n"
+                               "}\n"),
+                           "Main.jack"};
+  try {
+    engine.compileClass();
+    FAIL() << "Expected a syntax error";
+  } catch (const SyntaxError &err) {
+    EXPECT_NE(std::string(err.what()).find("Undefined variable y"),
+              std::string::npos)
+        << err.what();
+  }
+}
+
+TEST(CompilationEngineTest, ParameterScope) {
+  // The parameters of a function are not visible from the next one, whether
+  // the bodies are parsed in order or recorded for the parse threads
+  const std::string source =
+      "class Main {\n"
+      "  function int f(int n) { return n; }\n"
+      "  function int g() { return n; }\n"
+      "}\n";
+  for (unsigned threads : {1u, 4u}) {
+    CompilationEngine engine{std::make_unique<std::istringstream>(source),
+                             "Main.jack"};
+    engine.setParseThreads(threads);
+    EXPECT_THROW(engine.compileClass(), SyntaxError) << threads;
+  }
+
+  CompilationEngine engine{std::make_unique<std::istringstream>(
+                               "class Main {\n"
+                               "  field int x;\n"
+                               "  function int f(int n) { return n; }\n"
+                               "  method int g(int m) { return m + x; }\n"
+                               "}\n"),
+                           "Main.jack"};
+  engine.setParseThreads(4);
+  auto cls = engine.compileClass();
+  EXPECT_EQ(cls->getTable().size(), 1u);
+  EXPECT_FALSE(cls->getTable().lookup("n"));
+  const auto &g = **cls->mths_begin();
+  EXPECT_TRUE(g.getTable().lookup("m"));
+  EXPECT_TRUE(g.getTable().lookup("this"));
+  EXPECT_FALSE(g.getTable().lookup("n"));
+}
+
+TEST(CompilationEngineTest, ParseThreads) {
+  // Large enough for every thread to get bodies
+  std::string source = "class Main {\n  static int total;\n";
+  for (int i = 0; i < 400; ++i) {
+    source += "  function int f" + std::to_string(i) + "(int n) {\n";
+    source += "    var int i;\n";
+    for (int j = 0; j < 10; ++j) {
+      source += "    let i = n + (total * " + std::to_string(j) + ");\n";
+    }
+    source += "    return i;\n  }\n";
+  }
+  source += "}\n";
+
+  auto parse = [&](const std::string &source, unsigned threads) {
+    CompilationEngine engine{std::make_unique<std::istringstream>(source),
+                             "Main.jack"};
+    engine.setParseThreads(threads);
+    return engine.compileClass();
+  };
+  auto cls = parse(source, 4);
+  ASSERT_EQ(cls->numFunctions(), 400u);
+  EXPECT_EQ(ast::PrettyPrinter::print(*cls),
+            ast::PrettyPrinter::print(*parse(source, 1)));
+  const auto &last = **(cls->fcns_end() - 1);
+  EXPECT_EQ(last.getName(), "f399");
+  EXPECT_EQ((*last.getDefinition()->stmts_begin())->getLocation().line,
+            4u + 399 * 14);
+
+  // The first error of the file is reported, whichever thread finds it
+  std::string errors = source;
+  errors.replace(errors.find("let i", errors.size() * 3 / 4), 5, "let 1");
+  errors.replace(errors.find("let i", errors.size() / 4), 5, "let 2");
+  std::string expected;
+  try {
+    parse(errors, 1);
+  } catch (const SyntaxError &err) {
+    expected = err.what();
+  }
+  ASSERT_FALSE(expected.empty());
+  try {
+    parse(errors, 4);
+    FAIL() << "Expected a syntax error";
+  } catch (const SyntaxError &err) {
+    EXPECT_EQ(err.what(), expected);
+  }
+}
+
+TEST(CompilationEngineTest, ParseThreadsErrorOrder) {
+  // The error of a body comes before that of a later signature or of the end
+  // of the class, whether the bodies are recorded or not
+  const std::string body =
+      "class Main {\n"
+      "  function int f() {\n"
+      "    return x;\n"
+      "  }\n";
+  const std::vector<std::string> sources = {
+      body + "  function int g(int class) { return 0; }\n}\n",
+      body + "  function int g() { return 0; }\n  field int y;\n}\n",
+      body + "  function int g() { return 0; ",
+  };
+  for (const auto &source : sources) {
+    std::vector<std::string> errors;
+    for (unsigned threads : {1u, 4u}) {
+      CompilationEngine engine{std::make_unique<std::istringstream>(source),
+                               "Main.jack"};
+      engine.setParseThreads(threads);
+      try {
+        engine.compileClass();
+        ADD_FAILURE() << "Expected a syntax error\n" << source;
+      } catch (const SyntaxError &err) {
+        errors.push_back(err.what());
+      }
+    }
+    ASSERT_EQ(errors.size(), 2u);
+    EXPECT_NE(errors[0].find("3:"), std::string::npos) << errors[0];
+    EXPECT_EQ(errors[0], errors[1]);
+  }
+}
@@ -0,0 +1,94 @@
+#include <sstream>
+
+#include "CompilationEngine.hpp"
+#include "ConstantFolder.hpp"
+#include "SourcePrinter.hpp"
+#include "gtest/gtest.h"
+
+using namespace jcc;
+
+namespace {
+
+// Fold the body of `function int f(int x, boolean b)` and print it back
+std::string fold(const std::string &body, size_t *numFolded = nullptr) {
+  CompilationEngine engine{std::make_unique<std::istringstream>(
+      "class Main {\n"
+      "  function int f(int x, boolean b) {\n" +
+      body +
+      "  }\n"
+      "}\n")};
+  auto cls = engine.compileClass();
+  const auto n = ast::ConstantFolder::run(*cls);
+  if (numFolded) *numFolded = n;
+
+  // Only keep the statements of the function
+  const auto src = ast::SourcePrinter::print(*cls);
+  const auto begin = src.find("{\n", src.find("function")) + 2;
+  return src.substr(begin, src.rfind("  }\n") - begin);
+}
+
+}  // namespace
+
+TEST(ConstantFolderTest, Arithmetic) {
+  size_t numFolded = 0;
+  EXPECT_EQ(fold("    return (2 * 3) + (10 / 4) - 1;\n", &numFolded),
+            "    return 7;\n");
+  EXPECT_EQ(numFolded, 4u);
+
+  EXPECT_EQ(fold("    return -(2 - 5);\n"), "    return 3;\n");
+  EXPECT_EQ(fold("    return (6 & 3) | 8;\n"), "    return 10;\n");
+  EXPECT_EQ(fold("    return ~0;\n"), "    return -1;\n");
+
+  // 32 bit wrap around, like the generated code
+  EXPECT_EQ(fold("    return 65536 * 32768;\n"),
+            "    return -2147483648;\n");
+}
+
+TEST(ConstantFolderTest, Comparisons) {
+  EXPECT_EQ(fold("    let b = 1 < 2;\n    return 0;\n"),
+            "    let b = true;\n    return 0;\n");
+  EXPECT_EQ(fold("    let b = (3 = 4) | ~false;\n    return 0;\n"),
+            "    let b = true;\n    return 0;\n");
+}
+
+TEST(ConstantFolderTest, TrapsAreKept) {
+  EXPECT_EQ(fold("    return 1 / 0;\n"), "    return 1 / 0;\n");
+}
+
+TEST(ConstantFolderTest, Identities) {
+  EXPECT_EQ(fold("    return ((x + 0) * 1) - (0 * 5);\n"),
+            "    return x;\n");
+  EXPECT_EQ(fold("    return 0 * x;\n"), "    return 0;\n");
+  EXPECT_EQ(fold("    return -(-x);\n"), "    return x;\n");
+  EXPECT_EQ(fold("    let b = (b & true) | false;\n    return 0;\n"),
+            "    let b = b;\n    return 0;\n");
+
+  // The call has to run
+  EXPECT_EQ(fold("    return 0 * Main.f(x, b);\n"),
+            "    return 0 * Main.f(x, b);\n");
+}
+
+TEST(ConstantFolderTest, DeadBranches) {
+  size_t numFolded = 0;
+  EXPECT_EQ(fold("    if (1 < 2) {\n"
+                 "      let x = 1;\n"
+                 "    } else {\n"
+                 "      let x = 2;\n"
+                 "    }\n"
+                 "    while (false) {\n"
+                 "      let x = 3;\n"
+                 "    }\n"
+                 "    if (b) {\n"
+                 "      return 1;\n"
+                 "      let x = 4;\n"
+                 "    }\n"
+                 "    return x;\n"
+                 "    let x = 5;\n",
+                 &numFolded),
+            "    let x = 1;\n"
+            "    if (b) {\n"
+            "      return 1;\n"
+            "    }\n"
+            "    return x;\n");
+  EXPECT_EQ(numFolded, 5u);
+}
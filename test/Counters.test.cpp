@@ -0,0 +1,100 @@
+#include <sstream>
+
+#include "Counters.hpp"
+#include "gtest/gtest.h"
+
+using namespace jcc::instr;
+
+TEST(CountersTest, AddressesAreStable) {
+  CounterTable table;
+  auto &first = table.add("Main.main", Counter::Kind::Function, 2);
+  for (int i = 0; i < 1000; ++i) {
+    table.add("Main.f" + std::to_string(i), Counter::Kind::Function, 0);
+  }
+  first.count = 3;
+  EXPECT_EQ(table.size(), 1001u);
+  EXPECT_EQ(table.find("Main.main"), &first);
+  EXPECT_EQ(table.find("Main.main")->count, 3u);
+  EXPECT_EQ(table.find("Main.missing"), nullptr);
+}
+
+TEST(CountersTest, SameName) {
+  CounterTable table;
+  auto &loop = table.add("Main.f:4:5", Counter::Kind::Loop, 4);
+  loop.count = 2;
+  // A function generated again counts in the counters of the first one
+  EXPECT_EQ(&table.add("Main.f:4:5", Counter::Kind::Loop, 4), &loop);
+  EXPECT_EQ(table.size(), 1u);
+  EXPECT_EQ(loop.count, 2u);
+
+  table.clear();
+  EXPECT_EQ(table.find("Main.f:4:5"), nullptr);
+  EXPECT_EQ(table.add("Main.f:4:5", Counter::Kind::Loop, 4).count, 0u);
+}
+
+TEST(CountersTest, SortedByCount) {
+  CounterTable table;
+  table.add("Main.main", Counter::Kind::Function, 2).count = 1;
+  table.add("Main.main:4", Counter::Kind::Loop, 4).count = 100;
+  table.add("Main.f", Counter::Kind::Function, 8).count = 10;
+  table.add("Main.g", Counter::Kind::Function, 12).count = 10;
+  table.add("Main.unused", Counter::Kind::Function, 16);
+
+  const auto sorted = table.sorted();
+  ASSERT_EQ(sorted.size(), 5u);
+  EXPECT_EQ(sorted[0]->name, "Main.main:4");
+  EXPECT_EQ(sorted[1]->name, "Main.f");
+  EXPECT_EQ(sorted[2]->name, "Main.g");
+  EXPECT_EQ(sorted[3]->name, "Main.main");
+  EXPECT_EQ(sorted[4]->name, "Main.unused");
+
+  std::ostringstream os;
+  table.print(os);
+  const auto report = os.str();
+  EXPECT_LT(report.find("Main.main:4"), report.find("Main.f"));
+  EXPECT_NE(report.find("loop"), std::string::npos);
+  EXPECT_EQ(report.find("Main.unused"), std::string::npos);
+}
+
+TEST(CountersTest, ProfileRoundTrip) {
+  CounterTable table;
+  table.add("Main.main", Counter::Kind::Function, 2).count = 1;
+  table.add("Main.f", Counter::Kind::Function, 8).count = 40;
+  table.add("Main.f:10:5:entry", Counter::Kind::Branch, 10).count = 40;
+  table.add("Main.f:10:5:then", Counter::Kind::Branch, 10).count = 30;
+  // Statements on the same line are told apart by their column
+  table.add("Main.f:12:5", Counter::Kind::Loop, 12).count = 5;
+  table.add("Main.f:12:24", Counter::Kind::Loop, 12).count = 7;
+
+  std::stringstream ss;
+  table.write(ss);
+  auto result = Profile::read(ss);
+  ASSERT_FALSE(result.hasError());
+  const Profile &profile = result;
+
+  EXPECT_EQ(profile.size(), 6u);
+  EXPECT_EQ(profile.maxFunctionCount(), 40u);
+  EXPECT_EQ(profile.count("Main.f:10:5:then"), 30u);
+  EXPECT_EQ(profile.count("Main.f:12:5"), 5u);
+  EXPECT_EQ(profile.count("Main.f:12:24"), 7u);
+  EXPECT_FALSE(profile.count("Main.g").has_value());
+}
+
+TEST(CountersTest, MalformedProfile) {
+  std::istringstream missingHeader("function 1 Main.main\n");
+  EXPECT_TRUE(Profile::read(missingHeader).hasError());
+
+  std::istringstream badLine("# jcc profile v2\nfunction Main.main\n");
+  EXPECT_TRUE(Profile::read(badLine).hasError());
+
+  // The statements of the first version were only named by their line
+  std::istringstream oldVersion("# jcc profile v1\nloop 3 Main.main:4\n");
+  EXPECT_TRUE(Profile::read(oldVersion).hasError());
+
+  // Distinct statements are never merged
+  std::istringstream duplicate(
+      "# jcc profile v2\nloop 3 Main.main:4:5\nloop 4 Main.main:4:5\n");
+  EXPECT_TRUE(Profile::read(duplicate).hasError());
+
+  EXPECT_TRUE(Profile::read("/nonexistent/profile").hasError());
+}
@@ -0,0 +1,131 @@
+#include <stdlib.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#include "CompilationEngine.hpp"
+#include "DependencyGraph.hpp"
+#include "gtest/gtest.h"
+
+using namespace jcc;
+using namespace jcc::ast;
+
+namespace {
+
+std::unique_ptr<ClassDecl> parse(const std::string &source,
+                                 const std::string &file = "") {
+  CompilationEngine engine{std::make_unique<std::istringstream>(source),
+                           file};
+  return engine.compileClass();
+}
+
+const std::string kPoint =
+    "class Point {\n"
+    "  field int x, y;\n"
+    "  constructor Point new(int ax, int ay) {\n"
+    "    let x = ax;\n"
+    "    let y = ay;\n"
+    "    return this;\n"
+    "  }\n"
+    "  method int sum() { return x + y; }\n"
+    "}\n";
+
+const std::string kMain =
+    "class Main {\n"
+    "  static Line line;\n"
+    "  function void main() {\n"
+    "    var Point p;\n"
+    "    let p = Point.new(1, 2);\n"
+    "    do Output.printInt(p.sum());\n"
+    "    return;\n"
+    "  }\n"
+    "  function int twice(Main m) { return Main.twice(m); }\n"
+    "}\n";
+
+}  // namespace
+
+TEST(DependencyGraphTest, Dependencies) {
+  EXPECT_EQ(DependencyGraph::dependencies(*parse(kMain)),
+            (std::set<std::string>{"Line", "Output", "Point"}));
+  EXPECT_TRUE(DependencyGraph::dependencies(*parse(kPoint)).empty());
+}
+
+TEST(DependencyGraphTest, Interface) {
+  const auto hash = DependencyGraph::interfaceHash(*parse(kPoint));
+
+  // The bodies are not part of the interface
+  std::string body = kPoint;
+  body.replace(body.find("x + y"), 5, "y + x");
+  EXPECT_EQ(DependencyGraph::interfaceHash(*parse(body)), hash);
+
+  std::string signature = kPoint;
+  signature.replace(signature.find("int sum"), 7, "char sum");
+  EXPECT_NE(DependencyGraph::interfaceHash(*parse(signature)), hash);
+
+  std::string fields = kPoint;
+  fields.replace(fields.find("x, y"), 4, "y, x");
+  EXPECT_NE(DependencyGraph::interfaceHash(*parse(fields)), hash);
+}
+
+TEST(DependencyGraphTest, Invalidated) {
+  DependencyGraph previous;
+  previous.add(*parse(kPoint, "Point.jack"), 1);
+  previous.add(*parse(kMain, "Main.jack"), 2);
+
+  char dir[] = "/tmp/jcc-deps-XXXXXX";
+  ASSERT_TRUE(mkdtemp(dir));
+  const std::string path = std::string(dir) + "/jcc.deps";
+  ASSERT_TRUE(previous.write(path));
+
+  DependencyGraph graph;
+  ASSERT_TRUE(graph.read(path));
+  ASSERT_EQ(graph.size(), 2u);
+  ASSERT_TRUE(graph.findFile("Main.jack"));
+  EXPECT_EQ(*graph.findFile("Main.jack"), "Main");
+  EXPECT_EQ(graph.find("Main")->sourceHash, 2u);
+  EXPECT_EQ(graph.find("Main")->dependencies,
+            previous.find("Main")->dependencies);
+  std::filesystem::remove_all(dir);
+
+  // A change of the body of Point does not rebuild Main
+  std::string body = kPoint;
+  body.replace(body.find("x + y"), 5, "y + x");
+  graph.add(*parse(body, "Point.jack"), 3);
+  EXPECT_TRUE(graph.invalidated(previous).empty());
+
+  std::string signature = kPoint;
+  signature.replace(signature.find("int sum"), 7, "char sum");
+  graph.add(*parse(signature, "Point.jack"), 4);
+  EXPECT_EQ(graph.invalidated(previous), std::vector<std::string>{"Main"});
+
+  // Unless it is rebuilt already
+  graph.add(*parse(kMain, "Main.jack"), 2);
+  EXPECT_TRUE(graph.invalidated(previous).empty());
+}
+
+TEST(DependencyGraphTest, DeletedClass) {
+  char dir[] = "/tmp/jcc-deps-XXXXXX";
+  ASSERT_TRUE(mkdtemp(dir));
+  const std::string point = std::string(dir) + "/Point.jack";
+  const std::string main = std::string(dir) + "/Main.jack";
+  std::ofstream{point} << kPoint;
+  std::ofstream{main} << kMain;
+
+  DependencyGraph previous;
+  previous.add(*parse(kPoint, point), 1);
+  previous.add(*parse(kMain, main), 2);
+  DependencyGraph graph;
+  ASSERT_TRUE(previous.write(std::string(dir) + "/jcc.deps"));
+  ASSERT_TRUE(graph.read(std::string(dir) + "/jcc.deps"));
+  EXPECT_TRUE(graph.removeMissingFiles().empty());
+  EXPECT_EQ(graph.size(), 2u);
+
+  // Main is rebuilt to report that the class it uses is gone
+  std::filesystem::remove(point);
+  EXPECT_EQ(graph.removeMissingFiles(), std::vector<std::string>{"Point"});
+  EXPECT_EQ(graph.size(), 1u);
+  EXPECT_FALSE(graph.find("Point"));
+  EXPECT_EQ(graph.invalidated(previous), std::vector<std::string>{"Main"});
+  std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,87 @@
+#include <sstream>
+
+#include "CompilationEngine.hpp"
+#include "EscapeAnalysis.hpp"
+#include "Resolver.hpp"
+#include "TypeChecker.hpp"
+#include "gtest/gtest.h"
+
+using namespace jcc;
+using namespace jcc::ast;
+
+namespace {
+
+// Number of borrowed literals of `function void main()`, which may call the
+// functions given, themselves without literals
+size_t numBorrowed(const std::string &functions, const std::string &main) {
+  CompilationEngine engine{std::make_unique<std::istringstream>(
+      "class Main {\n" + functions +
+      "  function void main() {\n"
+      "    var String t;\n" +
+      main +
+      "    return;\n"
+      "  }\n"
+      "}\n")};
+  auto cls = engine.compileClass();
+  Resolver::run(*cls);
+
+  const ExprType String{ExprType::Kind::Class, "String"};
+  TypeChecker checker;
+  checker.declare("Output", "printString", ExprType::Kind::Void, {String});
+  checker.declare("String", "appendChar", String,
+                  {String, ExprType::Kind::Char});
+  checker.declare("Other", "f", ExprType::Kind::Void, {String});
+  checker.declare(*cls);
+  checker.check(*cls);
+
+  EscapeAnalysis escapes;
+  escapes.borrow("Output", "printString", 0);
+  escapes.declare(*cls);
+  return escapes.run(*cls);
+}
+
+const char *const s_functions =
+    "  function void say(String s) {\n"
+    "    do Output.printString(s);\n"
+    "    return;\n"
+    "  }\n"
+    "  function void repeat(String s, int n) {\n"
+    "    if (n > 0) {\n"
+    "      do Main.say(s);\n"
+    "      do Main.repeat(s, n - 1);\n"
+    "    }\n"
+    "    return;\n"
+    "  }\n"
+    "  function String keep(String s) {\n"
+    "    return s;\n"
+    "  }\n"
+    "  function void copy(String s) {\n"
+    "    var String u;\n"
+    "    let u = s;\n"
+    "    return;\n"
+    "  }\n"
+    "  function void append(String s) {\n"
+    "    do s.appendChar(33);\n"
+    "    return;\n"
+    "  }\n";
+
+}  // namespace
+
+TEST(EscapeAnalysisTest, Borrowed) {
+  EXPECT_EQ(numBorrowed("", "    do Output.printString(\"a\");\n"), 1u);
+  EXPECT_EQ(numBorrowed(s_functions, "    do Main.say(\"a\");\n"), 1u);
+  EXPECT_EQ(numBorrowed(s_functions, "    do Main.repeat(\"a\", 3);\n"), 1u);
+  EXPECT_EQ(numBorrowed(s_functions,
+                        "    do Output.printString(\"a\");\n"
+                        "    do Output.printString(\"b\");\n"),
+            2u);
+}
+
+TEST(EscapeAnalysisTest, Escaping) {
+  EXPECT_EQ(numBorrowed(s_functions, "    let t = \"a\";\n"), 0u);
+  EXPECT_EQ(numBorrowed(s_functions, "    let t = Main.keep(\"a\");\n"), 0u);
+  EXPECT_EQ(numBorrowed(s_functions, "    do Main.copy(\"a\");\n"), 0u);
+  EXPECT_EQ(numBorrowed(s_functions, "    do Main.append(\"a\");\n"), 0u);
+  // Not declared, so it may keep its argument
+  EXPECT_EQ(numBorrowed(s_functions, "    do Other.f(\"a\");\n"), 0u);
+}
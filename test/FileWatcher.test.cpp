@@ -0,0 +1,32 @@
+#include <stdlib.h>
+
+#include <filesystem>
+#include <fstream>
+
+#include "FileWatcher.hpp"
+#include "gtest/gtest.h"
+
+using namespace jcc;
+
+TEST(FileWatcherTest, Written) {
+  char dir[] = "/tmp/jcc-watch-XXXXXX";
+  ASSERT_TRUE(mkdtemp(dir));
+  io::FileWatcher watcher;
+  ASSERT_TRUE(watcher.add(dir));
+  EXPECT_FALSE(watcher.add(std::string(dir) + "/missing"));
+  EXPECT_TRUE(watcher.wait(0).empty());
+
+  const std::string path = std::string(dir) + "/Main.jack";
+  std::ofstream{path} << "class Main {}\n";
+  std::ofstream{path} << "class Main { }\n";
+  // Written twice, reported once
+  EXPECT_EQ(watcher.wait(1000), std::vector<std::string>{path});
+  EXPECT_TRUE(watcher.wait(0).empty());
+
+  // Saved through a file moved into the directory
+  std::filesystem::create_directory(std::string(dir) + "/sub");
+  std::ofstream{std::string(dir) + "/sub/Main.jack"} << "class Main {}\n";
+  std::filesystem::rename(std::string(dir) + "/sub/Main.jack", path);
+  EXPECT_EQ(watcher.wait(1000), std::vector<std::string>{path});
+  std::filesystem::remove_all(dir);
+}
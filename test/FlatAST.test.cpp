@@ -0,0 +1,220 @@
+#include <map>
+#include <sstream>
+
+#include "CompilationEngine.hpp"
+#include "FlatAST.hpp"
+#include "PrettyPrinter.hpp"
+#include "Resolver.hpp"
+#include "gtest/gtest.h"
+
+using namespace jcc;
+using namespace jcc::ast;
+
+namespace {
+
+const std::string kSource =
+    "class Main {\n"
+    "  static int count;\n"
+    "  field Array values;\n"
+    "  constructor Main new(int n) {\n"
+    "    let values = Array.new(n);\n"
+    "    return this;\n"
+    "  }\n"
+    "  method int sum(int n) {\n"
+    "    var int i, total;\n"
+    "    while (i < n) {\n"
+    "      let total = total + values[i];\n"
+    "      let i = i + 1;\n"
+    "    }\n"
+    "    if (~(total = 0) & true) { do print(\"sum\"); } else { return -1; }\n"
+    "    return total;\n"
+    "  }\n"
+    "  method void print(String s) {\n"
+    "    do Output.printString(s);\n"
+    "    return;\n"
+    "  }\n"
+    "  function void main() {\n"
+    "    var Main m;\n"
+    "    let m = Main.new(3);\n"
+    "    do m.print(\"sum\");\n"
+    "    let count = m.sum(false);\n"
+    "    return;\n"
+    "  }\n"
+    "}\n";
+
+std::unique_ptr<ClassDecl> parse(const std::string &source) {
+  CompilationEngine engine{std::make_unique<std::istringstream>(source),
+                           "Main.jack"};
+  auto cls = engine.compileClass();
+  Resolver::run(*cls);
+  return cls;
+}
+
+// Counts the nodes of each kind
+class Counter : public FlatVisitor<Counter> {
+public:
+  using FlatVisitor::FlatVisitor;
+  std::map<FlatAST::Kind, unsigned> counts;
+
+#define COUNT(KIND)                        \
+  void visit##KIND(FlatAST::Index node) {  \
+    ++counts[FlatAST::Kind::KIND];         \
+    visitChildren(node);                   \
+  }
+  COUNT(Empty)
+  COUNT(Int)
+  COUNT(Char)
+  COUNT(Str)
+  COUNT(Identifier)
+  COUNT(Index)
+  COUNT(This)
+  COUNT(True)
+  COUNT(False)
+  COUNT(Binary)
+  COUNT(Unary)
+  COUNT(MethodCall)
+  COUNT(FunctionCall)
+  COUNT(Let)
+  COUNT(If)
+  COUNT(While)
+  COUNT(Return)
+  COUNT(Var)
+  COUNT(Block)
+  COUNT(Static)
+  COUNT(Method)
+  COUNT(Constructor)
+  COUNT(Class)
+  COUNT(RValue)
+#undef COUNT
+};
+
+}  // namespace
+
+TEST(FlatASTTest, Print) {
+  CompilationEngine engine{
+      std::make_unique<std::istringstream>(
+          "class Point { field Array a; method int get(int i) {"
+          " while (i < 3) { let a[i] = -i; }"
+          " if (~(i = 0)) { do Output.printString(\"s\"); }"
+          " return get(i); } }"),
+      "Point.jack"};
+  auto cls = engine.compileClass();
+  Resolver::run(*cls);
+  // The output of the printer when it walked the tree
+  EXPECT_EQ(PrettyPrinter::print(FlatAST::build(*cls)),
+            "  Class: Point\n"
+            "  Fields: \n"
+            "    VarDecl: Array a\n"
+            "  Statics: \n"
+            "  Functions: \n"
+            "  Methods: \n"
+            "    MethodDecl: int get\n"
+            "    Params: \n"
+            "      VarDecl: Point this\n"
+            "      VarDecl: int i\n"
+            "      Block: {\n"
+            "        WhileStmt: \n"
+            "          <\n"
+            "            RValue (\n"
+            "              Identifier: i\n"
+            "            )\n"
+            "            IntConst: 3\n"
+            "        {\n"
+            "          Block: {\n"
+            "            LetStmt: \n"
+            "              IndexExpr:a\n"
+            "              [\n"
+            "                RValue (\n"
+            "                  Identifier: i\n"
+            "                )\n"
+            "              ]\n"
+            "              UnaryExpr: -\n"
+            "                RValue (\n"
+            "                  Identifier: i\n"
+            "                )\n"
+            "          }\n"
+            "        }\n"
+            "        IfStmt: \n"
+            "          UnaryExpr: ~\n"
+            "            =\n"
+            "              RValue (\n"
+            "                Identifier: i\n"
+            "              )\n"
+            "              IntConst: 0\n"
+            "          Block: {\n"
+            "            FunctionCall: Output.printString\n"
+            "            Args:\n"
+            "              StrConst: s\n"
+            "          }\n"
+            "        ReturnStmt: \n"
+            "          FunctionCall: get\n"
+            "          Args:\n"
+            "            RValue (\n"
+            "              Identifier: i\n"
+            "            )\n"
+            "      }\n");
+}
+
+TEST(FlatASTTest, Layout) {
+  auto cls = parse(kSource);
+  const auto flat = FlatAST::build(*cls);
+  ASSERT_EQ(flat.kind(0), FlatAST::Kind::Class);
+  EXPECT_EQ(flat.name(0), "Main");
+  EXPECT_EQ(flat.type(0), "Main.jack");
+
+  // Fields, statics, functions and methods
+  ASSERT_EQ(flat.numChildren(0), 6u);
+  const auto values = flat.child(0, 0);
+  EXPECT_EQ(flat.kind(values), FlatAST::Kind::Var);
+  EXPECT_EQ(flat.value(values), static_cast<int32_t>(sym::Kind::FIELD));
+  EXPECT_EQ(flat.type(values), "Array");
+  EXPECT_EQ(flat.slot(values).kind, sym::Kind::FIELD);
+  EXPECT_EQ(flat.value(flat.child(0, 1)),
+            static_cast<int32_t>(sym::Kind::STATIC));
+  EXPECT_EQ(flat.kind(flat.child(0, 2)), FlatAST::Kind::Constructor);
+  EXPECT_EQ(flat.kind(flat.child(0, 3)), FlatAST::Kind::Static);
+
+  // The parameters with this, then the body
+  const auto sum = flat.child(0, 4);
+  ASSERT_EQ(flat.kind(sum), FlatAST::Kind::Method);
+  EXPECT_EQ(flat.name(sum), "sum");
+  EXPECT_EQ(flat.location(sum).line, 8u);
+  ASSERT_TRUE(flat.hasOptional(sum));
+  ASSERT_EQ(flat.numChildren(sum), 3u);
+  EXPECT_EQ(flat.slot(flat.child(sum, 1)).kind, sym::Kind::ARG);
+  EXPECT_EQ(flat.slot(flat.child(sum, 1)).index, 1u);
+  EXPECT_EQ(flat.kind(flat.child(sum, 2)), FlatAST::Kind::Block);
+
+  // Nodes are numbered in preorder
+  for (FlatAST::Index node = 0; node < flat.size(); ++node) {
+    for (auto it = flat.children_begin(node); it != flat.children_end(node);
+         ++it) {
+      EXPECT_GT(*it, node);
+    }
+  }
+
+  // The two "sum" literals share the name of the method
+  std::vector<FlatAST::Index> strs;
+  for (FlatAST::Index node = 0; node < flat.size(); ++node) {
+    if (flat.kind(node) == FlatAST::Kind::Str) strs.push_back(node);
+  }
+  ASSERT_EQ(strs.size(), 2u);
+  EXPECT_EQ(&flat.name(strs[0]), &flat.name(strs[1]));
+  EXPECT_EQ(&flat.name(strs[0]), &flat.name(sum));
+}
+
+TEST(FlatASTTest, Visitor) {
+  auto cls = parse(kSource);
+  const auto flat = FlatAST::build(*cls);
+  Counter counter{flat};
+  counter.visit(0);
+
+  unsigned total = 0;
+  for (const auto &[kind, count] : counter.counts) total += count;
+  EXPECT_EQ(total, flat.size());
+  EXPECT_EQ(counter.counts[FlatAST::Kind::While], 1u);
+  EXPECT_EQ(counter.counts[FlatAST::Kind::If], 1u);
+  EXPECT_EQ(counter.counts[FlatAST::Kind::Index], 1u);
+  EXPECT_EQ(counter.counts[FlatAST::Kind::Str], 2u);
+  EXPECT_GT(flat.memoryUsage(), flat.size() * sizeof(FlatAST::Index));
+}
@@ -0,0 +1,123 @@
+#include <sstream>
+
+#include "CompilationEngine.hpp"
+#include "Inliner.hpp"
+#include "Resolver.hpp"
+#include "SourcePrinter.hpp"
+#include "TypeChecker.hpp"
+#include "gtest/gtest.h"
+
+using namespace jcc;
+using namespace jcc::ast;
+
+namespace {
+
+std::unique_ptr<ClassDecl> compile(const std::string &source) {
+  CompilationEngine engine{std::make_unique<std::istringstream>(source)};
+  auto cls = engine.compileClass();
+  Resolver::run(*cls);
+  return cls;
+}
+
+const char *const s_point =
+    "class Point {\n"
+    "  static int count;\n"
+    "  field int x, y;\n"
+    "  method int getX() {\n"
+    "    return x;\n"
+    "  }\n"
+    "  method Point self() {\n"
+    "    return this;\n"
+    "  }\n"
+    "  method int norm() {\n"
+    "    return Math.abs(x) + Math.abs(y);\n"
+    "  }\n"
+    "  method int getCount() {\n"
+    "    return count;\n"
+    "  }\n"
+    "  function int twice(int a) {\n"
+    "    return a + a;\n"
+    "  }\n"
+    "  function int fact(int n) {\n"
+    "    return n * Point.fact(n - 1);\n"
+    "  }\n"
+    "  method int area() {\n"
+    "    return getX() * y;\n"
+    "  }\n"
+    "}\n";
+
+// Inline the body of `function int f(Point p, int n)` and print it back
+std::string inlined(const std::string &body, size_t *numInlined = nullptr,
+                    Inliner inliner = Inliner{}) {
+  auto point = compile(s_point);
+  auto cls = compile("class Main {\n"
+                     "  function int f(Point p, int n) {\n" +
+                     body +
+                     "  }\n"
+                     "}\n");
+
+  TypeChecker checker;
+  checker.declare("Math", "abs", ExprType::Kind::Int, {ExprType::Kind::Int});
+  checker.declare(*point);
+  checker.declare(*cls);
+  checker.check(*point);
+  checker.check(*cls);
+
+  inliner.declare(*point);
+  inliner.declare(*cls);
+  const auto n = inliner.run(*cls);
+  if (numInlined) *numInlined = n;
+
+  const auto src = SourcePrinter::print(*cls);
+  const auto begin = src.find("{\n", src.find("function")) + 2;
+  return src.substr(begin, src.rfind("  }\n") - begin);
+}
+
+}  // namespace
+
+TEST(InlinerTest, Getters) {
+  size_t numInlined = 0;
+  EXPECT_EQ(inlined("    return p.getX();\n", &numInlined),
+            "    return p.x;\n");
+  EXPECT_EQ(numInlined, 1u);
+  EXPECT_EQ(inlined("    return Point.twice(n) + 1;\n"),
+            "    return (n + n) + 1;\n");
+  EXPECT_EQ(inlined("    return p.norm();\n"),
+            "    return Math.abs(p.x) + Math.abs(p.y);\n");
+  EXPECT_EQ(inlined("    let p = p.self();\n    return 0;\n"),
+            "    let p = p;\n    return 0;\n");
+}
+
+TEST(InlinerTest, NotInlined) {
+  size_t numInlined = 0;
+  // Arguments with side effects, recursion, methods called by the body,
+  // statics of another class and calls made for their side effects
+  inlined("    return Point.twice(Point.twice(n) + 1);\n", &numInlined);
+  EXPECT_EQ(numInlined, 1u);
+  EXPECT_EQ(inlined("    return Point.fact(n);\n"),
+            "    return Point.fact(n);\n");
+  EXPECT_EQ(inlined("    return p.area();\n"), "    return p.area();\n");
+  EXPECT_EQ(inlined("    return p.getCount();\n"),
+            "    return p.getCount();\n");
+  EXPECT_EQ(inlined("    do p.getX();\n    return 0;\n"),
+            "    do p.getX();\n    return 0;\n");
+
+  // Too large
+  EXPECT_EQ(inlined("    return p.norm();\n", nullptr, Inliner{4}),
+            "    return p.norm();\n");
+}
+
+TEST(InlinerTest, CallCounts) {
+  Inliner inliner{4};
+  inliner.setCallCounts(
+      [](const std::string &name) -> std::optional<uint64_t> {
+        if (name == "Point.norm") return 100;
+        if (name == "Point.getX") return 0;
+        return std::nullopt;
+      },
+      1000);
+  // Hot functions may be larger, those that never ran are left alone
+  EXPECT_EQ(inlined("    return p.norm() + p.getX();\n", nullptr,
+                    std::move(inliner)),
+            "    return (Math.abs(p.x) + Math.abs(p.y)) + p.getX();\n");
+}
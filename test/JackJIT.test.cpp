@@ -0,0 +1,49 @@
+#include "JackJIT.hpp"
+
+#include <stdexcept>
+
+#include "gtest/gtest.h"
+
+using namespace exec;
+
+TEST(JITPoolTest, Reuse) {
+  JITPool pool{1};
+  auto jit = pool.acquire();
+  const JIT *warm = jit.get();
+  jit->createJobDylib();
+  pool.release(std::move(jit));
+
+  // The same instance comes back with the dylibs of its previous jobs
+  jit = pool.acquire();
+  EXPECT_EQ(jit.get(), warm);
+  EXPECT_EQ(jit->numJobs(), 1u);
+
+  // Every warm instance is busy, a new one is created
+  auto other = pool.acquire();
+  EXPECT_NE(other.get(), warm);
+  EXPECT_EQ(other->numJobs(), 0u);
+  pool.release(std::move(other));
+  pool.release(std::move(jit));
+}
+
+TEST(JITPoolTest, Recycle) {
+  JITPool pool{1, 2};
+  for (unsigned i = 0; i < 2; ++i) {
+    auto jit = pool.acquire();
+    EXPECT_EQ(jit->numJobs(), i);
+    jit->createJobDylib();
+    pool.release(std::move(jit));
+  }
+
+  // The instance ran its last job and was replaced
+  EXPECT_EQ(pool.acquire()->numJobs(), 0u);
+}
+
+TEST(JITTest, MissingSymbol) {
+  auto jit = JIT::Create();
+  auto &dylib = jit->createJobDylib();
+  EXPECT_THROW(jit->findSymbol(dylib, "Main.main"), std::runtime_error);
+  // The JIT can still be used after the failed lookup
+  EXPECT_THROW(jit->findSymbol("Main.main"), std::runtime_error);
+  EXPECT_EQ(jit->numJobs(), 1u);
+}
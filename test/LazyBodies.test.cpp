@@ -0,0 +1,135 @@
+#include <sstream>
+
+#include "CompilationEngine.hpp"
+#include "ErrorHandling.hpp"
+#include "LazyBodies.hpp"
+#include "PrettyPrinter.hpp"
+#include "gtest/gtest.h"
+
+using namespace jcc;
+using namespace jcc::ast;
+
+namespace {
+
+const std::string kPoint =
+    "class Point {\n"
+    "  field int x, y;\n"
+    "  constructor Point new(int ax, int ay) {\n"
+    "    let x = ax;\n"
+    "    let y = ay;\n"
+    "    return this;\n"
+    "  }\n"
+    "  method int sum() { return x + y; }\n"
+    "  method int unused() { return x - y; }\n"
+    "}\n";
+
+const std::string kMain =
+    "class Main {\n"
+    "  function void main() {\n"
+    "    var Point p;\n"
+    "    let p = Point.new(1, 2);\n"
+    "    if (p.sum() > 2) { do Main.print(p.sum()); }\n"
+    "    return;\n"
+    "  }\n"
+    "  function void print(int n) {\n"
+    "    do Output.printInt(n);\n"
+    "    return;\n"
+    "  }\n"
+    "  function void broken() { let = ; }\n"
+    "}\n";
+
+std::unique_ptr<ClassDecl> parse(const std::string &source, bool defer) {
+  CompilationEngine engine{std::make_unique<std::istringstream>(source),
+                           "Main.jack"};
+  engine.setDeferBodies(defer);
+  return engine.compileClass();
+}
+
+}  // namespace
+
+TEST(LazyBodiesTest, Deferred) {
+  auto point = parse(kPoint, true);
+  ASSERT_EQ(point->numMethods(), 2u);
+  const auto &sum = **point->mths_begin();
+  EXPECT_TRUE(sum.isDeferred());
+  EXPECT_FALSE(sum.getDefinition());
+  EXPECT_EQ(sum.numParams(), 1u);
+
+  // The bodies are parsed as they would have been, at their place in the file
+  for (auto it = point->mths_begin(); it != point->mths_end(); ++it) {
+    (*it)->parseDefinition();
+  }
+  for (auto it = point->fcns_begin(); it != point->fcns_end(); ++it) {
+    (*it)->parseDefinition();
+  }
+  EXPECT_EQ(PrettyPrinter::print(*point),
+            PrettyPrinter::print(*parse(kPoint, false)));
+  const auto &body = **(*point->fcns_begin())->getDefinition()->stmts_begin();
+  EXPECT_EQ(body.getLocation().line, 4u);
+  EXPECT_EQ(body.getLocation().column, 5u);
+}
+
+TEST(LazyBodiesTest, Reachable) {
+  std::vector<std::unique_ptr<Node>> program;
+  program.push_back(parse(kPoint, true));
+  program.push_back(parse(kMain, true));
+
+  // Main.broken is never called, its syntax error is not reported
+  const auto result = LazyBodies::run(program);
+  EXPECT_EQ(result.numParsed, 4u);
+  EXPECT_EQ(result.numRemoved, 2u);
+
+  const auto &point = static_cast<const ClassDecl &>(*program[0]);
+  ASSERT_EQ(point.numMethods(), 1u);
+  EXPECT_EQ((*point.mths_begin())->getName(), "sum");
+  EXPECT_TRUE((*point.mths_begin())->getDefinition());
+  const auto &main = static_cast<const ClassDecl &>(*program[1]);
+  EXPECT_EQ(main.numFunctions(), 2u);
+}
+
+TEST(LazyBodiesTest, SyntaxError) {
+  std::vector<std::unique_ptr<Node>> program;
+  program.push_back(parse(kMain, true));
+  // Without an entry point every body is parsed
+  try {
+    LazyBodies::run(program, "Other");
+    FAIL() << "Expected a syntax error";
+  } catch (const jcc::SyntaxError &err) {
+    EXPECT_NE(std::string(err.what()).find("12"), std::string::npos)
+        << err.what();
+  }
+
+  // The file must end after the body
+  EXPECT_THROW(parse("class Main { function void main() { return; }", true),
+               jcc::SyntaxError);
+}
+
+TEST(LazyBodiesTest, RemovedParameters) {
+  // The parameters of a removed function are only in its own table
+  const std::string source =
+      "class Main {\n"
+      "  function void main() { do Main.used(1); return; }\n"
+      "  function int used(int a) { return a; }\n"
+      "  function int unused(int n) { return n; }\n"
+      "}\n";
+  std::vector<std::unique_ptr<Node>> program;
+  program.push_back(parse(source, true));
+  EXPECT_EQ(LazyBodies::run(program).numRemoved, 1u);
+  const auto &main = static_cast<const ClassDecl &>(*program[0]);
+  EXPECT_EQ(main.getTable().size(), 0u);
+  EXPECT_FALSE(main.getTable().lookup("n"));
+
+  // Nor can a function called from the entry point see them
+  std::string leaked = source;
+  leaked.replace(leaked.find("return a;"), 9, "return n;");
+  program.clear();
+  program.push_back(parse(leaked, true));
+  try {
+    LazyBodies::run(program);
+    FAIL() << "Expected a syntax error";
+  } catch (const jcc::SyntaxError &err) {
+    EXPECT_NE(std::string(err.what()).find("Undefined variable n"),
+              std::string::npos)
+        << err.what();
+  }
+}
@@ -0,0 +1,92 @@
+#include "Peephole.hpp"
+#include "gtest/gtest.h"
+
+using namespace jcc::io;
+
+TEST(PeepholeTest, Constants) {
+  size_t numRemoved = 0;
+  EXPECT_EQ(Peephole::optimize("push constant 2\n"
+                               "push constant 3\n"
+                               "add\n"
+                               "push constant 4\n"
+                               "call Math.multiply 2\n"
+                               "push constant 1\n"
+                               "neg\n"
+                               "add\n",
+                               &numRemoved),
+            "push constant 19\n");
+  EXPECT_EQ(numRemoved, 7u);
+
+  // The VM computes with 16 bits, comparisons are true or false
+  EXPECT_EQ(Peephole::optimize("push constant 32767\n"
+                               "push constant 1\n"
+                               "add\n"),
+            "push constant 32767\n"
+            "not\n");
+  EXPECT_EQ(Peephole::optimize("push constant 1\n"
+                               "push constant 2\n"
+                               "lt\n"),
+            "push constant 0\n"
+            "not\n");
+  EXPECT_EQ(Peephole::optimize("push constant 1\n"
+                               "push constant 0\n"
+                               "call Math.divide 2\n"),
+            "push constant 1\n"
+            "push constant 0\n"
+            "call Math.divide 2\n");
+}
+
+TEST(PeepholeTest, Identities) {
+  EXPECT_EQ(Peephole::optimize("push local 0\n"
+                               "push constant 0\n"
+                               "add\n"
+                               "push constant 1\n"
+                               "call Math.multiply 2\n"
+                               "not\n"
+                               "not\n"
+                               "pop local 1\n"
+                               "push local 1\n"
+                               "pop local 1\n"),
+            "push local 0\n"
+            "pop local 1\n");
+}
+
+TEST(PeepholeTest, Branches) {
+  EXPECT_EQ(Peephole::optimize("push local 0\n"
+                               "push constant 3\n"
+                               "eq\n"
+                               "not\n"
+                               "if-goto IF_FALSE0\n"
+                               "push local 0\n"
+                               "push constant 0\n"
+                               "eq\n"
+                               "not\n"
+                               "if-goto IF_FALSE1\n"),
+            "push local 0\n"
+            "push constant 3\n"
+            "sub\n"
+            "if-goto IF_FALSE0\n"
+            "push local 0\n"
+            "if-goto IF_FALSE1\n");
+
+  // The code that cannot run is removed
+  EXPECT_EQ(Peephole::optimize("label WHILE_EXP0\n"
+                               "push constant 0\n"
+                               "not\n"
+                               "not\n"
+                               "if-goto WHILE_END0\n"
+                               "push constant 1\n"
+                               "return\n"
+                               "goto WHILE_EXP0\n"
+                               "label WHILE_END0\n"
+                               "push constant 0\n"
+                               "not\n"
+                               "if-goto END\n"
+                               "push constant 2\n"
+                               "label END\n"),
+            "label WHILE_EXP0\n"
+            "push constant 1\n"
+            "return\n"
+            "label WHILE_END0\n"
+            "label END\n");
+}
@@ -0,0 +1,51 @@
+#include <sstream>
+
+#include "Repl.hpp"
+#include "gtest/gtest.h"
+
+using namespace jcc;
+
+namespace {
+
+std::string session(const std::string &input) {
+  std::istringstream in{input};
+  std::ostringstream out;
+  Repl{in, out}.run();
+  return out.str();
+}
+
+}  // namespace
+
+TEST(ReplTest, BraceDepth) {
+  EXPECT_EQ(Repl::braceDepth("class A {\n"), 1);
+  EXPECT_EQ(Repl::braceDepth("class A {\n function void f() {}\n}\n"), 0);
+  EXPECT_EQ(Repl::braceDepth("do Output.printString(\"{\");\n"), 0);
+  EXPECT_EQ(Repl::braceDepth("if (x) { do f(\"}}\");\n"), 1);
+  // An unterminated string ends with its line
+  EXPECT_EQ(Repl::braceDepth("let s = \"{;\n{\n"), 1);
+}
+
+TEST(ReplTest, Session) {
+  const auto out = session(
+      "var int x;\n"
+      "let x = 4;\n"
+      "y + 1\n"
+      "do Output.printString(\"{\");\n"
+      "x * 2\n"
+      ":quit\n");
+  // The undefined variable is reported and the session goes on
+  EXPECT_NE(out.find("Undefined variable y"), std::string::npos) << out;
+  EXPECT_NE(out.find("{"), std::string::npos) << out;
+  EXPECT_NE(out.find("8\n"), std::string::npos) << out;
+  EXPECT_EQ(out.find(". "), std::string::npos) << out;
+}
+
+TEST(ReplTest, MultiLineClass) {
+  const auto out = session(
+      "class Point {\n"
+      "  function int twice(int n) { return n * 2; }\n"
+      "}\n"
+      "Point.twice(21)\n");
+  EXPECT_NE(out.find(". "), std::string::npos) << out;
+  EXPECT_NE(out.find("42\n"), std::string::npos) << out;
+}
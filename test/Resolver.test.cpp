@@ -0,0 +1,57 @@
+#include <sstream>
+
+#include "CompilationEngine.hpp"
+#include "Resolver.hpp"
+#include "gtest/gtest.h"
+
+using namespace jcc;
+using namespace jcc::ast;
+
+namespace {
+
+std::unique_ptr<ClassDecl> resolve(const std::string &source) {
+  CompilationEngine engine{std::make_unique<std::istringstream>(source),
+                           "Main.jack"};
+  auto cls = engine.compileClass();
+  Resolver::run(*cls);
+  return cls;
+}
+
+void expectSlot(const Node *node, sym::Kind kind, unsigned index) {
+  auto slot = static_cast<const NamedValue *>(node)->getSlot();
+  EXPECT_EQ(slot.kind, kind);
+  EXPECT_EQ(slot.index, index);
+}
+
+}  // namespace
+
+TEST(ResolverTest, Slots) {
+  auto cls = resolve(
+      "class Main {\n"
+      "  static int s, t;\n"
+      "  field int f, g;\n"
+      "  method int m(int x, int y) {\n"
+      "    var int a, b;\n"
+      "    let b = y;\n"
+      "    let g = t;\n"
+      "    return a;\n"
+      "  }\n"
+      "}\n");
+
+  auto &body = *(*cls->mths_begin())->getDefinition();
+  auto stmt = body.stmts_begin() + 2;
+  auto &let = static_cast<const LetStmt &>(**stmt);
+  expectSlot(let.getAssignee(), sym::Kind::VAR, 1);
+  auto &rv = static_cast<const RValueT &>(*let.getExpression());
+  // `this` is the first parameter of a method
+  expectSlot(rv.getWrapped(), sym::Kind::ARG, 2);
+
+  auto &member = static_cast<const LetStmt &>(**++stmt);
+  expectSlot(member.getAssignee(), sym::Kind::FIELD, 1);
+  auto &stat = static_cast<const RValueT &>(*member.getExpression());
+  expectSlot(stat.getWrapped(), sym::Kind::STATIC, 1);
+
+  auto &ret = static_cast<const ReturnStmt &>(**++stmt);
+  auto &local = static_cast<const RValueT &>(*ret.getExpr());
+  expectSlot(local.getWrapped(), sym::Kind::VAR, 0);
+}
@@ -0,0 +1,68 @@
+#include <sstream>
+
+#include "CompilationEngine.hpp"
+#include "ProgramGenerator.hpp"
+#include "SourcePrinter.hpp"
+#include "gtest/gtest.h"
+
+using namespace jcc;
+
+namespace {
+
+std::unique_ptr<ast::ClassDecl> compile(const std::string &source) {
+  CompilationEngine engine{std::make_unique<std::istringstream>(source)};
+  return engine.compileClass();
+}
+
+}  // namespace
+
+TEST(SourcePrinterTest, RoundTrip) {
+  const std::string source =
+      "class Point {\n"
+      "  field int x;\n"
+      "  static int count;\n"
+      "\n"
+      "  constructor Point new(int ax) {\n"
+      "    let x = ax;\n"
+      "    return this;\n"
+      "  }\n"
+      "\n"
+      "  method int get(Array a, int i) {\n"
+      "    var int y;\n"
+      "    let y = (a[i] + x) * (i - 1);\n"
+      "    if (y < 10) {\n"
+      "      do Output.printInt(y);\n"
+      "    } else {\n"
+      "      let a[i + 1] = \"str\";\n"
+      "    }\n"
+      "    while (true) {\n"
+      "      do reset();\n"
+      "    }\n"
+      "    return y;\n"
+      "  }\n"
+      "\n"
+      "  method void reset() {\n"
+      "    return;\n"
+      "  }\n"
+      "}\n";
+
+  EXPECT_EQ(ast::SourcePrinter::print(*compile(source)), source);
+}
+
+TEST(SourcePrinterTest, GeneratedPrograms) {
+  gen::ProgramOptions options;
+  options.numClasses = 3;
+  options.functionsPerClass = 4;
+  options.callDensity = 0.3;
+
+  const auto sources = gen::ProgramGenerator(options).generateSources();
+  ASSERT_EQ(sources.size(), 4u);
+  EXPECT_EQ(sources.back().first, "Main.jack");
+
+  for (const auto &[file, source] : sources) {
+    EXPECT_EQ(ast::SourcePrinter::print(*compile(source)), source) << file;
+  }
+
+  // The same seed gives the same program
+  EXPECT_EQ(gen::ProgramGenerator(options).generateSources(), sources);
+}
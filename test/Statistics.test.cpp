@@ -0,0 +1,111 @@
+#include <sstream>
+
+#include "CompilationEngine.hpp"
+#include "MemoryUsage.hpp"
+#include "Statistics.hpp"
+#include "gtest/gtest.h"
+
+using namespace jcc;
+using namespace jcc::stats;
+
+namespace {
+
+std::string report(Statistics::Format format, bool timers, bool counters,
+                   bool memory = false) {
+  std::ostringstream os;
+  Statistics::get().print(os, format, timers, counters, memory);
+  return os.str();
+}
+
+}  // namespace
+
+TEST(StatisticsTest, DisabledRecordsNothing) {
+  Statistics::get().clear();
+  { ScopedTimer timer("phase", "Unit"); }
+  addCount("count", "Unit", 3);
+
+  const auto json = report(Statistics::Format::JSON, true, true);
+  EXPECT_EQ(json.find("\"phase\""), std::string::npos);
+  EXPECT_EQ(json.find("\"count\""), std::string::npos);
+}
+
+TEST(StatisticsTest, CountersAccumulate) {
+  auto &stats = Statistics::get();
+  stats.clear();
+  stats.enable();
+
+  addCount("count", "A", 3);
+  addCount("count", "A", 4);
+  addCount("count", "B", 1);
+  stats.addTime("phase", "A", 0.5, -1);
+  stats.addTime("phase", "A", 0.25, 0.1);
+
+  const auto json = report(Statistics::Format::JSON, true, true);
+  EXPECT_NE(json.find("{\"name\": \"count\", \"unit\": \"A\", \"value\": 7}"),
+            std::string::npos);
+  EXPECT_NE(json.find("{\"name\": \"count\", \"unit\": \"B\", \"value\": 1}"),
+            std::string::npos);
+  EXPECT_NE(json.find("{\"phase\": \"phase\", \"unit\": \"A\", \"wall_ms\": "
+                      "750.000, \"cpu_ms\": null, \"calls\": 2}"),
+            std::string::npos);
+  EXPECT_NE(json.find("\"peak_rss_kb\": "), std::string::npos);
+
+  const auto table = report(Statistics::Format::Table, false, true);
+  EXPECT_EQ(table.find("time report"), std::string::npos);
+  EXPECT_NE(table.find("statistics"), std::string::npos);
+}
+
+TEST(StatisticsTest, ParserCounts) {
+  auto &stats = Statistics::get();
+  stats.clear();
+  stats.enable();
+
+  CompilationEngine engine{std::make_unique<std::istringstream>(
+      "class Main { function int main() { return 1 + 2; } }")};
+  engine.compileClass();
+
+  const auto json = report(Statistics::Format::JSON, true, true);
+  EXPECT_NE(json.find("{\"name\": \"tokens\", \"unit\": \"Main\", "
+                      "\"value\": 16}"),
+            std::string::npos);
+  EXPECT_NE(json.find("{\"phase\": \"parse\", \"unit\": \"Main\""),
+            std::string::npos);
+  EXPECT_NE(json.find("{\"phase\": \"parse.lex\", \"unit\": \"Main\""),
+            std::string::npos);
+}
+
+TEST(StatisticsTest, MemoryReport) {
+  auto &stats = Statistics::get();
+  stats.clear();
+  stats.enable();
+
+  CompilationEngine engine{std::make_unique<std::istringstream>(
+      "class Main {\n"
+      "  field int x;\n"
+      "  function int main(int a) { return a + 2; }\n"
+      "}\n")};
+  auto cls = engine.compileClass();
+  const auto usage = ast::MemoryUsage::of(*cls);
+  EXPECT_EQ(usage.nodes.at("BinaryOp"), sizeof(ast::BinaryOp));
+  EXPECT_EQ(usage.nodes.at("VarDecl"), 2 * sizeof(ast::VarDecl));
+  EXPECT_GT(usage.numNodeBytes(), sizeof(ast::ClassDecl));
+  EXPECT_GT(usage.symbols, 0u);
+  EXPECT_EQ(usage.cls, "Main");
+  usage.record();
+
+  const auto json = report(Statistics::Format::JSON, false, false, true);
+  EXPECT_NE(json.find("{\"name\": \"tokens\", \"unit\": \"Main\""),
+            std::string::npos);
+  EXPECT_NE(json.find("{\"name\": \"ast.BinaryOp\", \"unit\": \"Main\", "
+                      "\"bytes\": " +
+                      std::to_string(sizeof(ast::BinaryOp)) + "}"),
+            std::string::npos);
+  EXPECT_NE(json.find("{\"name\": \"symbols\""), std::string::npos);
+  EXPECT_EQ(json.find("\"statistics\""), std::string::npos);
+
+  const auto table = report(Statistics::Format::Table, false, false, true);
+  EXPECT_NE(table.find("memory report"), std::string::npos);
+  EXPECT_NE(table.find("total"), std::string::npos);
+  EXPECT_EQ(report(Statistics::Format::Table, false, true).find("memory"),
+            std::string::npos);
+}
@@ -26,3 +26,56 @@ TEST(SymbolTableTest, Basic) {
   success = table->addValue(dup.get());
   ASSERT_FALSE(success);
 }
+
+TEST(SymbolTableTest, Index) {
+  // Enough variables to be indexed rather than scanned
+  Table table{"Main"};
+  std::vector<std::unique_ptr<jcc::ast::VarDecl>> vars;
+  for (int i = 0; i < 100; ++i) {
+    vars.push_back(
+        std::make_unique<jcc::ast::VarDecl>("v" + std::to_string(i), "int"));
+    ASSERT_TRUE(table.addValue(vars.back().get()));
+  }
+  EXPECT_EQ(table.size(), 100u);
+  for (const auto &var : vars) {
+    EXPECT_EQ(table.lookup(var->getName()), var.get());
+  }
+  EXPECT_EQ(table.lookup("v100"), nullptr);
+  EXPECT_EQ(table.lookup(""), nullptr);
+
+  jcc::ast::VarDecl dup{"v42", "char"};
+  EXPECT_FALSE(table.addValue(&dup));
+  EXPECT_EQ(table.lookup("v42")->getType(), "int");
+  EXPECT_GT(table.memoryUsage(), 100 * sizeof(void *));
+}
+
+TEST(SymbolTableTest, Scopes) {
+  Table table{"Main"};
+  jcc::ast::VarDecl x{"x", "int"};
+  ASSERT_TRUE(table.addValue(&x));
+
+  table.push();
+  std::vector<std::unique_ptr<jcc::ast::VarDecl>> vars;
+  for (int i = 0; i < 40; ++i) {
+    vars.push_back(
+        std::make_unique<jcc::ast::VarDecl>("v" + std::to_string(i), "int"));
+    ASSERT_TRUE(table.addValue(vars.back().get()));
+  }
+  table.push();
+  jcc::ast::VarDecl y{"y", "char"};
+  ASSERT_TRUE(table.addValue(&y));
+  EXPECT_EQ(table.lookup("y"), &y);
+  EXPECT_EQ(table.lookup("v39"), vars.back().get());
+
+  table.pop();
+  EXPECT_EQ(table.lookup("y"), nullptr);
+  EXPECT_EQ(table.lookup("v39"), vars.back().get());
+  table.pop();
+  EXPECT_EQ(table.size(), 1u);
+  EXPECT_EQ(table.lookup("v0"), nullptr);
+  EXPECT_EQ(table.lookup("x"), &x);
+
+  // A name removed by pop() can be declared again
+  ASSERT_TRUE(table.addValue(&y));
+  EXPECT_EQ(table.lookup("y"), &y);
+}
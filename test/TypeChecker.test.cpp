@@ -0,0 +1,144 @@
+#include <sstream>
+
+#include "CompilationEngine.hpp"
+#include "ErrorHandling.hpp"
+#include "TypeChecker.hpp"
+#include "gtest/gtest.h"
+
+using namespace jcc;
+using namespace jcc::ast;
+
+namespace {
+
+std::unique_ptr<ClassDecl> compile(const std::string &source) {
+  CompilationEngine engine{std::make_unique<std::istringstream>(source),
+                           "Main.jack"};
+  return engine.compileClass();
+}
+
+// Check `function <ret> f(int x, char c, boolean b, Array a)` with the body
+std::unique_ptr<ClassDecl> check(const std::string &ret,
+                                 const std::string &body) {
+  auto cls = compile("class Main {\n"
+                     "  function " + ret +
+                     " f(int x, char c, boolean b, Array a) {\n" + body +
+                     "  }\n"
+                     "}\n");
+  TypeChecker().check(*cls);
+  return cls;
+}
+
+const Node &returned(const ClassDecl &cls) {
+  auto &body = *(*cls.fcns_begin())->getDefinition();
+  return *static_cast<const ReturnStmt &>(**(body.stmts_end() - 1)).getExpr();
+}
+
+}  // namespace
+
+TEST(TypeCheckerTest, Expressions) {
+  using Kind = ExprType::Kind;
+  EXPECT_EQ(returned(*check("int", "return c + 1;\n")).getExprType().kind,
+            Kind::Int);
+  EXPECT_EQ(returned(*check("char", "return c;\n")).getExprType().kind,
+            Kind::Char);
+  EXPECT_EQ(returned(*check("boolean", "return (x < 1) & b;\n"))
+                .getExprType()
+                .kind,
+            Kind::Boolean);
+  EXPECT_EQ(returned(*check("int", "return a[x] | 2;\n")).getExprType().kind,
+            Kind::Int);
+  EXPECT_EQ(returned(*check("String", "return \"str\";\n")).getExprType(),
+            ExprType(Kind::Class, "String"));
+
+  // The operands are annotated too
+  auto cls = check("boolean", "return ~(c = 65);\n");
+  auto &unop = static_cast<const UnaryOp &>(returned(*cls));
+  EXPECT_EQ(unop.getExprType().kind, Kind::Boolean);
+  auto &cmp = static_cast<const BinaryOp &>(*unop.getOperand());
+  EXPECT_EQ(cmp.getLHS()->getExprType().kind, Kind::Char);
+  EXPECT_EQ(cmp.getRHS()->getExprType().kind, Kind::Int);
+}
+
+TEST(TypeCheckerTest, Calls) {
+  auto point = compile(
+      "class Point {\n"
+      "  field int x;\n"
+      "  constructor Point new(int ax) {\n"
+      "    let x = ax;\n"
+      "    return this;\n"
+      "  }\n"
+      "  method int getX() {\n"
+      "    return x;\n"
+      "  }\n"
+      "}\n");
+  auto main = compile(
+      "class Main {\n"
+      "  function int main() {\n"
+      "    var Point p;\n"
+      "    let p = Point.new(Output.read());\n"
+      "    return p.getX();\n"
+      "  }\n"
+      "}\n");
+
+  TypeChecker checker;
+  checker.declare(*main);
+  checker.declare(*point);
+  checker.declare("Output", "read", ExprType::Kind::Char, {});
+  checker.check(*main);
+  checker.check(*point);
+  EXPECT_EQ(returned(*main).getExprType().kind, ExprType::Kind::Int);
+
+  auto &let = static_cast<const LetStmt &>(
+      **((*main->fcns_begin())->getDefinition()->stmts_begin() + 1));
+  EXPECT_EQ(let.getExpression()->getExprType(),
+            ExprType(ExprType::Kind::Class, "Point"));
+  // The variables that are not expressions are annotated too
+  EXPECT_EQ(let.getAssignee()->getExprType(),
+            ExprType(ExprType::Kind::Class, "Point"));
+  auto &call = static_cast<const MethodCall &>(returned(*main));
+  EXPECT_EQ(call.getCallee()->getExprType(),
+            ExprType(ExprType::Kind::Class, "Point"));
+}
+
+TEST(TypeCheckerTest, Errors) {
+  auto error = [](const std::string &ret, const std::string &body) {
+    try {
+      check(ret, body);
+    } catch (const TypeError &err) {
+      return std::string(err.what());
+    }
+    return std::string();
+  };
+
+  EXPECT_NE(error("int", "return x + b;\n").find(
+                "Invalid operands to +: int and boolean"),
+            std::string::npos);
+  EXPECT_NE(error("int", "return ~a;\n").find("Invalid operand to ~: Array"),
+            std::string::npos);
+  EXPECT_NE(error("int", "if (x) {\n  return 1;\n}\nreturn 0;\n")
+                .find("Condition must be a boolean, got int"),
+            std::string::npos);
+  EXPECT_NE(error("int", "let b = 1;\nreturn 0;\n")
+                .find("Cannot assign int to b of type boolean"),
+            std::string::npos);
+  EXPECT_NE(error("int", "return c[0];\n").find("Cannot index c of type char"),
+            std::string::npos);
+  EXPECT_NE(error("boolean", "return x;\n")
+                .find("f returns boolean, got int"),
+            std::string::npos);
+  EXPECT_NE(error("int", "return Main.f(x, c, b);\n")
+                .find("Main.f expects 4 arguments, got 3"),
+            std::string::npos);
+  EXPECT_NE(error("int", "return Main.f(x, c, x, a);\n")
+                .find("Argument 3 of Main.f expects boolean, got int"),
+            std::string::npos);
+  EXPECT_NE(error("int", "return Main.g();\n")
+                .find("Undefined function Main.g"),
+            std::string::npos);
+  EXPECT_NE(error("int", "return Foo.g();\n").find("Undefined class Foo"),
+            std::string::npos);
+
+  // Reported at the operator
+  EXPECT_NE(error("int", "    return x + b;\n").find("Main.jack: 3:14"),
+            std::string::npos);
+}
@@ -0,0 +1,154 @@
+#include <sstream>
+
+#include "CompilationEngine.hpp"
+#include "Peephole.hpp"
+#include "Resolver.hpp"
+#include "VMGenerator.hpp"
+#include "gtest/gtest.h"
+
+using namespace jcc;
+using namespace jcc::ast;
+
+namespace {
+
+std::string generate(const std::string &source) {
+  CompilationEngine engine{std::make_unique<std::istringstream>(source)};
+  auto cls = engine.compileClass();
+  Resolver::run(*cls);
+  return VMGenerator::generate(*cls);
+}
+
+}  // namespace
+
+TEST(VMGeneratorTest, Functions) {
+  EXPECT_EQ(generate("class Main {\n"
+                     "  static int count;\n"
+                     "  function int twice(int a) {\n"
+                     "    var int b;\n"
+                     "    let b = a + a;\n"
+                     "    let count = count + 1;\n"
+                     "    do Output.printString(\"hi\");\n"
+                     "    return b * 2;\n"
+                     "  }\n"
+                     "  function void main() {\n"
+                     "    return;\n"
+                     "  }\n"
+                     "}\n"),
+            "function Main.twice 1\n"
+            "push argument 0\n"
+            "push argument 0\n"
+            "add\n"
+            "pop local 0\n"
+            "push static 0\n"
+            "push constant 1\n"
+            "add\n"
+            "pop static 0\n"
+            "push constant 2\n"
+            "call String.new 1\n"
+            "push constant 104\n"
+            "call String.appendChar 2\n"
+            "push constant 105\n"
+            "call String.appendChar 2\n"
+            "call Output.printString 1\n"
+            "pop temp 0\n"
+            "push local 0\n"
+            "push constant 2\n"
+            "call Math.multiply 2\n"
+            "return\n"
+            "function Main.main 0\n"
+            "push constant 0\n"
+            "return\n");
+}
+
+TEST(VMGeneratorTest, Objects) {
+  EXPECT_EQ(generate("class Point {\n"
+                     "  field int x, y;\n"
+                     "  field Array a;\n"
+                     "  constructor Point new(int ax) {\n"
+                     "    let x = ax;\n"
+                     "    let a[x] = a[1];\n"
+                     "    return this;\n"
+                     "  }\n"
+                     "  method int getX() {\n"
+                     "    return x;\n"
+                     "  }\n"
+                     "  method boolean same(Point p) {\n"
+                     "    return p.getX() = getX();\n"
+                     "  }\n"
+                     "}\n"),
+            "function Point.new 0\n"
+            "push constant 3\n"
+            "call Memory.alloc 1\n"
+            "pop pointer 0\n"
+            "push argument 0\n"
+            "pop this 0\n"
+            "push this 2\n"
+            "push this 0\n"
+            "add\n"
+            "push this 2\n"
+            "push constant 1\n"
+            "add\n"
+            "pop pointer 1\n"
+            "push that 0\n"
+            "pop temp 0\n"
+            "pop pointer 1\n"
+            "push temp 0\n"
+            "pop that 0\n"
+            "push pointer 0\n"
+            "return\n"
+            "function Point.getX 0\n"
+            "push argument 0\n"
+            "pop pointer 0\n"
+            "push this 0\n"
+            "return\n"
+            "function Point.same 0\n"
+            "push argument 0\n"
+            "pop pointer 0\n"
+            "push argument 1\n"
+            "call Point.getX 1\n"
+            "push pointer 0\n"
+            "call Point.getX 1\n"
+            "eq\n"
+            "return\n");
+}
+
+TEST(VMGeneratorTest, ControlFlow) {
+  EXPECT_EQ(generate("class Main {\n"
+                     "  function int f(int n) {\n"
+                     "    while (n > 0) {\n"
+                     "      if (n = 3) {\n"
+                     "        return -1;\n"
+                     "      } else {\n"
+                     "        let n = n - 1;\n"
+                     "      }\n"
+                     "    }\n"
+                     "    return n;\n"
+                     "  }\n"
+                     "}\n"),
+            "function Main.f 0\n"
+            "label WHILE_EXP0\n"
+            "push argument 0\n"
+            "push constant 0\n"
+            "gt\n"
+            "not\n"
+            "if-goto WHILE_END0\n"
+            "push argument 0\n"
+            "push constant 3\n"
+            "eq\n"
+            "not\n"
+            "if-goto IF_FALSE1\n"
+            "push constant 1\n"
+            "neg\n"
+            "return\n"
+            "goto IF_END1\n"
+            "label IF_FALSE1\n"
+            "push argument 0\n"
+            "push constant 1\n"
+            "sub\n"
+            "pop argument 0\n"
+            "label IF_END1\n"
+            "goto WHILE_EXP0\n"
+            "label WHILE_END0\n"
+            "push argument 0\n"
+            "return\n");
+}
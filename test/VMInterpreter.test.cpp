@@ -0,0 +1,156 @@
+#include <sstream>
+#include <stdexcept>
+
+#include "CompilationEngine.hpp"
+#include "ErrorHandling.hpp"
+#include "Peephole.hpp"
+#include "Resolver.hpp"
+#include "VMGenerator.hpp"
+#include "VMInterpreter.hpp"
+#include "gtest/gtest.h"
+
+using namespace jcc;
+using namespace jcc::ast;
+
+namespace {
+
+void load(exec::VMInterpreter &vm, const std::string &source) {
+  CompilationEngine engine{std::make_unique<std::istringstream>(source)};
+  auto cls = engine.compileClass();
+  Resolver::run(*cls);
+  vm.load(io::Peephole::optimize(VMGenerator::generate(*cls)),
+          cls->getName());
+}
+
+}  // namespace
+
+TEST(VMInterpreterTest, Arithmetic) {
+  std::istringstream in;
+  std::ostringstream out;
+  exec::VMInterpreter vm{in, out};
+  load(vm,
+       "class Main {\n"
+       "  function int fib(int n) {\n"
+       "    if (n < 2) { return n; }\n"
+       "    return Main.fib(n - 1) + Main.fib(n - 2);\n"
+       "  }\n"
+       "  function int main() {\n"
+       "    var int i, sum;\n"
+       "    let i = 0;\n"
+       "    while (~(i = 10)) {\n"
+       "      let sum = sum + (i * 3);\n"
+       "      let i = i + 1;\n"
+       "    }\n"
+       "    if (sum > 100) { let sum = sum - (Main.fib(10) / 5); }\n"
+       "    return sum;\n"
+       "  }\n"
+       "}\n");
+  // 3 * 45 - 55 / 5
+  EXPECT_EQ(vm.run(), 124);
+
+  // The VM has 16 bit words
+  exec::VMInterpreter wrap{in, out};
+  wrap.load("function Main.main 0\n"
+            "push constant 32767\n"
+            "push constant 1\n"
+            "add\n"
+            "return\n",
+            "Main");
+  EXPECT_EQ(wrap.run(), -32768);
+}
+
+TEST(VMInterpreterTest, Objects) {
+  std::istringstream in{"42\n"};
+  std::ostringstream out;
+  exec::VMInterpreter vm{in, out};
+  load(vm,
+       "class Point {\n"
+       "  field int x, y;\n"
+       "  static int count;\n"
+       "  constructor Point new(int ax, int ay) {\n"
+       "    let x = ax;\n"
+       "    let y = ay;\n"
+       "    let count = count + 1;\n"
+       "    return this;\n"
+       "  }\n"
+       "  method int sum() { return x + y; }\n"
+       "  function int count() { return count; }\n"
+       "}\n");
+  load(vm,
+       "class Main {\n"
+       "  function int main() {\n"
+       "    var Array a;\n"
+       "    var Point p;\n"
+       "    var int n;\n"
+       "    let n = Keyboard.readInt(\"n? \");\n"
+       "    let a = Array.new(2);\n"
+       "    let a[0] = Point.new(1, 2);\n"
+       "    let a[1] = Point.new(n, 3);\n"
+       "    let p = a[1];\n"
+       "    do Output.printString(\"sum \");\n"
+       "    do Output.printInt(p.sum());\n"
+       "    do Output.println();\n"
+       "    return Point.count();\n"
+       "  }\n"
+       "}\n");
+  EXPECT_EQ(vm.run(), 2);
+  EXPECT_EQ(out.str(), "n? sum 45\n");
+}
+
+TEST(VMInterpreterTest, Errors) {
+  std::istringstream in;
+  std::ostringstream out;
+  exec::VMInterpreter vm{in, out};
+  vm.load("function Main.main 0\n"
+          "call Main.missing 0\n"
+          "return\n",
+          "Main");
+  EXPECT_THROW(vm.run(), SyntaxError);
+
+  exec::VMInterpreter divide{in, out};
+  load(divide,
+       "class Main {\n"
+       "  function int main() {\n"
+       "    var int zero;\n"
+       "    return 1 / zero;\n"
+       "  }\n"
+       "}\n");
+  EXPECT_THROW(divide.run(), std::runtime_error);
+
+  exec::VMInterpreter recurse{in, out};
+  load(recurse,
+       "class Main {\n"
+       "  function int main() { return Main.main(); }\n"
+       "}\n");
+  EXPECT_THROW(recurse.run(), std::runtime_error);
+
+  exec::VMInterpreter label{in, out};
+  EXPECT_THROW(label.load("function Main.main 0\n"
+                          "goto END\n",
+                          "Main"),
+               SyntaxError);
+}
+
+TEST(VMInterpreterTest, LargeConstants) {
+  const std::string source =
+      "class Main {\n"
+      "  function int main() {\n"
+      "    var int x;\n"
+      "    let x = 100000;\n"
+      "    return (x - 99990) + 40000;\n"
+      "  }\n"
+      "}\n";
+  CompilationEngine engine{std::make_unique<std::istringstream>(source)};
+  auto cls = engine.compileClass();
+  Resolver::run(*cls);
+  const std::string code = VMGenerator::generate(*cls);
+  EXPECT_EQ(code.find("100000"), std::string::npos) << code;
+  EXPECT_EQ(code.find("40000"), std::string::npos) << code;
+
+  // The constants keep their low 16 bits, so the words compute the same
+  std::istringstream in;
+  std::ostringstream out;
+  exec::VMInterpreter vm{in, out};
+  vm.load(code, "Main");
+  EXPECT_EQ(vm.run(), static_cast<int16_t>(10 + 40000));
+}